@@ -31,6 +31,7 @@
 
 
 #include "zernike.h"
+#include "zernike_basis.h"
 #include "zernike_value.h"
 
 #include "ZernikePolyn/ZernikePolyn.h"
@@ -145,88 +146,113 @@ static errno_t init_module_CLI()
 
 
 
-imageID mk_zer(const char *ID_name, long SIZE, long zer_nb, float rpix)
+// mk_zer settings, read from CLI variables
+//
+typedef struct
+{
+    double coeffextend1; // ZEXTENDc1, extension beyond radius if > 0
+    double coeffextend2; // ZEXTENDc2
+    double xoffset;      // Zxoffset
+    double yoffset;      // Zyoffset
+} MKZER_PARAMS;
+
+static void mk_zer_readparams(MKZER_PARAMS *zp)
 {
-    long    ii, jj;
-    double  r, theta;
     imageID ID;
-    long    naxes[2];
-    long    n, m;
-    double  coeffextend1 = -1.0;
-    double  coeffextend2 = 0.3;
-    double  coeffextend3 = 4.0;
-    double  ss           = 0.0;
-    double  xoffset      = 0.0;
-    double  yoffset      = 0.0;
-    double  x, y;
+
+    zp->coeffextend1 = -1.0;
+    zp->coeffextend2 = 0.3;
+    zp->xoffset      = 0.0;
+    zp->yoffset      = 0.0;
 
     ID = variable_ID("ZEXTENDc1");
     if(ID != -1)
     {
-        coeffextend1 = data.variable[ID].value.f;
-        printf("ZEXTENDc1 = %f\n", coeffextend1);
+        zp->coeffextend1 = data.variable[ID].value.f;
+        printf("ZEXTENDc1 = %f\n", zp->coeffextend1);
     }
 
     ID = variable_ID("ZEXTENDc2");
     if(ID != -1)
     {
-        coeffextend2 = data.variable[ID].value.f;
-        printf("ZEXTENDc2 = %f\n", coeffextend2);
+        zp->coeffextend2 = data.variable[ID].value.f;
+        printf("ZEXTENDc2 = %f\n", zp->coeffextend2);
     }
 
     ID = variable_ID("Zxoffset");
     if(ID != -1)
     {
-        xoffset = data.variable[ID].value.f;
-        printf("Zxoffset = %f\n", xoffset);
+        zp->xoffset = data.variable[ID].value.f;
+        printf("Zxoffset = %f\n", zp->xoffset);
     }
     ID = variable_ID("Zyoffset");
     if(ID != -1)
     {
-        yoffset = data.variable[ID].value.f;
-        printf("Zyoffset = %f\n", yoffset);
+        zp->yoffset = data.variable[ID].value.f;
+        printf("Zyoffset = %f\n", zp->yoffset);
     }
+}
 
-    naxes[0] = SIZE;
-    naxes[1] = SIZE;
-
-    zernike_init();
-
-
-    n = Zernike_n(zer_nb);
-    m = Zernike_m(zer_nb);
-    printf("Z = %ld    :  n = %ld, m = %ld\n", zer_nb, n, m);
+// mk_zer with settings already read, for loops over modes
+//
+static imageID mk_zer_p(const char         *ID_name,
+                        long                SIZE,
+                        long                zer_nb,
+                        float               rpix,
+                        const MKZER_PARAMS *zp)
+{
+    long         ii, jj;
+    double       r, theta;
+    imageID      ID;
+    int          n, m;
+    double       coeffextend3 = 4.0;
+    double       ss           = 0.0;
+    double       x, y;
+    ZERNIKE_GEOM geom;
+
+    // zer_nb 0 is piston, Noll index 1
+    zernike_Noll_nm(zer_nb + 1, &n, &m);
+    printf("Z = %ld    :  n = %d, m = %d\n", zer_nb, n, m);
     create_2Dimage_ID(ID_name, SIZE, SIZE, &ID);
 
-    /* let's compute the polar coordinates */
-    ss = 0.0;
-    for(ii = 0; ii < SIZE; ii++)
-        for(jj = 0; jj < SIZE; jj++)
-        {
-            x = 1.0 * (ii - SIZE / 2) - xoffset;
-            y = 1.0 * (jj - SIZE / 2) - yoffset;
+    // inside unit circle : cached polar grid
+    memset(&geom, 0, sizeof(ZERNIKE_GEOM));
+    geom.xsize  = SIZE;
+    geom.ysize  = SIZE;
+    geom.xcent  = SIZE / 2 + zp->xoffset;
+    geom.ycent  = SIZE / 2 + zp->yoffset;
+    geom.xsign  = 1;
+    geom.ysign  = 1;
+    geom.radius = rpix;
+    geom.rmax   = 1.0;
+    zernike_basis_cube(&geom, zer_nb + 1, 1, data.image[ID].array.F);
 
-            r     = sqrt(x * x + y * y) / rpix;
-            theta = atan2(y, x);
-            if(r < 1.0)
-            {
-                data.image[ID].array.F[jj * naxes[0] + ii] =
-                    Zernike_value(zer_nb, r, theta);
-                //printf("%f\n", Zernike_value(zer_nb,r,theta));
-                ss += data.image[ID].array.F[jj * naxes[0] + ii] *
-                      data.image[ID].array.F[jj * naxes[0] + ii];
-            }
-            else if(coeffextend1 > 0)
+    for(ii = 0; ii < SIZE * SIZE; ii++)
+    {
+        ss += data.image[ID].array.F[ii] * data.image[ID].array.F[ii];
+    }
+
+    // outside : smooth extension of edge value
+    if(zp->coeffextend1 > 0)
+    {
+        for(ii = 0; ii < SIZE; ii++)
+            for(jj = 0; jj < SIZE; jj++)
             {
-                r = 1.0 + (r - 1.0) / (1.0 + coeffextend1 * (r - 1.0));
-                data.image[ID].array.F[jj * naxes[0] + ii] =
-                    Zernike_value(zer_nb, 1.0, theta);
-                data.image[ID].array.F[jj * naxes[0] + ii] *=
-                    exp(-pow((r - 1.0) / (rpix * coeffextend2), coeffextend3));
-                //	data.image[ID].array.F[jj*naxes[0]+ii] = r;
-                //printf("%f %f\n", Zernike_value(zer_nb, 1.0, theta), exp(-pow((r-1.0)/(rpix*coeffextend2), coeffextend3)));
+                x = 1.0 * (ii - SIZE / 2) - zp->xoffset;
+                y = 1.0 * (jj - SIZE / 2) - zp->yoffset;
+
+                r = sqrt(x * x + y * y) / rpix;
+                if(r >= 1.0)
+                {
+                    theta = atan2(y, x);
+                    r     = 1.0 + (r - 1.0) / (1.0 + zp->coeffextend1 * (r - 1.0));
+                    data.image[ID].array.F[jj * SIZE + ii] =
+                        zernike_edge_value(zer_nb + 1, theta) *
+                        exp(-pow((r - 1.0) / (rpix * zp->coeffextend2),
+                                 coeffextend3));
+                }
             }
-        }
+    }
 
     if(zer_nb > 0)
     {
@@ -249,13 +275,13 @@ imageID mk_zer(const char *ID_name, long SIZE, long zer_nb, float rpix)
                     rpix;
                 if(r > 1.0)
                 {
-                    if(coeffextend1 < 0)
+                    if(zp->coeffextend1 < 0)
                     {
-                        data.image[ID].array.F[jj * naxes[0] + ii] = 0.0;
+                        data.image[ID].array.F[jj * SIZE + ii] = 0.0;
                     }
                     else
                     {
-                        data.image[ID].array.F[jj * naxes[0] + ii] = 1.0;
+                        data.image[ID].array.F[jj * SIZE + ii] = 1.0;
                     }
                 }
             }
@@ -264,6 +290,15 @@ imageID mk_zer(const char *ID_name, long SIZE, long zer_nb, float rpix)
     return ID;
 }
 
+imageID mk_zer(const char *ID_name, long SIZE, long zer_nb, float rpix)
+{
+    MKZER_PARAMS zp;
+
+    mk_zer_readparams(&zp);
+
+    return mk_zer_p(ID_name, SIZE, zer_nb, rpix, &zp);
+}
+
 // continue Zernike exp. beyond nominal radius, using the same polynomial expression
 imageID
 mk_zer_unbounded(const char *ID_name, long SIZE, long zer_nb, float rpix)
@@ -482,91 +517,32 @@ errno_t mk_zer_series(const char *ID_name, long SIZE, long zer_nb, float rpix)
 imageID
 mk_zer_seriescube(const char *ID_namec, long SIZE, long zer_nb, float rpix)
 {
-    long    ii, jj;
-    double *r;
-    double *theta;
-    imageID ID;
-    long    naxes[2];
-    double  tmp;
-    long    j;
-
-    j        = 0;
-    naxes[0] = SIZE;
-    naxes[1] = SIZE;
-
-    zernike_init();
+    imageID      ID;
+    ZERNIKE_GEOM geom;
 
     create_3Dimage_ID(ID_namec, SIZE, SIZE, zer_nb, &ID);
-    //    ID = image_ID("ztmp");
-
-    r = (double *) malloc(SIZE * SIZE * sizeof(double));
-    if(r == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
 
-    theta = (double *) malloc(SIZE * SIZE * sizeof(double));
-    if(theta == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    /* let's compute the polar coordinates */
-    for(ii = 0; ii < SIZE; ii++)
-        for(jj = 0; jj < SIZE; jj++)
-        {
-            r[jj * naxes[0] + ii] =
-                sqrt((0.5 + ii - SIZE / 2) * (0.5 + ii - SIZE / 2) +
-                     (0.5 + jj - SIZE / 2) * (0.5 + jj - SIZE / 2)) /
-                rpix;
-            theta[jj * naxes[0] + ii] = atan2((jj - SIZE / 2), (ii - SIZE / 2));
-        }
-
-    /* let's make the Zernikes */
-    for(ii = 0; ii < SIZE; ii++)
-        for(jj = 0; jj < SIZE; jj++)
-        {
-            tmp = r[jj * naxes[0] + ii];
-            if(tmp < 1.0)
-            {
-                data.image[ID].array.F[jj * SIZE + ii] = 1.0;
-            }
-            else
-            {
-                data.image[ID].array.F[jj * SIZE + ii] = 0.0;
-            }
-        }
-    for(j = 1; j < zer_nb; j++)
-    {
-        /*	printf("%ld/%ld\n",j,zer_nb);*/
-        //        fflush(stdout);
+    // r and theta share the same pixel-centered origin
+    memset(&geom, 0, sizeof(ZERNIKE_GEOM));
+    geom.xsize  = SIZE;
+    geom.ysize  = SIZE;
+    geom.xcent  = SIZE / 2 - 0.5;
+    geom.ycent  = SIZE / 2 - 0.5;
+    geom.xsign  = 1;
+    geom.ysign  = 1;
+    geom.radius = rpix;
+    geom.rmax   = 1.0;
 
-        for(ii = 0; ii < SIZE; ii++)
-            for(jj = 0; jj < SIZE; jj++)
-            {
-                tmp = r[jj * naxes[0] + ii];
-                if(tmp < 1.0)
-                {
-                    data.image[ID].array.F[j * SIZE * SIZE + jj * SIZE + ii] =
-                        Zernike_value(j, tmp, theta[jj * naxes[0] + ii]);
-                }
-                else
-                {
-                    data.image[ID].array.F[j * SIZE * SIZE + jj * SIZE + ii] =
-                        0.0;
-                }
-            }
-    }
-
-    free(r);
-    free(theta);
+    // first slice is piston (Noll index 1)
+    zernike_basis_cube(&geom, 1, zer_nb, data.image[ID].array.F);
 
     return ID;
 }
 
-double get_zer(const char *ID_name, long zer_nb, double radius)
+static double get_zer_p(const char         *ID_name,
+                        long                zer_nb,
+                        double              radius,
+                        const MKZER_PARAMS *zp)
 {
     double  value;
     long    SIZE;
@@ -590,7 +566,7 @@ double get_zer(const char *ID_name, long zer_nb, double radius)
         }
         else
         {
-            mk_zer(fname1, SIZE, zer_nb, radius);
+            mk_zer_p(fname1, SIZE, zer_nb, radius, zp);
         }
     }
 
@@ -604,6 +580,15 @@ double get_zer(const char *ID_name, long zer_nb, double radius)
     return (value);
 }
 
+double get_zer(const char *ID_name, long zer_nb, double radius)
+{
+    MKZER_PARAMS zp;
+
+    mk_zer_readparams(&zp);
+
+    return get_zer_p(ID_name, zer_nb, radius, &zp);
+}
+
 double
 get_zer_crop(const char *ID_name, long zer_nb, double radius, double radius1)
 {
@@ -647,9 +632,12 @@ get_zer_crop(const char *ID_name, long zer_nb, double radius, double radius1)
 
 int get_zerns(const char *ID_name, long max_zer, double radius)
 {
+    MKZER_PARAMS zp;
+
+    mk_zer_readparams(&zp);
     for(long i = 0; i < max_zer; i++)
     {
-        printf("%ld %e\n", i, get_zer(ID_name, i, radius));
+        printf("%ld %e\n", i, get_zer_p(ID_name, i, radius, &zp));
     }
 
     return (0);
@@ -660,11 +648,14 @@ int get_zern_array(const char *ID_name,
                    double      radius,
                    double     *array)
 {
+    MKZER_PARAMS zp;
+
+    mk_zer_readparams(&zp);
     for(long i = 0; i < max_zer; i++)
     {
         double tmp;
 
-        tmp = get_zer(ID_name, i, radius);
+        tmp = get_zer_p(ID_name, i, radius, &zp);
         /*     printf("%ld %e\n",i,tmp);*/
         array[i] = tmp;
     }
@@ -677,9 +668,11 @@ int remove_zerns(const char *ID_name,
                  int         max_zer,
                  double      radius)
 {
-    imageID ID;
-    long    SIZE;
+    imageID      ID;
+    long         SIZE;
+    MKZER_PARAMS zp;
 
+    mk_zer_readparams(&zp);
     copy_image_ID(ID_name, ID_name_out, 0);
     ID   = image_ID(ID_name);
     SIZE = data.image[ID].md[0].size[0];
@@ -687,8 +680,8 @@ int remove_zerns(const char *ID_name,
     {
         double coeff;
 
-        mk_zer("zer_tmp", SIZE, i, radius);
-        coeff = -1.0 * get_zer(ID_name, i, radius);
+        mk_zer_p("zer_tmp", SIZE, i, radius, &zp);
+        coeff = -1.0 * get_zer_p(ID_name, i, radius, &zp);
         arith_image_cstmult_inplace("zer_tmp", coeff);
         arith_image_add(ID_name_out, "zer_tmp", "tmp");
         delete_image_ID(ID_name_out, DELETE_IMAGE_ERRMODE_WARNING);
@@ -737,11 +730,13 @@ long ZERNIKEPOLYN_rmPiston(const char *ID_name, const char *IDmask_name)
 
 int remove_TTF(const char *ID_name, const char *ID_name_out, double radius)
 {
-    int     i;
-    double  coeff;
-    imageID ID;
-    long    SIZE;
+    int          i;
+    double       coeff;
+    imageID      ID;
+    long         SIZE;
+    MKZER_PARAMS zp;
 
+    mk_zer_readparams(&zp);
     //  printf("-- %s  --- %s --\n",ID_name,ID_name_out);
     copy_image_ID(ID_name, ID_name_out, 0);
     ID   = image_ID(ID_name);
@@ -752,13 +747,13 @@ int remove_TTF(const char *ID_name, const char *ID_name_out, double radius)
     {
         if((i == 0) || (i == 1) || (i == 2) || (i == 4))
         {
-            mk_zer("zer_tmp", SIZE, i, radius);
+            mk_zer_p("zer_tmp", SIZE, i, radius, &zp);
             arith_image_mult("zer_tmp", ID_name, "mult_tmp");
             //coeff = arith_image_total("mult_tmp")/arith_image_total("disktmpttf");
             delete_image_ID("mult_tmp", DELETE_IMAGE_ERRMODE_WARNING);
-            coeff               = -1.0 * get_zer(ID_name, i, radius);
+            coeff               = -1.0 * get_zer_p(ID_name, i, radius, &zp);
             data.DOUBLEARRAY[i] = coeff;
-            mk_zer("zer_tmpu", SIZE, i, radius);
+            mk_zer_p("zer_tmpu", SIZE, i, radius, &zp);
             arith_image_cstmult_inplace("zer_tmpu", coeff);
             //	  basic_add(ID_name_out,"zer_tmpu","tmp",0,0);
             arith_image_add(ID_name_out, "zer_tmpu", "tmp");
@@ -792,6 +787,9 @@ double fit_zer(const char *ID_name,
     double  value;
     double  residualf = 0.0;
 
+    MKZER_PARAMS zp;
+    mk_zer_readparams(&zp);
+
     NBpass = 10;
 
     copy_image_ID(ID_name, "resid", 0);
@@ -828,7 +826,7 @@ double fit_zer(const char *ID_name,
                 }
                 else
                 {
-                    IDZ = mk_zer(fname1, SIZE, i, radius);
+                    IDZ = mk_zer_p(fname1, SIZE, i, radius, &zp);
                 }
             }
             tmp = 0.0;
@@ -9,7 +9,7 @@
 
 #include <math.h>
 
-#include "zernike_value.h"
+#include "zernike_basis.h"
 
 
 // zonal WFS response
@@ -185,87 +185,43 @@ static errno_t compute_function()
 {
     DEBUG_TRACE_FSTART();
 
-    zernike_init();
-
     IMGID imgout = makeIMGID_3D(outzcubename, *xsize, *ysize, *NBzermode);
     createimagefromIMGID(&imgout);
 
     uint64_t xysize = *xsize;
     xysize *= *ysize;
 
-    double *polar_r;
-    double *polar_theta;
-
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_START
     {
-        polar_r = (double *) malloc(xysize * sizeof(double));
-        if(polar_r == NULL)
-        {
-            PRINT_ERROR("malloc returns NULL pointer");
-            abort();
-        }
-
-        polar_theta = (double *) malloc(xysize * sizeof(double));
-        if(polar_theta == NULL)
-        {
-            PRINT_ERROR("malloc returns NULL pointer");
-            abort();
-        }
-
-        if((polar_r == NULL) || (polar_theta == NULL))
-        {
-            printf("error in memory allocation !!!\n");
-        }
-
-        // polar coordinates
+        // x = xcent - ii, y = ycent - jj
         //
-        for(uint32_t ii = 0; ii < *xsize; ii++)
-        {
-            float x = (*xcent) - ii;
-            for(uint32_t jj = 0; jj < *ysize; jj++)
-            {
-                float y = (*ycent) - jj;
-                polar_r[jj * (*xsize) + ii] = sqrt(x * x + y * y) / (*radius);
-
-                polar_theta[jj * (*xsize) + ii] = atan2(y, x);
-            }
-        }
-
-
-        // Make Zernikes
+        ZERNIKE_GEOM geom;
+        memset(&geom, 0, sizeof(ZERNIKE_GEOM));
+        geom.xsize  = *xsize;
+        geom.ysize  = *ysize;
+        geom.xcent  = *xcent;
+        geom.ycent  = *ycent;
+        geom.xsign  = -1;
+        geom.ysign  = -1;
+        geom.radius = *radius;
+        geom.rmax   = *radiusmaskfactor;
+
+        // Make Zernikes, starting at tip (Noll index 2)
         //
-        for(uint32_t zi = 0; zi < (*NBzermode); zi++)
+        FUNC_CHECK_RETURN(
+            zernike_basis_cube(&geom, 2, *NBzermode, imgout.im->array.F));
+
+        for(uint32_t zi = 0; (zi < 2) && (zi < (*NBzermode)); zi++)
         {
-            float ampl = 1.0;
-            if((zi == 0) || (zi == 1))
-            {
-                ampl = *TTfactor;
-            }
-            else
+            for(uint64_t ii = 0; ii < xysize; ii++)
             {
-                ampl = 1.0;
-            }
-            for(uint32_t ii = 0; ii < xysize; ii++)
-            {
-                float r = polar_r[ii];
-                if(r < (*radiusmaskfactor))
-                {
-                    imgout.im->array.F[zi * xysize + ii] = ampl * Zernike_value(zi + 1, r,
-                                                           polar_theta[ii]);
-                }
-                else
-                {
-                    imgout.im->array.F[ii] = 0.0;
-                }
+                imgout.im->array.F[zi * xysize + ii] *= *TTfactor;
             }
         }
     }
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
-    free(polar_r);
-    free(polar_theta);
-
 
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
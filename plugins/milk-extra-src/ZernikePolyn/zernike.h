@@ -22,8 +22,6 @@ typedef struct
     // This points to the index in this structure for Noll index
     //
     long   *Zer_reverseNollindex;
-
-    double *R_array;
 } ZERNIKE;
 
 
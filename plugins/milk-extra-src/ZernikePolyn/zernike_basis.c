@@ -0,0 +1,412 @@
+/**
+ * @file zernike_basis.c
+ *
+ * Zernike basis cube generator
+ *
+ * Radial polynomials are evaluated with Kintner's three-term recurrence,
+ * angular terms with the angle addition recurrence, so that all modes
+ * are computed in a single pass over pixels without factorials or pow().
+ *
+ * Polar grid (r, cos, sin) is cached, keyed by geometry.
+ * Last computed cube is also cached if smaller than ZERNIKE_CACHE_MAXBYTES,
+ * so that repeated cube requests are a copy without holding a second
+ * copy of large cubes.
+ */
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "zernike_basis.h"
+
+
+#define OMP_NELEMENT_LIMIT 1000000
+
+// largest cube kept in cache
+#define ZERNIKE_CACHE_MAXBYTES (64UL * 1024 * 1024)
+
+
+// cached grid and basis
+//
+static ZERNIKE_GEOM cache_geom;
+static int          cache_gridOK = 0;
+static double      *cache_r      = NULL; // normalized radius
+static double      *cache_cos    = NULL; // cos(theta)
+static double      *cache_sin    = NULL; // sin(theta)
+
+static float *cache_cube   = NULL;
+static long   cache_Noll0  = 0;
+static long   cache_NBmode = 0;
+
+
+
+
+/**
+ * @brief Radial order n and azimuthal frequency m of Noll index
+ *
+ * Noll index starts at 1 for piston.
+ * m > 0 for cosine terms (even Noll index), m < 0 for sine terms.
+ */
+void zernike_Noll_nm(long Nollindex, int *n, int *m)
+{
+    int nn = 0;
+    while(Nollindex > (long)(nn + 1) * (nn + 2) / 2)
+    {
+        nn++;
+    }
+
+    // rank within radial order
+    long jr = Nollindex - (long) nn * (nn + 1) / 2 - 1;
+
+    int mabs;
+    if(nn % 2 == 0)
+    {
+        mabs = 2 * ((jr + 1) / 2);
+    }
+    else
+    {
+        mabs = 2 * (jr / 2) + 1;
+    }
+
+    *n = nn;
+    if((mabs == 0) || (Nollindex % 2 == 0))
+    {
+        *m = mabs;
+    }
+    else
+    {
+        *m = -mabs;
+    }
+}
+
+
+
+
+/**
+ * @brief Kintner recurrence coefficients, R_n = (K2 r^2 + K3) R_{n-2} + K4 R_{n-4}
+ *
+ * Valid for n >= m + 4, coefficients already divided by K1.
+ */
+static inline void zernike_Kintner_coeff(
+    int     n,
+    int     m,
+    double *K2,
+    double *K3,
+    double *K4
+)
+{
+    double K1 = 1.0 * (n + m) * (n - m) * (n - 2);
+
+    *K2 = 4.0 * n * (n - 1) * (n - 2) / K1;
+    *K3 = -2.0 * (n - 1) * (m * m + n * (n - 2)) / K1;
+    *K4 = -1.0 * n * (n + m - 2) * (n - m - 2) / K1;
+}
+
+
+
+
+/**
+ * @brief Unnormalized radial polynomial R_n^|m|(r)
+ */
+double zernike_radial(int n, int m, double r)
+{
+    m = abs(m);
+    if((n < m) || ((n - m) % 2 != 0))
+    {
+        return 0.0;
+    }
+
+    double r2  = r * r;
+    double Rm4 = pow(r, m);                          // R_m^m
+    if(n == m)
+    {
+        return Rm4;
+    }
+    double Rm2 = ((m + 2) * r2 - (m + 1)) * Rm4;     // R_{m+2}^m
+
+    for(int nn = m + 4; nn <= n; nn += 2)
+    {
+        double K2, K3, K4;
+        zernike_Kintner_coeff(nn, m, &K2, &K3, &K4);
+        double R = (K2 * r2 + K3) * Rm2 + K4 * Rm4;
+        Rm4      = Rm2;
+        Rm2      = R;
+    }
+
+    return Rm2;
+}
+
+
+
+
+/**
+ * @brief Value of Zernike polynomial on unit circle, normalized as zernike_basis_cube()
+ *
+ * R_n^m(1) = 1, so only the angular term remains.
+ */
+double zernike_edge_value(long Nollindex, double theta)
+{
+    int n, m;
+    zernike_Noll_nm(Nollindex, &n, &m);
+
+    double value = sqrt(n + 1.0);
+    if(m > 0)
+    {
+        value *= sqrt(2.0) * cos(m * theta);
+    }
+    else if(m < 0)
+    {
+        value *= sqrt(2.0) * sin(-m * theta);
+    }
+
+    return value;
+}
+
+
+
+
+static errno_t zernike_basis_grid(const ZERNIKE_GEOM *geom)
+{
+    if(cache_gridOK == 1)
+    {
+        if(memcmp(geom, &cache_geom, sizeof(ZERNIKE_GEOM)) == 0)
+        {
+            return RETURN_SUCCESS;
+        }
+    }
+
+    uint64_t xysize = geom->xsize;
+    xysize *= geom->ysize;
+
+    free(cache_r);
+    free(cache_cos);
+    free(cache_sin);
+    free(cache_cube);
+    cache_cube   = NULL;
+    cache_NBmode = 0;
+
+    cache_r   = (double *) malloc(sizeof(double) * xysize);
+    cache_cos = (double *) malloc(sizeof(double) * xysize);
+    cache_sin = (double *) malloc(sizeof(double) * xysize);
+    if((cache_r == NULL) || (cache_cos == NULL) || (cache_sin == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    for(uint32_t jj = 0; jj < geom->ysize; jj++)
+    {
+        double y = geom->ysign * (jj - geom->ycent);
+        for(uint32_t ii = 0; ii < geom->xsize; ii++)
+        {
+            double   x   = geom->xsign * (ii - geom->xcent);
+            double   rho = sqrt(x * x + y * y);
+            uint64_t pix = (uint64_t) jj * geom->xsize + ii;
+
+            cache_r[pix] = rho / geom->radius;
+            if(rho > 0.0)
+            {
+                cache_cos[pix] = x / rho;
+                cache_sin[pix] = y / rho;
+            }
+            else
+            {
+                // same convention as atan2(0,0) = 0
+                cache_cos[pix] = 1.0;
+                cache_sin[pix] = 0.0;
+            }
+        }
+    }
+
+    memcpy(&cache_geom, geom, sizeof(ZERNIKE_GEOM));
+    cache_gridOK = 1;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Compute Zernike cube, NBmode slices starting at Noll index Noll0
+ *
+ * Normalization matches Zernike_value() : unit RMS over unit circle.
+ * Pixels with normalized radius >= rmax are set to zero.
+ *
+ * Polar grid is cached. Cubes up to ZERNIKE_CACHE_MAXBYTES are also
+ * cached : a following call with same geometry and Noll0, and NBmode
+ * not larger, is a copy.
+ */
+errno_t zernike_basis_cube(
+    const ZERNIKE_GEOM *geom,
+    long                Noll0,
+    long                NBmode,
+    float              *outarray
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    uint64_t xysize = geom->xsize;
+    xysize *= geom->ysize;
+
+    FUNC_CHECK_RETURN(zernike_basis_grid(geom));
+
+    if((cache_cube != NULL) && (cache_Noll0 == Noll0) &&
+            (cache_NBmode >= NBmode))
+    {
+        memcpy(outarray, cache_cube, sizeof(float) * xysize * NBmode);
+
+        DEBUG_TRACE_FEXIT();
+        return RETURN_SUCCESS;
+    }
+
+    // radial order and frequency range
+    int nmax = 0;
+    for(long zi = 0; zi < NBmode; zi++)
+    {
+        int n, m;
+        zernike_Noll_nm(Noll0 + zi, &n, &m);
+        if(n > nmax)
+        {
+            nmax = n;
+        }
+    }
+
+    // slice index of (n,m) cos and sin terms, -1 if not computed
+    int *slicecos = (int *) malloc(sizeof(int) * (nmax + 1) * (nmax + 1));
+    int *slicesin = (int *) malloc(sizeof(int) * (nmax + 1) * (nmax + 1));
+    if((slicecos == NULL) || (slicesin == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    for(int k = 0; k < (nmax + 1) * (nmax + 1); k++)
+    {
+        slicecos[k] = -1;
+        slicesin[k] = -1;
+    }
+    for(long zi = 0; zi < NBmode; zi++)
+    {
+        int n, m;
+        zernike_Noll_nm(Noll0 + zi, &n, &m);
+        if(m >= 0)
+        {
+            slicecos[n * (nmax + 1) + m] = zi;
+        }
+        else
+        {
+            slicesin[n * (nmax + 1) - m] = zi;
+        }
+    }
+
+    // computed in place, cache copy made afterwards if small enough
+    float *cube = outarray;
+
+    double s2 = sqrt(2.0);
+
+#ifdef _OPENMP
+    #pragma omp parallel if (xysize * NBmode > OMP_NELEMENT_LIMIT)
+    {
+        #pragma omp for
+#endif
+        for(uint64_t pix = 0; pix < xysize; pix++)
+        {
+            double r = cache_r[pix];
+
+            if(r >= geom->rmax)
+            {
+                for(long zi = 0; zi < NBmode; zi++)
+                {
+                    cube[zi * xysize + pix] = 0.0;
+                }
+                continue;
+            }
+
+            double r2   = r * r;
+            double c1   = cache_cos[pix];
+            double s1   = cache_sin[pix];
+            double cm   = 1.0; // cos(m theta)
+            double sm   = 0.0; // sin(m theta)
+            double rpow = 1.0; // r^m
+
+            for(int m = 0; m <= nmax; m++)
+            {
+                double Rm4 = 0.0;
+                double Rm2 = 0.0;
+                for(int n = m; n <= nmax; n += 2)
+                {
+                    double R;
+                    if(n == m)
+                    {
+                        R = rpow;
+                    }
+                    else if(n == m + 2)
+                    {
+                        R = ((m + 2) * r2 - (m + 1)) * rpow;
+                    }
+                    else
+                    {
+                        double K2, K3, K4;
+                        zernike_Kintner_coeff(n, m, &K2, &K3, &K4);
+                        R = (K2 * r2 + K3) * Rm2 + K4 * Rm4;
+                    }
+                    Rm4 = Rm2;
+                    Rm2 = R;
+
+                    double norm = sqrt(n + 1.0);
+                    int    zc   = slicecos[n * (nmax + 1) + m];
+                    int    zs   = slicesin[n * (nmax + 1) + m];
+                    if(m == 0)
+                    {
+                        if(zc != -1)
+                        {
+                            cube[zc * xysize + pix] = norm * R;
+                        }
+                    }
+                    else
+                    {
+                        if(zc != -1)
+                        {
+                            cube[zc * xysize + pix] = s2 * norm * R * cm;
+                        }
+                        if(zs != -1)
+                        {
+                            cube[zs * xysize + pix] = s2 * norm * R * sm;
+                        }
+                    }
+                }
+
+                // next azimuthal frequency
+                double cmn = cm * c1 - sm * s1;
+                sm         = sm * c1 + cm * s1;
+                cm         = cmn;
+                rpow *= r;
+            }
+        }
+#ifdef _OPENMP
+    }
+#endif
+
+    free(slicecos);
+    free(slicesin);
+
+    free(cache_cube);
+    cache_cube   = NULL;
+    cache_NBmode = 0;
+    if(sizeof(float) * xysize * NBmode <= ZERNIKE_CACHE_MAXBYTES)
+    {
+        cache_cube = (float *) malloc(sizeof(float) * xysize * NBmode);
+        if(cache_cube != NULL)
+        {
+            memcpy(cache_cube, outarray, sizeof(float) * xysize * NBmode);
+            cache_Noll0  = Noll0;
+            cache_NBmode = NBmode;
+        }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
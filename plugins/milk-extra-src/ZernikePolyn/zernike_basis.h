@@ -0,0 +1,41 @@
+/**
+ * @file zernike_basis.h
+ */
+
+
+#ifndef _ZERNIKEPOLYN_BASIS_H
+#define _ZERNIKEPOLYN_BASIS_H
+
+// pixel grid geometry
+//
+typedef struct
+{
+    uint32_t xsize;
+    uint32_t ysize;
+
+    // x = xsign * (ii - xcent), y = ysign * (jj - ycent)
+    double xcent;
+    double ycent;
+    int    xsign;
+    int    ysign;
+
+    double radius; // unit circle radius [pix]
+    double rmax;   // zero beyond this normalized radius
+
+} ZERNIKE_GEOM;
+
+
+void zernike_Noll_nm(long Nollindex, int *n, int *m);
+
+double zernike_radial(int n, int m, double r);
+
+double zernike_edge_value(long Nollindex, double theta);
+
+errno_t zernike_basis_cube(
+    const ZERNIKE_GEOM *geom,
+    long                Noll0,
+    long                NBmode,
+    float              *outarray
+);
+
+#endif
@@ -10,6 +10,7 @@
 
 #include "CommandLineInterface/CLIcore.h"
 #include "zernike.h"
+#include "zernike_basis.h"
 
 #include "COREMOD_tools/COREMOD_tools.h"
 
@@ -40,8 +41,8 @@ int zernike_init()
 
     if(zernikeinit == 0)
     {
-        long j, n, m, s;
-        long ii, jj;
+        long j, n, m;
+        long ii;
 
         Zernike.ZERMAX = zermax;
 
@@ -62,15 +63,6 @@ int zernike_init()
             abort();
         }
 
-        Zernike.R_array =
-            (double *) malloc(Zernike.ZERMAX * Zernike.ZERMAX * sizeof(double));
-        if(Zernike.R_array == NULL)
-        {
-            printf("malloc returns NULL pointer");
-            abort();
-        }
-
-
         Zernike.Zer_Nollindex = (long *) malloc(Zernike.ZERMAX * sizeof(long));
         if(Zernike.Zer_Nollindex == NULL)
         {
@@ -135,33 +127,6 @@ int zernike_init()
             index_Nollsort[j] = j;
         }
 
-        /* R_array is initialised */
-        for(ii = 0; ii < Zernike.ZERMAX; ii++)
-            for(jj = 0; jj < Zernike.ZERMAX; jj++)
-            {
-                Zernike.R_array[jj * Zernike.ZERMAX + ii] = 0;
-            }
-
-        /* now the R_array is computed */
-        for(j = 1; j < Zernike.ZERMAX; j++)
-        {
-            m = labs(Zernike.Zer_m[j]);
-            for(s = 0; s < ((int)(0.5 * (Zernike.Zer_n[j] - m) + 1)); s++)
-            {
-                Zernike.R_array[j * Zernike.ZERMAX + Zernike.Zer_n[j] - 2 * s] =
-                    pow(-1, s) * fact(Zernike.Zer_n[j] - s) / fact(s) /
-                    fact((Zernike.Zer_n[j] + m) / 2 - s) /
-                    fact((Zernike.Zer_n[j] - m) / 2 - s);
-            }
-        }
-
-        for(ii = 0; ii < Zernike.ZERMAX; ii++)
-            for(jj = 0; jj < Zernike.ZERMAX; jj++)
-            {
-                Zernike.R_array[jj * Zernike.ZERMAX + ii] *=
-                    sqrt(Zernike.Zer_n[jj] + 1);
-            }
-
         /* the zernikes index are computed */
 
         quick_sort2l(Nolldouble, index_Nollsort, Zernike.ZERMAX);
@@ -221,44 +186,21 @@ double Zernike_value(
     double PA
 )
 {
-    long   i;
-    double value = 0.0;
-    double tmp, s2;
-    long   n, m;
-    long zi = Zernike.Zer_reverseNollindex[j];
+    double value;
+    long   zi = Zernike.Zer_reverseNollindex[j];
+    int    n  = Zernike.Zer_n[zi];
+    int    m  = Zernike.Zer_m[zi];
 
-    n  = Zernike.Zer_n[zi] + 1;
-    m  = Zernike.Zer_m[zi];
-    s2 = sqrt(2.0);
+    // radial polynomial from recurrence, see zernike_basis.c
+    value = sqrt(n + 1.0) * zernike_radial(n, m, r);
 
-    if(m == 0)
+    if(m < 0)
     {
-        for(i = 0; i < n; i++)
-        {
-            tmp = Zernike.R_array[zi * Zernike.ZERMAX + i];
-            if(tmp != 0)
-            {
-                value += pow(r, i) * tmp;
-            }
-        }
+        value *= -sqrt(2.0) * sin(m * PA);
     }
-    else
+    else if(m > 0)
     {
-        for(i = 0; i < n; i++)
-        {
-            tmp = Zernike.R_array[zi * Zernike.ZERMAX + i];
-            if(tmp != 0)
-            {
-                if(m < 0)
-                {
-                    value -= tmp * s2 * pow(r, i) * sin(m * PA);
-                }
-                else
-                {
-                    value += tmp * s2 * pow(r, i) * cos(m * PA);
-                }
-            }
-        }
+        value *= sqrt(2.0) * cos(m * PA);
     }
 
     return (value);
@@ -109,12 +109,7 @@ errno_t CFtree_rebuild(CLUSTERTREE *ctree, long *frameleafCFindex, long NBframe)
             long   cfi1    = tipCFi[lf1];
             double distval = 0.0;
             FUNC_CHECK_RETURN(
-                compute_imdistance_double(ctree,
-                                          ctree->CFarray[cfi0].datasumvec,
-                                          ctree->CFarray[cfi0].N,
-                                          ctree->CFarray[cfi1].datasumvec,
-                                          ctree->CFarray[cfi1].N,
-                                          &distval));
+                compute_CFdistance(ctree, cfi0, cfi1, &distval));
             if(distval > maxldist)
             {
                 maxldist = distval;
@@ -454,13 +449,8 @@ errno_t CFtree_rebuild(CLUSTERTREE *ctree, long *frameleafCFindex, long NBframe)
                         (cfi != cfi0))
                 {
                     double distval = 0.0;
-                    FUNC_CHECK_RETURN(compute_imdistance_double(
-                                          ctree,
-                                          ctree->CFarray[cfi0].datasumvec,
-                                          ctree->CFarray[cfi0].N,
-                                          ctree->CFarray[cfi].datasumvec,
-                                          ctree->CFarray[cfi].N,
-                                          &distval));
+                    FUNC_CHECK_RETURN(
+                        compute_CFdistance(ctree, cfi0, cfi, &distval));
                     tipdist[lf * ctree->nbleaf + lf0] = distval;
                     tipdist[lf0 * ctree->nbleaf + lf] = distval;
                 }
@@ -478,13 +468,8 @@ errno_t CFtree_rebuild(CLUSTERTREE *ctree, long *frameleafCFindex, long NBframe)
                         (cfi != cfi1))
                 {
                     double distval = 0.0;
-                    FUNC_CHECK_RETURN(compute_imdistance_double(
-                                          ctree,
-                                          ctree->CFarray[cfi1].datasumvec,
-                                          ctree->CFarray[cfi1].N,
-                                          ctree->CFarray[cfi].datasumvec,
-                                          ctree->CFarray[cfi].N,
-                                          &distval));
+                    FUNC_CHECK_RETURN(
+                        compute_CFdistance(ctree, cfi1, cfi, &distval));
                     tipdist[lf * ctree->nbleaf + lf1] = distval;
                     tipdist[lf1 * ctree->nbleaf + lf] = distval;
                 }
@@ -11,16 +11,19 @@ errno_t addvector_to_CF(CLUSTERTREE *ctree,
 {
     DEBUG_TRACE_FSTART();
 
-    double *sumvec = (double *) malloc(sizeof(double) * ctree->npix);
+    double *sumvec = ctree->CFarray[CFindex].datasumvec;
 
     long   N1   = ctree->CFarray[CFindex].N + N;
     double sum2 = 0.0;
 
-    // add to vec sum
+    // square norm of vec sum, CF is only updated if entry is accepted
+#ifdef _OPENMP
+    #pragma omp simd reduction(+ : sum2)
+#endif
     for(long ii = 0; ii < ctree->npix; ii++)
     {
-        sumvec[ii] = ctree->CFarray[CFindex].datasumvec[ii] + datavec[ii];
-        sum2 += sumvec[ii] * sumvec[ii];
+        double tmpv = sumvec[ii] + datavec[ii];
+        sum2 += tmpv * tmpv;
     }
 
     long double ssq1 = ctree->CFarray[CFindex].datassq + ssqr;
@@ -34,13 +37,12 @@ errno_t addvector_to_CF(CLUSTERTREE *ctree,
     {
         *addOK = 1;
 
+        // add to vec sum
         for(long ii = 0; ii < ctree->npix; ii++)
         {
-            ctree->CFarray[CFindex].datasumvec[ii] = sumvec[ii];
+            sumvec[ii] += datavec[ii];
         }
 
-        free(sumvec);
-
         ctree->CFarray[CFindex].N       = N1;
         ctree->CFarray[CFindex].datassq = ssq1;
         ctree->CFarray[CFindex].sum2    = sum2;
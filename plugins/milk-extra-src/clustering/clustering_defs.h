@@ -14,6 +14,9 @@
 #define CLUSTER_CF_STATUS_COMPUTE 0x0002
 #define CLUSTER_CF_STATUS_CREATE  0x0004
 
+// CF sum vectors alignment in arena [byte]
+#define CLUSTER_CF_ALIGN 64
+
 // cluster feature
 typedef struct
 {
@@ -32,7 +35,7 @@ typedef struct
     long parentindex;
 
     long        N;          // number of points aggregated in node
-    double     *datasumvec; // sum
+    double     *datasumvec; // sum, points into CLUSTERTREE CFsumarena
     long double datassq;    // sum squared
     long double sum2;       // square norm of sumvec
     double      radius2;    // square cluster radius
@@ -51,6 +54,12 @@ typedef struct
     CLUSTERING_CF *CFarray; // pointer to cluster features
     long           rootindex;
 
+    // CF sum vectors are stored contiguously, one every npixstride
+    // double, each aligned to CLUSTER_CF_ALIGN
+    long    npixstride;
+    double *CFsumarena;
+    long   *CFindexarena; // childindex and leafindex storage
+
     // correction for uncorrelated noise
     double noise2offset;
 
@@ -61,6 +70,7 @@ typedef struct
 
     double minnoise2;
 
+    long double cdist2sum; // sum of distance2, used to compute cdist
     long long cdistcnt;    // number of distance computation
     long long cdistnegcnt; // number of neg distance
 
@@ -3,6 +3,70 @@
 
 #include <math.h>
 
+// number of pixels processed per block in batched distance
+// vector block stays in L1 cache while scanning CFs
+#define CF_DIST_BLOCKSIZE 1024
+
+#define OMP_NELEMENT_LIMIT 1000000
+
+/**
+ * @brief Dot product, written for compiler vectorization
+ */
+static inline double imdistance_dot(const double *__restrict vec1,
+                                    const double *__restrict vec2,
+                                    long n)
+{
+    double dot = 0.0;
+
+#ifdef _OPENMP
+    #pragma omp simd reduction(+ : dot)
+#endif
+    for(long ii = 0; ii < n; ii++)
+    {
+        dot += vec1[ii] * vec2[ii];
+    }
+
+    return dot;
+}
+
+/**
+ * @brief Correct raw distance2 for noise, update tree statistics
+ *
+ * Statistics are held in ctree, so that independent trees can be
+ * processed concurrently.
+ *
+ * @return distance
+ */
+static double imdistance_update(CLUSTERTREE *ctree,
+                                double       dist2,
+                                long         N1,
+                                long         N2)
+{
+    // keep track of minimum N-corrected distance encountered
+    // assuming uncorrelated noise, distance2 is
+    // sum of variance/N1 and variance/N2
+    // = var * (1/N1 + 1/N2)
+    double noise2val = dist2 / (1.0 / N1 + 1.0 / N2);
+    if((ctree->cdistcnt == 0) || (noise2val < ctree->minnoise2))
+    {
+        ctree->minnoise2 = noise2val;
+    }
+
+    dist2 -= ctree->noise2offset * (1.0 / N1 + 1.0 / N2);
+    if(dist2 < 0.0)
+    {
+        ctree->cdistnegcnt++;
+        dist2 = 0.0;
+    }
+
+    // collect stats
+    ctree->cdist2sum += dist2;
+    ctree->cdistcnt++;
+    ctree->cdist = sqrt(ctree->cdist2sum / ctree->cdistcnt);
+
+    return sqrt(dist2);
+}
+
 errno_t compute_imdistance_double(CLUSTERTREE *ctree,
                                   double      *vec1,
                                   long         N1,
@@ -12,59 +76,119 @@ errno_t compute_imdistance_double(CLUSTERTREE *ctree,
 {
     DEBUG_TRACE_FSTART();
 
-    long double dist2 = 0.0;
-
-    static long double cdist2_sum    = 0.0;
-    static long long   cdist2_cnt    = 0;
-    static long long   dist2_neg_cnt = 0;
-
-    static long double minnoise2_val = -1.0;
-
-    //printf("Computing distance over %ld elements  %ld %ld\n", NBelem, N1, N2);
-    //fflush(stdout);
+    double dist2 = 0.0;
+    double a1    = 1.0 / N1;
+    double a2    = 1.0 / N2;
 
+#ifdef _OPENMP
+    #pragma omp simd reduction(+ : dist2)
+#endif
     for(long ii = 0; ii < ctree->npix; ii++)
     {
-        double tmpv = vec1[ii] / N1 - vec2[ii] / N2;
+        double tmpv = vec1[ii] * a1 - vec2[ii] * a2;
         dist2 += tmpv * tmpv;
     }
 
-    // keep track of minimum N-corrected distance encountered
-    // assuming uncorrelated noise, distance2 is
-    // sum of variance/N1 and variance/N2
-    // = var * (1/N1 + 1/N2)
-    double noise2val = dist2 / (1.0 / N1 + 1.0 / N2);
-    if(cdist2_cnt == 1)
+    *distval = imdistance_update(ctree, dist2, N1, N2);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Distance between two CFs centroids
+ *
+ * Uses CF square norms (sum2) :
+ * |s1/N1 - s2/N2|^2 = sum2_1/N1^2 + sum2_2/N2^2 - 2 s1.s2/(N1 N2)
+ * so that a single dot product is computed.
+ */
+errno_t
+compute_CFdistance(CLUSTERTREE *ctree, long CFindex1, long CFindex2, double *distval)
+{
+    DEBUG_TRACE_FSTART();
+
+    CLUSTERING_CF *cf1 = &ctree->CFarray[CFindex1];
+    CLUSTERING_CF *cf2 = &ctree->CFarray[CFindex2];
+
+    double dot =
+        imdistance_dot(cf1->datasumvec, cf2->datasumvec, ctree->npix);
+
+    double a1    = 1.0 / cf1->N;
+    double a2    = 1.0 / cf2->N;
+    double dist2 = (double) cf1->sum2 * a1 * a1 +
+                   (double) cf2->sum2 * a2 * a2 - 2.0 * dot * a1 * a2;
+
+    *distval = imdistance_update(ctree, dist2, cf1->N, cf2->N);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+/**
+ * @brief Distances from vector to multiple CFs centroids
+ *
+ * Computes all dot products in a single pass over vec, processed in
+ * blocks of CF_DIST_BLOCKSIZE pixels. Used to scan children or leaves
+ * of a node.
+ *
+ * @param ctree        cluster tree
+ * @param vec          input vector sum
+ * @param N            number of points in vec
+ * @param vecsum2      square norm of vec
+ * @param CFindexarray CFs to compare against
+ * @param NBCF         number of CFs
+ * @param distarray    output distances, NBCF elements
+ */
+errno_t compute_CFdistance_batch(CLUSTERTREE *ctree,
+                                 double      *vec,
+                                 long         N,
+                                 long double  vecsum2,
+                                 long        *CFindexarray,
+                                 int          NBCF,
+                                 double      *distarray)
+{
+    DEBUG_TRACE_FSTART();
+
+    double dotarray[NBCF];
+    for(int i = 0; i < NBCF; i++)
     {
-        minnoise2_val = noise2val;
+        dotarray[i] = 0.0;
     }
-    else
+
+    long npix    = ctree->npix;
+    long NBblock = (npix + CF_DIST_BLOCKSIZE - 1) / CF_DIST_BLOCKSIZE;
+
+#ifdef _OPENMP
+    #pragma omp parallel for reduction(+ : dotarray[:NBCF]) if (npix * NBCF > OMP_NELEMENT_LIMIT)
+#endif
+    for(long blk = 0; blk < NBblock; blk++)
     {
-        if(noise2val < minnoise2_val)
+        long ii0 = blk * CF_DIST_BLOCKSIZE;
+        long nii = npix - ii0;
+        if(nii > CF_DIST_BLOCKSIZE)
+        {
+            nii = CF_DIST_BLOCKSIZE;
+        }
+        for(int i = 0; i < NBCF; i++)
         {
-            minnoise2_val = noise2val;
+            dotarray[i] += imdistance_dot(
+                               ctree->CFarray[CFindexarray[i]].datasumvec + ii0,
+                               vec + ii0,
+                               nii);
         }
     }
 
-    dist2 -= ctree->noise2offset * (1.0 / N1 + 1.0 / N2);
-    if(dist2 < 0.0)
+    double a2 = 1.0 / N;
+    for(int i = 0; i < NBCF; i++)
     {
-        dist2_neg_cnt++;
-        dist2 = 0.0;
-    }
+        CLUSTERING_CF *cf = &ctree->CFarray[CFindexarray[i]];
 
-    *distval = (double) sqrt(dist2);
+        double a1    = 1.0 / cf->N;
+        double dist2 = (double) cf->sum2 * a1 * a1 +
+                       (double) vecsum2 * a2 * a2 - 2.0 * dotarray[i] * a1 * a2;
 
-    //printf("    -> %g\n", *distval);
-
-    cdist2_sum += dist2;
-    cdist2_cnt++;
-
-    // collect stats
-    ctree->cdist       = sqrt(cdist2_sum / cdist2_cnt);
-    ctree->minnoise2   = minnoise2_val;
-    ctree->cdistcnt    = cdist2_cnt;
-    ctree->cdistnegcnt = dist2_neg_cnt;
+        distarray[i] = imdistance_update(ctree, dist2, cf->N, N);
+    }
 
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
@@ -8,4 +8,17 @@ errno_t compute_imdistance_double(CLUSTERTREE *ctree,
                                   long         N2,
                                   double      *distval);
 
+errno_t compute_CFdistance(CLUSTERTREE *ctree,
+                           long         CFindex1,
+                           long         CFindex2,
+                           double      *distval);
+
+errno_t compute_CFdistance_batch(CLUSTERTREE *ctree,
+                                 double      *vec,
+                                 long         N,
+                                 long double  vecsum2,
+                                 long        *CFindexarray,
+                                 int          NBCF,
+                                 double      *distarray);
+
 #endif
@@ -1,4 +1,3 @@
-
 #include "CommandLineInterface/CLIcore.h"
 #include "clustering_defs.h"
 
@@ -9,9 +8,13 @@ errno_t ctree_memallocate(CLUSTERTREE *ctree)
     // Allocate memory for CFs
     DEBUG_TRACE_FSTART();
 
+    // pad vectors so that each CF sum starts on aligned boundary
+    long alignnb      = CLUSTER_CF_ALIGN / sizeof(double);
+    ctree->npixstride = ((ctree->npix + alignnb - 1) / alignnb) * alignnb;
+
     printf("Allocating CF memory. %ld CFs, size = %ld bytes\n",
            ctree->NBCF,
-           (long) sizeof(double) * ctree->npix * ctree->NBCF);
+           (long) sizeof(double) * ctree->npixstride * ctree->NBCF);
 
     ctree->CFarray =
         (CLUSTERING_CF *) malloc(sizeof(CLUSTERING_CF) * ctree->NBCF);
@@ -20,35 +23,47 @@ errno_t ctree_memallocate(CLUSTERTREE *ctree)
         FUNC_RETURN_FAILURE("malloc error");
     }
 
-    for(long CFindex = 0; CFindex < ctree->NBCF; CFindex++)
+    if(posix_memalign((void **) &ctree->CFsumarena,
+                      CLUSTER_CF_ALIGN,
+                      sizeof(double) * ctree->npixstride * ctree->NBCF) != 0)
     {
+        FUNC_RETURN_FAILURE("posix_memalign error");
+    }
+    memset(ctree->CFsumarena,
+           0,
+           sizeof(double) * ctree->npixstride * ctree->NBCF);
 
+    long NBindex = (ctree->B + 1) + (ctree->L + 1);
+    ctree->CFindexarena =
+        (long *) malloc(sizeof(long) * NBindex * ctree->NBCF);
+    if(ctree->CFindexarena == NULL)
+    {
+        FUNC_RETURN_FAILURE("malloc error");
+    }
+
+    for(long CFindex = 0; CFindex < ctree->NBCF; CFindex++)
+    {
         ctree->CFarray[CFindex].childindex =
-            (long *) malloc(sizeof(long) * (ctree->B + 1));
-        if(ctree->CFarray[CFindex].childindex == NULL)
-        {
-            FUNC_RETURN_FAILURE("malloc error");
-        }
+            ctree->CFindexarena + CFindex * NBindex;
 
         ctree->CFarray[CFindex].leafindex =
-            (long *) malloc(sizeof(long) * (ctree->L + 1));
-        if(ctree->CFarray[CFindex].leafindex == NULL)
-        {
-            FUNC_RETURN_FAILURE("malloc error");
-        }
+            ctree->CFindexarena + CFindex * NBindex + (ctree->B + 1);
 
         ctree->CFarray[CFindex].datasumvec =
-            (double *) malloc(sizeof(double) * ctree->npix);
-        if(ctree->CFarray[CFindex].datasumvec == NULL)
-        {
-            FUNC_RETURN_FAILURE("malloc error");
-        }
+            ctree->CFsumarena + CFindex * ctree->npixstride;
 
         ctree->CFarray[CFindex].parentindex =
             -1; // Require to avoid infinite loop in CFmeminit upstream tracking
         CFmeminit(ctree, CFindex, 0);
     }
 
+    // distance statistics
+    ctree->cdist       = 0.0;
+    ctree->minnoise2   = 0.0;
+    ctree->cdist2sum   = 0.0;
+    ctree->cdistcnt    = 0;
+    ctree->cdistnegcnt = 0;
+
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
 }
@@ -124,8 +124,10 @@ static errno_t ctree_check(CLUSTERTREE *ctree)
     return RETURN_SUCCESS;
 }
 
-static errno_t
-findleafnode(CLUSTERTREE *ctree, double *datavec, long *nodeindex)
+static errno_t findleafnode(CLUSTERTREE *ctree,
+                            double      *datavec,
+                            long double  vecsum2,
+                            long        *nodeindex)
 {
     DEBUG_TRACE_FSTART();
 
@@ -134,47 +136,33 @@ findleafnode(CLUSTERTREE *ctree, double *datavec, long *nodeindex)
     int  level   = 0;
     long CFindex = ctree->rootindex;
 
+    double distarray[ctree->B + 1];
+
     DEBUG_TRACEPOINT("root CF = %ld, has %d child",
                      CFindex,
                      ctree->CFarray[CFindex].NBchild);
 
     while(ctree->CFarray[CFindex].NBchild > 0)
     {
-        int    scaninit    = 0;
-        double distvalmin  = 0;
-        long   CFindexbest = 0;
-        for(long childi = 0; childi < ctree->CFarray[CFindex].NBchild;
+        // distance to all children in one pass
+        FUNC_CHECK_RETURN(
+            compute_CFdistance_batch(ctree,
+                                     datavec,
+                                     1,
+                                     vecsum2,
+                                     ctree->CFarray[CFindex].childindex,
+                                     ctree->CFarray[CFindex].NBchild,
+                                     distarray));
+
+        double distvalmin  = distarray[0];
+        long   CFindexbest = ctree->CFarray[CFindex].childindex[0];
+        for(long childi = 1; childi < ctree->CFarray[CFindex].NBchild;
                 childi++)
         {
-            double distval = 0.0;
-
-            long CFindex1 = ctree->CFarray[CFindex].childindex[childi];
-
-            DEBUG_TRACEPOINT("computing distance to CF node # %ld(%ld)",
-                             CFindex1,
-                             ctree->CFarray[CFindex1].N);
-
-            FUNC_CHECK_RETURN(
-                compute_imdistance_double(ctree,
-                                          ctree->CFarray[CFindex1].datasumvec,
-                                          ctree->CFarray[CFindex1].N,
-                                          datavec,
-                                          1,
-                                          &distval));
-
-            if(scaninit == 0)
+            if(distarray[childi] < distvalmin)
             {
-                distvalmin  = distval;
-                CFindexbest = CFindex1;
-                scaninit    = 1;
-            }
-            else
-            {
-                if(distval < distvalmin)
-                {
-                    distvalmin  = distval;
-                    CFindexbest = CFindex1;
-                }
+                distvalmin  = distarray[childi];
+                CFindexbest = ctree->CFarray[CFindex].childindex[childi];
             }
         }
 
@@ -194,59 +182,46 @@ findleafnode(CLUSTERTREE *ctree, double *datavec, long *nodeindex)
     return RETURN_SUCCESS;
 }
 
-static errno_t
-findleaf(CLUSTERTREE *ctree, double *datavec, long CFindex, long *leafindex)
+static errno_t findleaf(CLUSTERTREE *ctree,
+                        double      *datavec,
+                        long double  vecsum2,
+                        long         CFindex,
+                        long        *leafindex)
 {
     DEBUG_TRACE_FSTART();
 
-    int    leafimin     = -1; // leaf index into which entry will be added
-    double distvalmin   = 0;
-    int    leafloopinit = 0;
-    for(long leafi = 0; leafi < ctree->CFarray[CFindex].NBleaf; leafi++)
-    {
-        long CFindex1 = ctree->CFarray[CFindex].leafindex[leafi];
-        //if(sqrt(ctree->CFarray[CFindex1].radius2) < ctree->T)
-        //{   // radius below threahold -> we can add
-        double distval = 0.0;
+    int    leafimin   = -1; // leaf index into which entry will be added
+    double distvalmin = 0;
 
-        DEBUG_TRACEPOINT("computing distance to leaf %ld = node # %ld(%ld)",
-                         leafi,
-                         CFindex1,
-                         ctree->CFarray[CFindex1].N);
+    double distarray[ctree->L + 1];
 
+    if(ctree->CFarray[CFindex].NBleaf > 0)
+    {
+        // distance to all leaves in one pass
         FUNC_CHECK_RETURN(
-            compute_imdistance_double(ctree,
-                                      ctree->CFarray[CFindex1].datasumvec,
-                                      ctree->CFarray[CFindex1].N,
-                                      datavec,
-                                      1,
-                                      &distval));
-
-        DEBUG_TRACEPOINT("dist %4ld(%3ld) - new sample : %g",
-                         CFindex1,
-                         ctree->CFarray[CFindex1].N,
-                         (double) distval);
-
-        if(leafloopinit == 0)
+            compute_CFdistance_batch(ctree,
+                                     datavec,
+                                     1,
+                                     vecsum2,
+                                     ctree->CFarray[CFindex].leafindex,
+                                     ctree->CFarray[CFindex].NBleaf,
+                                     distarray));
+
+        leafimin   = 0;
+        distvalmin = distarray[0];
+        for(long leafi = 1; leafi < ctree->CFarray[CFindex].NBleaf; leafi++)
         {
-            leafimin     = leafi;
-            distvalmin   = distval;
-            leafloopinit = 1;
-        }
-        else
-        {
-            if(distval < distvalmin)
+            DEBUG_TRACEPOINT("dist %4ld(%3ld) - new sample : %g",
+                             ctree->CFarray[CFindex].leafindex[leafi],
+                             ctree->CFarray[ctree->CFarray[CFindex].leafindex[leafi]].N,
+                             distarray[leafi]);
+
+            if(distarray[leafi] < distvalmin)
             {
                 leafimin   = leafi;
-                distvalmin = distval;
+                distvalmin = distarray[leafi];
             }
         }
-        /*}
-        else
-        {
-            printf("        cluster radius %g > %g -> skipping\n",
-                   (double) sqrt(ctree->CFarray[CFindex1].radius2), (double) ctree->T);
-        }*/
     }
 
     if(distvalmin > ctree->T)
@@ -442,14 +417,14 @@ static errno_t imcube_makecluster(IMGID img, const char *__restrict outdname)
             else
             {
                 long CFindex;
-                FUNC_CHECK_RETURN(findleafnode(&ctree, datarray, &CFindex));
+                FUNC_CHECK_RETURN(findleafnode(&ctree, datarray, ssqr, &CFindex));
                 DEBUG_TRACEPOINT("CF %ld type is %d",
                                  CFindex,
                                  ctree.CFarray[CFindex].type);
                 // we have descended the tree and are now at a leaf node
 
                 long leafi;
-                FUNC_CHECK_RETURN(findleaf(&ctree, datarray, CFindex, &leafi));
+                FUNC_CHECK_RETURN(findleaf(&ctree, datarray, ssqr, CFindex, &leafi));
 
                 // we have descended the tree and are now at a leaf node
 
@@ -702,13 +677,10 @@ static errno_t imcube_makecluster(IMGID img, const char *__restrict outdname)
                                 ctree.CFarray[CFindex1].level)
                         {
                             double distval;
-                            compute_imdistance_double(
-                                &ctree,
-                                ctree.CFarray[CFindex0].datasumvec,
-                                ctree.CFarray[CFindex0].N,
-                                ctree.CFarray[CFindex1].datasumvec,
-                                ctree.CFarray[CFindex1].N,
-                                &distval);
+                            compute_CFdistance(&ctree,
+                                               CFindex0,
+                                               CFindex1,
+                                               &distval);
 
                             fprintf(fp,
                                     "%5ld %5ld      %16g  %6.4f  %6.2f\n",
@@ -89,12 +89,7 @@ errno_t split_CF_node(CLUSTERTREE *ctree, long CFindex, long *CFi0, long *CFi1)
             long   CFindex11 = subCFarray[index1];
             double distval;
             FUNC_CHECK_RETURN(
-                compute_imdistance_double(ctree,
-                                          ctree->CFarray[CFindex00].datasumvec,
-                                          ctree->CFarray[CFindex00].N,
-                                          ctree->CFarray[CFindex11].datasumvec,
-                                          ctree->CFarray[CFindex11].N,
-                                          &distval));
+                compute_CFdistance(ctree, CFindex00, CFindex11, &distval));
             DEBUG_TRACEPOINT("DIST %02d %02d  %g\n", index0, index1, distval);
             if(distval > maxdist)
             {
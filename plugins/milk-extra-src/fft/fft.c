@@ -15,6 +15,7 @@
 
 #include "dofft.h"
 #include "fftcorrelation.h"
+#include "fftregister.h"
 #include "ffttranslate.h"
 #include "init_fftwplan.h"
 #include "permut.h"
@@ -53,6 +54,7 @@ static errno_t init_module_CLI()
     fftcorrelation_addCLIcmd();
 
     CLIADDCMD_milk_fft__pup2foc();
+    CLIADDCMD_milk_fft__fftregister();
 
     return RETURN_SUCCESS;
 }
@@ -0,0 +1,666 @@
+/** @file fftregister.c
+ *
+ * Image registration by FFT cross-correlation
+ *
+ * Translation between image and reference is the position of the peak
+ * of their cross-correlation, computed by FFT. Integer peak position is
+ * refined by evaluating the cross-correlation on an upsampled grid
+ * around the peak with a matrix-multiply DFT (Guizar-Sicairos et al.
+ * 2008), or by parabolic fit.
+ *
+ * FFTW plans and buffers are created once, so that per-frame cost is
+ * one forward and one inverse FFT plus a small DFT.
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "fftregister.h"
+
+// default upsampled DFT region : +/- 0.75 pixel around integer peak
+#define FFTREGISTER_UPREGION 0.75
+
+// ==========================================
+// Function parameters
+// ==========================================
+
+static char *inimname;
+static long  fpi_inimname = -1;
+
+static char *refimname;
+
+static char *outimname;
+
+static uint32_t *upsample;
+static long      fpi_upsample = -1;
+
+static uint64_t *phasecorr;
+static long      fpi_phasecorr = -1;
+
+static uint32_t *maxshift;
+static long      fpi_maxshift = -1;
+
+
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STREAM,
+        ".inim",
+        "input image stream",
+        "im",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inimname,
+        &fpi_inimname
+    },
+    {
+        CLIARG_IMG,
+        ".refim",
+        "reference image",
+        "imref",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &refimname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outim",
+        "output dx, dy, peak stream",
+        "imregout",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".upsample",
+        "subpixel upsampling factor, <2 for parabolic fit",
+        "20",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &upsample,
+        &fpi_upsample
+    },
+    {
+        CLIARG_ONOFF,
+        ".phasecorr",
+        "phase correlation (normalized cross-spectrum)",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &phasecorr,
+        &fpi_phasecorr
+    },
+    {
+        CLIARG_UINT32,
+        ".maxshift",
+        "max shift searched [pix], 0 for unlimited",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &maxshift,
+        &fpi_maxshift
+    }
+};
+
+
+
+// Optional custom configuration setup.
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_inimname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+
+        data.fpsptr->parray[fpi_phasecorr].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_maxshift].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+static errno_t customCONFcheck()
+{
+    if(data.fpsptr != NULL)
+    {
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+static CLICMDDATA CLIcmddata =
+{
+    "fftregister",
+    "measure image translation by FFT cross-correlation",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Measure translation of input stream frames relative to\n");
+    printf("reference image, by FFT cross-correlation\n");
+    printf("Output stream holds dx, dy and correlation peak\n");
+    printf("Positive dx : image is shifted toward +x from reference\n");
+    printf("Reference spectrum is updated when reference cnt0 changes\n");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static inline int fftregister_NBup(int upsample)
+{
+    return 2 * (int) ceil(FFTREGISTER_UPREGION * upsample) + 1;
+}
+
+
+// mean subtraction and copy to FFT input, returns sum of squares
+static double fftregister_loadim(FFTREGISTER *reg, const float *im)
+{
+    uint64_t nelem = (uint64_t) reg->xsize * reg->ysize;
+
+    double mean = 0.0;
+    for(uint64_t ii = 0; ii < nelem; ii++)
+    {
+        mean += im[ii];
+    }
+    mean /= nelem;
+
+    double sum2 = 0.0;
+    for(uint64_t ii = 0; ii < nelem; ii++)
+    {
+        reg->im[ii] = im[ii] - mean;
+        sum2 += reg->im[ii] * reg->im[ii];
+    }
+
+    return sum2;
+}
+
+
+// 3-point parabolic peak offset, in [-0.5, 0.5]
+static inline double fftregister_parabolic(double vm, double v0, double vp)
+{
+    double denom = vm - 2.0 * v0 + vp;
+    if(denom >= 0.0)
+    {
+        return 0.0;
+    }
+    double delta = 0.5 * (vm - vp) / denom;
+    if(delta > 0.5)
+    {
+        delta = 0.5;
+    }
+    if(delta < -0.5)
+    {
+        delta = -0.5;
+    }
+    return delta;
+}
+
+
+
+
+/**
+ * @brief Allocate buffers and create FFTW plans
+ */
+errno_t fftregister_init(
+    FFTREGISTER *reg,
+    uint32_t     xsize,
+    uint32_t     ysize,
+    int          upsample,
+    unsigned int fftwflags
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    reg->xsize     = xsize;
+    reg->ysize     = ysize;
+    reg->xsizeft   = xsize / 2 + 1;
+    reg->upsample  = upsample;
+    reg->phasecorr = 0;
+    reg->maxshift  = 0;
+
+    uint64_t nelemft = (uint64_t) reg->xsizeft * ysize;
+
+    reg->im    = (float *) fftwf_malloc(sizeof(float) * xsize * ysize);
+    reg->ftref = (fftwf_complex *) fftwf_malloc(sizeof(fftwf_complex) * nelemft);
+    reg->ftim  = (fftwf_complex *) fftwf_malloc(sizeof(fftwf_complex) * nelemft);
+    if((reg->im == NULL) || (reg->ftref == NULL) || (reg->ftim == NULL))
+    {
+        PRINT_ERROR("fftwf_malloc returns NULL pointer");
+        abort();
+    }
+
+    // row-major FFTW : slow axis first
+    reg->planfwd = fftwf_plan_dft_r2c_2d(ysize,
+                                         xsize,
+                                         reg->im,
+                                         reg->ftim,
+                                         fftwflags);
+    reg->planinv = fftwf_plan_dft_c2r_2d(ysize,
+                                         xsize,
+                                         reg->ftim,
+                                         reg->im,
+                                         fftwflags);
+
+    memset(reg->ftref, 0, sizeof(fftwf_complex) * nelemft);
+
+    reg->ftcross = NULL;
+    reg->dftrow  = NULL;
+    reg->kernx   = NULL;
+    reg->kerny   = NULL;
+    reg->upcorr  = NULL;
+    if(upsample > 1)
+    {
+        int NBup     = fftregister_NBup(upsample);
+        reg->ftcross =
+            (fftwf_complex *) malloc(sizeof(fftwf_complex) * nelemft);
+        reg->dftrow = (fftwf_complex *) malloc(sizeof(fftwf_complex) *
+                                               reg->xsizeft * NBup);
+        reg->kernx  = (fftwf_complex *) malloc(sizeof(fftwf_complex) *
+                                               reg->xsizeft * NBup);
+        reg->kerny =
+            (fftwf_complex *) malloc(sizeof(fftwf_complex) * ysize * NBup);
+        reg->upcorr = (double *) malloc(sizeof(double) * NBup * NBup);
+        if((reg->ftcross == NULL) || (reg->dftrow == NULL) ||
+                (reg->kernx == NULL) || (reg->kerny == NULL) ||
+                (reg->upcorr == NULL))
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t fftregister_free(FFTREGISTER *reg)
+{
+    DEBUG_TRACE_FSTART();
+
+    fftwf_destroy_plan(reg->planfwd);
+    fftwf_destroy_plan(reg->planinv);
+    fftwf_free(reg->im);
+    fftwf_free(reg->ftref);
+    fftwf_free(reg->ftim);
+    free(reg->ftcross);
+    free(reg->dftrow);
+    free(reg->kernx);
+    free(reg->kerny);
+    free(reg->upcorr);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Compute and store reference spectrum
+ *
+ * Spectrum is scaled so that correlation peak is normalized.
+ */
+errno_t fftregister_setref(FFTREGISTER *reg, const float *ref)
+{
+    DEBUG_TRACE_FSTART();
+
+    double   sum2    = fftregister_loadim(reg, ref);
+    uint64_t nelemft = (uint64_t) reg->xsizeft * reg->ysize;
+
+    fftwf_execute_dft_r2c(reg->planfwd, reg->im, reg->ftref);
+
+    float scale = (sum2 > 0.0) ? 1.0 / sqrt(sum2) : 0.0;
+    for(uint64_t ii = 0; ii < nelemft; ii++)
+    {
+        reg->ftref[ii][0] *= scale;
+        reg->ftref[ii][1] *= scale;
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Measure translation of image relative to reference
+ *
+ * im(x) ~ ref(x - (dx,dy))
+ * peak is normalized cross-correlation at (dx,dy) if phasecorr = 0.
+ */
+errno_t fftregister_measure(
+    FFTREGISTER *reg,
+    const float *im,
+    double      *dx,
+    double      *dy,
+    double      *peak
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    uint32_t xsize   = reg->xsize;
+    uint32_t ysize   = reg->ysize;
+    uint32_t xsizeft = reg->xsizeft;
+    uint64_t nelem   = (uint64_t) xsize * ysize;
+    uint64_t nelemft = (uint64_t) xsizeft * ysize;
+
+    double sum2  = fftregister_loadim(reg, im);
+    double scale = (sum2 > 0.0) ? 1.0 / sqrt(sum2) / nelem : 0.0;
+
+    fftwf_execute_dft_r2c(reg->planfwd, reg->im, reg->ftim);
+
+    // cross-spectrum F(im) conj(F(ref))
+    //
+    for(uint64_t ii = 0; ii < nelemft; ii++)
+    {
+        float re   = reg->ftim[ii][0] * reg->ftref[ii][0] +
+                     reg->ftim[ii][1] * reg->ftref[ii][1];
+        float imag = reg->ftim[ii][1] * reg->ftref[ii][0] -
+                     reg->ftim[ii][0] * reg->ftref[ii][1];
+
+        if(reg->phasecorr == 1)
+        {
+            float amp = sqrtf(re * re + imag * imag);
+            if(amp > 0.0)
+            {
+                re   /= amp;
+                imag /= amp;
+            }
+            reg->ftim[ii][0] = re / nelem;
+            reg->ftim[ii][1] = imag / nelem;
+        }
+        else
+        {
+            reg->ftim[ii][0] = re * scale;
+            reg->ftim[ii][1] = imag * scale;
+        }
+    }
+
+    // keep cross-spectrum for upsampled DFT, c2r overwrites input
+    if(reg->upsample > 1)
+    {
+        memcpy(reg->ftcross, reg->ftim, sizeof(fftwf_complex) * nelemft);
+    }
+
+    fftwf_execute_dft_c2r(reg->planinv, reg->ftim, reg->im);
+
+
+    // integer peak
+    //
+    long   iipeak = 0;
+    long   jjpeak = 0;
+    double vpeak  = -HUGE_VAL;
+    for(uint32_t jj = 0; jj < ysize; jj++)
+    {
+        long sy = (jj < (ysize + 1) / 2) ? (long) jj : (long) jj - ysize;
+        if((reg->maxshift > 0) && (labs(sy) > reg->maxshift))
+        {
+            continue;
+        }
+        for(uint32_t ii = 0; ii < xsize; ii++)
+        {
+            long sx = (ii < (xsize + 1) / 2) ? (long) ii : (long) ii - xsize;
+            if((reg->maxshift > 0) && (labs(sx) > reg->maxshift))
+            {
+                continue;
+            }
+            if(reg->im[jj * xsize + ii] > vpeak)
+            {
+                vpeak  = reg->im[jj * xsize + ii];
+                iipeak = ii;
+                jjpeak = jj;
+            }
+        }
+    }
+    double sx0 = (iipeak < (xsize + 1) / 2) ? iipeak : iipeak - (long) xsize;
+    double sy0 = (jjpeak < (ysize + 1) / 2) ? jjpeak : jjpeak - (long) ysize;
+
+
+    if(reg->upsample < 2)
+    {
+        // parabolic fit on 3 neighbours, wrapping around
+        //
+        long iim = (iipeak + xsize - 1) % xsize;
+        long iip = (iipeak + 1) % xsize;
+        long jjm = (jjpeak + ysize - 1) % ysize;
+        long jjp = (jjpeak + 1) % ysize;
+
+        *dx = sx0 + fftregister_parabolic(reg->im[jjpeak * xsize + iim],
+                                          vpeak,
+                                          reg->im[jjpeak * xsize + iip]);
+        *dy = sy0 + fftregister_parabolic(reg->im[jjm * xsize + iipeak],
+                                          vpeak,
+                                          reg->im[jjp * xsize + iipeak]);
+        *peak = vpeak;
+    }
+    else
+    {
+        // upsampled DFT around integer peak
+        // c(s) = sum_kx w(kx) Re[ e^(2i pi kx sx/nx) T(kx, sy) ]
+        // T(kx, sy) = sum_ky C(kx, ky) e^(2i pi ky sy/ny)
+        //
+        int    NBup = fftregister_NBup(reg->upsample);
+        double off0 = -(NBup / 2) / (double) reg->upsample;
+
+        for(uint32_t ky = 0; ky < ysize; ky++)
+        {
+            double kys = (ky <= ysize / 2) ? ky : (double) ky - ysize;
+            for(int v = 0; v < NBup; v++)
+            {
+                double sy = sy0 + off0 + (double) v / reg->upsample;
+                double a  = 2.0 * M_PI * kys * sy / ysize;
+                reg->kerny[ky * NBup + v][0] = cos(a);
+                reg->kerny[ky * NBup + v][1] = sin(a);
+            }
+        }
+        for(uint32_t kx = 0; kx < xsizeft; kx++)
+        {
+            double w = ((kx == 0) || (2 * kx == xsize)) ? 1.0 : 2.0;
+            for(int u = 0; u < NBup; u++)
+            {
+                double sx = sx0 + off0 + (double) u / reg->upsample;
+                double a  = 2.0 * M_PI * kx * sx / xsize;
+                reg->kernx[kx * NBup + u][0] = w * cos(a);
+                reg->kernx[kx * NBup + u][1] = w * sin(a);
+            }
+        }
+
+        for(uint32_t kx = 0; kx < xsizeft; kx++)
+        {
+            for(int v = 0; v < NBup; v++)
+            {
+                double re   = 0.0;
+                double imag = 0.0;
+                for(uint32_t ky = 0; ky < ysize; ky++)
+                {
+                    float *c = reg->ftcross[ky * xsizeft + kx];
+                    float *k = reg->kerny[ky * NBup + v];
+                    re   += c[0] * k[0] - c[1] * k[1];
+                    imag += c[0] * k[1] + c[1] * k[0];
+                }
+                reg->dftrow[kx * NBup + v][0] = re;
+                reg->dftrow[kx * NBup + v][1] = imag;
+            }
+        }
+
+        // upsampled correlation
+        //
+        int    upeak  = 0;
+        int    vpeakc = 0;
+        double cpeak  = -HUGE_VAL;
+        for(int v = 0; v < NBup; v++)
+        {
+            for(int u = 0; u < NBup; u++)
+            {
+                double c = 0.0;
+                for(uint32_t kx = 0; kx < xsizeft; kx++)
+                {
+                    float *t = reg->dftrow[kx * NBup + v];
+                    float *k = reg->kernx[kx * NBup + u];
+                    c += t[0] * k[0] - t[1] * k[1];
+                }
+                reg->upcorr[v * NBup + u] = c;
+                if(c > cpeak)
+                {
+                    cpeak  = c;
+                    upeak  = u;
+                    vpeakc = v;
+                }
+            }
+        }
+
+        double du = 0.0;
+        double dv = 0.0;
+        if((upeak > 0) && (upeak < NBup - 1))
+        {
+            du = fftregister_parabolic(reg->upcorr[vpeakc * NBup + upeak - 1],
+                                       cpeak,
+                                       reg->upcorr[vpeakc * NBup + upeak + 1]);
+        }
+        if((vpeakc > 0) && (vpeakc < NBup - 1))
+        {
+            dv = fftregister_parabolic(reg->upcorr[(vpeakc - 1) * NBup + upeak],
+                                       cpeak,
+                                       reg->upcorr[(vpeakc + 1) * NBup + upeak]);
+        }
+
+        *dx   = sx0 + off0 + (upeak + du) / reg->upsample;
+        *dy   = sy0 + off0 + (vpeakc + dv) / reg->upsample;
+        *peak = cpeak;
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imgin = mkIMGID_from_name(inimname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    IMGID imgref = mkIMGID_from_name(refimname);
+    resolveIMGID(&imgref, ERRMODE_ABORT);
+
+    if((imgin.md->datatype != _DATATYPE_FLOAT) ||
+            (imgref.md->datatype != _DATATYPE_FLOAT))
+    {
+        FUNC_RETURN_FAILURE("input and reference must be float");
+    }
+    if((imgin.md->size[0] != imgref.md->size[0]) ||
+            (imgin.md->size[1] != imgref.md->size[1]))
+    {
+        FUNC_RETURN_FAILURE("input and reference sizes differ");
+    }
+
+    // Set input to be the trigger
+    strcpy(CLIcmddata.cmdsettings->triggerstreamname, inimname);
+    // for FPS mode:
+    if(data.fpsptr != NULL)
+    {
+        strcpy(data.fpsptr->cmdset.triggerstreamname, inimname);
+    }
+
+    IMGID imgout = stream_connect_create_2Df32(outimname, 3, 1);
+
+    // plans are created once, worth measuring
+    FFTREGISTER reg;
+    FUNC_CHECK_RETURN(fftregister_init(&reg,
+                                       imgin.md->size[0],
+                                       imgin.md->size[1],
+                                       *upsample,
+                                       FFTW_MEASURE));
+
+    uint64_t refcnt0 = imgref.md->cnt0;
+    if(fftregister_setref(&reg, imgref.im->array.F) != RETURN_SUCCESS)
+    {
+        fftregister_free(&reg);
+        FUNC_RETURN_FAILURE("cannot set reference %s", refimname);
+    }
+
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        errno_t ret = RETURN_SUCCESS;
+        if(imgref.md->cnt0 != refcnt0)
+        {
+            refcnt0 = imgref.md->cnt0;
+            ret     = fftregister_setref(&reg, imgref.im->array.F);
+        }
+        reg.phasecorr = *phasecorr;
+        reg.maxshift  = *maxshift;
+
+        double dx, dy, peak;
+        if(ret == RETURN_SUCCESS)
+        {
+            ret = fftregister_measure(&reg,
+                                      imgin.im->array.F,
+                                      &dx,
+                                      &dy,
+                                      &peak);
+        }
+
+        if(ret != RETURN_SUCCESS)
+        {
+            // exit loop, reg freed below
+            processinfo_error(processinfo, "registration failed");
+            processloopOK = 0;
+        }
+        else
+        {
+            imgout.md->write      = 1;
+            imgout.im->array.F[0] = dx;
+            imgout.im->array.F[1] = dy;
+            imgout.im->array.F[2] = peak;
+            processinfo_update_output_stream(processinfo, imgout.ID);
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    fftregister_free(&reg);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+// Register function in CLI
+errno_t CLIADDCMD_milk_fft__fftregister()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,57 @@
+/** @file fftregister.h
+ */
+
+#ifndef _MILK_FFT__FFTREGISTER_H
+#define _MILK_FFT__FFTREGISTER_H
+
+#include <fftw3.h>
+
+// image registration by FFT cross-correlation
+// buffers and FFTW plans are allocated once by fftregister_init
+// fftwflags is the FFTW planner mode : FFTW_MEASURE for streams,
+// FFTW_ESTIMATE for one-shot use
+//
+typedef struct
+{
+    uint32_t xsize;
+    uint32_t ysize;
+    uint32_t xsizeft; // xsize/2+1, r2c output size
+
+    int upsample;  // DFT upsampling factor, parabolic fit if < 2
+    int phasecorr; // 1 : normalize cross-spectrum modulus
+    int maxshift;  // max integer shift searched, 0 if unlimited
+
+    float         *im;      // real input / correlation output
+    fftwf_complex *ftref;   // reference spectrum
+    fftwf_complex *ftim;    // image spectrum, then cross-spectrum
+    fftwf_plan     planfwd; // im -> ftim
+    fftwf_plan     planinv; // ftim -> im
+
+    // upsampled DFT work arrays
+    fftwf_complex *ftcross; // cross-spectrum
+    fftwf_complex *dftrow;  // [xsizeft x NBup]
+    fftwf_complex *kernx;   // [xsizeft x NBup]
+    fftwf_complex *kerny;   // [ysize x NBup]
+    double        *upcorr;  // [NBup x NBup]
+
+} FFTREGISTER;
+
+errno_t fftregister_init(FFTREGISTER *reg,
+                         uint32_t     xsize,
+                         uint32_t     ysize,
+                         int          upsample,
+                         unsigned int fftwflags);
+
+errno_t fftregister_free(FFTREGISTER *reg);
+
+errno_t fftregister_setref(FFTREGISTER *reg, const float *ref);
+
+errno_t fftregister_measure(FFTREGISTER *reg,
+                            const float *im,
+                            double      *dx,
+                            double      *dy,
+                            double      *peak);
+
+errno_t CLIADDCMD_milk_fft__fftregister();
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "CommandLineInterface/CLIcore.h"
 
+#include "COREMOD_arith/image_axisreduce.h"
 #include "COREMOD_memory/COREMOD_memory.h"
 
 // ==========================================
@@ -55,26 +56,37 @@ errno_t __attribute__((cold)) cubecollapse_addCLIcmd()
 imageID cube_collapse(const char *__restrict ID_in_name,
                       const char *__restrict ID_out_name)
 {
-    imageID IDin;
-    imageID IDout;
-    long    xsize, ysize, ksize;
-    long    ii, kk;
+    IMGID imgin = mkIMGID_from_name(ID_in_name);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
 
-    IDin  = image_ID(ID_in_name);
-    xsize = data.image[IDin].md[0].size[0];
-    ysize = data.image[IDin].md[0].size[1];
-    ksize = data.image[IDin].md[0].size[2];
+    uint32_t xsize  = imgin.md->size[0];
+    uint32_t ysize  = imgin.md->size[1];
+    uint64_t xysize = (uint64_t) xsize * ysize;
 
-    create_2Dimage_ID(ID_out_name, xsize, ysize, &IDout);
+    // sum along z, float output
+    double *sumarray = (double *) malloc(sizeof(double) * xysize);
+    if(sumarray == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    double *outarray[IMAXISREDUCE_NBOP] = {NULL};
+    outarray[0] = sumarray;
+    if(image_axisreduce_array(imgin, 2, 2, NULL, IMAXISREDUCE_SUM, outarray) !=
+            RETURN_SUCCESS)
+    {
+        PRINT_ERROR("cannot collapse %s", ID_in_name);
+        free(sumarray);
+        return -1;
+    }
 
-    for(ii = 0; ii < xsize * ysize; ii++)
+    imageID IDout;
+    create_2Dimage_ID(ID_out_name, xsize, ysize, &IDout);
+    for(uint64_t ii = 0; ii < xysize; ii++)
     {
-        for(kk = 0; kk < ksize; kk++)
-        {
-            data.image[IDout].array.F[ii] +=
-                data.image[IDin].array.F[kk * xsize * ysize + ii];
-        }
+        data.image[IDout].array.F[ii] = sumarray[ii];
     }
+    free(sumarray);
 
     return (IDout);
 }
@@ -56,6 +56,7 @@
 #include "imexpand.h"
 #include "imgetcircasym.h"
 #include "imgetcircsym.h"
+#include "imresample.h"
 #include "imresize.h"
 #include "imrotate.h"
 #include "imswapaxis2D.h"
@@ -106,9 +107,10 @@ static errno_t init_module_CLI()
     imresize_addCLIcmd();
     imcontract_addCLIcmd();
     imrotate_addCLIcmd();
+    CLIADDCMD_image_basic__imresample();
     loadfitsimgcube_addCLIcmd();
-    streamfeed_addCLIcmd();
-    streamrecord_addCLIcmd();
+    CLIADDCMD_image_basic__streamfeed();
+    CLIADDCMD_image_basic__streamrecord();
     cubecollapse_addCLIcmd();
 
     // add atexit functions here
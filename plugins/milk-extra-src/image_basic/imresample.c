@@ -0,0 +1,687 @@
+/** @file imresample.c
+ *
+ * Geometric resampling : shift, rotation and scaling
+ *
+ * Output pixel to input coordinate mapping and kernel weights are
+ * computed once per geometry and stored as a warp map. Kernels are
+ * separable along input axes, so each output pixel is a NBtap x NBtap
+ * weighted sum of input pixels.
+ *
+ * Map is stored tap-major, so that applying it is a sequence of
+ * unit-stride vectorizable gathers over blocks of output pixels.
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "imresample.h"
+
+#define OMP_NELEMENT_LIMIT 1000000
+
+// output pixels processed per block when applying map
+#define IMRESAMPLE_BLOCKSIZE 256
+
+
+
+
+// ==========================================
+// Resampling engine
+// ==========================================
+
+
+static int imresample_kernel_NBtap(int kernel)
+{
+    switch(kernel)
+    {
+        case IMRESAMPLE_KERNEL_BICUBIC:
+            return 4;
+        case IMRESAMPLE_KERNEL_LANCZOS3:
+            return 6;
+        default:
+            return 2;
+    }
+}
+
+
+
+static inline double imresample_sinc(double x)
+{
+    if(fabs(x) < 1.0e-8)
+    {
+        return 1.0;
+    }
+    return sin(M_PI * x) / (M_PI * x);
+}
+
+
+
+/**
+ * @brief Kernel taps along one axis for input coordinate x
+ *
+ * Writes NBtap clamped indices and weights.
+ * Returns 0 if x is outside input range, in which case weights are zero.
+ */
+static int imresample_kernel_taps(
+    int      kernel,
+    int      NBtap,
+    double   x,
+    uint32_t size,
+    int32_t *index,
+    float   *weight
+)
+{
+    if((x < -0.5) || (x > size - 0.5))
+    {
+        for(int t = 0; t < NBtap; t++)
+        {
+            index[t]  = 0;
+            weight[t] = 0.0;
+        }
+        return 0;
+    }
+
+    long   i0 = (long) floor(x) - (NBtap / 2 - 1);
+    double f  = x - floor(x);
+
+    double w[6];
+    switch(kernel)
+    {
+        case IMRESAMPLE_KERNEL_BICUBIC:
+        {
+            // Keys kernel, a = -0.5
+            double a = -0.5;
+            for(int t = 0; t < 4; t++)
+            {
+                double d = fabs(f - (t - 1));
+                if(d < 1.0)
+                {
+                    w[t] = ((a + 2.0) * d - (a + 3.0)) * d * d + 1.0;
+                }
+                else if(d < 2.0)
+                {
+                    w[t] = ((a * d - 5.0 * a) * d + 8.0 * a) * d - 4.0 * a;
+                }
+                else
+                {
+                    w[t] = 0.0;
+                }
+            }
+        }
+        break;
+
+        case IMRESAMPLE_KERNEL_LANCZOS3:
+        {
+            double wsum = 0.0;
+            for(int t = 0; t < 6; t++)
+            {
+                double d = f - (t - 2);
+                w[t]     = imresample_sinc(d) * imresample_sinc(d / 3.0);
+                wsum += w[t];
+            }
+            for(int t = 0; t < 6; t++)
+            {
+                w[t] /= wsum;
+            }
+        }
+        break;
+
+        default:
+            w[0] = 1.0 - f;
+            w[1] = f;
+            break;
+    }
+
+    for(int t = 0; t < NBtap; t++)
+    {
+        long i = i0 + t;
+        if(i < 0)
+        {
+            i = 0;
+        }
+        if(i > (long) size - 1)
+        {
+            i = size - 1;
+        }
+        index[t]  = i;
+        weight[t] = w[t];
+    }
+
+    return 1;
+}
+
+
+
+
+errno_t imresample_map_init(IMRESAMPLE_MAP *map)
+{
+    memset(map, 0, sizeof(IMRESAMPLE_MAP));
+    map->geom.xsizeout = 0;
+    map->NBpix         = 0;
+    map->xindex        = NULL;
+    map->yoffset       = NULL;
+    map->xweight       = NULL;
+    map->yweight       = NULL;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+errno_t imresample_map_free(IMRESAMPLE_MAP *map)
+{
+    free(map->xindex);
+    free(map->yoffset);
+    free(map->xweight);
+    free(map->yweight);
+
+    return imresample_map_init(map);
+}
+
+
+
+/**
+ * @brief Compute warp map for geometry
+ *
+ * Does nothing if map already matches geometry.
+ */
+errno_t imresample_map_build(IMRESAMPLE_MAP *map, const IMRESAMPLE_GEOM *geom)
+{
+    DEBUG_TRACE_FSTART();
+
+    if((map->NBpix > 0) &&
+            (memcmp(&map->geom, geom, sizeof(IMRESAMPLE_GEOM)) == 0))
+    {
+        DEBUG_TRACE_FEXIT();
+        return RETURN_SUCCESS;
+    }
+
+    if((geom->scalex == 0.0) || (geom->scaley == 0.0))
+    {
+        FUNC_RETURN_FAILURE("scale factors must be non-zero");
+    }
+
+    int      NBtap = imresample_kernel_NBtap(geom->kernel);
+    uint64_t NBpix = (uint64_t) geom->xsizeout * geom->ysizeout;
+
+    if((map->NBpix != NBpix) || (map->NBtap != NBtap))
+    {
+        imresample_map_free(map);
+
+        map->xindex  = (int32_t *) malloc(sizeof(int32_t) * NBtap * NBpix);
+        map->yoffset = (int32_t *) malloc(sizeof(int32_t) * NBtap * NBpix);
+        map->xweight = (float *) malloc(sizeof(float) * NBtap * NBpix);
+        map->yweight = (float *) malloc(sizeof(float) * NBtap * NBpix);
+        if((map->xindex == NULL) || (map->yoffset == NULL) ||
+                (map->xweight == NULL) || (map->yweight == NULL))
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+    }
+    map->NBtap = NBtap;
+    map->NBpix = NBpix;
+    memcpy(&map->geom, geom, sizeof(IMRESAMPLE_GEOM));
+
+    // inverse transform
+    // input = centin + R^-1 S^-1 (output - centout - shift)
+    double ca = cos(geom->angle);
+    double sa = sin(geom->angle);
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (NBpix > OMP_NELEMENT_LIMIT / 10)
+#endif
+    for(uint32_t jj = 0; jj < geom->ysizeout; jj++)
+    {
+        int32_t xi[6];
+        int32_t yi[6];
+        float   wx[6];
+        float   wy[6];
+
+        for(uint32_t ii = 0; ii < geom->xsizeout; ii++)
+        {
+            uint64_t pix = (uint64_t) jj * geom->xsizeout + ii;
+
+            double u = (ii - geom->xcentout - geom->shiftx) / geom->scalex;
+            double v = (jj - geom->ycentout - geom->shifty) / geom->scaley;
+            double x = geom->xcentin + ca * u + sa * v;
+            double y = geom->ycentin - sa * u + ca * v;
+
+            int inx = imresample_kernel_taps(geom->kernel, NBtap, x,
+                                             geom->xsizein, xi, wx);
+            int iny = imresample_kernel_taps(geom->kernel, NBtap, y,
+                                             geom->ysizein, yi, wy);
+
+            for(int t = 0; t < NBtap; t++)
+            {
+                map->xindex[t * NBpix + pix]  = xi[t];
+                map->yoffset[t * NBpix + pix] = yi[t] * (int32_t) geom->xsizein;
+                map->xweight[t * NBpix + pix] = (inx && iny) ? wx[t] : 0.0;
+                map->yweight[t * NBpix + pix] = wy[t];
+            }
+        }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t imresample_map_apply(const IMRESAMPLE_MAP *map,
+                             const float *__restrict in,
+                             float *__restrict out)
+{
+    uint64_t NBpix = map->NBpix;
+    int      NBtap = map->NBtap;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (NBpix * NBtap * NBtap > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t pix0 = 0; pix0 < NBpix; pix0 += IMRESAMPLE_BLOCKSIZE)
+    {
+        float    acc[IMRESAMPLE_BLOCKSIZE];
+        uint64_t npix = NBpix - pix0;
+        if(npix > IMRESAMPLE_BLOCKSIZE)
+        {
+            npix = IMRESAMPLE_BLOCKSIZE;
+        }
+
+        for(uint64_t p = 0; p < npix; p++)
+        {
+            acc[p] = 0.0;
+        }
+
+        for(int ty = 0; ty < NBtap; ty++)
+        {
+            const int32_t *yoff = map->yoffset + ty * NBpix + pix0;
+            const float   *wy   = map->yweight + ty * NBpix + pix0;
+            for(int tx = 0; tx < NBtap; tx++)
+            {
+                const int32_t *xi = map->xindex + tx * NBpix + pix0;
+                const float   *wx = map->xweight + tx * NBpix + pix0;
+#ifdef _OPENMP
+                #pragma omp simd
+#endif
+                for(uint64_t p = 0; p < npix; p++)
+                {
+                    acc[p] += wy[p] * wx[p] * in[yoff[p] + xi[p]];
+                }
+            }
+        }
+
+        memcpy(out + pix0, acc, sizeof(float) * npix);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t imresample_map_applyD(const IMRESAMPLE_MAP *map,
+                              const double *__restrict in,
+                              double *__restrict out)
+{
+    uint64_t NBpix = map->NBpix;
+    int      NBtap = map->NBtap;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (NBpix * NBtap * NBtap > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t pix0 = 0; pix0 < NBpix; pix0 += IMRESAMPLE_BLOCKSIZE)
+    {
+        double   acc[IMRESAMPLE_BLOCKSIZE];
+        uint64_t npix = NBpix - pix0;
+        if(npix > IMRESAMPLE_BLOCKSIZE)
+        {
+            npix = IMRESAMPLE_BLOCKSIZE;
+        }
+
+        for(uint64_t p = 0; p < npix; p++)
+        {
+            acc[p] = 0.0;
+        }
+
+        for(int ty = 0; ty < NBtap; ty++)
+        {
+            const int32_t *yoff = map->yoffset + ty * NBpix + pix0;
+            const float   *wy   = map->yweight + ty * NBpix + pix0;
+            for(int tx = 0; tx < NBtap; tx++)
+            {
+                const int32_t *xi = map->xindex + tx * NBpix + pix0;
+                const float   *wx = map->xweight + tx * NBpix + pix0;
+#ifdef _OPENMP
+                #pragma omp simd
+#endif
+                for(uint64_t p = 0; p < npix; p++)
+                {
+                    acc[p] += wy[p] * wx[p] * in[yoff[p] + xi[p]];
+                }
+            }
+        }
+
+        memcpy(out + pix0, acc, sizeof(double) * npix);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Resample 2D image, one-off
+ *
+ * Output image is created with geometry output size and input datatype.
+ * Float and double images are supported.
+ */
+errno_t imresample_image(const char *__restrict IDin_name,
+                         const char *__restrict IDout_name,
+                         const IMRESAMPLE_GEOM *geom)
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imgin = mkIMGID_from_name(IDin_name);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    uint8_t datatype = imgin.md->datatype;
+    if((datatype != _DATATYPE_FLOAT) && (datatype != _DATATYPE_DOUBLE))
+    {
+        FUNC_RETURN_FAILURE("image %s : wrong type", IDin_name);
+    }
+    if((imgin.md->size[0] != geom->xsizein) ||
+            (imgin.md->size[1] != geom->ysizein))
+    {
+        FUNC_RETURN_FAILURE("image %s : size does not match geometry",
+                            IDin_name);
+    }
+
+    IMGID imgout = makeIMGID_2D(IDout_name, geom->xsizeout, geom->ysizeout);
+    imgout.datatype = datatype;
+    createimagefromIMGID(&imgout);
+
+    IMRESAMPLE_MAP map;
+    imresample_map_init(&map);
+    FUNC_CHECK_RETURN(imresample_map_build(&map, geom));
+
+    if(datatype == _DATATYPE_FLOAT)
+    {
+        imresample_map_apply(&map, imgin.im->array.F, imgout.im->array.F);
+    }
+    else
+    {
+        imresample_map_applyD(&map, imgin.im->array.D, imgout.im->array.D);
+    }
+
+    imresample_map_free(&map);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// ==========================================
+// Stream process
+// ==========================================
+
+
+static char *inimname;
+static long  fpi_inimname;
+
+static char *outimname;
+static long  fpi_outimname;
+
+static uint32_t *xsizeout;
+static long      fpi_xsizeout;
+
+static uint32_t *ysizeout;
+static long      fpi_ysizeout;
+
+static uint32_t *kernel;
+static long      fpi_kernel;
+
+static double *angle;
+static long    fpi_angle;
+
+static double *scalex;
+static long    fpi_scalex;
+
+static double *scaley;
+static long    fpi_scaley;
+
+static double *shiftx;
+static long    fpi_shiftx;
+
+static double *shifty;
+static long    fpi_shifty;
+
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STREAM,
+        ".inim",
+        "input image",
+        "inim",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inimname,
+        &fpi_inimname
+    },
+    {
+        CLIARG_STR,
+        ".outim",
+        "output image",
+        "outim",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        &fpi_outimname
+    },
+    {
+        CLIARG_UINT32,
+        ".xsizeout",
+        "output x size, 0 if same as input",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &xsizeout,
+        &fpi_xsizeout
+    },
+    {
+        CLIARG_UINT32,
+        ".ysizeout",
+        "output y size, 0 if same as input",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &ysizeout,
+        &fpi_ysizeout
+    },
+    {
+        CLIARG_UINT32,
+        ".kernel",
+        "0:bilinear 1:bicubic 2:lanczos3",
+        "1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &kernel,
+        &fpi_kernel
+    },
+    {
+        CLIARG_FLOAT64,
+        ".angle",
+        "rotation angle [rad]",
+        "0.0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &angle,
+        &fpi_angle
+    },
+    {
+        CLIARG_FLOAT64,
+        ".scalex",
+        "x scaling factor",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &scalex,
+        &fpi_scalex
+    },
+    {
+        CLIARG_FLOAT64,
+        ".scaley",
+        "y scaling factor",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &scaley,
+        &fpi_scaley
+    },
+    {
+        CLIARG_FLOAT64,
+        ".shiftx",
+        "x shift [pix]",
+        "0.0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &shiftx,
+        &fpi_shiftx
+    },
+    {
+        CLIARG_FLOAT64,
+        ".shifty",
+        "y shift [pix]",
+        "0.0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &shifty,
+        &fpi_shifty
+    }
+};
+
+
+
+// Optional custom configuration setup.
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_inimname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+
+        data.fpsptr->parray[fpi_kernel].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_angle].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_scalex].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_scaley].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_shiftx].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_shifty].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+static errno_t customCONFcheck()
+{
+    if(data.fpsptr != NULL)
+    {
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+static CLICMDDATA CLIcmddata =
+{
+    "imresample", "shift, rotate and scale image", CLICMD_FIELDS_DEFAULTS
+};
+
+
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Resample 2D image or stream\n");
+    printf("output = S R (input - centin) + centout + shift\n");
+    printf("R : rotation by .angle, S : scaling by .scalex, .scaley\n");
+    printf("Centers are size/2 of input and output images\n");
+    printf("Warp map is recomputed only when geometry changes\n");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imgin = mkIMGID_from_name(inimname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    if(imgin.md->datatype != _DATATYPE_FLOAT)
+    {
+        FUNC_RETURN_FAILURE("image %s must be float", inimname);
+    }
+
+    IMRESAMPLE_GEOM geom;
+    memset(&geom, 0, sizeof(IMRESAMPLE_GEOM));
+    geom.xsizein  = imgin.md->size[0];
+    geom.ysizein  = imgin.md->size[1];
+    geom.xsizeout = (*xsizeout == 0) ? geom.xsizein : *xsizeout;
+    geom.ysizeout = (*ysizeout == 0) ? geom.ysizein : *ysizeout;
+    geom.xcentin  = 0.5 * geom.xsizein;
+    geom.ycentin  = 0.5 * geom.ysizein;
+    geom.xcentout = 0.5 * geom.xsizeout;
+    geom.ycentout = 0.5 * geom.ysizeout;
+
+    IMGID imgout =
+        stream_connect_create_2Df32(outimname, geom.xsizeout, geom.ysizeout);
+
+    IMRESAMPLE_MAP map;
+    imresample_map_init(&map);
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        geom.kernel = *kernel;
+        geom.angle  = *angle;
+        geom.scalex = *scalex;
+        geom.scaley = *scaley;
+        geom.shiftx = *shiftx;
+        geom.shifty = *shifty;
+
+        FUNC_CHECK_RETURN(imresample_map_build(&map, &geom));
+
+        imgout.md->write = 1;
+        imresample_map_apply(&map, imgin.im->array.F, imgout.im->array.F);
+        processinfo_update_output_stream(processinfo, imgout.ID);
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    imresample_map_free(&map);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+// Register function in CLI
+errno_t CLIADDCMD_image_basic__imresample()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
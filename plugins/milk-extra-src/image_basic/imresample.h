@@ -0,0 +1,73 @@
+/** @file imresample.h
+ */
+
+#ifndef _IMAGE_BASIC_IMRESAMPLE_H
+#define _IMAGE_BASIC_IMRESAMPLE_H
+
+#define IMRESAMPLE_KERNEL_BILINEAR 0
+#define IMRESAMPLE_KERNEL_BICUBIC  1
+#define IMRESAMPLE_KERNEL_LANCZOS3 2
+
+// geometric transform, output = S R (input - centin) + centout + shift
+// R : rotation by angle [rad], S : scaling
+//
+typedef struct
+{
+    uint32_t xsizein;
+    uint32_t ysizein;
+    uint32_t xsizeout;
+    uint32_t ysizeout;
+
+    double xcentin;
+    double ycentin;
+    double xcentout;
+    double ycentout;
+
+    double angle;
+    double scalex;
+    double scaley;
+    double shiftx;
+    double shifty;
+
+    int kernel;
+
+} IMRESAMPLE_GEOM;
+
+// precomputed warp map
+// separable kernel taps, stored tap-major : array[tap * NBpix + pix]
+//
+typedef struct
+{
+    IMRESAMPLE_GEOM geom;
+
+    int      NBtap; // taps per axis
+    uint64_t NBpix; // output pixels
+
+    int32_t *xindex; // input column of tap
+    int32_t *yoffset; // input row offset (row x xsizein) of tap
+    float   *xweight;
+    float   *yweight;
+
+} IMRESAMPLE_MAP;
+
+errno_t CLIADDCMD_image_basic__imresample();
+
+errno_t imresample_map_init(IMRESAMPLE_MAP *map);
+
+errno_t imresample_map_build(IMRESAMPLE_MAP *map, const IMRESAMPLE_GEOM *geom);
+
+errno_t imresample_map_free(IMRESAMPLE_MAP *map);
+
+errno_t imresample_map_apply(const IMRESAMPLE_MAP *map,
+                             const float *__restrict in,
+                             float *__restrict out);
+
+errno_t imresample_map_applyD(const IMRESAMPLE_MAP *map,
+                              const double *__restrict in,
+                              double *__restrict out);
+
+errno_t imresample_image(const char *__restrict IDin_name,
+                         const char *__restrict IDout_name,
+                         const IMRESAMPLE_GEOM *geom);
+
+#endif
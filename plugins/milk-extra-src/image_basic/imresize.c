@@ -5,6 +5,8 @@
 
 #include "COREMOD_memory/COREMOD_memory.h"
 
+#include "imresample.h"
+
 // ==========================================
 // Forward declaration(s)
 // ==========================================
@@ -67,76 +69,22 @@ long basic_resizeim(const char *imname_in,
                     long        xsizeout,
                     long        ysizeout)
 {
-    imageID  ID, IDout;
-    long     naxis = 2;
-    uint32_t naxes[2];
-    uint32_t naxesout[2];
-    float    xf, yf, xf1, yf1, uf, tf, v00f, v01f, v10f, v11f;
-    double   xd, yd, xd1, yd1, ud, td, v00d, v01d, v10d, v11d;
-    uint8_t  datatype;
-    long     ii, jj, ii1, jj1;
-
-    ID          = image_ID(imname_in);
-    datatype    = data.image[ID].md[0].datatype;
-    naxes[0]    = data.image[ID].md[0].size[0];
-    naxes[1]    = data.image[ID].md[0].size[1];
-    naxesout[0] = xsizeout;
-    naxesout[1] = ysizeout;
-
-    if(datatype == _DATATYPE_FLOAT)
-    {
-        create_image_ID(imname_out, naxis, naxesout, datatype, 0, 0, 0, &IDout);
-        for(ii = 0; ii < naxesout[0]; ii++)
-            for(jj = 0; jj < naxesout[1]; jj++)
-            {
-                xf  = (float)(1.0 * ii / naxesout[0]);
-                yf  = (float)(1.0 * jj / naxesout[1]);
-                xf1 = xf * (float) naxes[0];
-                yf1 = yf * (float) naxes[1];
-                ii1 = (long) xf1;
-                jj1 = (long) yf1;
-                uf  = xf1 - (float) ii1;
-                tf  = yf1 - (float) jj1;
-                if((ii1 > -1) && (ii1 + 1 < naxes[0]) && (jj1 > -1) &&
-                        (jj1 + 1 < naxes[1]))
-                {
-                    v00f = data.image[ID].array.F[jj1 * naxes[0] + ii1];
-                    v01f = data.image[ID].array.F[(jj1 + 1) * naxes[0] + ii1];
-                    v10f = data.image[ID].array.F[jj1 * naxes[0] + ii1 + 1];
-                    v11f =
-                        data.image[ID].array.F[(jj1 + 1) * naxes[0] + ii1 + 1];
-                    data.image[IDout].array.F[jj * naxesout[0] + ii] =
-                        (float)(v00f * (1.0 - uf) * (1.0 - tf) +
-                                v10f * uf * (1.0 - tf) +
-                                v01f * (1.0 - uf) * tf + v11f * uf * tf);
-                }
-            }
-    }
-    else if(datatype == _DATATYPE_DOUBLE)
-    {
-        create_image_ID(imname_out, naxis, naxesout, datatype, 0, 0, 0, &IDout);
-        for(ii = 0; ii < naxesout[0] - 1; ii++)
-            for(jj = 0; jj < naxesout[1] - 1; jj++)
-            {
-                xd   = 1.0 * ii / naxesout[0];
-                yd   = 1.0 * jj / naxesout[1];
-                xd1  = xd * naxes[0];
-                yd1  = yd * naxes[1];
-                ii1  = (long) xd1;
-                jj1  = (long) yd1;
-                ud   = xd1 - (float) ii1;
-                td   = yd1 - (float) jj1;
-                v00d = data.image[ID].array.D[jj1 * naxes[0] + ii1];
-                v01d = data.image[ID].array.D[(jj1 + 1) * naxes[0] + ii1];
-                v10d = data.image[ID].array.D[jj1 * naxes[0] + ii1 + 1];
-                v11d = data.image[ID].array.D[(jj1 + 1) * naxes[0] + ii1 + 1];
-                data.image[IDout].array.D[jj * naxesout[0] + ii] =
-                    (double)(v00d * (1.0 - ud) * (1.0 - td) +
-                             v10d * ud * (1.0 - td) + v01d * (1.0 - ud) * td +
-                             v11d * ud * td);
-            }
-    }
-    else
+    imageID         ID;
+    IMRESAMPLE_GEOM geom;
+
+    ID = image_ID(imname_in);
+
+    // output pixel ii samples input at ii * xsizein / xsizeout
+    memset(&geom, 0, sizeof(IMRESAMPLE_GEOM));
+    geom.xsizein  = data.image[ID].md[0].size[0];
+    geom.ysizein  = data.image[ID].md[0].size[1];
+    geom.xsizeout = xsizeout;
+    geom.ysizeout = ysizeout;
+    geom.scalex   = 1.0 * xsizeout / geom.xsizein;
+    geom.scaley   = 1.0 * ysizeout / geom.ysizein;
+    geom.kernel   = IMRESAMPLE_KERNEL_BILINEAR;
+
+    if(imresample_image(imname_in, imname_out, &geom) != RETURN_SUCCESS)
     {
         PRINT_ERROR("Wrong image type(s)\n");
         exit(0);
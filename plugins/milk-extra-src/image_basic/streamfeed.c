@@ -1,189 +1,559 @@
 /** @file streamfeed.c
+ *
+ * Feed image cube slices to a stream at a fixed rate, or replay
+ * a logged cube with its original frame timing.
+ *
+ * Frames are paced against absolute deadlines (clock_nanosleep with
+ * TIMER_ABSTIME) computed from the start time, so that copy time and
+ * scheduling delays do not accumulate into rate drift.
+ * Wake-up latency relative to deadline is measured for every frame,
+ * and achieved rate and jitter are reported through processinfo.
  */
 
-#include <sched.h>
+#include <math.h>
+#include <time.h>
 
 #include "CommandLineInterface/CLIcore.h"
 
 #include "COREMOD_memory/COREMOD_memory.h"
 
-// ==========================================
-// Forward declaration(s)
-// ==========================================
-long IMAGE_BASIC_streamfeed(const char *__restrict IDname,
-                            const char *__restrict streamname,
-                            float frequ);
+#include "streamfeed.h"
+
+// statistics reporting interval [s]
+#define STREAMFEED_REPORT_INTERVAL 1.0
+
+
+
 
 // ==========================================
-// Command line interface wrapper function(s)
+// Function parameters
 // ==========================================
 
-static errno_t image_basic_streamfeed_cli()
+static char *inimname;
+static long  fpi_inimname = -1;
+
+static char *outstreamname;
+
+static double *frequ;
+static long    fpi_frequ = -1;
+
+static char *timingfname;
+
+static double *speed;
+static long    fpi_speed = -1;
+
+static uint64_t *loopmode;
+
+static double *achievedrate;
+
+static double *jitterrms;
+
+static double *jittermax;
+
+static uint64_t *NBoverrun;
+
+
+
+static CLICMDARGDEF farg[] =
 {
-    if(CLI_checkarg(1, 4) + CLI_checkarg(2, 4) + CLI_checkarg(3, 1) == 0)
     {
-        IMAGE_BASIC_streamfeed(data.cmdargtoken[1].val.string,
-                               data.cmdargtoken[2].val.string,
-                               data.cmdargtoken[3].val.numf);
-        return CLICMD_SUCCESS;
-    }
-    else
+        CLIARG_IMG,
+        ".inim",
+        "input image cube",
+        "imc",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inimname,
+        &fpi_inimname
+    },
+    {
+        CLIARG_STR,
+        ".outstream",
+        "output stream",
+        "imstream",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outstreamname,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".frequ",
+        "frame rate [Hz]",
+        "100.0",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &frequ,
+        &fpi_frequ
+    },
+    {
+        CLIARG_STR,
+        ".timingfile",
+        "logged timing file for replay, none for fixed rate",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &timingfname,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".speed",
+        "replay speed factor",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &speed,
+        &fpi_speed
+    },
+    {
+        CLIARG_ONOFF,
+        ".loop",
+        "loop over cube",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &loopmode,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".status.rate",
+        "achieved frame rate [Hz]",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &achievedrate,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".status.jitterrms",
+        "RMS wake-up latency [us]",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &jitterrms,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".status.jittermax",
+        "max wake-up latency [us]",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &jittermax,
+        NULL
+    },
     {
-        return CLICMD_INVALID_ARG;
+        CLIARG_UINT64,
+        ".status.NBoverrun",
+        "number of frames late by more than one period",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBoverrun,
+        NULL
     }
-}
+};
 
-// ==========================================
-// Register CLI command(s)
-// ==========================================
 
-errno_t __attribute__((cold)) streamfeed_addCLIcmd()
+
+// Optional custom configuration setup.
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
 {
-    RegisterCLIcommand("imgstreamfeed",
-                       __FILE__,
-                       image_basic_streamfeed_cli,
-                       "feed stream of images",
-                       "<input image/cube> <stream> <fequ [Hz]>",
-                       "imgstreamfeed im imstream 100",
-                       "long IMAGE_BASIC_streamfeed(const char *IDname, const "
-                       "char *streamname, float frequ)");
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_inimname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+
+        data.fpsptr->parray[fpi_frequ].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_speed].fpflag |= FPFLAG_WRITERUN;
+    }
 
     return RETURN_SUCCESS;
 }
 
-// feed image to data stream
-// only works on slice #1 out output
-long IMAGE_BASIC_streamfeed(const char *__restrict IDname,
-                            const char *__restrict streamname,
-                            float frequ)
+
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+// .frequ and .speed are divisors, writable while running :
+// values <= 0 are rejected, last valid value is restored
+//
+static errno_t customCONFcheck()
 {
-    imageID            ID;
-    imageID            IDs;
-    long               xsize, ysize, xysize, zsize;
-    long               k;
-    long               tdelay;
-    int                RT_priority = 95; //any number from 0-99
-    struct sched_param schedpar;
-    int                semval;
-    const char        *ptr0;
-    const char        *ptr1;
-    int                loopOK;
-    long               ii;
-
-    schedpar.sched_priority = RT_priority;
-    if(seteuid(data.euid) != 0)  //This goes up to maximum privileges
-    {
-        PRINT_ERROR("seteuid error");
-    }
-    sched_setscheduler(0,
-                       SCHED_FIFO,
-                       &schedpar); //other option is SCHED_RR, might be faster
-    if(seteuid(data.ruid) != 0)    //Go back to normal privileges
+    static double frequ_valid = 100.0;
+    static double speed_valid = 1.0;
+
+    if(data.fpsptr != NULL)
     {
-        PRINT_ERROR("seteuid error");
+        double *fval = &data.fpsptr->parray[fpi_frequ].val.f64[0];
+        if(!(*fval > 0.0))
+        {
+            PRINT_WARNING(".frequ %f must be > 0, reset to %f",
+                          *fval,
+                          frequ_valid);
+            *fval = frequ_valid;
+        }
+        frequ_valid = *fval;
+
+        double *sval = &data.fpsptr->parray[fpi_speed].val.f64[0];
+        if(!(*sval > 0.0))
+        {
+            PRINT_WARNING(".speed %f must be > 0, reset to %f",
+                          *sval,
+                          speed_valid);
+            *sval = speed_valid;
+        }
+        speed_valid = *sval;
     }
 
-    ID     = image_ID(IDname);
-    xsize  = data.image[ID].md[0].size[0];
-    ysize  = data.image[ID].md[0].size[1];
-    xysize = xsize * ysize;
+    return RETURN_SUCCESS;
+}
+
 
-    tdelay = (long)(1000000.0 / frequ);
 
-    printf("frequ = %f Hz\n", frequ);
-    printf("tdelay = %ld us\n", tdelay);
+static CLICMDDATA CLIcmddata =
+{
+    "imgstreamfeed", "feed stream of images", CLICMD_FIELDS_DEFAULTS
+};
+
+
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Copy successive slices of input cube to output stream\n");
+    printf("Frames are published at absolute deadlines, either every\n");
+    printf("1/.frequ sec, or following timestamps of a logged cube\n");
+    printf("if .timingfile is set (col5 of logshim timing file),\n");
+    printf("time-scaled by 1/.speed\n");
+    printf("Achieved rate and jitter are written to .status.*\n");
+
+    return RETURN_SUCCESS;
+}
+
 
-    IDs = image_ID(streamname);
-    if((xsize != data.image[IDs].md[0].size[0]) ||
-            (ysize != data.image[IDs].md[0].size[1]))
-    {
-        printf("ERROR: images have different x and y sizes");
-        exit(0);
-    }
-    zsize = data.image[ID].md[0].size[2];
 
-    ptr1 = (char *) data.image[IDs].array.F; // destination
 
-    if(sigaction(SIGINT, &data.sigact, NULL) == -1)
+static inline void timespec_add_ns(struct timespec *t, int64_t dtns)
+{
+    int64_t ns = t->tv_nsec + dtns;
+
+    t->tv_sec += ns / 1000000000L;
+    ns = ns % 1000000000L;
+    if(ns < 0)
     {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+        ns += 1000000000L;
+        t->tv_sec--;
     }
-    if(sigaction(SIGTERM, &data.sigact, NULL) == -1)
+    t->tv_nsec = ns;
+}
+
+
+static inline int64_t timespec_diff_ns(
+    const struct timespec *t1,
+    const struct timespec *t0
+)
+{
+    return (int64_t)(t1->tv_sec - t0->tv_sec) * 1000000000L +
+           (t1->tv_nsec - t0->tv_nsec);
+}
+
+
+
+
+/**
+ * @brief Read frame times from logshim timing file
+ *
+ * Frame times are relative to first frame, in ns.
+ * Acquisition time (col5) is used.
+ */
+static errno_t streamfeed_read_timingfile(
+    const char *fname,
+    uint32_t    NBframe,
+    int64_t    *tframe
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    FILE *fp = fopen(fname, "r");
+    if(fp == NULL)
     {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+        FUNC_RETURN_FAILURE("cannot open timing file %s", fname);
     }
-    if(sigaction(SIGBUS, &data.sigact, NULL) == -1)
+
+    char     line[512];
+    uint32_t k  = 0;
+    double   t0 = 0.0;
+    while((k < NBframe) && (fgets(line, sizeof(line), fp) != NULL))
     {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+        if(line[0] == '#')
+        {
+            continue;
+        }
+
+        long          index;
+        unsigned long mainindex;
+        double        tcube, tlog, tacq;
+        if(sscanf(line,
+                  "%ld %lu %lf %lf %lf",
+                  &index,
+                  &mainindex,
+                  &tcube,
+                  &tlog,
+                  &tacq) != 5)
+        {
+            continue;
+        }
+
+        if(k == 0)
+        {
+            t0 = tacq;
+        }
+        tframe[k] = (int64_t)((tacq - t0) * 1.0e9);
+        k++;
     }
-    if(sigaction(SIGSEGV, &data.sigact, NULL) == -1)
+    fclose(fp);
+
+    if(k < NBframe)
     {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+        FUNC_RETURN_FAILURE("timing file %s has %u entries, %u frames",
+                            fname, k, NBframe);
     }
-    if(sigaction(SIGABRT, &data.sigact, NULL) == -1)
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imgin = mkIMGID_from_name(inimname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    if(!(*frequ > 0.0) || !(*speed > 0.0))
     {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+        FUNC_RETURN_FAILURE(".frequ %f and .speed %f must be > 0",
+                            *frequ,
+                            *speed);
     }
-    if(sigaction(SIGHUP, &data.sigact, NULL) == -1)
+
+    uint32_t xsize  = imgin.md->size[0];
+    uint32_t ysize  = imgin.md->size[1];
+    uint32_t zsize  = (imgin.md->naxis > 2) ? imgin.md->size[2] : 1;
+    uint64_t framesize =
+        (uint64_t) xsize * ysize * ImageStreamIO_typesize(imgin.md->datatype);
+
+    IMGID imgout =
+        stream_connect_create_2D(outstreamname, xsize, ysize, imgin.md->datatype);
+    if((imgout.md->size[0] != xsize) || (imgout.md->size[1] != ysize) ||
+            (imgout.md->datatype != imgin.md->datatype))
     {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+        FUNC_RETURN_FAILURE("stream %s size or type does not match input",
+                            outstreamname);
     }
-    if(sigaction(SIGPIPE, &data.sigact, NULL) == -1)
+
+
+    // replay frame times, relative to cube start [ns]
+    // tframe[zsize] is the cube period when looping
+    //
+    int64_t *tframe = NULL;
+    if(strcmp(timingfname, "none") != 0)
     {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+        tframe = (int64_t *) malloc(sizeof(int64_t) * (zsize + 1));
+        if(tframe == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        if(streamfeed_read_timingfile(timingfname, zsize, tframe) !=
+                RETURN_SUCCESS)
+        {
+            free(tframe);
+            FUNC_RETURN_FAILURE("cannot read timing file %s", timingfname);
+        }
+
+        // gap between last and first frame is the mean frame interval
+        if(zsize > 1)
+        {
+            tframe[zsize] = tframe[zsize - 1] + tframe[zsize - 1] / (zsize - 1);
+        }
+        else
+        {
+            tframe[zsize] = (int64_t)(1.0e9 / (*frequ));
+        }
     }
 
-    k      = 0;
-    loopOK = 1;
-    while(loopOK == 1)
+
+    struct timespec tstart;     // deadline of frame 0 of current cube
+    struct timespec tdeadline;
+    struct timespec twake;
+    struct timespec treport;
+    clock_gettime(CLOCK_MONOTONIC, &tstart);
+    tdeadline = tstart;
+    treport   = tstart;
+
+    uint32_t slice = 0;
+
+    // fixed rate deadlines are counted from tstart, so that rate
+    // changes while running restart the count
+    // .frequ and .speed may be written while running : values <= 0 are
+    // ignored, last valid value is kept
+    double   frequ0 = *frequ;
+    double   speed0 = *speed;
+    uint64_t fcnt   = 0;
+
+    // statistics over reporting interval
+    uint64_t statcnt    = 0;
+    double   statlat2   = 0.0;
+    double   statlatmax = 0.0;
+
+    *NBoverrun = 0;
+
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
     {
-        ptr0 = (char *) data.image[ID].array.F;
-        ptr0 += sizeof(float) * xysize * k;
-        data.image[IDs].md[0].write = 1;
-        memcpy((void *) ptr1, (void *) ptr0, sizeof(float) * xysize);
+        // next deadline
+        //
+        if(tframe == NULL)
+        {
+            double frequreq = *frequ; // read once, may be written
+            if((frequreq != frequ0) && (frequreq > 0.0))
+            {
+                frequ0 = frequreq;
+                tstart = tdeadline;
+                fcnt   = 1;
+            }
+            tdeadline = tstart;
+            timespec_add_ns(&tdeadline, (int64_t)(1.0e9 * fcnt / frequ0));
+        }
+        else
+        {
+            double speedreq = *speed; // read once, may be written
+            if((speedreq != speed0) && (speedreq > 0.0))
+            {
+                // rebase tstart so that current deadline is unchanged and
+                // playback continues from current position at new speed
+                timespec_add_ns(&tstart,
+                                (int64_t)(tframe[slice] / speed0) -
+                                (int64_t)(tframe[slice] / speedreq));
+                speed0 = speedreq;
+            }
+            tdeadline = tstart;
+            timespec_add_ns(&tdeadline, (int64_t)(tframe[slice] / speed0));
+        }
 
-        data.image[IDs].md[0].write = 0;
-        data.image[IDs].md[0].cnt0++;
-        COREMOD_MEMORY_image_set_sempost_byID(IDs, -1);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tdeadline, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &twake);
 
-        usleep(tdelay);
-        k++;
-        if(k == zsize)
+        imgout.md->write = 1;
+        memcpy(imgout.im->array.raw,
+               (char *) imgin.im->array.raw + framesize * slice,
+               framesize);
+        processinfo_update_output_stream(processinfo, imgout.ID);
+
+
+        // wake-up latency
+        //
+        double lat = 1.0e-9 * timespec_diff_ns(&twake, &tdeadline);
+        statlat2 += lat * lat;
+        if(lat > statlatmax)
         {
-            k = 0;
+            statlatmax = lat;
         }
+        statcnt++;
 
-        if((data.signal_INT == 1) || (data.signal_TERM == 1) ||
-                (data.signal_ABRT == 1) || (data.signal_BUS == 1) ||
-                (data.signal_SEGV == 1) || (data.signal_HUP == 1) ||
-                (data.signal_PIPE == 1))
+        // if late by more than one period, resynchronize deadlines
+        // instead of bursting frames to catch up
+        //
+        double period = (tframe == NULL) ?
+                        1.0 / frequ0 :
+                        1.0e-9 * tframe[zsize] / speed0 / zsize;
+        if(lat > period)
         {
-            loopOK = 0;
+            (*NBoverrun)++;
+            if(tframe == NULL)
+            {
+                tstart = twake;
+                fcnt   = 0;
+            }
+            else
+            {
+                timespec_add_ns(&tstart, timespec_diff_ns(&twake, &tdeadline));
+            }
         }
-    }
 
-    data.image[IDs].md[0].write = 1;
-    for(ii = 0; ii < xysize; ii++)
-    {
-        data.image[IDs].array.F[ii] = 0.0;
-    }
-    if(data.image[IDs].md[0].sem > 0)
-    {
-        semval = ImageStreamIO_semvalue(data.image+IDs, 0);
-        if(semval < SEMAPHORE_MAXVAL)
+
+        // next frame
+        //
+        fcnt++;
+        slice++;
+        if(slice == zsize)
         {
-            ImageStreamIO_sempost(data.image+IDs, 0);
+            slice = 0;
+            if(tframe != NULL)
+            {
+                timespec_add_ns(&tstart, (int64_t)(tframe[zsize] / speed0));
+            }
+            if(*loopmode == 0)
+            {
+                processloopOK = 0;
+            }
+        }
+
+
+        // report
+        //
+        double dtreport = 1.0e-9 * timespec_diff_ns(&twake, &treport);
+        if(dtreport > STREAMFEED_REPORT_INTERVAL)
+        {
+            *achievedrate = statcnt / dtreport;
+            *jitterrms    = 1.0e6 * sqrt(statlat2 / statcnt);
+            *jittermax    = 1.0e6 * statlatmax;
+
+            if(processinfo != NULL)
+            {
+                char msgstring[STRINGMAXLEN_PROCESSINFO_STATUSMSG];
+                snprintf(msgstring,
+                         STRINGMAXLEN_PROCESSINFO_STATUSMSG,
+                         "%.1f Hz (req %.1f) jit %.1f/%.1f us ovr %lu",
+                         *achievedrate,
+                         (tframe == NULL) ? frequ0 : speed0 * 1.0e9 * zsize /
+                         tframe[zsize],
+                         *jitterrms,
+                         *jittermax,
+                         (unsigned long) *NBoverrun);
+                processinfo_WriteMessage(processinfo, msgstring);
+            }
+
+            treport    = twake;
+            statcnt    = 0;
+            statlat2   = 0.0;
+            statlatmax = 0.0;
         }
     }
-    data.image[IDs].md[0].write = 0;
-    data.image[IDs].md[0].cnt0++;
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    free(tframe);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
 
-    return (0);
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+// Register function in CLI
+errno_t CLIADDCMD_image_basic__streamfeed()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
 }
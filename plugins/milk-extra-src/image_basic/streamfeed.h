@@ -1,8 +1,4 @@
 /** @file streamfeed.h
  */
 
-errno_t __attribute__((cold)) streamfeed_addCLIcmd();
-
-long IMAGE_BASIC_streamfeed(const char *__restrict IDname,
-                            const char *__restrict streamname,
-                            float frequ);
+errno_t CLIADDCMD_image_basic__streamfeed();
@@ -1,105 +1,424 @@
 /** @file streamrecord.c
+ *
+ * Record stream frames into memory, triggered by stream semaphore.
+ *
+ * Frames are copied into a ring buffer allocated once at startup
+ * (optionally backed by huge pages), so that the fast loop does not
+ * allocate, print or poll. Missed frames are detected from gaps in
+ * the stream cnt0 counter and counted.
+ *
+ * On exit, the ring is written in chronological order to the output
+ * cube, and per-frame counters and timestamps to <output>_timing.
  */
 
-#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
 
 #include "CommandLineInterface/CLIcore.h"
 
 #include "COREMOD_memory/COREMOD_memory.h"
 
-// ==========================================
-// Forward declaration(s)
-// ==========================================
+#include "streamrecord.h"
+
+// columns of timing image
+// cnt0, cnt1, stream acquisition time, record time
+#define STREAMRECORD_NBTIMINGCOL 4
+
+
 
-imageID IMAGE_BASIC_streamrecord(const char *__restrict streamname,
-                                 long NBframes,
-                                 const char *__restrict IDname);
 
 // ==========================================
-// Command line interface wrapper function(s)
+// Function parameters
 // ==========================================
 
-static errno_t IMAGE_BASIC_streamrecord_cli()
+static char *instreamname;
+static long  fpi_instreamname = -1;
+
+static uint64_t *NBframe;
+
+static char *outimname;
+
+static uint64_t *ringmode;
+
+static uint64_t *hugepage;
+
+static uint64_t *NBrecorded;
+
+static uint64_t *NBdropped;
+
+static uint64_t *NBtorn;
+
+
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STREAM,
+        ".instream",
+        "input stream",
+        "imstream",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &instreamname,
+        &fpi_instreamname
+    },
+    {
+        CLIARG_UINT64,
+        ".NBframe",
+        "number of frames",
+        "100",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &NBframe,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outim",
+        "output cube",
+        "imrec",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    },
+    {
+        CLIARG_ONOFF,
+        ".ring",
+        "keep recording until stopped, keep last NBframe",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &ringmode,
+        NULL
+    },
+    {
+        CLIARG_ONOFF,
+        ".hugepage",
+        "allocate ring buffer on huge pages",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &hugepage,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".status.NBrecorded",
+        "number of frames recorded",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBrecorded,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".status.NBdropped",
+        "number of frames missed, from cnt0 gaps",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBdropped,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".status.NBtorn",
+        "number of frames overwritten during copy",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBtorn,
+        NULL
+    }
+};
+
+
+
+// Optional custom configuration setup.
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
 {
-    if(0 + CLI_checkarg(1, 4) + CLI_checkarg(2, 2) + CLI_checkarg(3, 3) == 0)
+    if(data.fpsptr != NULL)
     {
-        IMAGE_BASIC_streamrecord(data.cmdargtoken[1].val.string,
-                                 data.cmdargtoken[2].val.numl,
-                                 data.cmdargtoken[3].val.string);
-        return CLICMD_SUCCESS;
+        data.fpsptr->parray[fpi_instreamname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
     }
-    else
+
+    return RETURN_SUCCESS;
+}
+
+
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+static errno_t customCONFcheck()
+{
+    if(data.fpsptr != NULL)
     {
-        return CLICMD_INVALID_ARG;
     }
+
+    return RETURN_SUCCESS;
 }
 
-// ==========================================
-// Register CLI command(s)
-// ==========================================
 
-errno_t __attribute__((cold)) streamrecord_addCLIcmd()
+
+static CLICMDDATA CLIcmddata =
 {
+    "imgstreamrec", "record stream of images", CLICMD_FIELDS_DEFAULTS
+};
 
-    RegisterCLIcommand("imgstreamrec",
-                       __FILE__,
-                       IMAGE_BASIC_streamrecord_cli,
-                       "record stream of images",
-                       "<stream> <# frames> <output>",
-                       "imgstreamrec imstream 100 imrec",
-                       "long IMAGE_BASIC_streamrecord(const char *streamname, "
-                       "long NBframes, const char *IDname)");
+
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Record frames of input stream, triggered by stream semaphore\n");
+    printf("Stops after .NBframe frames, or if .ring is on, records\n");
+    printf("continuously and keeps last .NBframe frames\n");
+    printf("Output cube is written on exit, with per-frame\n");
+    printf("cnt0, cnt1, acquisition time and record time in <outim>_timing\n");
+    printf("Missed frames (cnt0 gaps) are counted in .status.NBdropped\n");
+    printf("3D input frames are written as size[0] x (size[1]*size[2]) slices\n");
 
     return RETURN_SUCCESS;
 }
 
-// works only for floats
-//
-imageID IMAGE_BASIC_streamrecord(const char *__restrict streamname,
-                                 long NBframes,
-                                 const char *__restrict IDname)
+
+
+
+/**
+ * @brief Allocate ring buffer, pages populated upfront
+ *
+ * Falls back to regular pages if huge pages are not available.
+ */
+static void *streamrecord_ring_alloc(
+    size_t  ringsize,
+    int     usehugepage,
+    size_t *mapsize
+)
 {
-    imageID       ID;
-    imageID       IDstream;
-    long          xsize, ysize, zsize, xysize;
-    unsigned long cnt;
-    long          waitdelayus = 50;
-    long          kk;
-    char         *ptr;
+    void *ring = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if(usehugepage == 1)
+    {
+        // round up to 2 MB default huge page size
+        size_t hpsize = 1UL << 21;
+        *mapsize      = ((ringsize + hpsize - 1) / hpsize) * hpsize;
+        ring          = mmap(NULL,
+                             *mapsize,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                             MAP_POPULATE,
+                             -1,
+                             0);
+        if(ring == MAP_FAILED)
+        {
+            PRINT_WARNING("huge page allocation failed, using regular pages");
+        }
+    }
+#endif
+
+    if(ring == MAP_FAILED)
+    {
+        *mapsize = ringsize;
+        ring     = mmap(NULL,
+                        *mapsize,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                        -1,
+                        0);
+    }
+
+    if(ring == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    return ring;
+}
 
-    IDstream = image_ID(streamname);
-    xsize    = data.image[IDstream].md[0].size[0];
-    ysize    = data.image[IDstream].md[0].size[1];
-    zsize    = NBframes;
-    xysize   = xsize * ysize;
 
-    create_3Dimage_ID(IDname, xsize, ysize, zsize, &ID);
-    cnt = data.image[IDstream].md[0].cnt0;
 
-    kk = 0;
 
-    ptr = (char *) data.image[ID].array.F;
-    while(kk != NBframes)
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imgin = mkIMGID_from_name(instreamname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    // recorder is always triggered by input stream semaphore
+    //
+    strcpy(CLIcmddata.cmdsettings->triggerstreamname, instreamname);
+    CLIcmddata.cmdsettings->triggermode = PROCESSINFO_TRIGGERMODE_SEMAPHORE;
+    if(data.fpsptr != NULL)
     {
-        while(cnt > data.image[IDstream].md[0].cnt0)
+        strcpy(data.fpsptr->cmdset.triggerstreamname, instreamname);
+        data.fpsptr->cmdset.triggermode = PROCESSINFO_TRIGGERMODE_SEMAPHORE;
+        if(data.fpsptr->cmdset.triggermodeptr != NULL)
         {
-            usleep(waitdelayus);
+            *data.fpsptr->cmdset.triggermodeptr =
+                PROCESSINFO_TRIGGERMODE_SEMAPHORE;
         }
+    }
 
-        cnt++;
+    uint64_t NBslot    = *NBframe;
+    uint64_t framesize = imgin.md->nelement *
+                         ImageStreamIO_typesize(imgin.md->datatype);
 
-        printf("\r%ld / %ld  [%ld %ld]      ",
-               kk,
-               NBframes,
-               cnt,
-               data.image[ID].md[0].cnt0);
-        fflush(stdout);
+    size_t mapsize;
+    char  *ring =
+        (char *) streamrecord_ring_alloc(NBslot * framesize, *hugepage, &mapsize);
+    if(ring == NULL)
+    {
+        FUNC_RETURN_FAILURE("cannot allocate %lu byte ring buffer",
+                            (unsigned long)(NBslot * framesize));
+    }
 
-        memcpy(ptr, data.image[IDstream].array.F, sizeof(float) * xysize);
-        ptr += sizeof(float) * xysize;
-        kk++;
+    double *timing =
+        (double *) malloc(sizeof(double) * STREAMRECORD_NBTIMINGCOL * NBslot);
+    if(timing == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
     }
-    printf("\n\n");
 
-    return ID;
+    uint64_t slot     = 0;
+    uint64_t cnt0prev = 0;
+
+    *NBrecorded = 0;
+    *NBdropped  = 0;
+    *NBtorn     = 0;
+
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        uint64_t cnt0 = imgin.md->cnt0;
+
+        // skip semaphore posted without new frame
+        if((*NBrecorded == 0) || (cnt0 != cnt0prev))
+        {
+            // cnt0 going backward (stream re-created) is not a drop
+            if((*NBrecorded > 0) && (cnt0 > cnt0prev))
+            {
+                *NBdropped += cnt0 - cnt0prev - 1;
+            }
+            cnt0prev = cnt0;
+
+            memcpy(ring + slot * framesize, imgin.im->array.raw, framesize);
+
+            // frame overwritten while copying
+            if(imgin.md->cnt0 != cnt0)
+            {
+                (*NBtorn)++;
+            }
+
+            struct timespec trec;
+            clock_gettime(CLOCK_MILK, &trec);
+
+            double *tslot = timing + STREAMRECORD_NBTIMINGCOL * slot;
+            tslot[0]      = cnt0;
+            tslot[1]      = imgin.md->cnt1;
+            tslot[2]      = imgin.md->atime.tv_sec +
+                            1.0e-9 * imgin.md->atime.tv_nsec;
+            tslot[3]      = trec.tv_sec + 1.0e-9 * trec.tv_nsec;
+
+            (*NBrecorded)++;
+            slot++;
+            if(slot == NBslot)
+            {
+                slot = 0;
+                if(*ringmode == 0)
+                {
+                    processloopOK = 0;
+                }
+            }
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+
+    // write ring to output, oldest frame first
+    //
+    uint64_t NBout = (*NBrecorded < NBslot) ? *NBrecorded : NBslot;
+    uint64_t slot0 = (*NBrecorded < NBslot) ? 0 : slot;
+
+    printf("recorded %lu frames, %lu dropped, %lu torn\n",
+           (unsigned long) *NBrecorded,
+           (unsigned long) *NBdropped,
+           (unsigned long) *NBtorn);
+
+    if(NBout > 0)
+    {
+        // one slice per frame, higher input axes folded into y
+        imageID  IDout;
+        uint32_t sizeout[3] = {imgin.md->size[0],
+                               (uint32_t)(imgin.md->nelement /
+                                          imgin.md->size[0]),
+                               (uint32_t) NBout
+                              };
+        if(create_image_ID(outimname,
+                           3,
+                           sizeout,
+                           imgin.md->datatype,
+                           0,
+                           0,
+                           0,
+                           &IDout) != RETURN_SUCCESS)
+        {
+            munmap(ring, mapsize);
+            free(timing);
+            FUNC_RETURN_FAILURE("cannot create %s", outimname);
+        }
+
+        char timingname[STRINGMAXLEN_IMAGE_NAME];
+        WRITE_IMAGENAME(timingname, "%s_timing", outimname);
+        imageID  IDtiming;
+        uint32_t sizetiming[2] = {STREAMRECORD_NBTIMINGCOL, (uint32_t) NBout};
+        if(create_image_ID(timingname,
+                           2,
+                           sizetiming,
+                           _DATATYPE_DOUBLE,
+                           0,
+                           0,
+                           0,
+                           &IDtiming) != RETURN_SUCCESS)
+        {
+            munmap(ring, mapsize);
+            free(timing);
+            FUNC_RETURN_FAILURE("cannot create %s", timingname);
+        }
+
+        for(uint64_t k = 0; k < NBout; k++)
+        {
+            uint64_t s = (slot0 + k) % NBslot;
+            memcpy((char *) data.image[IDout].array.raw + k * framesize,
+                   ring + s * framesize,
+                   framesize);
+            memcpy(data.image[IDtiming].array.D + STREAMRECORD_NBTIMINGCOL * k,
+                   timing + STREAMRECORD_NBTIMINGCOL * s,
+                   sizeof(double) * STREAMRECORD_NBTIMINGCOL);
+        }
+    }
+
+    munmap(ring, mapsize);
+    free(timing);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+// Register function in CLI
+errno_t CLIADDCMD_image_basic__streamrecord()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
 }
@@ -1,8 +1,4 @@
 /** @file streamrecord.h
  */
 
-errno_t __attribute__((cold)) streamrecord_addCLIcmd();
-
-imageID IMAGE_BASIC_streamrecord(const char *__restrict streamname,
-                                 long NBframes,
-                                 const char *__restrict IDname);
+errno_t CLIADDCMD_image_basic__streamrecord();
@@ -12,7 +12,7 @@
 #include "image_filter/image_filter.h"
 #include "image_gen/image_gen.h"
 
-#include "kdtree/kdtree.h"
+#include "kdtree/kdtree_bulk.h"
 
 /* ----------------------------------------------------------------------
  *
@@ -42,23 +42,17 @@ imageID basic_tableto2Dim(const char *__restrict fname,
     double       *xarray = NULL;
     double       *yarray = NULL;
     double       *varray = NULL;
-    void         *ptree  = NULL;
-    double        buf[2];
-    double        pt[2];
-    double        radius, radius0;
-    double       *pv       = NULL;
-    struct kdres *presults = NULL;
+    KDTREE_BULK  *ptree  = NULL;
+    double       *ptpos  = NULL;
+    double        radius0;
     double        dist;
-    double       *pos;
-    //  double tmp1;
-    int ok;
 
     long long cnttotal    = 0;
     long long cntrejected = 0;
     double    valm, val0, val1;
 
     // nearest points
-    long    NBnpt, NBnptmax;
+    long    NBnpt;
     double *pt_x   = NULL;
     double *pt_y   = NULL;
     double *pt_val = NULL;
@@ -70,22 +64,15 @@ imageID basic_tableto2Dim(const char *__restrict fname,
 
     double radiusmax = 50.0;
 
+    // number of nearest points used for each output pixel
+    int NBknn = 30;
+
     printf("table : %s\n", fname);
     printf("range : %f -> %f    %f -> %f\n", xmin, xmax, ymin, ymax);
     printf("output: %s (%ld x %ld)\n", ID_name, xsize, ysize);
     printf("kernel size = %f\n", convsize);
     printf("radiusmax = %f\n", radiusmax);
 
-    pos = (double *) malloc(sizeof(double) * 2);
-    if(pos == NULL)
-    {
-        C_ERRNO = errno;
-        PRINT_ERROR("malloc() error");
-        exit(0);
-    }
-    pos[0] = 0.0;
-    pos[1] = 0.0;
-
     // load table into array
     NBpts  = file_number_lines(fname);
     xarray = (double *) malloc(sizeof(double) * NBpts);
@@ -142,16 +129,26 @@ imageID basic_tableto2Dim(const char *__restrict fname,
     printf("%ld points read\n", NBpts);
     fflush(stdout);
 
-    /* create a k-d tree for 2-dimensional points */
-    ptree = kd_create(2);
-
-    /* add nodes to the tree */
+    /* build k-d tree for 2-dimensional points */
+    ptpos = (double *) malloc(sizeof(double) * 2 * NBpts);
+    if(ptpos == NULL)
+    {
+        C_ERRNO = errno;
+        PRINT_ERROR("malloc() error");
+        exit(0);
+    }
     for(i = 0; i < NBpts; i++)
     {
-        buf[0] = xarray[i];
-        buf[1] = yarray[i];
-        kd_insert(ptree, buf, &varray[i]);
+        ptpos[2 * i]     = xarray[i];
+        ptpos[2 * i + 1] = yarray[i];
+    }
+    ptree = kdtree_bulk_create(ptpos, NBpts, 2);
+    if(ptree == NULL)
+    {
+        PRINT_ERROR("kdtree_bulk_create() error");
+        exit(0);
     }
+    free(ptpos);
 
     create_2Dimage_ID(ID_name, xsize, ysize, &ID);
 
@@ -170,9 +167,8 @@ imageID basic_tableto2Dim(const char *__restrict fname,
     radius0 = 5.0 * convsize / sqrt(1.0 * xsize * ysize);
     radius0 *= sqrt((xmax - xmin) * (ymax - ymin));
 
-    NBnpt    = 15000;
-    NBnptmax = NBnpt;
-    pt_x     = (double *) malloc(sizeof(double) * NBnpt);
+    NBnpt = NBknn;
+    pt_x  = (double *) malloc(sizeof(double) * NBnpt);
     if(pt_x == NULL)
     {
         C_ERRNO = errno;
@@ -230,85 +226,58 @@ imageID basic_tableto2Dim(const char *__restrict fname,
     printf("radius = %g\n", radius0);
     fflush(stdout);
 
+    // k-NN query buffers for one column of output pixels
+    double *qpos    = (double *) malloc(sizeof(double) * 2 * ysize);
+    long   *nnindex = (long *) malloc(sizeof(long) * NBknn * ysize);
+    double *nndist2 = (double *) malloc(sizeof(double) * NBknn * ysize);
+    if((qpos == NULL) || (nnindex == NULL) || (nndist2 == NULL))
+    {
+        C_ERRNO = errno;
+        PRINT_ERROR("malloc() error");
+        exit(0);
+    }
+
     printf("\n");
     for(ii = 0; ii < xsize; ii++)
     {
         printf("\r[%ld/%ld]   ", ii, xsize);
         fflush(stdout);
+
+        /* find NBknn points closest to each pixel of column */
         for(jj = 0; jj < ysize; jj++)
         {
-            //	printf("[%ld %ld]\n",ii,jj);
-            //	fflush(stdout);
-
-            x = (float)(1.0 * xmin + 1.0 * (xmax - xmin) * ii / xsize);
-            y = (float)(1.0 * ymin + 1.0 * (ymax - ymin) * jj / ysize);
-
-            /* find points closest to the origin and within distance radius */
-            pt[0] = x;
-            pt[1] = y;
-
-            radius = radius0;
-            ok     = 0;
-            while(ok == 0)
-            {
-                presults = kd_nearest_range(ptree, pt, radius);
+            qpos[2 * jj] = (float)(1.0 * xmin + 1.0 * (xmax - xmin) * ii / xsize);
+            qpos[2 * jj + 1] =
+                (float)(1.0 * ymin + 1.0 * (ymax - ymin) * jj / ysize);
+        }
+        kdtree_bulk_knn_batch(ptree, qpos, ysize, NBknn, nnindex, nndist2);
 
-                //presults = kd_nearest( ptree, pt );
+        for(jj = 0; jj < ysize; jj++)
+        {
+            x = qpos[2 * jj];
+            y = qpos[2 * jj + 1];
 
-                /* print out all the points found in results */
-                //  printf( "[%g %g] found %d results (radius = %f):\n", x,y, kd_res_size(presults), radius );
-                if((kd_res_size(presults) < 30) && (radius < radiusmax))
-                {
-                    radius *= 1.5;
-                    //	  printf("        radius -> %f\n",radius);
-                    //  fflush(stdout);
-                }
-                else
-                {
-                    ok = 1;
-                }
-            }
+            long   *pnnindex = nnindex + jj * NBknn;
+            double *pnndist2 = nndist2 + jj * NBknn;
 
-            if(radius < 0.99 * radiusmax)
+            // require NBknn points within radiusmax
+            if((pnnindex[NBknn - 1] != -1) &&
+                    (sqrt(pnndist2[NBknn - 1]) < 0.99 * radiusmax))
             {
-                NBnpt = kd_res_size(presults);
-                //printf("NBnpt = %ld\n",NBnpt);
-                //fflush(stdout);
-                if(NBnpt > NBnptmax)
-                {
-                    pt_x      = realloc(pt_x, sizeof(double) * NBnpt);
-                    pt_y      = realloc(pt_y, sizeof(double) * NBnpt);
-                    pt_val    = realloc(pt_val, sizeof(double) * NBnpt);
-                    pt_coeff  = realloc(pt_coeff, sizeof(double) * NBnpt);
-                    pt_coeff1 = realloc(pt_coeff1, sizeof(double) * NBnpt);
-                    NBnptmax  = NBnpt;
-                    //  printf("Reallocation to %ld points\n",NBnpt);
-                    // fflush(stdout);
-                }
-
-                i = 0;
-                while(kd_res_end(presults) == 0)
+                for(i = 0; i < NBnpt; i++)
                 {
-                    /* get the data and position of the current result item */
-                    pv = (double *) kd_res_item(presults, pos);
+                    long ptindex = pnnindex[i];
 
-                    /* compute the distance of the current result from the pt */
-                    dist = sqrt((pos[0] - pt[0]) * (pos[0] - pt[0]) +
-                                (pos[1] - pt[1]) * (pos[1] - pt[1]));
+                    dist = sqrt(pnndist2[i]);
 
-                    pt_x[i]      = pos[0];
-                    pt_y[i]      = pos[1];
-                    pt_val[i]    = *pv;
+                    pt_x[i]      = xarray[ptindex];
+                    pt_y[i]      = yarray[ptindex];
+                    pt_val[i]    = varray[ptindex];
                     pt_val_cp[i] = (float) pt_val[i];
                     pt_coeff[i] =
                         pow((1.0 + cos(M_PI * dist / radius0)) / 2.0, 2.0);
                     pt_coeff1[i] = pow(dist / radius0, 2.0) *
                                    (1.0 + cos(M_PI * dist / radius0)) / 2.0;
-                    /* go to the next entry */
-                    free(pv);
-                    kd_res_next(presults);
-
-                    i++;
                 }
 
                 // reject outliers
@@ -388,7 +357,9 @@ imageID basic_tableto2Dim(const char *__restrict fname,
         }
     }
 
-    free(pos);
+    free(qpos);
+    free(nnindex);
+    free(nndist2);
     printf("\n");
 
     printf("fraction of points rejected = %g\n",
@@ -404,25 +375,7 @@ imageID basic_tableto2Dim(const char *__restrict fname,
     free(xarray);
     free(yarray);
     free(varray);
-    if(presults != NULL)
-    {
-        kd_res_free(presults);
-    }
-    if(presults != NULL)
-    {
-        PRINT_ERROR(
-            "presults was not freed by kd_res_free. Attempting free(presults) "
-            "and continuing.");
-        free(presults);
-    }
-    kd_free(ptree);
-    if(ptree != NULL)
-    {
-        PRINT_ERROR(
-            "ptree was not freed by kd_free. Attempting free(ptree) and "
-            "continuing.");
-        free(ptree);
-    }
+    kdtree_bulk_free(ptree);
     save_fl_fits(ID_name, "tmp2dinterp.fits");
 
     make_gauss("kerg",
@@ -7,6 +7,8 @@
 
 #include "COREMOD_memory/COREMOD_memory.h"
 
+#include "bayer_demosaic.h"
+
 static float FLUXFACTOR = 1.0;
 
 // convers a single raw bayer FITS frame into RGB FITS
@@ -16,6 +18,7 @@ static float FLUXFACTOR = 1.0;
 // IMPORTANT: input will be modified
 // Sampling factor : 0=full resolution (slow), 1=half resolution (fast), 2=quarter resolution (very fast)
 // Fast mode does not reject bad pixels
+// Fast full resolution mode uses edge-aware demosaic if variable _RGBedge exists
 errno_t convert_rawbayerFITStorgbFITS_simple(const char *__restrict ID_name,
         const char *__restrict ID_name_r,
         const char *__restrict ID_name_g,
@@ -40,6 +43,8 @@ errno_t convert_rawbayerFITStorgbFITS_simple(const char *__restrict ID_name,
 
     int FastMode = 0;
 
+    errno_t ret = RETURN_SUCCESS;
+
     if(variable_ID("_RGBfast") != -1)
     {
         FastMode = 1;
@@ -397,177 +402,25 @@ errno_t convert_rawbayerFITStorgbFITS_simple(const char *__restrict ID_name,
             }
             else
             {
-                if(RGBmode == 1)  // GBRG
+                // full resolution interpolation, see bayer_demosaic.c
+                int algo = BAYER_DEMOSAIC_BILINEAR;
+                if(variable_ID("_RGBedge") != -1)
                 {
-                    // G
-                    for(ii1 = 0; ii1 < Xsize / 2; ii1++)
-                        for(jj1 = 0; jj1 < Ysize / 2; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii;
-                            jj2 = jj;
-                            data.image[IDg].array.F[jj2 * Xsize + ii2] =
-                                data.image[ID].array.F[jj2 * Xsize + ii2];
-                            ii2 = ii + 1;
-                            jj2 = jj + 1;
-                            data.image[IDg].array.F[jj2 * Xsize + ii2] =
-                                data.image[ID].array.F[jj2 * Xsize + ii2];
-                        }
-                    // replace blue pixels
-                    for(ii1 = 0; ii1 < Xsize / 2 - 1; ii1++)
-                        for(jj1 = 1; jj1 < Ysize / 2; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii + 1;
-                            jj2 = jj;
-                            data.image[IDg].array.F[jj2 * Xsize + ii2] =
-                                0.25 *
-                                (data.image[ID].array.F[jj2 * Xsize + (ii2 - 1)] +
-                                 data.image[ID].array.F[jj2 * Xsize + (ii2 + 1)] +
-                                 data.image[ID].array.F[(jj2 + 1) * Xsize + ii2] +
-                                 data.image[ID].array.F[(jj2 - 1) * Xsize + ii2]);
-                        }
-                    // replace red pixels
-                    for(ii1 = 1; ii1 < Xsize / 2; ii1++)
-                        for(jj1 = 0; jj1 < Ysize / 2 - 1; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii;
-                            jj2 = jj + 1;
-                            data.image[IDg].array.F[jj2 * Xsize + ii2] =
-                                0.25 *
-                                (data.image[ID].array.F[jj2 * Xsize + (ii2 - 1)] +
-                                 data.image[ID].array.F[jj2 * Xsize + (ii2 + 1)] +
-                                 data.image[ID].array.F[(jj2 + 1) * Xsize + ii2] +
-                                 data.image[ID].array.F[(jj2 - 1) * Xsize + ii2]);
-                        }
-
-                    // R
-                    for(ii1 = 0; ii1 < Xsize / 2; ii1++)
-                        for(jj1 = 0; jj1 < Ysize / 2; jj1++)
-                        {
-                            ii  = ii1 * 2;
-                            jj  = jj1 * 2;
-                            ii2 = ii;
-                            jj2 = jj + 1;
-                            data.image[IDr].array.F[jj2 * Xsize + ii2] =
-                                data.image[ID].array.F[jj2 * Xsize + ii2];
-                        }
-                    // replace g1 pixels
-                    for(ii1 = 0; ii1 < Xsize / 2; ii1++)
-                        for(jj1 = 1; jj1 < Ysize / 2; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii;
-                            jj2 = jj;
-                            data.image[IDr].array.F[jj2 * Xsize + ii2] =
-                                0.5 *
-                                (data.image[ID].array.F[(jj2 - 1) * Xsize + ii2] +
-                                 data.image[ID].array.F[(jj2 + 1) * Xsize + ii2]);
-                        }
-                    // replace g2 pixels
-                    for(ii1 = 0; ii1 < Xsize / 2 - 1; ii1++)
-                        for(jj1 = 0; jj1 < Ysize / 2; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii + 1;
-                            jj2 = jj + 1;
-                            data.image[IDr].array.F[jj2 * Xsize + ii2] =
-                                0.5 *
-                                (data.image[ID].array.F[jj2 * Xsize + (ii2 - 1)] +
-                                 data.image[ID].array.F[jj2 * Xsize + (ii2 + 1)]);
-                        }
-                    // replace b pixels
-                    for(ii1 = 0; ii1 < Xsize / 2 - 1; ii1++)
-                        for(jj1 = 1; jj1 < Ysize / 2; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii + 1;
-                            jj2 = jj;
-                            data.image[IDr].array.F[jj2 * Xsize + ii2] =
-                                0.25 *
-                                (data.image[ID]
-                                 .array.F[(jj2 - 1) * Xsize + (ii2 - 1)] +
-                                 data.image[ID]
-                                 .array.F[(jj2 - 1) * Xsize + (ii2 + 1)] +
-                                 data.image[ID]
-                                 .array.F[(jj2 + 1) * Xsize + (ii2 - 1)] +
-                                 data.image[ID]
-                                 .array.F[(jj2 + 1) * Xsize + (ii2 + 1)]);
-                        }
-
-                    // B
-                    for(ii1 = 0; ii1 < Xsize / 2; ii1++)
-                        for(jj1 = 0; jj1 < Ysize / 2; jj1++)
-                        {
-                            ii  = ii1 * 2;
-                            jj  = jj1 * 2;
-                            ii2 = ii + 1;
-                            jj2 = jj;
-                            data.image[IDb].array.F[jj2 * Xsize + ii2] =
-                                data.image[ID].array.F[jj2 * Xsize + ii2];
-                        }
-
-                    // replace g2 pixels
-                    for(ii1 = 0; ii1 < Xsize / 2; ii1++)
-                        for(jj1 = 0; jj1 < Ysize / 2 - 1; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii + 1;
-                            jj2 = jj + 1;
-                            data.image[IDb].array.F[jj2 * Xsize + ii2] =
-                                0.5 *
-                                (data.image[ID].array.F[(jj2 - 1) * Xsize + ii2] +
-                                 data.image[ID].array.F[(jj2 + 1) * Xsize + ii2]);
-                        }
-                    // replace g1 pixels
-                    for(ii1 = 1; ii1 < Xsize / 2; ii1++)
-                        for(jj1 = 0; jj1 < Ysize / 2; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii;
-                            jj2 = jj;
-                            data.image[IDb].array.F[jj2 * Xsize + ii2] =
-                                0.5 *
-                                (data.image[ID].array.F[jj2 * Xsize + (ii2 - 1)] +
-                                 data.image[ID].array.F[jj2 * Xsize + (ii2 + 1)]);
-                        }
-                    // replace r pixels
-                    for(ii1 = 1; ii1 < Xsize / 2; ii1++)
-                        for(jj1 = 0; jj1 < Ysize / 2 - 1; jj1++)
-                        {
-                            ii = ii1 * 2;
-                            jj = jj1 * 2;
-
-                            ii2 = ii;
-                            jj2 = jj + 1;
-                            data.image[IDb].array.F[jj2 * Xsize + ii2] =
-                                0.25 *
-                                (data.image[ID]
-                                 .array.F[(jj2 - 1) * Xsize + (ii2 - 1)] +
-                                 data.image[ID]
-                                 .array.F[(jj2 - 1) * Xsize + (ii2 + 1)] +
-                                 data.image[ID]
-                                 .array.F[(jj2 + 1) * Xsize + (ii2 - 1)] +
-                                 data.image[ID]
-                                 .array.F[(jj2 + 1) * Xsize + (ii2 + 1)]);
-                        }
+                    algo = BAYER_DEMOSAIC_EDGE;
+                }
+                ret = bayer_demosaic(data.image[ID].array.F,
+                                     Xsize,
+                                     Ysize,
+                                     (RGBmode == 1) ? BAYER_GBRG : BAYER_RGGB,
+                                     algo,
+                                     data.image[IDr].array.F,
+                                     data.image[IDg].array.F,
+                                     data.image[IDb].array.F);
+                if(ret != RETURN_SUCCESS)
+                {
+                    PRINT_ERROR("demosaic failed on %ld x %ld frame",
+                                Xsize,
+                                Ysize);
                 }
             }
 
@@ -684,5 +537,5 @@ errno_t convert_rawbayerFITStorgbFITS_simple(const char *__restrict ID_name,
             break;
     }
 
-    return RETURN_SUCCESS;
+    return ret;
 }
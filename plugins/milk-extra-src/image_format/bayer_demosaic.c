@@ -0,0 +1,592 @@
+/**
+ * @file    bayer_demosaic.c
+ * @brief   Bayer demosaic engine and real-time demosaic stream process
+ *
+ * Reconstructs full resolution R, G, B planes from a raw Bayer frame.
+ *
+ * Algorithms :
+ * - bilinear : average of nearest same-colour pixels
+ * - edge     : green interpolated along direction of smallest gradient,
+ *              with second-order (Laplacian) correction from the colour
+ *              channel (Hamilton-Adams), then R and B interpolated on
+ *              colour differences R-G, B-G
+ *
+ * Interior rows are processed as two stride-2 passes, one per Bayer
+ * column parity, so that inner loops are branch-free and vectorize.
+ * Rows are distributed over threads with OpenMP.
+ * Border pixels (1 pixel bilinear, 2 pixels edge) use bilinear
+ * interpolation with mirrored indices, which preserve Bayer parity.
+ *
+ * Stream process demosaic :
+ * Input: raw camera stream, any integer type or float
+ * Output: xsize x ysize x 3 stream (float 32), slices R, G, B
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "bayer_demosaic.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP_NELEMENT_LIMIT 100000
+#endif
+
+// Local variables pointers
+static char *insname;
+static char *patternstr;
+static char *algostr;
+static char *outimname;
+
+static CLICMDARGDEF farg[] = {{
+        CLIARG_IMG,
+        ".insname",
+        "input raw Bayer stream",
+        "im1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &insname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".pattern",
+        "Bayer pattern: RGGB GRBG GBRG BGGR",
+        "RGGB",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &patternstr,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".algo",
+        "algorithm: bilinear or edge",
+        "bilinear",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &algostr,
+        NULL
+    },
+    {
+        CLIARG_STR_NOT_IMG,
+        ".outimname",
+        "output RGB cube stream",
+        "outRGB",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "demosaic", "RT Bayer demosaic of raw stream", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Demosaic raw Bayer stream into R G B planes.\n");
+    printf("Pattern is 2x2 cell in raster order, first row first.\n");
+    printf("Output is xsize x ysize x 3 float cube, slices R G B.\n");
+
+    return RETURN_SUCCESS;
+}
+
+/*
+THE IMPORTANT, CUSTOM PART
+*/
+
+int bayer_pattern_from_string(const char *str)
+{
+    if(strcmp(str, "RGGB") == 0)
+    {
+        return BAYER_RGGB;
+    }
+    if(strcmp(str, "GRBG") == 0)
+    {
+        return BAYER_GRBG;
+    }
+    if(strcmp(str, "GBRG") == 0)
+    {
+        return BAYER_GBRG;
+    }
+    if(strcmp(str, "BGGR") == 0)
+    {
+        return BAYER_BGGR;
+    }
+    return -1;
+}
+
+int bayer_algo_from_string(const char *str)
+{
+    if(strcmp(str, "bilinear") == 0)
+    {
+        return BAYER_DEMOSAIC_BILINEAR;
+    }
+    if(strcmp(str, "edge") == 0)
+    {
+        return BAYER_DEMOSAIC_EDGE;
+    }
+    return -1;
+}
+
+#define BAYER_DECODE(inarray)                                               \
+    do                                                                      \
+    {                                                                       \
+        const __typeof__((inarray)[0]) *__restrict in = (inarray);          \
+        BAYER_OMP_FOR                                                       \
+        for(uint64_t ii = 0; ii < nelem; ii++)                              \
+        {                                                                   \
+            out[ii] = (float) in[ii];                                       \
+        }                                                                   \
+    } while(0)
+
+#ifdef _OPENMP
+#define BAYER_OMP_FOR                                                       \
+    _Pragma("omp parallel for if (nelem > OMP_NELEMENT_LIMIT)")
+#else
+#define BAYER_OMP_FOR
+#endif
+
+/**
+ * @brief Convert raw frame to float
+ *
+ * out must hold xsize x ysize elements
+ */
+errno_t bayer_decode_raw(IMGID img, float *out_)
+{
+    DEBUG_TRACE_FSTART();
+
+    uint64_t          nelem = (uint64_t) img.md->size[0] * img.md->size[1];
+    float *__restrict out   = out_;
+
+    switch(img.md->datatype)
+    {
+        case _DATATYPE_UINT8:
+            BAYER_DECODE(img.im->array.UI8);
+            break;
+
+        case _DATATYPE_UINT16:
+            BAYER_DECODE(img.im->array.UI16);
+            break;
+
+        case _DATATYPE_INT16:
+            BAYER_DECODE(img.im->array.SI16);
+            break;
+
+        case _DATATYPE_UINT32:
+            BAYER_DECODE(img.im->array.UI32);
+            break;
+
+        case _DATATYPE_INT32:
+            BAYER_DECODE(img.im->array.SI32);
+            break;
+
+        case _DATATYPE_FLOAT:
+            memcpy(out, img.im->array.F, sizeof(float) * nelem);
+            break;
+
+        default:
+            FUNC_RETURN_FAILURE("datatype %d not supported",
+                                img.md->datatype);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+// mirror index into [0, n-1], preserves parity
+//
+static inline long bayer_mirror(long i, long n)
+{
+    i = (i < 0) ? -i : i;
+    return (i > n - 1) ? 2 * (n - 1) - i : i;
+}
+
+// bilinear, any pixel, mirrored neighbors
+// used on image border
+//
+static void demosaic_pixel_border(const float *in,
+                                  long         xs,
+                                  long         ys,
+                                  long         x,
+                                  long         y,
+                                  int          pattern,
+                                  float       *outR,
+                                  float       *outG,
+                                  float       *outB)
+{
+#define BPIX(dx, dy)                                                        \
+    in[bayer_mirror(y + (dy), ys) * xs + bayer_mirror(x + (dx), xs)]
+
+    long ii    = y * xs + x;
+    int  rxpar = ((x & 1) == BAYER_RX(pattern));
+    int  rypar = ((y & 1) == BAYER_RY(pattern));
+
+    float c     = in[ii];
+    float cross = 0.25f * (BPIX(-1, 0) + BPIX(1, 0) + BPIX(0, -1) + BPIX(0, 1));
+    float diag =
+        0.25f * (BPIX(-1, -1) + BPIX(1, -1) + BPIX(-1, 1) + BPIX(1, 1));
+    float horiz = 0.5f * (BPIX(-1, 0) + BPIX(1, 0));
+    float vert  = 0.5f * (BPIX(0, -1) + BPIX(0, 1));
+
+#undef BPIX
+
+    if(rxpar && rypar)
+    {
+        // R pixel
+        outR[ii] = c;
+        outG[ii] = cross;
+        outB[ii] = diag;
+    }
+    else if(!rxpar && !rypar)
+    {
+        // B pixel
+        outR[ii] = diag;
+        outG[ii] = cross;
+        outB[ii] = c;
+    }
+    else if(rypar)
+    {
+        // G pixel on R row
+        outR[ii] = horiz;
+        outG[ii] = c;
+        outB[ii] = vert;
+    }
+    else
+    {
+        // G pixel on B row
+        outR[ii] = vert;
+        outG[ii] = c;
+        outB[ii] = horiz;
+    }
+}
+
+// bilinear, interior of row y, 1 <= x < xs-1
+// x0 : column parity of non-green pixels on row
+// oc : plane of row colour, oo : plane of other colour
+//
+static void demosaic_row_bilinear(const float *__restrict in,
+                                  long                    xs,
+                                  long                    y,
+                                  long                    x0,
+                                  float *__restrict       oc,
+                                  float *__restrict       og,
+                                  float *__restrict       oo)
+{
+    const float *mid = in + y * xs;
+    const float *up  = mid - xs;
+    const float *dn  = mid + xs;
+
+    oc += y * xs;
+    og += y * xs;
+    oo += y * xs;
+
+    // R or B pixels
+    for(long x = 2 - x0; x < xs - 1; x += 2)
+    {
+        oc[x] = mid[x];
+        og[x] = 0.25f * (mid[x - 1] + mid[x + 1] + up[x] + dn[x]);
+        oo[x] = 0.25f * (up[x - 1] + up[x + 1] + dn[x - 1] + dn[x + 1]);
+    }
+
+    // G pixels
+    for(long x = 1 + x0; x < xs - 1; x += 2)
+    {
+        og[x] = mid[x];
+        oc[x] = 0.5f * (mid[x - 1] + mid[x + 1]);
+        oo[x] = 0.5f * (up[x] + dn[x]);
+    }
+}
+
+// edge-aware green, interior of row y, 2 <= x < xs-2
+//
+static void demosaic_row_green_edge(const float *__restrict in,
+                                    long                    xs,
+                                    long                    y,
+                                    long                    x0,
+                                    float *__restrict       og)
+{
+    const float *mid = in + y * xs;
+    const float *u1  = mid - xs;
+    const float *u2  = mid - 2 * xs;
+    const float *d1  = mid + xs;
+    const float *d2  = mid + 2 * xs;
+
+    og += y * xs;
+
+    // R or B pixels
+    for(long x = 2 + x0; x < xs - 2; x += 2)
+    {
+        float lh = 2.0f * mid[x] - mid[x - 2] - mid[x + 2];
+        float lv = 2.0f * mid[x] - u2[x] - d2[x];
+        float dh = fabsf(mid[x - 1] - mid[x + 1]) + fabsf(lh);
+        float dv = fabsf(u1[x] - d1[x]) + fabsf(lv);
+        float gh = 0.5f * (mid[x - 1] + mid[x + 1]) + 0.25f * lh;
+        float gv = 0.5f * (u1[x] + d1[x]) + 0.25f * lv;
+        float gm = 0.5f * (gh + gv);
+
+        og[x] = (dh < dv) ? gh : ((dv < dh) ? gv : gm);
+    }
+
+    // G pixels
+    for(long x = 3 - x0; x < xs - 2; x += 2)
+    {
+        og[x] = mid[x];
+    }
+}
+
+// edge-aware R and B from colour differences, interior of row y
+// requires green plane on rows y-1 .. y+1
+//
+static void demosaic_row_colour_edge(const float *__restrict in,
+                                     const float *__restrict g,
+                                     long                    xs,
+                                     long                    y,
+                                     long                    x0,
+                                     float *__restrict       oc,
+                                     float *__restrict       oo)
+{
+    const float *mid = in + y * xs;
+    const float *up  = mid - xs;
+    const float *dn  = mid + xs;
+    const float *gm  = g + y * xs;
+    const float *gu  = gm - xs;
+    const float *gd  = gm + xs;
+
+    oc += y * xs;
+    oo += y * xs;
+
+    // R or B pixels
+    for(long x = 2 + x0; x < xs - 2; x += 2)
+    {
+        oc[x] = mid[x];
+        oo[x] = gm[x] + 0.25f * ((up[x - 1] - gu[x - 1]) +
+                                 (up[x + 1] - gu[x + 1]) +
+                                 (dn[x - 1] - gd[x - 1]) +
+                                 (dn[x + 1] - gd[x + 1]));
+    }
+
+    // G pixels
+    for(long x = 3 - x0; x < xs - 2; x += 2)
+    {
+        oc[x] = gm[x] + 0.5f * ((mid[x - 1] - gm[x - 1]) +
+                                (mid[x + 1] - gm[x + 1]));
+        oo[x] = gm[x] + 0.5f * ((up[x] - gu[x]) + (dn[x] - gd[x]));
+    }
+}
+
+/**
+ * @brief Demosaic raw Bayer frame into R, G, B planes
+ *
+ * All arrays are xsize x ysize, output planes must not overlap input.
+ */
+errno_t bayer_demosaic(const float *in,
+                       uint32_t     xsize,
+                       uint32_t     ysize,
+                       int          pattern,
+                       int          algo,
+                       float       *outR,
+                       float       *outG,
+                       float       *outB)
+{
+    DEBUG_TRACE_FSTART();
+
+    if((xsize < 4) || (ysize < 4))
+    {
+        FUNC_RETURN_FAILURE("image %u x %u too small", xsize, ysize);
+    }
+    if((pattern < 0) || (pattern > 3))
+    {
+        FUNC_RETURN_FAILURE("invalid Bayer pattern %d", pattern);
+    }
+
+    long xs    = xsize;
+    long ys    = ysize;
+    long rx    = BAYER_RX(pattern);
+    long ry    = BAYER_RY(pattern);
+    long bmarg = (algo == BAYER_DEMOSAIC_EDGE) ? 2 : 1;
+
+    // first pass : border pixels, bilinear or edge-aware green
+#ifdef _OPENMP
+    #pragma omp parallel for if (xs * ys > OMP_NELEMENT_LIMIT)
+#endif
+    for(long y = 0; y < ys; y++)
+    {
+        if((y < bmarg) || (y >= ys - bmarg))
+        {
+            for(long x = 0; x < xs; x++)
+            {
+                demosaic_pixel_border(in, xs, ys, x, y, pattern, outR, outG,
+                                      outB);
+            }
+            continue;
+        }
+
+        for(long x = 0; x < bmarg; x++)
+        {
+            demosaic_pixel_border(in, xs, ys, x, y, pattern, outR, outG, outB);
+            demosaic_pixel_border(in, xs, ys, xs - 1 - x, y, pattern, outR,
+                                  outG, outB);
+        }
+
+        int  isrrow = ((y & 1) == ry);
+        long x0     = isrrow ? rx : 1 - rx;
+
+        if(algo == BAYER_DEMOSAIC_EDGE)
+        {
+            demosaic_row_green_edge(in, xs, y, x0, outG);
+        }
+        else
+        {
+            demosaic_row_bilinear(in, xs, y, x0, isrrow ? outR : outB, outG,
+                                  isrrow ? outB : outR);
+        }
+    }
+
+    // second pass : edge-aware R and B, once green plane complete
+    if(algo == BAYER_DEMOSAIC_EDGE)
+    {
+#ifdef _OPENMP
+        #pragma omp parallel for if (xs * ys > OMP_NELEMENT_LIMIT)
+#endif
+        for(long y = bmarg; y < ys - bmarg; y++)
+        {
+            int  isrrow = ((y & 1) == ry);
+            long x0     = isrrow ? rx : 1 - rx;
+
+            demosaic_row_colour_edge(in, outG, xs, y, x0,
+                                     isrrow ? outR : outB,
+                                     isrrow ? outB : outR);
+        }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID in_img = mkIMGID_from_name(insname);
+    resolveIMGID(&in_img, ERRMODE_ABORT);
+
+    // Set in_img to be the trigger
+    strcpy(CLIcmddata.cmdsettings->triggerstreamname, insname);
+    // for FPS mode:
+    if(data.fpsptr != NULL)
+    {
+        strcpy(data.fpsptr->cmdset.triggerstreamname, insname);
+    }
+
+    uint32_t xsize = in_img.md->size[0];
+    uint32_t ysize = in_img.md->size[1];
+    long     npix  = (long) xsize * ysize;
+
+    // checked once here, so that decode and demosaic cannot fail in loop
+    switch(in_img.md->datatype)
+    {
+        case _DATATYPE_UINT8:
+        case _DATATYPE_UINT16:
+        case _DATATYPE_INT16:
+        case _DATATYPE_UINT32:
+        case _DATATYPE_INT32:
+        case _DATATYPE_FLOAT:
+            break;
+
+        default:
+            PRINT_ERROR("%s datatype %d not supported",
+                        insname,
+                        in_img.md->datatype);
+            abort();
+    }
+    if((xsize < 4) || (ysize < 4))
+    {
+        PRINT_ERROR("%s size %u x %u too small, must be at least 4 x 4",
+                    insname,
+                    xsize,
+                    ysize);
+        abort();
+    }
+
+    int pattern = bayer_pattern_from_string(patternstr);
+    if(pattern == -1)
+    {
+        PRINT_ERROR("unknown Bayer pattern %s", patternstr);
+        abort();
+    }
+
+    int algo = bayer_algo_from_string(algostr);
+    if(algo == -1)
+    {
+        PRINT_ERROR("unknown demosaic algorithm %s", algostr);
+        abort();
+    }
+
+    IMGID imgout = stream_connect_create_3Df32(outimname, xsize, ysize, 3);
+
+    // float input is read in place, other types decoded to buffer
+    float *rawbuf = NULL;
+    if(in_img.md->datatype != _DATATYPE_FLOAT)
+    {
+        rawbuf = (float *) malloc(sizeof(float) * npix);
+        if(rawbuf == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        const float *raw = in_img.im->array.F;
+        errno_t      ret = RETURN_SUCCESS;
+        if(rawbuf != NULL)
+        {
+            ret = bayer_decode_raw(in_img, rawbuf);
+            raw = rawbuf;
+        }
+
+        float *out = imgout.im->array.F;
+        if(ret == RETURN_SUCCESS)
+        {
+            ret = bayer_demosaic(raw,
+                                 xsize,
+                                 ysize,
+                                 pattern,
+                                 algo,
+                                 out,
+                                 out + npix,
+                                 out + 2 * npix);
+        }
+
+        if(ret != RETURN_SUCCESS)
+        {
+            // exit loop through processinfo cleanup, rawbuf freed below
+            processinfo_error(processinfo, "demosaic failed");
+            processloopOK = 0;
+        }
+        else
+        {
+            processinfo_update_output_stream(processinfo, imgout.ID);
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    free(rawbuf);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_image_format__demosaic()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,37 @@
+/** @file bayer_demosaic.h
+ */
+
+#ifndef IMAGE_FORMAT_BAYER_DEMOSAIC_H
+#define IMAGE_FORMAT_BAYER_DEMOSAIC_H
+
+// Bayer pattern, named by 2x2 cell in raster order
+// value = rx + 2*ry, where (rx,ry) is position of R pixel in cell
+#define BAYER_RGGB 0
+#define BAYER_GRBG 1
+#define BAYER_GBRG 2
+#define BAYER_BGGR 3
+
+#define BAYER_RX(pattern) ((pattern) & 1)
+#define BAYER_RY(pattern) (((pattern) >> 1) & 1)
+
+#define BAYER_DEMOSAIC_BILINEAR 0
+#define BAYER_DEMOSAIC_EDGE     1
+
+int bayer_pattern_from_string(const char *str);
+
+int bayer_algo_from_string(const char *str);
+
+errno_t bayer_decode_raw(IMGID img, float *out);
+
+errno_t bayer_demosaic(const float *in,
+                       uint32_t     xsize,
+                       uint32_t     ysize,
+                       int          pattern,
+                       int          algo,
+                       float       *outR,
+                       float       *outG,
+                       float       *outB);
+
+errno_t CLIADDCMD_image_format__demosaic();
+
+#endif
@@ -5,6 +5,13 @@
 
 #include "COREMOD_memory/COREMOD_memory.h"
 
+#include "bayer_demosaic.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP_NELEMENT_LIMIT 100000
+#endif
+
 
 
 
@@ -23,6 +30,9 @@ static long  fpi_outimG2;
 static char *outimB;
 static long  fpi_outimB;
 
+static char *patternstr;
+static long  fpi_patternstr;
+
 
 
 
@@ -70,6 +80,15 @@ static CLICMDARGDEF farg[] = {{
         CLIARG_VISIBLE_DEFAULT,
         (void **) &outimB,
         &fpi_outimB
+    },
+    {
+        CLIARG_STR,
+        ".pattern",
+        "Bayer pattern: RGGB GRBG GBRG BGGR",
+        "GBRG",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &patternstr,
+        &fpi_patternstr
     }
 };
 
@@ -99,12 +118,51 @@ static errno_t help_function()
     IMGID imgoutB
 */
 
+#define RGGBCHAN_EXTRACT(ARRAY)                                             \
+    do                                                                      \
+    {                                                                       \
+        RGGBCHAN_OMP_FOR                                                    \
+        for(uint32_t jj = 0; jj < ysize1; jj++)                             \
+        {                                                                   \
+            uint64_t row0 = (uint64_t)(2 * jj) * xsize;                     \
+            uint64_t row1 = row0 + xsize;                                   \
+            uint64_t pix1 = (uint64_t) jj * xsize1;                         \
+            const __typeof__(imgin.im->array.ARRAY[0]) *inR =               \
+                imgin.im->array.ARRAY + (ry ? row1 : row0) + rx;            \
+            const __typeof__(imgin.im->array.ARRAY[0]) *inB =               \
+                imgin.im->array.ARRAY + (ry ? row0 : row1) + (1 - rx);      \
+            const __typeof__(imgin.im->array.ARRAY[0]) *inG1 =              \
+                imgin.im->array.ARRAY + row0 + g1x;                         \
+            const __typeof__(imgin.im->array.ARRAY[0]) *inG2 =              \
+                imgin.im->array.ARRAY + row1 + (1 - g1x);                   \
+            for(uint32_t ii = 0; ii < xsize1; ii++)                         \
+            {                                                               \
+                imgoutR.im->array.ARRAY[pix1 + ii]  = inR[2 * ii];          \
+                imgoutG1.im->array.ARRAY[pix1 + ii] = inG1[2 * ii];         \
+                imgoutG2.im->array.ARRAY[pix1 + ii] = inG2[2 * ii];         \
+                imgoutB.im->array.ARRAY[pix1 + ii]  = inB[2 * ii];          \
+            }                                                               \
+        }                                                                   \
+    } while(0)
+
+#ifdef _OPENMP
+#define RGGBCHAN_OMP_FOR                                                    \
+    _Pragma("omp parallel for if (xsize1 * ysize1 > OMP_NELEMENT_LIMIT)")
+#else
+#define RGGBCHAN_OMP_FOR
+#endif
+
 //
 // separates a single RGB image into its 4 channels
 // output written in im_r, im_g1, im_g2 and im_b
+// G1 is green pixel on even rows, G2 on odd rows
 //
-errno_t image_format_extract_RGGBchan(
-    IMGID imgin, IMGID imgoutR, IMGID imgoutG1, IMGID imgoutG2, IMGID imgoutB)
+errno_t image_format_extract_RGGBchan(IMGID imgin,
+                                      int   pattern,
+                                      IMGID imgoutR,
+                                      IMGID imgoutG1,
+                                      IMGID imgoutG2,
+                                      IMGID imgoutB)
 {
     DEBUG_TRACE_FSTART();
 
@@ -126,7 +184,15 @@ errno_t image_format_extract_RGGBchan(
     createimagefromIMGID(&imgoutG2);
     createimagefromIMGID(&imgoutB);
 
-    uint32_t xsize = imgin.size[0];
+    uint32_t xsize  = imgin.size[0];
+    uint32_t xsize1 = imgoutR.size[0];
+    uint32_t ysize1 = imgoutR.size[1];
+
+    // R pixel position in 2x2 cell, B is opposite
+    // G1 column is opposite to even row R or B pixel, G2 to odd row
+    int rx  = BAYER_RX(pattern);
+    int ry  = BAYER_RY(pattern);
+    int g1x = ry ? rx : 1 - rx;
 
     list_image_ID();
 
@@ -134,63 +200,20 @@ errno_t image_format_extract_RGGBchan(
 
     switch(imgin.datatype)
     {
-
         case _DATATYPE_FLOAT:
-            for(uint32_t ii = 0; ii < imgoutR.size[0]; ii++)
-                for(uint32_t jj = 0; jj < imgoutR.size[1]; jj++)
-                {
-                    uint32_t ii1  = 2 * ii;
-                    uint32_t jj1  = 2 * jj;
-                    uint64_t pixi = jj * imgoutR.size[0] + ii;
-
-                    imgoutR.im->array.F[pixi] =
-                        imgin.im->array.F[(jj1 + 1) * xsize + ii1];
-                    imgoutG1.im->array.F[pixi] =
-                        imgin.im->array.F[jj1 * xsize + ii1];
-                    imgoutG2.im->array.F[pixi] =
-                        imgin.im->array.F[(jj1 + 1) * xsize + (ii1 + 1)];
-                    imgoutB.im->array.F[pixi] =
-                        imgin.im->array.F[jj1 * xsize + (ii1 + 1)];
-                }
+            RGGBCHAN_EXTRACT(F);
             break;
 
         case _DATATYPE_DOUBLE:
-            for(uint32_t ii = 0; ii < imgoutR.size[0]; ii++)
-                for(uint32_t jj = 0; jj < imgoutR.size[1]; jj++)
-                {
-                    uint32_t ii1  = 2 * ii;
-                    uint32_t jj1  = 2 * jj;
-                    uint64_t pixi = jj * imgoutR.size[0] + ii;
-
-                    imgoutR.im->array.D[pixi] =
-                        imgin.im->array.D[(jj1 + 1) * xsize + ii1];
-                    imgoutG1.im->array.D[pixi] =
-                        imgin.im->array.D[jj1 * xsize + ii1];
-                    imgoutG2.im->array.D[pixi] =
-                        imgin.im->array.D[(jj1 + 1) * xsize + (ii1 + 1)];
-                    imgoutB.im->array.D[pixi] =
-                        imgin.im->array.D[jj1 * xsize + (ii1 + 1)];
-                }
+            RGGBCHAN_EXTRACT(D);
             break;
 
-
         case _DATATYPE_UINT16:
-            for(uint32_t ii = 0; ii < imgoutR.size[0]; ii++)
-                for(uint32_t jj = 0; jj < imgoutR.size[1]; jj++)
-                {
-                    uint32_t ii1  = 2 * ii;
-                    uint32_t jj1  = 2 * jj;
-                    uint64_t pixi = jj * imgoutR.size[0] + ii;
-
-                    imgoutR.im->array.UI16[pixi] =
-                        imgin.im->array.UI16[(jj1 + 1) * xsize + ii1];
-                    imgoutG1.im->array.UI16[pixi] =
-                        imgin.im->array.UI16[jj1 * xsize + ii1];
-                    imgoutG2.im->array.UI16[pixi] =
-                        imgin.im->array.UI16[(jj1 + 1) * xsize + (ii1 + 1)];
-                    imgoutB.im->array.UI16[pixi] =
-                        imgin.im->array.UI16[jj1 * xsize + (ii1 + 1)];
-                }
+            RGGBCHAN_EXTRACT(UI16);
+            break;
+
+        case _DATATYPE_INT16:
+            RGGBCHAN_EXTRACT(SI16);
             break;
     }
 
@@ -213,9 +236,17 @@ static errno_t compute_function()
 
 
 
+    int pattern = bayer_pattern_from_string(patternstr);
+    if(pattern == -1)
+    {
+        PRINT_ERROR("unknown Bayer pattern %s", patternstr);
+        abort();
+    }
+
     INSERT_STD_PROCINFO_COMPUTEFUNC_START
 
     image_format_extract_RGGBchan(mkIMGID_from_name(inim),
+                                  pattern,
                                   mkIMGID_from_name(outimR),
                                   mkIMGID_from_name(outimG1),
                                   mkIMGID_from_name(outimG2),
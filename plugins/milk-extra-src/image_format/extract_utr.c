@@ -13,17 +13,30 @@
  * Input: Saturation threshold for UTR/CDS discard
  *
  * Output: Post UTR reduced stream (float 32)
+ * Output: optional UTR slope variance and jump count streams (float 32)
+ *
+ * UTR slope is fitted per pixel with jump detection, see UP-THE-RAMP ENGINE
  */
 
+#include <math.h>
 #include <pthread.h>
 
 #include "CommandLineInterface/CLIcore.h"
 #include "extract_utr.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+// below CRED1 frame size (81920 px), so that CRED1 and CRED2 are threaded
+#define OMP_NELEMENT_LIMIT 16384
+#endif
+
 // Local variables pointers
 static char  *in_imname;
 static char  *out_imname;
 static float *ptr_sat_value;
+static float *ptr_jump_thresh;
+static char  *var_imname;
+static char  *jump_imname;
 
 static CLICMDARGDEF farg[] = {{
         CLIARG_IMG,
@@ -51,6 +64,33 @@ static CLICMDARGDEF farg[] = {{
         CLIARG_VISIBLE_DEFAULT,
         (void **) &ptr_sat_value,
         NULL
+    },
+    {
+        CLIARG_FLOAT32,
+        ".jump_thresh",
+        "UTR jump threshold [ADU], 0 to disable",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &ptr_jump_thresh,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".var_name",
+        "UTR slope variance stream, none to skip",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &var_imname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".jump_name",
+        "UTR jump count stream, none to skip",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &jump_imname,
+        NULL
     }
 };
 
@@ -63,6 +103,11 @@ static errno_t help_function()
 {
     printf(
         "Perform real-time up-the-ramp data reduction on CRED1/2 streams.\n");
+    printf("UTR mode (NDR > 6) : least-squares slope per pixel.\n");
+    printf("Reads departing from the ramp by more than .jump_thresh start\n");
+    printf("a new ramp segment; segments share a common slope.\n");
+    printf("Slope variance and jump count go to .var_name, .jump_name\n");
+    printf(".jump_thresh changes take effect at next ramp\n");
     return RETURN_SUCCESS;
 }
 
@@ -135,131 +180,354 @@ static errno_t simple_desat_iterate(float  *last_valid,
     return RETURN_SUCCESS;
 }
 
-static errno_t utr_iterate(float  *sum_x,
-                           float  *sum_y,
-                           float  *sum_xy,
-                           float  *sum_xx,
-                           float  *sum_yy,
-                           int    *frame_count,
-                           u_char *frame_valid,
-                           float   sat_val,
-                           IMGID   in_img,
-                           int     reset)
-{
-
-    int subframe_count = in_img.im->array.UI16[2]; // NDR raw counter
-    int n_pixels       = in_img.md->size[0] * in_img.md->size[1];
-
-    float in_val_px;
-    int   k;
+/*
+UP-THE-RAMP ENGINE
+
+Per-pixel least-squares slope, accumulated incrementally from reads.
+Sums are centered on the first read of the current ramp segment so
+they remain accurate in float.
+A read that departs from the segment mean slope by more than the jump
+threshold (cosmic ray, saturation onset) closes the segment : its
+centered sums are folded into the common-slope accumulators and a new
+segment starts, so each segment keeps its own intercept.
+State is stored as struct of arrays and updated without branches.
+With jump detection off, segments never close : the per-read update
+only touches the count, reference read and segment sums.
+Jump detection mode is latched at ramp start.
+*/
 
-    if(reset)
+typedef struct
+{
+    // current segment
+    int32_t *n;
+    float   *xref;
+    float   *yref;
+    float   *xlast;
+    float   *ylast;
+    float   *sx;
+    float   *sy;
+    float   *sxx;
+    float   *sxy;
+    float   *syy;
+
+    // closed segments, centered sums
+    float   *cxx;
+    float   *cxy;
+    float   *cyy;
+    int32_t *cn;
+    int32_t *cnseg;
+    int32_t *njump;
+
+    int nojump; // jump detection off for current ramp
+} UTR_ACCUM;
+
+static errno_t utr_accum_alloc(UTR_ACCUM *a, int n_pixels)
+{
+    float **farray[] = {&a->xref,
+                        &a->yref,
+                        &a->xlast,
+                        &a->ylast,
+                        &a->sx,
+                        &a->sy,
+                        &a->sxx,
+                        &a->sxy,
+                        &a->syy,
+                        &a->cxx,
+                        &a->cxy,
+                        &a->cyy
+                       };
+    int32_t **iarray[] = {&a->n, &a->cn, &a->cnseg, &a->njump};
+
+    a->nojump = 0;
+
+    for(unsigned int i = 0; i < sizeof(farray) / sizeof(farray[0]); i++)
     {
-        for(
-            int ii = 8; ii < n_pixels;
-            ++ii) // For all pixels, including the tags [we could skip the 1st row on the CREDs]
+        *farray[i] = (float *) calloc(n_pixels, SIZEOF_DATATYPE_FLOAT);
+        if(*farray[i] == NULL)
         {
-            in_val_px = (float) in_img.im->array.UI16[ii];
-
-            // Detect saturation - which can have several forms for CRED1 / CRED2 / clipping to some max
-
-            k               = (in_val_px <= sat_val);
-            frame_valid[ii] = k;
-
-            frame_count[ii] = k; // At reset: 0 or 1
-
-            sum_x[ii]  = k * subframe_count;
-            sum_y[ii]  = k * in_val_px;
-            sum_xy[ii] = (k * subframe_count) * in_val_px;
-            sum_xx[ii] = (k * subframe_count) * subframe_count;
-            sum_yy[ii] = (k * in_val_px) * in_val_px;
+            PRINT_ERROR("calloc returns NULL pointer");
+            abort();
         }
     }
-    else
+    for(unsigned int i = 0; i < sizeof(iarray) / sizeof(iarray[0]); i++)
     {
-        // not reset
-        for(
-            int ii = 8; ii < n_pixels;
-            ++ii) // For all pixels, including the tags [we could skip the 1st row on the CREDs]
+        *iarray[i] = (int32_t *) calloc(n_pixels, SIZEOF_DATATYPE_INT32);
+        if(*iarray[i] == NULL)
         {
-            in_val_px = (float) in_img.im->array.UI16[ii];
-
-            // Detect saturation - which can have several forms for CRED1 / CRED2 / clipping to some max
-            k = (in_val_px <= sat_val);
-
-            frame_valid[ii] = k;
-            frame_count[ii] += k; // At reset: 0 or 1
-
-            // Only perform those accumulations for unsat pixels, but this avoids if statements.
-            sum_x[ii] += k * subframe_count;
-            sum_y[ii] += k * in_val_px;
-            sum_xy[ii] += (k * subframe_count) * in_val_px;
-            sum_xx[ii] += (k * subframe_count) * subframe_count;
-            sum_yy[ii] += (k * in_val_px) * in_val_px;
+            PRINT_ERROR("calloc returns NULL pointer");
+            abort();
         }
     }
 
     return RETURN_SUCCESS;
 }
 
-static errno_t utr_reset_buffers(float  *sum_x,
-                                 float  *sum_y,
-                                 float  *sum_xy,
-                                 float  *sum_xx,
-                                 float  *sum_yy,
-                                 int    *frame_count,
-                                 u_char *frame_valid,
-                                 int     n_pixels)
+static errno_t utr_accum_free(UTR_ACCUM *a)
 {
-    memset(sum_x, 0, n_pixels * SIZEOF_DATATYPE_FLOAT);
-    memset(sum_y, 0, n_pixels * SIZEOF_DATATYPE_FLOAT);
-    memset(sum_xy, 0, n_pixels * SIZEOF_DATATYPE_FLOAT);
-    memset(sum_xx, 0, n_pixels * SIZEOF_DATATYPE_FLOAT);
-    memset(sum_yy, 0, n_pixels * SIZEOF_DATATYPE_FLOAT);
-
-    memset(frame_count, 0, n_pixels * SIZEOF_DATATYPE_INT32);
-    memset(frame_valid, 1, n_pixels * SIZEOF_DATATYPE_UINT8);
+    free(a->n);
+    free(a->xref);
+    free(a->yref);
+    free(a->xlast);
+    free(a->ylast);
+    free(a->sx);
+    free(a->sy);
+    free(a->sxx);
+    free(a->sxy);
+    free(a->syy);
+    free(a->cxx);
+    free(a->cxy);
+    free(a->cyy);
+    free(a->cn);
+    free(a->cnseg);
+    free(a->njump);
 
     return RETURN_SUCCESS;
 }
 
-static errno_t utr_finalize(float *sum_x,
-                            float *sum_y,
-                            float *sum_xy,
-                            float *sum_xx,
-                            int   *frame_count,
-                            int    tot_num_frames,
-                            int    n_pixels,
-                            float *out_buf)
+static inline void utr_update_pixel(const UTR_ACCUM *a,
+                                    long             ii,
+                                    float            x,
+                                    float            y,
+                                    float            sat_val,
+                                    float            jump_thresh,
+                                    int              reset)
+{
+    int k = (y <= sat_val);
+
+    int32_t n     = reset ? 0 : a->n[ii];
+    float   xref  = reset ? x : a->xref[ii];
+    float   yref  = reset ? y : a->yref[ii];
+    float   xlast = reset ? x : a->xlast[ii];
+    float   ylast = reset ? y : a->ylast[ii];
+    float   sx    = reset ? 0.0f : a->sx[ii];
+    float   sy    = reset ? 0.0f : a->sy[ii];
+    float   sxx   = reset ? 0.0f : a->sxx[ii];
+    float   sxy   = reset ? 0.0f : a->sxy[ii];
+    float   syy   = reset ? 0.0f : a->syy[ii];
+    float   cxx   = reset ? 0.0f : a->cxx[ii];
+    float   cxy   = reset ? 0.0f : a->cxy[ii];
+    float   cyy   = reset ? 0.0f : a->cyy[ii];
+    int32_t cn    = reset ? 0 : a->cn[ii];
+    int32_t cnseg = reset ? 0 : a->cnseg[ii];
+    int32_t njump = reset ? 0 : a->njump[ii];
+
+    // jump test against segment mean slope
+    float dx     = x - xlast;
+    float dy     = y - ylast;
+    float span   = xlast - xref;
+    float expect = ((n >= 2) && (span != 0.0f))
+                   ? (ylast - yref) / (span != 0.0f ? span : 1.0f) * dx
+                   : dy;
+    int   jump   = k && (n >= 1) && (jump_thresh > 0.0f) &&
+                   (fabsf(dy - expect) > jump_thresh);
+
+    // close segment
+    int   fold = jump && (n >= 2);
+    float invn = 1.0f / (n > 0 ? n : 1);
+    cxx += fold ? sxx - sx * sx * invn : 0.0f;
+    cxy += fold ? sxy - sx * sy * invn : 0.0f;
+    cyy += fold ? syy - sy * sy * invn : 0.0f;
+    cn += fold ? n : 0;
+    cnseg += fold;
+    njump += jump;
+
+    n    = jump ? 0 : n;
+    sx   = jump ? 0.0f : sx;
+    sy   = jump ? 0.0f : sy;
+    sxx  = jump ? 0.0f : sxx;
+    sxy  = jump ? 0.0f : sxy;
+    syy  = jump ? 0.0f : syy;
+    xref = (k && (n == 0)) ? x : xref;
+    yref = (k && (n == 0)) ? y : yref;
+
+    // accumulate valid read
+    float u = k ? x - xref : 0.0f;
+    float v = k ? y - yref : 0.0f;
+    n += k;
+    sx += u;
+    sy += v;
+    sxx += u * u;
+    sxy += u * v;
+    syy += v * v;
+    xlast = k ? x : xlast;
+    ylast = k ? y : ylast;
+
+    a->n[ii]     = n;
+    a->xref[ii]  = xref;
+    a->yref[ii]  = yref;
+    a->xlast[ii] = xlast;
+    a->ylast[ii] = ylast;
+    a->sx[ii]    = sx;
+    a->sy[ii]    = sy;
+    a->sxx[ii]   = sxx;
+    a->sxy[ii]   = sxy;
+    a->syy[ii]   = syy;
+    a->cxx[ii]   = cxx;
+    a->cxy[ii]   = cxy;
+    a->cyy[ii]   = cyy;
+    a->cn[ii]    = cn;
+    a->cnseg[ii] = cnseg;
+    a->njump[ii] = njump;
+}
+
+// jump detection off : no segment closing, closed sums stay zero
+//
+static inline void utr_update_pixel_nojump(const UTR_ACCUM *a,
+                                           long             ii,
+                                           float            x,
+                                           float            y,
+                                           float            sat_val,
+                                           int              reset)
 {
+    int k = (y <= sat_val);
+
+    int32_t n    = reset ? 0 : a->n[ii];
+    float   xref = (n == 0) ? x : a->xref[ii];
+    float   yref = (n == 0) ? y : a->yref[ii];
+    float   sx   = reset ? 0.0f : a->sx[ii];
+    float   sy   = reset ? 0.0f : a->sy[ii];
+    float   sxx  = reset ? 0.0f : a->sxx[ii];
+    float   sxy  = reset ? 0.0f : a->sxy[ii];
+    float   syy  = reset ? 0.0f : a->syy[ii];
+
+    float u = k ? x - xref : 0.0f;
+    float v = k ? y - yref : 0.0f;
+
+    a->n[ii]    = n + k;
+    a->xref[ii] = xref;
+    a->yref[ii] = yref;
+    a->sx[ii]   = sx + u;
+    a->sy[ii]   = sy + v;
+    a->sxx[ii]  = sxx + u * u;
+    a->sxy[ii]  = sxy + u * v;
+    a->syy[ii]  = syy + v * v;
+}
 
-    int   fcii;
-    float sxii;
+#ifdef _OPENMP
+#define UTR_OMP_FOR                                                            \
+    _Pragma("omp parallel for if (n_pixels > OMP_NELEMENT_LIMIT)")
+#else
+#define UTR_OMP_FOR
+#endif
+
+#define UTR_ITERATE_LOOP(inarray)                                              \
+    do                                                                         \
+    {                                                                          \
+        const __typeof__((inarray)[0]) *in = (inarray);                        \
+        if(a->nojump)                                                          \
+        {                                                                      \
+            UTR_OMP_FOR                                                        \
+            for(long ii = 8; ii < n_pixels; ++ii)                              \
+            {                                                                  \
+                utr_update_pixel_nojump(a,                                     \
+                                        ii,                                    \
+                                        subframe_count,                        \
+                                        (float) in[ii],                        \
+                                        sat_val,                               \
+                                        reset);                                \
+            }                                                                  \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            UTR_OMP_FOR                                                        \
+            for(long ii = 8; ii < n_pixels; ++ii)                              \
+            {                                                                  \
+                utr_update_pixel(a,                                            \
+                                 ii,                                           \
+                                 subframe_count,                               \
+                                 (float) in[ii],                               \
+                                 sat_val,                                      \
+                                 jump_thresh,                                  \
+                                 reset);                                       \
+            }                                                                  \
+        }                                                                      \
+    } while(0)
+
+static errno_t utr_iterate(UTR_ACCUM *a,
+                           float      sat_val,
+                           float      jump_thresh,
+                           IMGID      in_img,
+                           int        reset)
+{
+    float subframe_count = in_img.im->array.UI16[2]; // NDR raw counter
+    long  n_pixels       = in_img.md->size[0] * in_img.md->size[1];
 
-    for(int ii = 0; ii < n_pixels; ++ii)
+    // latch jump detection mode at ramp start
+    // closed segment sums are not updated without it, clear them once
+    if(reset)
     {
-        fcii = frame_count[ii];
-        sxii = sum_x[ii];
-
-        if(fcii > 1)  // Multiple valid readouts
+        a->nojump = !(jump_thresh > 0.0f);
+        if(a->nojump)
         {
-            // There's a minus because x is the decreasing raw number, thus decreases w/ time.
-            out_buf[ii] = -tot_num_frames *
-                          (fcii * sum_xy[ii] - sxii * sum_y[ii]) /
-                          (fcii * sum_xx[ii] - sxii * sxii);
-            /*if((frame_count[ii] * sum_xx[ii] - sum_x[ii] * sum_x[ii]) == 0)
-            {
-                utr_img.im->array.F[ii] = -1;
-                // PRINT_WARNING("MADE NANs -- %d, %d, %f, %f", ii, frame_count[ii], sum_xx[ii], sum_x[ii]*sum_x[ii]);
-            }*/
+            memset(a->cxx, 0, sizeof(float) * n_pixels);
+            memset(a->cxy, 0, sizeof(float) * n_pixels);
+            memset(a->cyy, 0, sizeof(float) * n_pixels);
+            memset(a->cn, 0, sizeof(int32_t) * n_pixels);
+            memset(a->cnseg, 0, sizeof(int32_t) * n_pixels);
+            memset(a->njump, 0, sizeof(int32_t) * n_pixels);
         }
-        else if(fcii == 1)  // One single valid readout
+    }
+
+    // For all pixels, including the tags [we could skip the 1st row on the CREDs]
+    if(in_img.md->datatype == _DATATYPE_UINT16)
+    {
+        UTR_ITERATE_LOOP(in_img.im->array.UI16);
+    }
+    else
+    {
+        UTR_ITERATE_LOOP(in_img.im->array.SI16);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+// slope, slope variance and jump count over pixel range
+// out_var and out_jump may be NULL
+//
+static errno_t utr_finalize(const UTR_ACCUM *a,
+                            int              tot_num_frames,
+                            int              warp_offset,
+                            int              n_pixels,
+                            float           *out_buf,
+                            float           *out_var,
+                            float           *out_jump)
+{
+#ifdef _OPENMP
+    #pragma omp parallel for if (n_pixels > OMP_NELEMENT_LIMIT)
+#endif
+    for(int i = 0; i < n_pixels; ++i)
+    {
+        long    ii   = warp_offset + i;
+        int32_t n    = a->n[ii];
+        int     open = (n >= 2);
+        float   invn = 1.0f / (n > 0 ? n : 1);
+
+        float txx = a->cxx[ii] +
+                    (open ? a->sxx[ii] - a->sx[ii] * a->sx[ii] * invn : 0.0f);
+        float txy = a->cxy[ii] +
+                    (open ? a->sxy[ii] - a->sx[ii] * a->sy[ii] * invn : 0.0f);
+        float tyy = a->cyy[ii] +
+                    (open ? a->syy[ii] - a->sy[ii] * a->sy[ii] * invn : 0.0f);
+        int32_t ntot = a->cn[ii] + (open ? n : 0);
+        int32_t nseg = a->cnseg[ii] + open;
+        int32_t dof  = ntot - nseg - 1;
+
+        float slope = (txx > 0.0f) ? txy / (txx > 0.0f ? txx : 1.0f) : 0.0f;
+        float resid = tyy - slope * txy;
+        resid       = (resid > 0.0f) ? resid : 0.0f;
+        float var   = ((txx > 0.0f) && (dof > 0))
+                      ? resid / (dof > 0 ? dof : 1) / (txx > 0.0f ? txx : 1.0f)
+                      : 0.0f;
+
+        // There's a minus because x is the decreasing raw number, thus decreases w/ time.
+        out_buf[i] = -tot_num_frames * slope;
+        if(out_var != NULL)
         {
-            out_buf[ii] = tot_num_frames * sum_x[ii];
+            out_var[i] = (float) tot_num_frames * tot_num_frames * var;
         }
-        else
+        if(out_jump != NULL)
         {
-            out_buf[ii] = 0.0f;
+            out_jump[i] = a->njump[ii];
         }
     }
 
@@ -332,6 +600,26 @@ static errno_t compute_function()
         resolveIMGID(&out_img, ERRMODE_ABORT);
     }
 
+    // Optional UTR quality outputs : slope variance, jump count
+    IMGID var_img  = mkIMGID_from_name(var_imname);
+    IMGID jump_img = mkIMGID_from_name(jump_imname);
+    {
+        IMGID *qual_img[2] = {&var_img, &jump_img};
+        for(int q = 0; q < 2; ++q)
+        {
+            if(strcmp(qual_img[q]->name, "none") == 0)
+            {
+                qual_img[q]->ID = -1;
+            }
+            else if(resolveIMGID(qual_img[q], ERRMODE_WARN))
+            {
+                in_img.datatype = _DATATYPE_FLOAT;
+                imcreatelikewiseIMGID(qual_img[q], &in_img);
+                resolveIMGID(qual_img[q], ERRMODE_ABORT);
+            }
+        }
+    }
+
     /*
      Keyword setup - initialization
     */
@@ -375,11 +663,7 @@ static errno_t compute_function()
     int  n_pixels = in_img.md->size[0] * in_img.md->size[1];
     long buf_pp   = 0;
 
-    float *sum_x[2];
-    float *sum_xx[2];
-    float *sum_y[2];
-    float *sum_xy[2];
-    float *sum_yy[2];
+    UTR_ACCUM utr_accum[2];
 
     int    *frame_count[2];
     u_char *frame_valid[2];
@@ -388,11 +672,7 @@ static errno_t compute_function()
 
     for(long pp = 0; pp < 2; ++pp)
     {
-        sum_x[pp]  = (float *) malloc(n_pixels * SIZEOF_DATATYPE_FLOAT);
-        sum_xx[pp] = (float *) malloc(n_pixels * SIZEOF_DATATYPE_FLOAT);
-        sum_y[pp]  = (float *) malloc(n_pixels * SIZEOF_DATATYPE_FLOAT);
-        sum_xy[pp] = (float *) malloc(n_pixels * SIZEOF_DATATYPE_FLOAT);
-        sum_yy[pp] = (float *) malloc(n_pixels * SIZEOF_DATATYPE_FLOAT);
+        utr_accum_alloc(&utr_accum[pp], n_pixels);
 
         frame_count[pp] = (int *) malloc(n_pixels * SIZEOF_DATATYPE_INT32);
         frame_valid[pp] = (u_char *) malloc(n_pixels * SIZEOF_DATATYPE_INT8);
@@ -400,16 +680,9 @@ static errno_t compute_function()
         save_first_read[pp] =
             (float *) malloc(n_pixels * SIZEOF_DATATYPE_FLOAT);
 
-        // Reset the buffers for utr
-        utr_reset_buffers(sum_x[pp],
-                          sum_y[pp],
-                          sum_xy[pp],
-                          sum_xx[pp],
-                          sum_yy[pp],
-                          frame_count[pp],
-                          frame_valid[pp],
-                          n_pixels);
-        // Reset the buffer for simple_desat
+        // Reset the buffers for simple_desat
+        memset(frame_count[pp], 0, n_pixels * SIZEOF_DATATYPE_INT32);
+        memset(frame_valid[pp], 1, n_pixels * SIZEOF_DATATYPE_UINT8);
         memset(last_valid[pp], 0, n_pixels * SIZEOF_DATATYPE_FLOAT);
     }
 
@@ -576,14 +849,9 @@ static errno_t compute_function()
         }
         else if(ndr_value > 6)
         {
-            utr_iterate(sum_x[buf_pp],
-                        sum_y[buf_pp],
-                        sum_xy[buf_pp],
-                        sum_xx[buf_pp],
-                        sum_yy[buf_pp],
-                        frame_count[buf_pp],
-                        frame_valid[buf_pp],
+            utr_iterate(&utr_accum[buf_pp],
                         *ptr_sat_value,
+                        *ptr_jump_thresh,
                         in_img,
                         just_init);
         }
@@ -718,14 +986,24 @@ static errno_t compute_function()
             else // UTR
             {
                 out_img.im->md->write = TRUE;
-                utr_finalize(&sum_x[1 - buf_pp][warp_offset],
-                             &sum_y[1 - buf_pp][warp_offset],
-                             &sum_xy[1 - buf_pp][warp_offset],
-                             &sum_xx[1 - buf_pp][warp_offset],
-                             &frame_count[1 - buf_pp][warp_offset],
-                             ndr_value,
-                             n_pixels_in_warp,
-                             &(out_img.im->array.F[warp_offset]));
+                utr_finalize(
+                    &utr_accum[1 - buf_pp],
+                    ndr_value,
+                    warp_offset,
+                    n_pixels_in_warp,
+                    &(out_img.im->array.F[warp_offset]),
+                    (var_img.ID != -1) ? &(var_img.im->array.F[warp_offset])
+                    : NULL,
+                    (jump_img.ID != -1) ? &(jump_img.im->array.F[warp_offset])
+                    : NULL);
+                if(var_img.ID != -1)
+                {
+                    var_img.md->write = TRUE;
+                }
+                if(jump_img.ID != -1)
+                {
+                    jump_img.md->write = TRUE;
+                }
             }
 
             if(next_fin_warp == tot_fin_warps - 1)
@@ -734,6 +1012,19 @@ static errno_t compute_function()
                 if(publishable_output)
                 {
                     processinfo_update_output_stream(processinfo, out_img.ID);
+                    if(ndr_value > 6)
+                    {
+                        if(var_img.ID != -1)
+                        {
+                            processinfo_update_output_stream(processinfo,
+                                                              var_img.ID);
+                        }
+                        if(jump_img.ID != -1)
+                        {
+                            processinfo_update_output_stream(processinfo,
+                                                              jump_img.ID);
+                        }
+                    }
                 }
             }
             ++next_fin_warp;
@@ -748,11 +1039,7 @@ static errno_t compute_function()
 
     for(int pp = 0; pp < 2; ++pp)
     {
-        free(sum_x[pp]);
-        free(sum_y[pp]);
-        free(sum_xy[pp]);
-        free(sum_xx[pp]);
-        free(sum_yy[pp]);
+        utr_accum_free(&utr_accum[pp]);
 
         free(frame_count[pp]);
         free(frame_valid[pp]);
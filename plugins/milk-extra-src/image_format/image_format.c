@@ -14,6 +14,7 @@
 #include "CR2toFITS.h"
 #include "FITS_to_floatbin_lock.h"
 #include "FITS_to_ushortintbin_lock.h"
+#include "bayer_demosaic.h"
 #include "combineHDR.h"
 #include "stream_temporal_stats.h"
 #include "extract_RGGBchan.h"
@@ -21,6 +22,7 @@
 #include "imtoASCII.h"
 #include "loadCR2toFITSRGB.h"
 #include "read_binary32f.h"
+#include "streamHDR.h"
 #include "writeBMP.h"
 
 
@@ -44,8 +46,10 @@ static errno_t init_module_CLI()
 {
 
     CLIADDCMD_image_format__extractRGGBchan();
+    CLIADDCMD_image_format__demosaic();
 
     CLIADDCMD_image_format__combineHDR();
+    CLIADDCMD_image_format__streamHDR();
     CLIADDCMD_image_format__cred_cds_utr();
     CLIADDCMD_image_format__temporal_stats();
 
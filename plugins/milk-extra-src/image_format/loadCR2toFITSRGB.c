@@ -32,11 +32,10 @@ static errno_t IMAGE_FORMAT_loadCR2toFITSRGB_cli()
             CLI_checkarg(4, 3) ==
             0)
     {
-        loadCR2toFITSRGB(data.cmdargtoken[1].val.string,
-                         data.cmdargtoken[2].val.string,
-                         data.cmdargtoken[3].val.string,
-                         data.cmdargtoken[4].val.string);
-        return RETURN_SUCCESS;
+        return loadCR2toFITSRGB(data.cmdargtoken[1].val.string,
+                                data.cmdargtoken[2].val.string,
+                                data.cmdargtoken[3].val.string,
+                                data.cmdargtoken[4].val.string);
     }
     else
     {
@@ -161,26 +160,27 @@ errno_t loadCR2toFITSRGB(const char *__restrict fnameCR2,
 
     printf("FLUXFACTOR = %g\n", FLUXFACTOR);
 
+    errno_t ret;
     if(variable_ID("RGBfullres") == -1)
     {
-        convert_rawbayerFITStorgbFITS_simple("tmpfits1",
-                                             fnameFITSr,
-                                             fnameFITSg,
-                                             fnameFITSb,
-                                             1);
+        ret = convert_rawbayerFITStorgbFITS_simple("tmpfits1",
+                fnameFITSr,
+                fnameFITSg,
+                fnameFITSb,
+                1);
     }
     else
     {
-        convert_rawbayerFITStorgbFITS_simple("tmpfits1",
-                                             fnameFITSr,
-                                             fnameFITSg,
-                                             fnameFITSb,
-                                             0);
+        ret = convert_rawbayerFITStorgbFITS_simple("tmpfits1",
+                fnameFITSr,
+                fnameFITSg,
+                fnameFITSb,
+                0);
     }
 
     delete_image_ID("tmpfits1", DELETE_IMAGE_ERRMODE_WARNING);
 
     FLUXFACTOR = 1.0;
 
-    return RETURN_SUCCESS;
+    return ret;
 }
@@ -0,0 +1,435 @@
+/**
+ * @file    streamHDR.c
+ * @brief   Real-time HDR fusion of interleaved exposures in a camera stream
+ *
+ * Camera cycles through NBexp exposure times, one frame per exposure.
+ * Frame index within cycle : k = (cnt0 - phase) % NBexp
+ *
+ * Each frame is dark-subtracted with its own calibration slice and
+ * accumulated with a saturation-aware weight :
+ *
+ *   v    = raw - dark[k]
+ *   wsat = clamp( (satlevel - raw) / (softsat * satlevel), 0, 1 )
+ *   num += wsat * v
+ *   den += wsat * etime[k]
+ *
+ * wsat rolls off linearly over the top softsat fraction of the ADU range,
+ * so pixels approaching saturation fade out instead of switching.
+ * Weighting by exposure time favors long exposures where they are valid.
+ *
+ * On last frame of cycle, output flux [ADU/etime unit] = num / den.
+ * Pixels saturated in all exposures fall back to shortest exposure.
+ *
+ * Cycles with missing frames (cnt0 jump) are not published.
+ *
+ * Input: raw camera stream, any integer type or float
+ * Input: exposure time table (1D, NBexp elements)
+ * Input: optional dark cube (xsize x ysize x NBexp)
+ *
+ * Output: HDR stream (float 32), updated once per cycle
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "streamHDR.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP_NELEMENT_LIMIT 100000
+#endif
+
+// Local variables pointers
+static char     *insname;
+static uint32_t *NBexp;
+static char     *etimename;
+static double   *satlevel;
+static char     *darkname;
+static double   *biaslevel;
+static double   *softsat;
+static uint32_t *phase;
+
+static char *outimname;
+
+static CLICMDARGDEF farg[] = {{
+        CLIARG_IMG,
+        ".insname",
+        "input camera stream",
+        "im1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &insname,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".NBexp",
+        "number of exposures per cycle",
+        "2",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &NBexp,
+        NULL
+    },
+    {
+        CLIARG_IMG,
+        ".etime",
+        "exposure time table",
+        "etime",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &etimename,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".satlevel",
+        "Saturation level [ADU]",
+        "65000",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &satlevel,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".dark",
+        "dark cube, one slice per exposure, none to use bias",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &darkname,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".bias",
+        "Bias level, if no dark",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &biaslevel,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".softsat",
+        "saturation roll-off, fraction of satlevel",
+        "0.1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &softsat,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".phase",
+        "cnt0 value of first exposure, modulo NBexp",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &phase,
+        NULL
+    },
+    {
+        CLIARG_STR_NOT_IMG,
+        ".outimname",
+        "output HDR stream",
+        "outHDR",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "streamHDR", "RT HDR fusion of interleaved exposures", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Fuse interleaved exposures of a camera stream into HDR stream.\n");
+    printf("Exposure k = (cnt0 - .phase) %% .NBexp, time .etime[k]\n");
+    printf("Dark slice k of .dark subtracted, or .bias if none.\n");
+    printf("Pixels above satlevel*(1-softsat) are progressively rejected.\n");
+    printf("Output in ADU per exposure time unit, once per cycle.\n");
+
+    return RETURN_SUCCESS;
+}
+
+/*
+THE IMPORTANT, CUSTOM PART
+*/
+
+// accumulate one frame into num/den
+// loop is branch-free so that compiler can vectorize it
+//
+#define STREAMHDR_ACCUM(inarray)                                            \
+    do                                                                      \
+    {                                                                       \
+        const __typeof__((inarray)[0]) *__restrict in = (inarray);          \
+        STREAMHDR_OMP_FOR                                                   \
+        for(long ii = 0; ii < npix; ii++)                                   \
+        {                                                                   \
+            float raw  = (float) in[ii];                                    \
+            float v    = raw - dark[ii];                                    \
+            float wsat = (sat - raw) * invsoft;                             \
+            wsat       = (wsat < 0.0f) ? 0.0f : wsat;                       \
+            wsat       = (wsat > 1.0f) ? 1.0f : wsat;                       \
+            num[ii] += wsat * v;                                            \
+            den[ii] += wsat * et;                                           \
+            fb[ii] = isfb ? v * invet : fb[ii];                             \
+        }                                                                   \
+    } while(0)
+
+#ifdef _OPENMP
+#define STREAMHDR_OMP_FOR                                                   \
+    _Pragma("omp parallel for if (npix > OMP_NELEMENT_LIMIT)")
+#else
+#define STREAMHDR_OMP_FOR
+#endif
+
+static errno_t streamHDR_accumulate(IMGID                   in_img,
+                                    long                    npix,
+                                    const float *__restrict dark,
+                                    float                   sat,
+                                    float                   invsoft,
+                                    float                   et,
+                                    int                     isfb,
+                                    float *__restrict       num,
+                                    float *__restrict       den,
+                                    float *__restrict       fb)
+{
+    float invet = 1.0f / et;
+
+    switch(in_img.md->datatype)
+    {
+        case _DATATYPE_UINT8:
+            STREAMHDR_ACCUM(in_img.im->array.UI8);
+            break;
+
+        case _DATATYPE_UINT16:
+            STREAMHDR_ACCUM(in_img.im->array.UI16);
+            break;
+
+        case _DATATYPE_INT16:
+            STREAMHDR_ACCUM(in_img.im->array.SI16);
+            break;
+
+        case _DATATYPE_UINT32:
+            STREAMHDR_ACCUM(in_img.im->array.UI32);
+            break;
+
+        case _DATATYPE_INT32:
+            STREAMHDR_ACCUM(in_img.im->array.SI32);
+            break;
+
+        case _DATATYPE_FLOAT:
+            STREAMHDR_ACCUM(in_img.im->array.F);
+            break;
+
+        default:
+            PRINT_ERROR("datatype %d not supported", in_img.md->datatype);
+            return RETURN_FAILURE;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID in_img = mkIMGID_from_name(insname);
+    resolveIMGID(&in_img, ERRMODE_ABORT);
+
+    // Set in_img to be the trigger
+    strcpy(CLIcmddata.cmdsettings->triggerstreamname, insname);
+    // for FPS mode:
+    if(data.fpsptr != NULL)
+    {
+        strcpy(data.fpsptr->cmdset.triggerstreamname, insname);
+    }
+
+    uint32_t xsize = in_img.md->size[0];
+    uint32_t ysize = in_img.md->size[1];
+    long     npix  = (long) xsize * ysize;
+
+    switch(in_img.md->datatype)
+    {
+        case _DATATYPE_UINT8:
+        case _DATATYPE_UINT16:
+        case _DATATYPE_INT16:
+        case _DATATYPE_UINT32:
+        case _DATATYPE_INT32:
+        case _DATATYPE_FLOAT:
+            break;
+
+        default:
+            PRINT_ERROR("%s datatype %d not supported",
+                        insname,
+                        in_img.md->datatype);
+            abort();
+    }
+
+    uint32_t nexp = *NBexp;
+    if(nexp < 1)
+    {
+        nexp = 1;
+    }
+
+    if(!(*satlevel > 0.0) || !(*softsat > 0.0))
+    {
+        PRINT_ERROR("satlevel = %f and softsat = %f must be positive",
+                    *satlevel,
+                    *softsat);
+        abort();
+    }
+
+    // exposure times
+    IMGID etime_img = mkIMGID_from_name(etimename);
+    resolveIMGID(&etime_img, ERRMODE_ABORT);
+    if(etime_img.md->datatype != _DATATYPE_FLOAT ||
+            etime_img.md->nelement < nexp)
+    {
+        PRINT_ERROR("%s must be float, with at least %u elements",
+                    etimename,
+                    nexp);
+        abort();
+    }
+
+    float   *etime = (float *) malloc(sizeof(float) * nexp);
+    if(etime == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    uint32_t kfb   = 0; // shortest exposure, fallback for saturated pixels
+    for(uint32_t k = 0; k < nexp; k++)
+    {
+        etime[k] = etime_img.im->array.F[k];
+        if(!(etime[k] > 0.0f))
+        {
+            PRINT_ERROR("exposure time %u = %f not positive", k, etime[k]);
+            abort();
+        }
+        if(etime[k] < etime[kfb])
+        {
+            kfb = k;
+        }
+    }
+
+    // dark calibration, one slice per exposure
+    float *darkc = (float *) malloc(sizeof(float) * npix * nexp);
+    if(darkc == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    if(strcmp(darkname, "none") == 0)
+    {
+        for(long ii = 0; ii < npix * nexp; ii++)
+        {
+            darkc[ii] = *biaslevel;
+        }
+    }
+    else
+    {
+        IMGID dark_img = mkIMGID_from_name(darkname);
+        resolveIMGID(&dark_img, ERRMODE_ABORT);
+        if(dark_img.md->datatype != _DATATYPE_FLOAT ||
+                dark_img.md->nelement != (uint64_t) npix * nexp)
+        {
+            PRINT_ERROR("%s must be float %u x %u x %u",
+                        darkname,
+                        xsize,
+                        ysize,
+                        nexp);
+            abort();
+        }
+        memcpy(darkc, dark_img.im->array.F, sizeof(float) * npix * nexp);
+    }
+
+    float *num = (float *) malloc(sizeof(float) * npix);
+    float *den = (float *) malloc(sizeof(float) * npix);
+    float *fb  = (float *) malloc(sizeof(float) * npix);
+    if((num == NULL) || (den == NULL) || (fb == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    IMGID imgout = stream_connect_create_2Df32(outimname, xsize, ysize);
+
+    float sat     = *satlevel;
+    float invsoft = 1.0f / (*softsat * *satlevel);
+
+    uint64_t cnt0prev   = 0;
+    int      cyclestart = 0; // first frame of current cycle received
+    int      cyclevalid = 0;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        uint64_t cnt0 = in_img.md->cnt0;
+        // phase reduced first : no unsigned wrap when cnt0 < phase
+        uint32_t k = (uint32_t)((cnt0 + nexp - (*phase % nexp)) % nexp);
+
+        if(k == 0)
+        {
+            memset(num, 0, sizeof(float) * npix);
+            memset(den, 0, sizeof(float) * npix);
+            cyclestart = 1;
+            cyclevalid = 1;
+        }
+        else if(cnt0 != cnt0prev + 1)
+        {
+            // missed frame(s) : drop current cycle
+            cyclevalid = 0;
+        }
+        cnt0prev = cnt0;
+
+        if(cyclestart && cyclevalid)
+        {
+            streamHDR_accumulate(in_img,
+                                 npix,
+                                 darkc + k * npix,
+                                 sat,
+                                 invsoft,
+                                 etime[k],
+                                 (k == kfb),
+                                 num,
+                                 den,
+                                 fb);
+
+            if(k == nexp - 1)
+            {
+                float *out = imgout.im->array.F;
+
+#ifdef _OPENMP
+                #pragma omp parallel for if (npix > OMP_NELEMENT_LIMIT)
+#endif
+                for(long ii = 0; ii < npix; ii++)
+                {
+                    out[ii] = (den[ii] > 0.0f) ? num[ii] / den[ii] : fb[ii];
+                }
+                processinfo_update_output_stream(processinfo, imgout.ID);
+            }
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    free(etime);
+    free(darkc);
+    free(num);
+    free(den);
+    free(fb);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t CLIADDCMD_image_format__streamHDR()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
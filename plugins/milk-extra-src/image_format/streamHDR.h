@@ -0,0 +1,6 @@
+#ifndef _IMAGE_FORMAT_STREAMHDR_H
+#define _IMAGE_FORMAT_STREAMHDR_H
+
+errno_t CLIADDCMD_image_format__streamHDR();
+
+#endif
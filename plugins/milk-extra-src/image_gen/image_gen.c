@@ -35,6 +35,7 @@
 #include "COREMOD_iofits/COREMOD_iofits.h"
 #include "COREMOD_memory/COREMOD_memory.h"
 
+#include "statistic/rng_philox.h"
 #include "statistic/statistic.h"
 
 #include "image_gen/image_gen.h"
@@ -2250,16 +2251,16 @@ make_rnd(const char *ID_name, uint32_t l1, uint32_t l2, const char *options)
     int      distrib;
     uint64_t nelement;
 
-    distrib = 0; /* uniform */
+    distrib = RNG_PDF_UNIFORM;
     if(strstr(options, "gauss") != NULL)
     {
-        distrib = 1; /* gauss */
+        distrib = RNG_PDF_GAUSS;
         printf("gaussian distribution\n");
     }
 
     if(strstr(options, "trgauss") != NULL)
     {
-        distrib = 2; /* truncated gauss */
+        distrib = RNG_PDF_TRGAUSS;
         printf("truncated gaussian distribution\n");
     }
 
@@ -2273,28 +2274,11 @@ make_rnd(const char *ID_name, uint32_t l1, uint32_t l2, const char *options)
     naxes[1] = data.image[ID].md[0].size[1];
     nelement = naxes[0] * naxes[1];
 
-    // openMP is slow when calling gsl random number generator : do not use openMP here
-    if(distrib == 0)
-    {
-        for(uint64_t ii = 0; ii < nelement; ii++)
-        {
-            data.image[ID].array.F[ii] = (double) ran1();
-        }
-    }
-    if(distrib == 1)
-    {
-        for(uint64_t ii = 0; ii < nelement; ii++)
-        {
-            data.image[ID].array.F[ii] = (double) gauss();
-        }
-    }
-    if(distrib == 2)
-    {
-        for(uint64_t ii = 0; ii < nelement; ii++)
-        {
-            data.image[ID].array.F[ii] = (double) gauss_trc();
-        }
-    }
+    // counter-based generator, parallel and reproducible for a given seed
+    rng_philox_fill_float(rng_philox_default(),
+                          distrib,
+                          data.image[ID].array.F,
+                          nelement);
 
     return (ID);
 }
@@ -2309,16 +2293,16 @@ imageID make_rnd_double(const char *ID_name,
     int      distrib;
     uint64_t nelement;
 
-    distrib = 0; /* uniform */
+    distrib = RNG_PDF_UNIFORM;
     if(strstr(options, "gauss") != NULL)
     {
-        distrib = 1; /* gauss */
+        distrib = RNG_PDF_GAUSS;
         printf("gaussian distribution\n");
     }
 
     if(strstr(options, "trgauss") != NULL)
     {
-        distrib = 2; /* truncated gauss */
+        distrib = RNG_PDF_TRGAUSS;
         printf("truncated gaussian distribution\n");
     }
 
@@ -2332,28 +2316,11 @@ imageID make_rnd_double(const char *ID_name,
     naxes[1] = data.image[ID].md[0].size[1];
     nelement = naxes[0] * naxes[1];
 
-    // openMP is slow when calling gsl random number generator : do not use openMP here
-    if(distrib == 0)
-    {
-        for(uint64_t ii = 0; ii < nelement; ii++)
-        {
-            data.image[ID].array.D[ii] = (double) ran1();
-        }
-    }
-    if(distrib == 1)
-    {
-        for(uint64_t ii = 0; ii < nelement; ii++)
-        {
-            data.image[ID].array.D[ii] = (double) gauss();
-        }
-    }
-    if(distrib == 2)
-    {
-        for(uint64_t ii = 0; ii < nelement; ii++)
-        {
-            data.image[ID].array.D[ii] = (double) gauss_trc();
-        }
-    }
+    // counter-based generator, parallel and reproducible for a given seed
+    rng_philox_fill_double(rng_philox_default(),
+                           distrib,
+                           data.image[ID].array.D,
+                           nelement);
 
     return (ID);
 }
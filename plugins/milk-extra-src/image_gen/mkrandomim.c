@@ -1,4 +1,5 @@
 #include "CommandLineInterface/CLIcore.h"
+#include "statistic/rng_philox.h"
 #include "statistic/statistic.h"
 
 #include "COREMOD_memory/image_keyword_addL.h"
@@ -78,27 +79,13 @@ static imageID make_image_random(
     // Create image if needed
     imcreateIMGID(img);
 
-    // openMP is slow when calling gsl random number generator : do not use openMP here
-    if(pdf == 0)
+    if((pdf == RNG_PDF_UNIFORM) || (pdf == RNG_PDF_GAUSS) ||
+            (pdf == RNG_PDF_TRGAUSS))
     {
-        for(uint64_t ii = 0; ii < img->md->nelement; ii++)
-        {
-            img->im->array.F[ii] = (float) ran1();
-        }
-    }
-    if(pdf == 1)
-    {
-        for(uint64_t ii = 0; ii < img->md->nelement; ii++)
-        {
-            img->im->array.F[ii] = (float) gauss();
-        }
-    }
-    if(pdf == 2)
-    {
-        for(uint64_t ii = 0; ii < img->md->nelement; ii++)
-        {
-            img->im->array.F[ii] = (float) gauss_trc();
-        }
+        rng_philox_fill_float(rng_philox_default(),
+                              pdf,
+                              img->im->array.F,
+                              img->md->nelement);
     }
     if(pdf == 3)  // test pattern
     {
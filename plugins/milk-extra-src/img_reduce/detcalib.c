@@ -0,0 +1,852 @@
+/** @file detcalib.c
+ *
+ * Real-time detector calibration
+ *
+ * Raw frame -> dark subtraction -> nonlinearity -> flat field ->
+ * bad pixel interpolation, float output.
+ *
+ * All per-pixel operations use precomputed tables held in a DETCALIB
+ * struct, so several instances can run independently. Pixel loops are
+ * branch-free over restrict-qualified arrays for vectorization.
+ *
+ * Calibration images are rebuilt into a second table set when their
+ * cnt0 changes. The rebuild runs on a helper thread while frames keep
+ * being calibrated with the active set, and the new set is swapped in
+ * between frames once complete.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // pthread_tryjoin_np
+#endif
+
+#include <math.h>
+#include <pthread.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "detcalib.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP_NELEMENT_LIMIT 1000000
+#endif
+
+// min number of good pixels used to interpolate a bad pixel
+#define DETCALIB_NBNEARBYPIX 4
+
+
+
+
+// ==========================================
+// Function parameters
+// ==========================================
+
+static char *inimname;
+static long  fpi_inimname = -1;
+
+static char *darkname;
+static char *flatname;
+static char *badpixname;
+static char *nlname;
+
+static char *outimname;
+
+static uint64_t *reload;
+static long      fpi_reload = -1;
+
+static uint64_t *NBbadpix;
+static long      fpi_NBbadpix = -1;
+
+static uint64_t *NBupdate;
+static long      fpi_NBupdate = -1;
+
+
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STREAM,
+        ".inim",
+        "raw input stream",
+        "im",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inimname,
+        &fpi_inimname
+    },
+    {
+        CLIARG_STR,
+        ".dark",
+        "dark image, none to skip",
+        "none",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &darkname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".flat",
+        "flat field image, none to skip",
+        "none",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &flatname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".badpix",
+        "bad pixel map (1 = bad), none to skip",
+        "none",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &badpixname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".nlcoeff",
+        "nonlinearity coefficients cube, none to skip",
+        "none",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &nlname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outim",
+        "calibrated output stream",
+        "imcal",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    },
+    {
+        CLIARG_ONOFF,
+        ".reload",
+        "reload calibration images",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &reload,
+        &fpi_reload
+    },
+    {
+        CLIARG_UINT64,
+        ".status.NBbadpix",
+        "number of bad pixels",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBbadpix,
+        &fpi_NBbadpix
+    },
+    {
+        CLIARG_UINT64,
+        ".status.NBupdate",
+        "number of calibration updates",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBupdate,
+        &fpi_NBupdate
+    }
+};
+
+
+
+// Optional custom configuration setup.
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_inimname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+
+        data.fpsptr->parray[fpi_reload].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+static errno_t customCONFcheck()
+{
+    if(data.fpsptr != NULL)
+    {
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+static CLICMDDATA CLIcmddata =
+{
+    "detcalib",
+    "detector calibration: dark, nonlinearity, flat, bad pixels",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Calibrate raw frames :\n");
+    printf("   v = raw - dark\n");
+    printf("   v = v * (1 + c0 v + c1 v^2 + ...)   nonlinearity\n");
+    printf("   v = v / flat\n");
+    printf("   bad pixels interpolated from nearby good pixels\n");
+    printf("Pixels with flat <= 0 are flagged bad\n");
+    printf("Nonlinearity coefficients cube is xsize x ysize x NBcoeff\n");
+    printf("Calibration is rebuilt when calibration images are updated,\n");
+    printf("on a helper thread : frames use previous calibration until done\n");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// scan square box of half-width dist around bad pixel
+// returns number of good pixels, fills index and coeff if not NULL
+//
+static uint32_t detcalib_nearbypix(const DETCALIB *cal,
+                                   const uint8_t  *badmask,
+                                   uint32_t        ii,
+                                   uint32_t        jj,
+                                   long            dist,
+                                   uint32_t       *index,
+                                   float          *coeff)
+{
+    uint32_t k        = 0;
+    double   coefftot = 0.0;
+
+    for(long jj1 = (long) jj - dist; jj1 <= (long) jj + dist; jj1++)
+    {
+        if((jj1 < 0) || (jj1 >= cal->ysize))
+        {
+            continue;
+        }
+        for(long ii1 = (long) ii - dist; ii1 <= (long) ii + dist; ii1++)
+        {
+            if((ii1 < 0) || (ii1 >= cal->xsize))
+            {
+                continue;
+            }
+            uint64_t pix = (uint64_t) jj1 * cal->xsize + ii1;
+            if(badmask[pix] == 0)
+            {
+                if(index != NULL)
+                {
+                    double dist2 = 1.0 * (ii1 - ii) * (ii1 - ii) +
+                                   1.0 * (jj1 - jj) * (jj1 - jj);
+                    index[k] = pix;
+                    coeff[k] = 1.0 / (dist2 * dist2);
+                    coefftot += coeff[k];
+                }
+                k++;
+            }
+        }
+    }
+
+    if(index != NULL)
+    {
+        for(uint32_t k1 = 0; k1 < k; k1++)
+        {
+            coeff[k1] /= coefftot;
+        }
+    }
+
+    return k;
+}
+
+
+
+
+// build tables, without function trace so it can run on helper thread
+//
+static errno_t detcalib_buildtables(DETCALIB *cal,
+                                    uint32_t  xsize,
+                                    uint32_t  ysize,
+                                    IMGID     imgdark,
+                                    IMGID     imgflat,
+                                    IMGID     imgbadpix,
+                                    IMGID     imgnl)
+{
+    uint64_t xysize = (uint64_t) xsize * ysize;
+
+    IMGID *imgcheck[] = {&imgdark, &imgflat, &imgbadpix, &imgnl};
+    for(int i = 0; i < 4; i++)
+    {
+        IMGID *img = imgcheck[i];
+        if(img->ID != -1)
+        {
+            if((img->md->datatype != _DATATYPE_FLOAT) ||
+                    (img->md->size[0] != xsize) ||
+                    (img->md->size[1] != ysize))
+            {
+                PRINT_ERROR("calibration image %s must be float %u x %u",
+                            img->name,
+                            xsize,
+                            ysize);
+                return RETURN_FAILURE;
+            }
+        }
+    }
+
+    cal->xsize  = xsize;
+    cal->ysize  = ysize;
+    cal->xysize = xysize;
+
+    cal->dark    = (float *) malloc(sizeof(float) * xysize);
+    cal->gain    = (float *) malloc(sizeof(float) * xysize);
+    uint8_t *badmask = (uint8_t *) calloc(xysize, sizeof(uint8_t));
+    if((cal->dark == NULL) || (cal->gain == NULL) || (badmask == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    for(uint64_t ii = 0; ii < xysize; ii++)
+    {
+        cal->dark[ii] = 0.0;
+        cal->gain[ii] = 1.0;
+    }
+    if(imgdark.ID != -1)
+    {
+        memcpy(cal->dark, imgdark.im->array.F, sizeof(float) * xysize);
+    }
+    if(imgflat.ID != -1)
+    {
+        for(uint64_t ii = 0; ii < xysize; ii++)
+        {
+            float flat = imgflat.im->array.F[ii];
+            if((flat > 0.0) && isfinite(flat))
+            {
+                cal->gain[ii] = 1.0 / flat;
+            }
+            else
+            {
+                badmask[ii] = 1;
+            }
+        }
+    }
+    if(imgbadpix.ID != -1)
+    {
+        for(uint64_t ii = 0; ii < xysize; ii++)
+        {
+            if(imgbadpix.im->array.F[ii] > 0.5)
+            {
+                badmask[ii] = 1;
+            }
+        }
+    }
+
+    cal->NBnlcoeff = 0;
+    cal->nlcoeff   = NULL;
+    if(imgnl.ID != -1)
+    {
+        cal->NBnlcoeff = (imgnl.md->naxis == 3) ? imgnl.md->size[2] : 1;
+        cal->nlcoeff =
+            (float *) malloc(sizeof(float) * xysize * cal->NBnlcoeff);
+        if(cal->nlcoeff == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        memcpy(cal->nlcoeff,
+               imgnl.im->array.F,
+               sizeof(float) * xysize * cal->NBnlcoeff);
+    }
+
+
+    // bad pixel interpolation tables
+    // first pass sets search box size and counts operations
+    //
+    cal->NBbadpix = 0;
+    for(uint64_t ii = 0; ii < xysize; ii++)
+    {
+        cal->NBbadpix += badmask[ii];
+    }
+
+    cal->badpixindex = (uint32_t *) malloc(sizeof(uint32_t) * cal->NBbadpix);
+    cal->opstart =
+        (uint64_t *) malloc(sizeof(uint64_t) * (cal->NBbadpix + 1));
+    long *bpdist = (long *) malloc(sizeof(long) * cal->NBbadpix);
+    if((cal->badpixindex == NULL) || (cal->opstart == NULL) ||
+            (bpdist == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    long     distmax = (xsize > ysize) ? xsize : ysize;
+    uint64_t NBop    = 0;
+    uint64_t bp      = 0;
+    for(uint64_t ii = 0; ii < xysize; ii++)
+    {
+        if(badmask[ii] == 1)
+        {
+            uint32_t k    = 0;
+            long     dist = 0;
+            while((k < DETCALIB_NBNEARBYPIX) && (dist < distmax))
+            {
+                dist++;
+                k = detcalib_nearbypix(cal,
+                                       badmask,
+                                       ii % xsize,
+                                       ii / xsize,
+                                       dist,
+                                       NULL,
+                                       NULL);
+            }
+            cal->badpixindex[bp] = ii;
+            cal->opstart[bp]     = NBop;
+            bpdist[bp]           = dist;
+            NBop += k;
+            bp++;
+        }
+    }
+    cal->opstart[cal->NBbadpix] = NBop;
+
+    cal->opindex = (uint32_t *) malloc(sizeof(uint32_t) * (NBop + 1));
+    cal->opcoeff = (float *) malloc(sizeof(float) * (NBop + 1));
+    if((cal->opindex == NULL) || (cal->opcoeff == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    for(bp = 0; bp < cal->NBbadpix; bp++)
+    {
+        uint32_t ii = cal->badpixindex[bp];
+        detcalib_nearbypix(cal,
+                           badmask,
+                           ii % xsize,
+                           ii / xsize,
+                           bpdist[bp],
+                           cal->opindex + cal->opstart[bp],
+                           cal->opcoeff + cal->opstart[bp]);
+        cal->gain[ii] = 0.0;
+    }
+
+    free(bpdist);
+    free(badmask);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Build calibration tables
+ *
+ * Calibration images are optional (ID = -1 to skip) and must be float.
+ */
+errno_t detcalib_build(DETCALIB *cal,
+                       uint32_t  xsize,
+                       uint32_t  ysize,
+                       IMGID     imgdark,
+                       IMGID     imgflat,
+                       IMGID     imgbadpix,
+                       IMGID     imgnl)
+{
+    DEBUG_TRACE_FSTART();
+
+    FUNC_CHECK_RETURN(detcalib_buildtables(cal,
+                                           xsize,
+                                           ysize,
+                                           imgdark,
+                                           imgflat,
+                                           imgbadpix,
+                                           imgnl));
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t detcalib_free(DETCALIB *cal)
+{
+    free(cal->dark);
+    free(cal->gain);
+    free(cal->nlcoeff);
+    free(cal->badpixindex);
+    free(cal->opstart);
+    free(cal->opindex);
+    free(cal->opcoeff);
+
+    cal->dark        = NULL;
+    cal->gain        = NULL;
+    cal->nlcoeff     = NULL;
+    cal->badpixindex = NULL;
+    cal->opstart     = NULL;
+    cal->opindex     = NULL;
+    cal->opcoeff     = NULL;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// raw - dark, scaled by gain if set, any input type
+//
+#define DETCALIB_RAWLOOP(inarray)                                           \
+    do                                                                      \
+    {                                                                       \
+        const __typeof__((inarray)[0]) *__restrict in = (inarray) +         \
+                                                        frameoffset;        \
+        if(gain != NULL)                                                    \
+        {                                                                   \
+            DETCALIB_OMP_FOR                                                \
+            for(uint64_t ii = 0; ii < xysize; ii++)                         \
+            {                                                               \
+                out[ii] = ((float) in[ii] - dark[ii]) * gain[ii];           \
+            }                                                               \
+        }                                                                   \
+        else                                                                \
+        {                                                                   \
+            DETCALIB_OMP_FOR                                                \
+            for(uint64_t ii = 0; ii < xysize; ii++)                         \
+            {                                                               \
+                out[ii] = (float) in[ii] - dark[ii];                        \
+            }                                                               \
+        }                                                                   \
+    } while(0)
+
+#ifdef _OPENMP
+#define DETCALIB_OMP_FOR                                                    \
+    _Pragma("omp parallel for if (xysize > OMP_NELEMENT_LIMIT)")
+#else
+#define DETCALIB_OMP_FOR
+#endif
+
+
+/**
+ * @brief Calibrate one frame
+ *
+ * Input frame starts at element frameoffset of imgin.
+ */
+errno_t detcalib_apply(const DETCALIB *cal,
+                       IMGID           imgin,
+                       uint64_t        frameoffset,
+                       float          *out_)
+{
+    DEBUG_TRACE_FSTART();
+
+    uint64_t                 xysize = cal->xysize;
+    const float *__restrict  dark   = cal->dark;
+    float *__restrict        out    = out_;
+
+    // gain applied in first pass only if no nonlinearity
+    const float *__restrict gain = (cal->NBnlcoeff == 0) ? cal->gain : NULL;
+
+    switch(imgin.md->datatype)
+    {
+        case _DATATYPE_FLOAT:
+            DETCALIB_RAWLOOP(imgin.im->array.F);
+            break;
+        case _DATATYPE_UINT16:
+            DETCALIB_RAWLOOP(imgin.im->array.UI16);
+            break;
+        case _DATATYPE_INT16:
+            DETCALIB_RAWLOOP(imgin.im->array.SI16);
+            break;
+        case _DATATYPE_UINT32:
+            DETCALIB_RAWLOOP(imgin.im->array.UI32);
+            break;
+        case _DATATYPE_INT32:
+            DETCALIB_RAWLOOP(imgin.im->array.SI32);
+            break;
+        default:
+            FUNC_RETURN_FAILURE("unsupported input datatype %d",
+                                imgin.md->datatype);
+    }
+
+    if(cal->NBnlcoeff > 0)
+    {
+        const float *__restrict nl    = cal->nlcoeff;
+        const float *__restrict gainf = cal->gain;
+        uint32_t                NBc   = cal->NBnlcoeff;
+
+        DETCALIB_OMP_FOR
+        for(uint64_t ii = 0; ii < xysize; ii++)
+        {
+            float v = out[ii];
+            float p = 0.0;
+            for(uint32_t c = NBc; c > 0; c--)
+            {
+                p = p * v + nl[(uint64_t)(c - 1) * xysize + ii];
+            }
+            out[ii] = v * (1.0 + p * v) * gainf[ii];
+        }
+    }
+
+    // all interpolation inputs are good pixels, order does not matter
+    //
+    for(uint64_t bp = 0; bp < cal->NBbadpix; bp++)
+    {
+        float v = 0.0;
+        for(uint64_t k = cal->opstart[bp]; k < cal->opstart[bp + 1]; k++)
+        {
+            v += cal->opcoeff[k] * out[cal->opindex[k]];
+        }
+        out[cal->badpixindex[bp]] = v;
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// resolve optional calibration image, ID = -1 if none
+//
+static IMGID detcalib_resolve(const char *name)
+{
+    IMGID img = mkIMGID_from_name(name);
+    if(strcmp(name, "none") != 0)
+    {
+        resolveIMGID(&img, ERRMODE_WARN);
+    }
+    else
+    {
+        img.ID = -1;
+    }
+    return img;
+}
+
+
+
+
+// standby table rebuild, run on helper thread
+//
+typedef struct
+{
+    DETCALIB *cal;
+    uint32_t  xsize;
+    uint32_t  ysize;
+    IMGID     imgcal[4];
+    errno_t   status;
+} DETCALIB_BUILDMSG;
+
+static void *detcalib_build_thread(void *ptr)
+{
+    DETCALIB_BUILDMSG *msg = (DETCALIB_BUILDMSG *) ptr;
+
+    msg->status = detcalib_buildtables(msg->cal,
+                                       msg->xsize,
+                                       msg->ysize,
+                                       msg->imgcal[0],
+                                       msg->imgcal[1],
+                                       msg->imgcal[2],
+                                       msg->imgcal[3]);
+    return NULL;
+}
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imgin = mkIMGID_from_name(inimname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    // Set input to be the trigger
+    strcpy(CLIcmddata.cmdsettings->triggerstreamname, inimname);
+    // for FPS mode:
+    if(data.fpsptr != NULL)
+    {
+        strcpy(data.fpsptr->cmdset.triggerstreamname, inimname);
+    }
+
+    uint32_t xsize  = imgin.md->size[0];
+    uint32_t ysize  = imgin.md->size[1];
+
+    switch(imgin.md->datatype)
+    {
+        case _DATATYPE_FLOAT:
+        case _DATATYPE_UINT16:
+        case _DATATYPE_INT16:
+        case _DATATYPE_UINT32:
+        case _DATATYPE_INT32:
+            break;
+        default:
+            FUNC_RETURN_FAILURE("%s : unsupported input datatype %d",
+                                inimname,
+                                imgin.md->datatype);
+    }
+
+    // calibration images, in order dark, flat, badpix, nlcoeff
+    char  *calname[4] = {darkname, flatname, badpixname, nlname};
+    IMGID  imgcal[4];
+    uint64_t calcnt0[4];
+    for(int i = 0; i < 4; i++)
+    {
+        imgcal[i] = detcalib_resolve(calname[i]);
+        calcnt0[i] = (imgcal[i].ID != -1) ? imgcal[i].md->cnt0 : 0;
+    }
+
+    // active and standby calibration tables
+    DETCALIB  caltab[2];
+    int       calindex = 0;
+    FUNC_CHECK_RETURN(detcalib_build(&caltab[calindex],
+                                     xsize,
+                                     ysize,
+                                     imgcal[0],
+                                     imgcal[1],
+                                     imgcal[2],
+                                     imgcal[3]));
+    *NBbadpix = caltab[calindex].NBbadpix;
+
+    IMGID imgout = stream_connect_create_2Df32(outimname, xsize, ysize);
+
+
+    // standby tables rebuild
+    pthread_t         buildthread;
+    int               buildrunning = 0;
+    DETCALIB_BUILDMSG buildmsg;
+
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        // swap in standby tables once rebuild is complete
+        //
+        int builddone = 0;
+        if(buildrunning == 1)
+        {
+            if(pthread_tryjoin_np(buildthread, NULL) == 0)
+            {
+                buildrunning = 0;
+                builddone    = 1;
+            }
+        }
+
+        // start rebuild if a calibration image was updated
+        // pending updates wait for running rebuild to complete
+        //
+        if(buildrunning == 0)
+        {
+            int update = 0;
+            if(*reload == 1)
+            {
+                for(int i = 0; i < 4; i++)
+                {
+                    imgcal[i] = detcalib_resolve(calname[i]);
+                }
+                *reload = 0;
+                update  = 1;
+            }
+            for(int i = 0; i < 4; i++)
+            {
+                if((imgcal[i].ID != -1) &&
+                        (imgcal[i].md->cnt0 != calcnt0[i]))
+                {
+                    update = 1;
+                }
+            }
+
+            if(builddone == 1)
+            {
+                if(buildmsg.status == RETURN_SUCCESS)
+                {
+                    detcalib_free(&caltab[calindex]);
+                    calindex  = 1 - calindex;
+                    *NBbadpix = caltab[calindex].NBbadpix;
+                    (*NBupdate)++;
+                    processinfo_WriteMessage_fmt(processinfo,
+                                                 "calibration update %lu",
+                                                 *NBupdate);
+                }
+            }
+
+            if(update == 1)
+            {
+                for(int i = 0; i < 4; i++)
+                {
+                    calcnt0[i] =
+                        (imgcal[i].ID != -1) ? imgcal[i].md->cnt0 : 0;
+                    buildmsg.imgcal[i] = imgcal[i];
+                }
+                buildmsg.cal   = &caltab[1 - calindex];
+                buildmsg.xsize = xsize;
+                buildmsg.ysize = ysize;
+                if(pthread_create(&buildthread,
+                                  NULL,
+                                  detcalib_build_thread,
+                                  &buildmsg) == 0)
+                {
+                    buildrunning = 1;
+                }
+                else
+                {
+                    // no helper thread : rebuild now, swap next frame
+                    PRINT_WARNING("pthread_create failed, rebuilding in loop");
+                    detcalib_build_thread(&buildmsg);
+                    if(buildmsg.status == RETURN_SUCCESS)
+                    {
+                        detcalib_free(&caltab[calindex]);
+                        calindex  = 1 - calindex;
+                        *NBbadpix = caltab[calindex].NBbadpix;
+                        (*NBupdate)++;
+                    }
+                }
+            }
+        }
+
+        imgout.md->write = 1;
+        if(detcalib_apply(&caltab[calindex], imgin, 0, imgout.im->array.F) !=
+                RETURN_SUCCESS)
+        {
+            processinfo_error(processinfo, "calibration failed");
+            processloopOK = 0;
+        }
+        else
+        {
+            processinfo_update_output_stream(processinfo, imgout.ID);
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    if(buildrunning == 1)
+    {
+        pthread_join(buildthread, NULL);
+        if(buildmsg.status == RETURN_SUCCESS)
+        {
+            detcalib_free(&caltab[1 - calindex]);
+        }
+    }
+    detcalib_free(&caltab[calindex]);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+// Register function in CLI
+errno_t CLIADDCMD_img_reduce__detcalib()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,49 @@
+/** @file detcalib.h
+ */
+
+#ifndef _IMGREDUCE_DETCALIB_H
+#define _IMGREDUCE_DETCALIB_H
+
+// detector calibration tables, one instance per pipeline
+// bad pixel i is replaced by sum of coeff[k] x pix[opindex[k]],
+// k = opstart[i] .. opstart[i+1]-1, all inputs are good pixels
+//
+typedef struct
+{
+    uint32_t xsize;
+    uint32_t ysize;
+    uint64_t xysize;
+
+    float *dark; // subtracted from raw frame
+    float *gain; // 1/flat, 0 for bad pixels
+
+    // nonlinearity : v -> v * (1 + c[0] v + c[1] v^2 + ...)
+    uint32_t NBnlcoeff;
+    float   *nlcoeff; // [NBnlcoeff x xysize]
+
+    uint64_t  NBbadpix;
+    uint32_t *badpixindex;
+    uint64_t *opstart; // [NBbadpix+1]
+    uint32_t *opindex;
+    float    *opcoeff;
+
+} DETCALIB;
+
+errno_t detcalib_build(DETCALIB *cal,
+                       uint32_t  xsize,
+                       uint32_t  ysize,
+                       IMGID     imgdark,
+                       IMGID     imgflat,
+                       IMGID     imgbadpix,
+                       IMGID     imgnl);
+
+errno_t detcalib_free(DETCALIB *cal);
+
+errno_t detcalib_apply(const DETCALIB *cal,
+                       IMGID           imgin,
+                       uint64_t        frameoffset,
+                       float          *out);
+
+errno_t CLIADDCMD_img_reduce__detcalib();
+
+#endif
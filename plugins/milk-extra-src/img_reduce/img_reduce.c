@@ -42,6 +42,7 @@
 #include "CommandLineInterface/CLIcore.h"
 
 #include "COREMOD_arith/COREMOD_arith.h"
+#include "COREMOD_arith/image_axisreduce.h"
 #include "COREMOD_iofits/COREMOD_iofits.h"
 #include "COREMOD_memory/COREMOD_memory.h"
 
@@ -50,6 +51,8 @@
 
 #include "img_reduce/img_reduce.h"
 
+#include "detcalib.h"
+
 #ifdef _OPENMP
 #include <omp.h>
 #define OMP_NELEMENT_LIMIT 1000000
@@ -60,15 +63,6 @@
  *
  */
 
-int    badpixclean_init = 0;
-long   badpixclean_NBop;
-long  *badpixclean_array_indexin;
-long  *badpixclean_array_indexout;
-float *badpixclean_array_coeff;
-
-long  badpixclean_NBbadpix;
-long *badpixclean_indexlist;
-
 /* ================================================================== */
 /* ================================================================== */
 /*            INITIALIZE LIBRARY                                      */
@@ -227,6 +221,8 @@ static errno_t init_module_CLI()
                        "imgcubeprocess",
                        "int IMG_REDUCE_cubeprocess(const char *IDin_name)");
 
+    CLIADDCMD_img_reduce__detcalib();
+
     // add atexit functions here
 
     return RETURN_SUCCESS;
@@ -238,47 +234,51 @@ static errno_t init_module_CLI()
 
 imageID IMG_REDUCE_cubesimplestat(const char *IDin_name)
 {
-    imageID IDin;
-    long    xsize, ysize, zsize;
-    long    xysize;
-    long    ii, kk;
-    long    offset;
-    double  tmpf;
+    imageID IDave, IDrms;
 
-    long IDave, IDrms;
+    IMGID imgin = mkIMGID_from_name(IDin_name);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
 
-    IDin = image_ID(IDin_name);
-
-    xsize = data.image[IDin].md[0].size[0];
-    ysize = data.image[IDin].md[0].size[1];
-    zsize = data.image[IDin].md[0].size[2];
-
-    xysize = xsize * ysize;
+    uint32_t xsize  = imgin.md->size[0];
+    uint32_t ysize  = imgin.md->size[1];
+    uint64_t xysize = (uint64_t) xsize * ysize;
 
     create_2Dimage_ID("c_ave", xsize, ysize, &IDave);
     create_2Dimage_ID("c_rms", xsize, ysize, &IDrms);
 
-    for(kk = 0; kk < zsize; kk++)
+    // mean and standard deviation along z, single pass
+    double *outarray[IMAXISREDUCE_NBOP] = {NULL};
+    outarray[1] = (double *) malloc(sizeof(double) * xysize);
+    outarray[6] = (double *) malloc(sizeof(double) * xysize);
+    if((outarray[1] == NULL) || (outarray[6] == NULL))
     {
-        offset = kk * xysize;
-        for(ii = 0; ii < xysize; ii++)
-        {
-            tmpf = data.image[IDin].array.F[offset + ii];
-            data.image[IDave].array.F[ii] += tmpf;
-            data.image[IDrms].array.F[ii] += tmpf * tmpf;
-        }
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    if(image_axisreduce_array(imgin,
+                              2,
+                              2,
+                              NULL,
+                              IMAXISREDUCE_MEAN | IMAXISREDUCE_STD,
+                              outarray) != RETURN_SUCCESS)
+    {
+        PRINT_ERROR("cannot reduce %s", IDin_name);
+        free(outarray[1]);
+        free(outarray[6]);
+        return -1;
     }
 
-    for(ii = 0; ii < xysize; ii++)
+    for(uint64_t ii = 0; ii < xysize; ii++)
     {
-        data.image[IDave].array.F[ii] /= zsize;
-        data.image[IDrms].array.F[ii] /= zsize;
-        data.image[IDrms].array.F[ii] =
-            sqrt(data.image[IDrms].array.F[ii] -
-                 data.image[IDave].array.F[ii] * data.image[IDave].array.F[ii]);
+        data.image[IDave].array.F[ii] = outarray[1][ii];
+        data.image[IDrms].array.F[ii] = outarray[6][ii];
     }
 
-    return IDin;
+    free(outarray[1]);
+    free(outarray[6]);
+
+    return imgin.ID;
 }
 
 /// removes bad pixels in cube
@@ -400,274 +400,81 @@ errno_t clean_bad_pix(const char *IDin_name, const char *IDbadpix_name)
     return RETURN_SUCCESS;
 }
 
-// pre-compute operations to clean bad pixels
-long IMG_REDUCE_cleanbadpix_fast_precompute(const char *IDmask_name)
-{
-    long NBop;
-    long IDbadpix;
-    long xsize, ysize;
-    long xysize;
-    long ii, jj;
-    long ii1, jj1;
-    long k;
-    long distmax;
-    long NBnearbypix;
-    long bpcnt;
-
-    long  *nearbypix_array_index;
-    float *nearbypix_array_dist2;
-    float *nearbypix_array_coeff;
-
-    float coefftot;
-
-    printf("Pre-computing bad pixel compensation operations\n");
-    fflush(stdout);
-
-    IDbadpix = image_ID(IDmask_name);
-    xsize    = data.image[IDbadpix].md[0].size[0];
-    ysize    = data.image[IDbadpix].md[0].size[1];
-
-    xysize = xsize * ysize;
-
-    nearbypix_array_index = (long *) malloc(sizeof(long) * xysize);
-    if(nearbypix_array_index == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    nearbypix_array_dist2 = (float *) malloc(sizeof(float) * xysize);
-    if(nearbypix_array_dist2 == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    nearbypix_array_coeff = (float *) malloc(sizeof(float) * xysize);
-    if(nearbypix_array_coeff == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    badpixclean_init = 1;
-
-    badpixclean_indexlist = (long *) malloc(sizeof(long) * xysize);
-    if(badpixclean_indexlist == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    k = 0;
-    for(ii = 0; ii < xysize; ii++)
-    {
-        if(data.image[IDbadpix].array.F[ii] > 0.5)
-        {
-            badpixclean_indexlist[k] = ii;
-            k++;
-        }
-    }
-
-    badpixclean_NBbadpix = k;
-
-    badpixclean_array_indexin = (long *) malloc(sizeof(long) * xysize);
-    if(badpixclean_array_indexin == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    badpixclean_array_indexout = (long *) malloc(sizeof(long) * xysize);
-    if(badpixclean_array_indexout == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    badpixclean_array_coeff = (float *) malloc(sizeof(float) * xysize);
-    if(badpixclean_array_coeff == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    printf("Computing operations...\n");
-    fflush(stdout);
-    NBop  = 0;
-    bpcnt = 0;
-
-    for(ii = 0; ii < xsize; ii++)
-        for(jj = 0; jj < ysize; jj++)
-        {
-            if(data.image[IDbadpix].array.F[jj * xsize + ii] > 0.5)
-            {
-                // fill up array of nearby pixels
-                k       = 0;
-                distmax = 1;
-                while(k < 4)
-                {
-                    k        = 0;
-                    coefftot = 0.0;
-                    for(ii1 = ii - distmax; ii1 < ii + distmax + 1; ii1++)
-                        for(jj1 = jj - distmax; jj1 < jj + distmax + 1; jj1++)
-                        {
-                            if((ii1 > -1) && (ii1 < xsize) && (jj1 > -1) &&
-                                    (jj1 < ysize) &&
-                                    (data.image[IDbadpix]
-                                     .array.F[jj1 * xsize + ii1] < 0.5))
-                            {
-                                if((ii1 != ii) || (jj1 != jj))
-                                {
-                                    nearbypix_array_index[k] =
-                                        (long)(jj1 * xsize + ii1);
-                                    nearbypix_array_dist2[k] =
-                                        (float)(1.0 * (ii1 - ii) * (ii1 - ii) +
-                                                1.0 * (jj1 - jj) * (jj1 - jj));
-                                    nearbypix_array_coeff[k] =
-                                        pow(1.0 / nearbypix_array_dist2[k],
-                                            2.0);
-                                    coefftot += nearbypix_array_coeff[k];
-                                    k++;
-                                    if(k > xysize - 1)
-                                    {
-                                        printf(
-                                            "ERROR: too many nearby pixels\n");
-                                        exit(0);
-                                    }
-                                }
-                            }
-                        }
-                    distmax++;
-                }
-                NBnearbypix = k;
-                //      printf("%ld  distmax = %ld  -> k = %ld / %ld\n", bpcnt, distmax, NBnearbypix, xysize);
-                //    fflush(stdout);
-
-                if(NBnearbypix > xysize)
-                {
-                    printf("ERROR: NBnearbypix>xysize\n");
-                    exit(0);
-                }
-
-                for(k = 0; k < NBnearbypix; k++)
-                {
-                    nearbypix_array_coeff[k] /= coefftot;
-
-                    badpixclean_array_indexin[NBop]  = nearbypix_array_index[k];
-                    badpixclean_array_indexout[NBop] = jj * xsize + ii;
-                    badpixclean_array_coeff[NBop]    = nearbypix_array_coeff[k];
-                    NBop++;
-
-                    if(NBop > xysize - 1)
-                    {
-                        printf(
-                            "ERROR: TOO MANY BAD PIXELS .... sorry... you need "
-                            "a better detector.\n");
-                        exit(0);
-                    }
-                }
-
-                bpcnt++;
-            }
-        }
-    printf("%ld bad pixels\n", bpcnt);
-    printf("%ld / %ld  operations\n", NBop, xysize);
-
-    printf("free nearbypix_array_index ...\n");
-    fflush(stdout);
-    free(nearbypix_array_index);
-
-    printf("free nearbypix_array_dist2 ...\n");
-    fflush(stdout);
-    free(nearbypix_array_dist2);
-
-    printf("free nearbypix_array_coeff ...\n");
-    fflush(stdout);
-    free(nearbypix_array_coeff);
-
-    return (NBop);
-}
-
+// remove bad pixels, subtract "dark" image if it exists
+// bad pixel tables are built per call, see detcalib.c
 imageID IMG_REDUCE_cleanbadpix_fast(const char *IDname,
                                     const char *IDbadpix_name,
                                     const char *IDoutname,
                                     int         streamMode)
 {
-    imageID   ID;
-    uint32_t *sizearray;
-    long      k;
-    long      xysize, zsize;
-    imageID   IDout;
-    imageID   IDdark;
-    long      ii, kk;
-    int       naxis;
-
-    ID = image_ID(IDname);
-
-    sizearray = (uint32_t *) malloc(sizeof(uint32_t) * 3);
-    if(sizearray == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
+    IMGID imgin = mkIMGID_from_name(IDname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    IMGID imgbadpix = mkIMGID_from_name(IDbadpix_name);
+    resolveIMGID(&imgbadpix, ERRMODE_ABORT);
 
-    sizearray[0] = data.image[ID].md[0].size[0];
-    sizearray[1] = data.image[ID].md[0].size[1];
-    naxis        = 2;
-    if(data.image[ID].md[0].naxis == 3)
+    IMGID imgdark = mkIMGID_from_name("dark"); // use if it exists
+    resolveIMGID(&imgdark, ERRMODE_NULL);
+
+    IMGID imgnone = mkIMGID_from_name("");
+    imgnone.ID    = -1;
+
+    uint32_t sizearray[3];
+    sizearray[0] = imgin.md->size[0];
+    sizearray[1] = imgin.md->size[1];
+    sizearray[2] = 1;
+    int naxis    = 2;
+    if(imgin.md->naxis == 3)
     {
-        sizearray[2] = data.image[ID].md[0].size[2];
-        zsize        = sizearray[2];
+        sizearray[2] = imgin.md->size[2];
         naxis        = 3;
     }
-    else
+    uint64_t xysize = (uint64_t) sizearray[0] * sizearray[1];
+    uint32_t zsize  = sizearray[2];
+
+    // input datatypes handled by detcalib_apply
+    switch(imgin.md->datatype)
     {
-        zsize = 1;
+        case _DATATYPE_FLOAT:
+        case _DATATYPE_UINT16:
+        case _DATATYPE_INT16:
+        case _DATATYPE_UINT32:
+        case _DATATYPE_INT32:
+            break;
+        default:
+            PRINT_ERROR("%s : unsupported input datatype %d",
+                        IDname,
+                        imgin.md->datatype);
+            return -1;
     }
 
-    xysize = sizearray[0] * sizearray[1];
-
-    IDdark = image_ID("dark"); // use if it exists
-    list_image_ID();
-
-    IDout = image_ID(IDoutname);
+    imageID IDout = image_ID(IDoutname);
     if(IDout == -1)
     {
         printf("Creating output image\n");
         fflush(stdout);
-        if(streamMode == 1)
-        {
-            create_image_ID(IDoutname,
-                            naxis,
-                            sizearray,
-                            _DATATYPE_FLOAT,
-                            1,
-                            0,
-                            0,
-                            &IDout);
-        }
-        else
-        {
-            create_image_ID(IDoutname,
-                            naxis,
-                            sizearray,
-                            _DATATYPE_FLOAT,
-                            0,
-                            0,
-                            0,
-                            &IDout);
-        }
-    }
-    if(streamMode == 1)
-    {
+        create_image_ID(IDoutname,
+                        naxis,
+                        sizearray,
+                        _DATATYPE_FLOAT,
+                        (streamMode == 1) ? 1 : 0,
+                        0,
+                        0,
+                        &IDout);
     }
 
-    if(badpixclean_init == 0)
+    DETCALIB cal;
+    if(detcalib_build(&cal,
+                      sizearray[0],
+                      sizearray[1],
+                      imgdark,
+                      imgnone,
+                      imgbadpix,
+                      imgnone) != RETURN_SUCCESS)
     {
-        badpixclean_NBop =
-            IMG_REDUCE_cleanbadpix_fast_precompute(IDbadpix_name);
+        return -1;
     }
+    printf("%lu bad pixels\n", cal.NBbadpix);
 
     int OKloop = 1;
     while(OKloop == 1)
@@ -676,9 +483,9 @@ imageID IMG_REDUCE_cleanbadpix_fast(const char *IDname,
         {
             printf("Waiting for incoming image ... \n");
             fflush(stdout);
-            if(data.image[ID].md[0].sem > 0)
+            if(imgin.md->sem > 0)
             {
-                ImageStreamIO_semwait(data.image+ID, 0);
+                ImageStreamIO_semwait(imgin.im, 0);
             }
             else
             {
@@ -694,36 +501,18 @@ imageID IMG_REDUCE_cleanbadpix_fast(const char *IDname,
 
         data.image[IDout].md[0].write = 1;
 
-        memcpy(data.image[IDout].array.F,
-               data.image[ID].array.F,
-               sizeof(float) * xysize * zsize);
-
-        for(kk = 0; kk < zsize; kk++)
+        for(uint32_t kk = 0; kk < zsize; kk++)
         {
-            if(IDdark != -1)
-                for(ii = 0; ii < xysize; ii++)
-                {
-                    data.image[IDout].array.F[kk * xysize + ii] -=
-                        data.image[IDdark].array.F[ii];
-                }
-
-            for(k = 0; k < badpixclean_NBbadpix; k++)
-            {
-                data.image[IDout]
-                .array.F[kk * xysize + badpixclean_indexlist[k]] = 0.0;
-            }
-
-            for(k = 0; k < badpixclean_NBop; k++)
+            if(detcalib_apply(&cal,
+                              imgin,
+                              kk * xysize,
+                              data.image[IDout].array.F + kk * xysize) !=
+                    RETURN_SUCCESS)
             {
-                //    printf("Operation %ld / %ld    %ld x %f -> %ld", k, badpixclean_NBop, badpixclean_array_indexin[k], badpixclean_array_coeff[k], badpixclean_array_indexout[k]);
-                //   fflush(stdout);
-                data.image[IDout]
-                .array.F[kk * xysize + badpixclean_array_indexout[k]] +=
-                    badpixclean_array_coeff[k] *
-                    data.image[IDout]
-                    .array.F[kk * xysize + badpixclean_array_indexin[k]];
-                //  printf("\n");
-                //  fflush(stdout);
+                // frame incomplete : do not publish
+                data.image[IDout].md[0].write = 0;
+                detcalib_free(&cal);
+                return -1;
             }
         }
 
@@ -731,14 +520,14 @@ imageID IMG_REDUCE_cleanbadpix_fast(const char *IDname,
         {
             if(data.image[IDout].md[0].sem > 0)
             {
-                ImageStreamIO_sempost(data.image+IDout, 0);
+                ImageStreamIO_sempost(data.image + IDout, 0);
             }
         }
         data.image[IDout].md[0].write = 0;
         data.image[IDout].md[0].cnt0++;
     }
 
-    free(sizearray);
+    detcalib_free(&cal);
 
     return IDout;
 }
@@ -5,6 +5,7 @@
 
 #include "CommandLineInterface/CLIcore.h"
 
+#include "COREMOD_arith/image_axisreduce.h"
 #include "COREMOD_memory/COREMOD_memory.h"
 
 
@@ -72,9 +73,7 @@ imageID info_cubestats(const char *ID_name,
     float    min, max, tot, tot2;
     uint64_t xysize;
     FILE    *fp;
-    int      init = 0;
     float    mtot;
-    float    val;
 
     int    COMPUTE_CORR = 1;
     long   kcmax        = 100;
@@ -92,41 +91,60 @@ imageID info_cubestats(const char *ID_name,
 
     xysize = data.image[ID].md[0].size[0] * data.image[ID].md[0].size[1];
 
+    // binary mask as reduction weight
+    float *maskw = (float *) malloc(sizeof(float) * xysize);
+    if(maskw == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
     mtot = 0.0;
     for(unsigned long ii = 0; ii < xysize; ii++)
     {
         mtot += data.image[IDm].array.F[ii];
+        maskw[ii] = (data.image[IDm].array.F[ii] > 0.5) ? 1.0 : 0.0;
     }
 
-    fp = fopen(outfname, "w");
-    for(unsigned long kk = 0; kk < data.image[ID].md[0].size[2]; kk++)
+    // per-slice stats, single pass over cube
+    uint32_t zsize = data.image[ID].md[0].size[2];
+    double  *outarray[IMAXISREDUCE_NBOP] = {NULL};
+    for(int op = 0; op < 5; op++)
     {
-        init = 0;
-        tot  = 0.0;
-        tot2 = 0.0;
-        for(unsigned long ii = 0; ii < xysize; ii++)
+        if(op == 1)
         {
-            if(data.image[IDm].array.F[ii] > 0.5)
-            {
-                val = data.image[ID].array.F[kk * xysize + ii];
-                if(init == 0)
-                {
-                    init = 1;
-                    min  = val;
-                    max  = val;
-                }
-                if(val > max)
-                {
-                    max = val;
-                }
-                if(val < min)
-                {
-                    min = val;
-                }
-                tot += val;
-                tot2 += val * val;
-            }
+            continue;
+        }
+        outarray[op] = (double *) malloc(sizeof(double) * zsize);
+        if(outarray[op] == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
         }
+    }
+    if(image_axisreduce_array(mkIMGID_from_name(ID_name),
+                              0,
+                              1,
+                              maskw,
+                              IMAXISREDUCE_MIN | IMAXISREDUCE_MAX |
+                              IMAXISREDUCE_SUM | IMAXISREDUCE_SUMSQ,
+                              outarray) != RETURN_SUCCESS)
+    {
+        PRINT_ERROR("cannot reduce %s", ID_name);
+        free(outarray[0]);
+        free(outarray[2]);
+        free(outarray[3]);
+        free(outarray[4]);
+        free(maskw);
+        return -1;
+    }
+
+    fp = fopen(outfname, "w");
+    for(unsigned long kk = 0; kk < zsize; kk++)
+    {
+        min  = outarray[2][kk];
+        max  = outarray[3][kk];
+        tot  = outarray[0][kk];
+        tot2 = outarray[4][kk];
         fprintf(fp,
                 "%5ld  %20f  %20f  %20f  %20f  %20f  %20f\n",
                 kk,
@@ -139,6 +157,12 @@ imageID info_cubestats(const char *ID_name,
     }
     fclose(fp);
 
+    free(outarray[0]);
+    free(outarray[2]);
+    free(outarray[3]);
+    free(outarray[4]);
+    free(maskw);
+
     if(COMPUTE_CORR == 1)
     {
         fp = fopen("corr.txt", "w");
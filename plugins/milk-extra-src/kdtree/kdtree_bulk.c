@@ -0,0 +1,176 @@
+/**
+ * @file    kdtree_bulk.c
+ * @brief   Bulk-loaded implicit kd-tree with fixed-k nearest neighbor queries
+ *
+ * Points are copied once into a single arena and reordered by recursive
+ * median splits. Queries write into caller-provided buffers and do not
+ * allocate, so that batched queries can run concurrently.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "kdtree_bulk.h"
+
+// batched queries are multi-threaded above this number of query points
+#define KDTREE_BULK_OMP_NBQLIMIT 1000
+
+#define KDTB_T   double
+#define KDTB_SFX d
+#include "kdtree_bulk_impl.h"
+#undef KDTB_T
+#undef KDTB_SFX
+
+#define KDTB_T   float
+#define KDTB_SFX f
+#include "kdtree_bulk_impl.h"
+#undef KDTB_T
+#undef KDTB_SFX
+
+// arena sections are aligned to this size [byte]
+#define KDTREE_BULK_ALIGN 64
+
+static size_t kdtree_bulk_alignsize(size_t size)
+{
+    return ((size + KDTREE_BULK_ALIGN - 1) / KDTREE_BULK_ALIGN) *
+           KDTREE_BULK_ALIGN;
+}
+
+static KDTREE_BULK *
+kdtree_bulk_alloc(long NBpts, int dim, int datatype, size_t possize)
+{
+    if((NBpts < 1) || (dim < 1) || (dim > 255))
+    {
+        return NULL;
+    }
+
+    KDTREE_BULK *tree = (KDTREE_BULK *) malloc(sizeof(KDTREE_BULK));
+    if(tree == NULL)
+    {
+        return NULL;
+    }
+
+    size_t sizepos   = kdtree_bulk_alignsize(possize * NBpts * dim);
+    size_t sizeindex = kdtree_bulk_alignsize(sizeof(long) * NBpts);
+    size_t sizesplit = kdtree_bulk_alignsize(sizeof(uint8_t) * NBpts);
+
+    if(posix_memalign(&tree->arena,
+                      KDTREE_BULK_ALIGN,
+                      sizepos + sizeindex + sizesplit) != 0)
+    {
+        free(tree);
+        return NULL;
+    }
+
+    tree->dim      = dim;
+    tree->NBpts    = NBpts;
+    tree->datatype = datatype;
+    tree->posD     = NULL;
+    tree->posF     = NULL;
+    tree->index    = (long *)((char *) tree->arena + sizepos);
+    tree->splitdim = (uint8_t *)((char *) tree->arena + sizepos + sizeindex);
+
+    for(long i = 0; i < NBpts; i++)
+    {
+        tree->index[i] = i;
+    }
+
+    return tree;
+}
+
+KDTREE_BULK *kdtree_bulk_create(const double *pos, long NBpts, int dim)
+{
+    KDTREE_BULK *tree =
+        kdtree_bulk_alloc(NBpts, dim, KDTREE_BULK_DOUBLE, sizeof(double));
+    if(tree == NULL)
+    {
+        return NULL;
+    }
+
+    tree->posD = (double *) tree->arena;
+    memcpy(tree->posD, pos, sizeof(double) * NBpts * dim);
+    kdtb_build_d(tree->posD, tree->index, tree->splitdim, dim, 0, NBpts);
+
+    return tree;
+}
+
+KDTREE_BULK *kdtree_bulk_createf(const float *pos, long NBpts, int dim)
+{
+    KDTREE_BULK *tree =
+        kdtree_bulk_alloc(NBpts, dim, KDTREE_BULK_FLOAT, sizeof(float));
+    if(tree == NULL)
+    {
+        return NULL;
+    }
+
+    tree->posF = (float *) tree->arena;
+    memcpy(tree->posF, pos, sizeof(float) * NBpts * dim);
+    kdtb_build_f(tree->posF, tree->index, tree->splitdim, dim, 0, NBpts);
+
+    return tree;
+}
+
+void kdtree_bulk_free(KDTREE_BULK *tree)
+{
+    if(tree != NULL)
+    {
+        free(tree->arena);
+        free(tree);
+    }
+}
+
+int kdtree_bulk_knn(const KDTREE_BULK *tree,
+                    const double      *pt,
+                    int                k,
+                    long              *nnindex,
+                    double            *nndist2)
+{
+    if(tree->datatype != KDTREE_BULK_DOUBLE)
+    {
+        return -1;
+    }
+    return kdtb_knn_d(tree, tree->posD, pt, k, nnindex, nndist2);
+}
+
+int kdtree_bulk_knnf(const KDTREE_BULK *tree,
+                     const float       *pt,
+                     int                k,
+                     long              *nnindex,
+                     float             *nndist2)
+{
+    if(tree->datatype != KDTREE_BULK_FLOAT)
+    {
+        return -1;
+    }
+    return kdtb_knn_f(tree, tree->posF, pt, k, nnindex, nndist2);
+}
+
+int kdtree_bulk_knn_batch(const KDTREE_BULK *tree,
+                          const double      *pts,
+                          long               NBq,
+                          int                k,
+                          long              *nnindex,
+                          double            *nndist2)
+{
+    if(tree->datatype != KDTREE_BULK_DOUBLE)
+    {
+        return -1;
+    }
+    kdtb_knn_batch_d(tree, tree->posD, pts, NBq, k, nnindex, nndist2);
+    return 0;
+}
+
+int kdtree_bulk_knn_batchf(const KDTREE_BULK *tree,
+                           const float       *pts,
+                           long               NBq,
+                           int                k,
+                           long              *nnindex,
+                           float             *nndist2)
+{
+    if(tree->datatype != KDTREE_BULK_FLOAT)
+    {
+        return -1;
+    }
+    kdtb_knn_batch_f(tree, tree->posF, pts, NBq, k, nnindex, nndist2);
+    return 0;
+}
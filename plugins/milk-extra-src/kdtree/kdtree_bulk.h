@@ -0,0 +1,90 @@
+/**
+ * @file    kdtree_bulk.h
+ * @brief   Bulk-loaded implicit kd-tree with fixed-k nearest neighbor queries
+ *
+ * Complements the incremental kd_* API of kdtree.h for static point sets.
+ * The tree is built once by median splits and stored as an implicit array
+ * in a single allocation : no per-node or per-result allocation.
+ */
+
+#ifndef _KDTREE_BULK_H_
+#define _KDTREE_BULK_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define KDTREE_BULK_DOUBLE 1
+#define KDTREE_BULK_FLOAT  2
+
+typedef struct
+{
+    int  dim;      // number of dimensions
+    long NBpts;    // number of points
+    int  datatype; // KDTREE_BULK_DOUBLE or KDTREE_BULK_FLOAT
+
+    void *arena; // single allocation holding arrays below
+
+    // point coordinates in tree order, NBpts x dim
+    // only one is non-NULL, depending on datatype
+    double *posD;
+    float  *posF;
+
+    long    *index;    // input index of point, tree order
+    uint8_t *splitdim; // split dimension of node, tree order
+
+} KDTREE_BULK;
+
+/* build tree from NBpts points of dimension dim, pos is NBpts x dim */
+KDTREE_BULK *kdtree_bulk_create(const double *pos, long NBpts, int dim);
+KDTREE_BULK *kdtree_bulk_createf(const float *pos, long NBpts, int dim);
+
+void kdtree_bulk_free(KDTREE_BULK *tree);
+
+/* k nearest neighbors of pt
+ *
+ * Input indices and square distances are written to caller buffers of
+ * k elements, sorted by increasing distance.
+ * Returns number of neighbors found (< k if tree has less than k points),
+ * or -1 if datatype does not match tree.
+ */
+int kdtree_bulk_knn(const KDTREE_BULK *tree,
+                    const double      *pt,
+                    int                k,
+                    long              *nnindex,
+                    double            *nndist2);
+
+int kdtree_bulk_knnf(const KDTREE_BULK *tree,
+                     const float       *pt,
+                     int                k,
+                     long              *nnindex,
+                     float             *nndist2);
+
+/* k nearest neighbors of NBq points, pts is NBq x dim
+ *
+ * Output buffers hold NBq x k elements. Unused entries have index -1.
+ * Queries are distributed across threads.
+ * Returns 0, or -1 if datatype does not match tree.
+ */
+int kdtree_bulk_knn_batch(const KDTREE_BULK *tree,
+                          const double      *pts,
+                          long               NBq,
+                          int                k,
+                          long              *nnindex,
+                          double            *nndist2);
+
+int kdtree_bulk_knn_batchf(const KDTREE_BULK *tree,
+                           const float       *pts,
+                           long               NBq,
+                           int                k,
+                           long              *nnindex,
+                           float             *nndist2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _KDTREE_BULK_H_ */
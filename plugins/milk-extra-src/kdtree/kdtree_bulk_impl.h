@@ -0,0 +1,360 @@
+/**
+ * @file    kdtree_bulk_impl.h
+ * @brief   Type-generic kd-tree build and query, included by kdtree_bulk.c
+ *
+ * Included once per coordinate type, with KDTB_T (coordinate type) and
+ * KDTB_SFX (function name suffix) defined.
+ *
+ * Tree layout : the node covering range [lo, hi) of the point arrays is the
+ * point at mid = lo + (hi-lo)/2, its children cover [lo, mid) and
+ * [mid+1, hi). No child pointers are stored.
+ */
+
+#define KDTB_CAT2(a, b) a##b
+#define KDTB_CAT(a, b)  KDTB_CAT2(a, b)
+#define KDTB_FN(name)   KDTB_CAT(name, KDTB_SFX)
+
+static inline void KDTB_FN(kdtb_swap_)(
+    KDTB_T *pos, long *index, int dim, long i, long j)
+{
+    for(int d = 0; d < dim; d++)
+    {
+        KDTB_T tmp       = pos[i * dim + d];
+        pos[i * dim + d] = pos[j * dim + d];
+        pos[j * dim + d] = tmp;
+    }
+    long tmpi = index[i];
+    index[i]  = index[j];
+    index[j]  = tmpi;
+}
+
+/**
+ * @brief Partial sort of [lo, hi) along axis so that element nth is in place
+ */
+static void KDTB_FN(kdtb_select_)(
+    KDTB_T *pos, long *index, int dim, int axis, long lo, long hi, long nth)
+{
+    hi--;
+    while(hi > lo)
+    {
+        // median of three pivot, moved to hi
+        long   mid = lo + (hi - lo) / 2;
+        KDTB_T a   = pos[lo * dim + axis];
+        KDTB_T b   = pos[mid * dim + axis];
+        KDTB_T c   = pos[hi * dim + axis];
+        long   pivi;
+        if((a < b) == (b < c))
+        {
+            pivi = mid;
+        }
+        else if((b < a) == (a < c))
+        {
+            pivi = lo;
+        }
+        else
+        {
+            pivi = hi;
+        }
+        KDTB_FN(kdtb_swap_)(pos, index, dim, pivi, hi);
+        KDTB_T pivot = pos[hi * dim + axis];
+
+        long store = lo;
+        for(long i = lo; i < hi; i++)
+        {
+            if(pos[i * dim + axis] < pivot)
+            {
+                KDTB_FN(kdtb_swap_)(pos, index, dim, i, store);
+                store++;
+            }
+        }
+        KDTB_FN(kdtb_swap_)(pos, index, dim, store, hi);
+
+        if(store == nth)
+        {
+            return;
+        }
+        if(nth < store)
+        {
+            hi = store - 1;
+        }
+        else
+        {
+            lo = store + 1;
+        }
+    }
+}
+
+/**
+ * @brief Recursive median-split build of range [lo, hi)
+ *
+ * Split axis is the dimension of largest extent.
+ */
+static void KDTB_FN(kdtb_build_)(
+    KDTB_T *pos, long *index, uint8_t *splitdim, int dim, long lo, long hi)
+{
+    if(hi - lo < 1)
+    {
+        return;
+    }
+
+    long mid = lo + (hi - lo) / 2;
+    if(hi - lo == 1)
+    {
+        splitdim[mid] = 0;
+        return;
+    }
+
+    int    axis      = 0;
+    KDTB_T maxextent = -1;
+    for(int d = 0; d < dim; d++)
+    {
+        KDTB_T vmin = pos[lo * dim + d];
+        KDTB_T vmax = vmin;
+        for(long i = lo + 1; i < hi; i++)
+        {
+            KDTB_T v = pos[i * dim + d];
+            if(v < vmin)
+            {
+                vmin = v;
+            }
+            if(v > vmax)
+            {
+                vmax = v;
+            }
+        }
+        if(vmax - vmin > maxextent)
+        {
+            maxextent = vmax - vmin;
+            axis      = d;
+        }
+    }
+
+    KDTB_FN(kdtb_select_)(pos, index, dim, axis, lo, hi, mid);
+    splitdim[mid] = (uint8_t) axis;
+
+    KDTB_FN(kdtb_build_)(pos, index, splitdim, dim, lo, mid);
+    KDTB_FN(kdtb_build_)(pos, index, splitdim, dim, mid + 1, hi);
+}
+
+// bounded max-heap of k nearest candidates, held in caller buffers
+typedef struct
+{
+    int     k;
+    int     n;
+    long   *index;
+    KDTB_T *dist2;
+} KDTB_FN(KDTB_HEAP_);
+
+static inline void KDTB_FN(kdtb_heap_push_)(
+    KDTB_FN(KDTB_HEAP_) *heap, KDTB_T dist2, long index)
+{
+    int i;
+
+    if(heap->n < heap->k)
+    {
+        // sift up
+        i = heap->n;
+        heap->n++;
+        while(i > 0)
+        {
+            int parent = (i - 1) / 2;
+            if(heap->dist2[parent] >= dist2)
+            {
+                break;
+            }
+            heap->dist2[i] = heap->dist2[parent];
+            heap->index[i] = heap->index[parent];
+            i              = parent;
+        }
+    }
+    else
+    {
+        if(dist2 >= heap->dist2[0])
+        {
+            return;
+        }
+        // replace root, sift down
+        i = 0;
+        while(1)
+        {
+            int child = 2 * i + 1;
+            if(child >= heap->n)
+            {
+                break;
+            }
+            if((child + 1 < heap->n) &&
+                    (heap->dist2[child + 1] > heap->dist2[child]))
+            {
+                child++;
+            }
+            if(heap->dist2[child] <= dist2)
+            {
+                break;
+            }
+            heap->dist2[i] = heap->dist2[child];
+            heap->index[i] = heap->index[child];
+            i              = child;
+        }
+    }
+    heap->dist2[i] = dist2;
+    heap->index[i] = index;
+}
+
+/**
+ * @brief Sort heap content by increasing distance, in place
+ */
+static void KDTB_FN(kdtb_heap_sort_)(KDTB_FN(KDTB_HEAP_) *heap)
+{
+    int n = heap->n;
+    while(heap->n > 1)
+    {
+        // move largest to end, reinsert last element
+        int    last    = heap->n - 1;
+        KDTB_T d2      = heap->dist2[last];
+        long   idx     = heap->index[last];
+        KDTB_T d2max   = heap->dist2[0];
+        long   idxmax  = heap->index[0];
+        heap->n        = last;
+        heap->dist2[0] = d2;
+        heap->index[0] = idx;
+
+        int i = 0;
+        while(1)
+        {
+            int child = 2 * i + 1;
+            if(child >= heap->n)
+            {
+                break;
+            }
+            if((child + 1 < heap->n) &&
+                    (heap->dist2[child + 1] > heap->dist2[child]))
+            {
+                child++;
+            }
+            if(heap->dist2[child] <= d2)
+            {
+                break;
+            }
+            heap->dist2[i] = heap->dist2[child];
+            heap->index[i] = heap->index[child];
+            i              = child;
+        }
+        heap->dist2[i] = d2;
+        heap->index[i] = idx;
+
+        heap->dist2[last] = d2max;
+        heap->index[last] = idxmax;
+    }
+    heap->n = n;
+}
+
+static void KDTB_FN(kdtb_search_)(const KDTB_T        *pos,
+                                   const long          *index,
+                                   const uint8_t       *splitdim,
+                                   int                  dim,
+                                   const KDTB_T        *pt,
+                                   long                 lo,
+                                   long                 hi,
+                                   KDTB_FN(KDTB_HEAP_) *heap)
+{
+    while(hi > lo)
+    {
+        long          mid = lo + (hi - lo) / 2;
+        const KDTB_T *p   = pos + mid * dim;
+
+        KDTB_T dist2 = 0;
+        for(int d = 0; d < dim; d++)
+        {
+            KDTB_T dv = pt[d] - p[d];
+            dist2 += dv * dv;
+        }
+        KDTB_FN(kdtb_heap_push_)(heap, dist2, index[mid]);
+
+        int    axis = splitdim[mid];
+        KDTB_T diff = pt[axis] - p[axis];
+
+        long nearlo, nearhi, farlo, farhi;
+        if(diff < 0)
+        {
+            nearlo = lo;
+            nearhi = mid;
+            farlo  = mid + 1;
+            farhi  = hi;
+        }
+        else
+        {
+            nearlo = mid + 1;
+            nearhi = hi;
+            farlo  = lo;
+            farhi  = mid;
+        }
+
+        KDTB_FN(kdtb_search_)(pos, index, splitdim, dim, pt, nearlo, nearhi, heap);
+
+        // far side only if splitting plane is closer than current k-th
+        if((heap->n == heap->k) && (diff * diff >= heap->dist2[0]))
+        {
+            return;
+        }
+        lo = farlo;
+        hi = farhi;
+    }
+}
+
+static int KDTB_FN(kdtb_knn_)(const KDTREE_BULK *tree,
+                              const KDTB_T      *pos,
+                              const KDTB_T      *pt,
+                              int                k,
+                              long              *nnindex,
+                              KDTB_T            *nndist2)
+{
+    KDTB_FN(KDTB_HEAP_) heap;
+    heap.k     = k;
+    heap.n     = 0;
+    heap.index = nnindex;
+    heap.dist2 = nndist2;
+
+    KDTB_FN(kdtb_search_)(pos,
+                          tree->index,
+                          tree->splitdim,
+                          tree->dim,
+                          pt,
+                          0,
+                          tree->NBpts,
+                          &heap);
+    KDTB_FN(kdtb_heap_sort_)(&heap);
+
+    for(int i = heap.n; i < k; i++)
+    {
+        nnindex[i] = -1;
+        nndist2[i] = 0;
+    }
+
+    return heap.n;
+}
+
+static void KDTB_FN(kdtb_knn_batch_)(const KDTREE_BULK *tree,
+                                     const KDTB_T      *pos,
+                                     const KDTB_T      *pts,
+                                     long               NBq,
+                                     int                k,
+                                     long              *nnindex,
+                                     KDTB_T            *nndist2)
+{
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 64) if (NBq > KDTREE_BULK_OMP_NBQLIMIT)
+#endif
+    for(long q = 0; q < NBq; q++)
+    {
+        KDTB_FN(kdtb_knn_)(tree,
+                           pos,
+                           pts + q * tree->dim,
+                           k,
+                           nnindex + q * k,
+                           nndist2 + q * k);
+    }
+}
+
+#undef KDTB_FN
+#undef KDTB_CAT
+#undef KDTB_CAT2
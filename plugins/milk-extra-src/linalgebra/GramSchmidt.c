@@ -6,6 +6,23 @@
 #include "COREMOD_tools/COREMOD_tools.h"
 
 #include "SGEMM.h"
+#include "GramSchmidt.h"
+
+
+// CPU mode: Use MKL if available
+// Otherwise use openBLAS
+//
+#ifdef HAVE_MKL
+#include "mkl.h"
+#include "mkl_lapacke.h"
+#define BLASLIB "IntelMKL"
+#else
+#ifdef HAVE_OPENBLAS
+#include <cblas.h>
+#include <lapacke.h>
+#define BLASLIB "OpenBLAS"
+#endif
+#endif
 
 
 static char *inmodes;
@@ -20,6 +37,8 @@ static long  fpi_auxmat;;
 static int32_t *GPUdevice;
 static long     fpi_GPUdevice;
 
+static float *orthoerr;
+
 
 
 static CLICMDARGDEF farg[] =
@@ -60,6 +79,15 @@ static CLICMDARGDEF farg[] =
         CLIARG_HIDDEN_DEFAULT,
         (void **) &GPUdevice,
         &fpi_GPUdevice
+    },
+    {
+        CLIARG_FLOAT32,
+        ".status.orthoerr",
+        "orthogonality error, max |QtQ-I|",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &orthoerr,
+        NULL
     }
 };
 
@@ -72,7 +100,12 @@ static CLICMDDATA CLIcmddata =
 // detailed help
 static errno_t help_function()
 {
-    printf("Run Gram-Schmodt process\n");
+    printf("Run Gram-Schmidt process\n");
+    printf("Output modes are orthogonal, not normalized : mode k is\n");
+    printf("input mode k minus its projection on previous modes\n");
+    printf("Computed by blocked Householder QR (LAPACK sgeqrf)\n");
+    printf("Optional aux matrix undergoes the same linear transform\n");
+    printf("Orthogonality error max|QtQ-I| is written to .status.orthoerr\n");
 
     return RETURN_SUCCESS;
 }
@@ -80,26 +113,33 @@ static errno_t help_function()
 
 
 
+/**
+ * @brief Orthogonalize modes, same result as Gram-Schmidt process
+ *
+ * Input modes A = Q R (Householder QR, blocked BLAS-3 in LAPACK).
+ * Output mode k is Q_k R_kk, which is input mode k minus its
+ * projection on modes 0..k-1.
+ * Aux matrix is co-transformed : aux <- aux R^-1 diag(R)
+ *
+ * If orthoerr is not NULL, max |Q^T Q - I| is written to it.
+ */
 errno_t GramSchmidt(
     IMGID imginm,
     IMGID *imgoutm,
     IMGID imgaux,
-    int GPUdev
+    int GPUdev,
+    float *orthoerr
 )
 {
     DEBUG_TRACE_FSTART();
 
+    (void) GPUdev;
+
     resolveIMGID(&imginm, ERRMODE_ABORT);
 
     resolveIMGID(&imgaux, ERRMODE_WARN);
 
 
-    // Compute cross product on input
-    //
-    //IMGID imginxp  = mkIMGID_from_name("_outxp");
-    //computeSGEMM(imginm, imginm, &imginxp, 1, 0, GPUdev);
-
-
     // Create output
     //
     imcreatelikewiseIMGID(
@@ -132,57 +172,140 @@ errno_t GramSchmidt(
 
     printf("xysize = %u, zsize = %u\n", xysize, zsize);
 
-    printf("\n");
-    for ( uint32_t kk=0; kk<zsize; kk++ )
+    if( zsize > xysize )
     {
-        printf("\rGS mode %6u / %6u     ", kk, zsize);
+        FUNC_RETURN_FAILURE("%u modes cannot be orthogonal in %u-dimension space",
+                            zsize, xysize);
+    }
+
+    float *matQ = imgoutm->im->array.F;
+    memcpy(matQ, imginm.im->array.F, sizeof(float)*xysize*zsize);
+
+    float *tau  = (float *) malloc(sizeof(float) * zsize);
+    float *matR = (float *) malloc(sizeof(float) * zsize * zsize);
+    float *matG = (float *) malloc(sizeof(float) * zsize * zsize);
+    if((tau == NULL) || (matR == NULL) || (matG == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+#ifdef HAVE_MKL
+    mkl_set_interface_layer(MKL_INTERFACE_ILP64);
+#endif
 
-        // initialization
-        memcpy( &imgoutm->im->array.F[kk*xysize], &imginm.im->array.F[kk*xysize], sizeof(float)*xysize);
+    // A = Q R
+    //
+    if(LAPACKE_sgeqrf(LAPACK_COL_MAJOR, xysize, zsize, matQ, xysize, tau) != 0)
+    {
+        FUNC_RETURN_FAILURE("LAPACKE_sgeqrf failed");
+    }
 
-        for ( uint32_t kk0 = 0; kk0 < kk; kk0++ )
+    // keep upper triangular R
+    for(uint32_t jj = 0; jj < zsize; jj++)
+    {
+        for(uint32_t ii = 0; ii < zsize; ii++)
         {
-            // cross-product
-            double xpval = 0.0;
+            matR[jj * zsize + ii] = (ii <= jj) ? matQ[(uint64_t) jj * xysize + ii] : 0.0;
+        }
+    }
 
-            // square sum v0
-            double sqrsum0 = 0.0;
+    if(LAPACKE_sorgqr(LAPACK_COL_MAJOR, xysize, zsize, zsize, matQ, xysize, tau) != 0)
+    {
+        FUNC_RETURN_FAILURE("LAPACKE_sorgqr failed");
+    }
 
-            // square sum v1
-            double sqrsum1= 0.0;
 
-            for( uint32_t ii=0; ii<xysize; ii++)
+    // Measure orthogonality error on normalized modes
+    //
+    cblas_ssyrk(CblasColMajor, CblasUpper, CblasTrans,
+                zsize, xysize, 1.0,
+                matQ, xysize,
+                0.0, matG, zsize);
+    float errmax = 0.0;
+    for(uint32_t jj = 0; jj < zsize; jj++)
+    {
+        for(uint32_t ii = 0; ii <= jj; ii++)
+        {
+            float err = matG[jj * zsize + ii];
+            if(ii == jj)
             {
-                float v0 = imgoutm->im->array.F[ kk0*xysize + ii];
-                float v1 = imgoutm->im->array.F[ kk*xysize + ii];
-
-                xpval += v0*v1;
-                sqrsum0 += v0*v0;
-                sqrsum1 += v1*v1;
+                err -= 1.0;
             }
+            if(fabs(err) > errmax)
+            {
+                errmax = fabs(err);
+            }
+        }
+    }
+    printf("orthogonality error max|QtQ-I| = %g\n", errmax);
+    if(orthoerr != NULL)
+    {
+        *orthoerr = errmax;
+    }
 
-            float vcoeff = xpval / sqrsum0;
-
-            //printf("  %5u  %5u   %f\n", kk, kk0, vcoeff);
 
-            for( uint32_t ii=0; ii<xysize; ii++)
+    // Linearly dependent modes come out (near) zero, as with Gram-Schmidt
+    //
+    {
+        float Rdiagmax = 0.0;
+        for(uint32_t kk = 0; kk < zsize; kk++)
+        {
+            if(fabs(matR[kk * zsize + kk]) > Rdiagmax)
             {
-                imgoutm->im->array.F[ kk*xysize + ii] -= vcoeff * imgoutm->im->array.F[ kk0*xysize + ii];
+                Rdiagmax = fabs(matR[kk * zsize + kk]);
             }
-
-            if ( imgaux.ID != -1)
+        }
+        long NBdegen = 0;
+        for(uint32_t kk = 0; kk < zsize; kk++)
+        {
+            if(fabs(matR[kk * zsize + kk]) < 1.0e-6 * Rdiagmax)
             {
-                for( uint32_t ii=0; ii<xysizeaux; ii++)
-                {
-                    imgaux.im->array.F[ kk*xysizeaux + ii] -= vcoeff * imgaux.im->array.F[ kk0*xysizeaux + ii];
-                }
+                NBdegen++;
             }
         }
+        if(NBdegen > 0)
+        {
+            PRINT_WARNING("%ld / %u modes are linearly dependent on previous modes",
+                          NBdegen, zsize);
+        }
     }
-    printf("\n");
 
 
-    list_image_ID();
+    // Output mode k = Q_k R_kk
+    //
+    for(uint32_t kk = 0; kk < zsize; kk++)
+    {
+        float Rkk = matR[kk * zsize + kk];
+        for(uint32_t ii = 0; ii < xysize; ii++)
+        {
+            matQ[(uint64_t) kk * xysize + ii] *= Rkk;
+        }
+    }
+
+
+    // Co-transform aux matrix
+    //
+    if ( imgaux.ID != -1)
+    {
+        cblas_strsm(CblasColMajor, CblasRight, CblasUpper, CblasNoTrans, CblasNonUnit,
+                    xysizeaux, zsize, 1.0,
+                    matR, zsize,
+                    imgaux.im->array.F, xysizeaux);
+
+        for(uint32_t kk = 0; kk < zsize; kk++)
+        {
+            float Rkk = matR[kk * zsize + kk];
+            for(uint32_t ii = 0; ii < xysizeaux; ii++)
+            {
+                imgaux.im->array.F[(uint64_t) kk * xysizeaux + ii] *= Rkk;
+            }
+        }
+    }
+
+    free(tau);
+    free(matR);
+    free(matG);
 
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
@@ -215,7 +338,7 @@ static errno_t compute_function()
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
     {
-        GramSchmidt(imginm, &imgoutm, imgaux, *GPUdevice);
+        GramSchmidt(imginm, &imgoutm, imgaux, *GPUdevice, orthoerr);
     }
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
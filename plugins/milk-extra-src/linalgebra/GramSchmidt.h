@@ -5,7 +5,9 @@
 errno_t GramSchmidt(
     IMGID imginm,
     IMGID *imgoutm,
-    int GPUdev
+    IMGID imgaux,
+    int GPUdev,
+    float *orthoerr
 );
 
 errno_t CLIADDCMD_linalgebra__GramSchmidt();
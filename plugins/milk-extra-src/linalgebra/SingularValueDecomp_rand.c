@@ -0,0 +1,700 @@
+/**
+ * @file SingularValueDecomp_rand.c
+ *
+ * Truncated SVD by randomized range finder
+ *
+ * Only the leading NBmode singular triplets are computed :
+ * the range of the input matrix is sampled by a random Gaussian
+ * block, refined by power iterations, and the SVD is performed
+ * on the small projected matrix.
+ * The input matrix is never squared (no ATA), so that the condition
+ * number is not squared either.
+ *
+ * Outputs are written in the same format as compSVD.
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "COREMOD_iofits/COREMOD_iofits.h"
+
+#include "CommandLineInterface/timeutils.h"
+
+#include "SingularValueDecomp.h"
+#include "SingularValueDecomp_rand.h"
+#include "SGEMM.h"
+
+
+
+
+
+// CPU mode: Use MKL if available
+// Otherwise use openBLAS
+//
+#ifdef HAVE_MKL
+#include "mkl.h"
+#include "mkl_lapacke.h"
+#define BLASLIB "IntelMKL"
+#else
+#ifdef HAVE_OPENBLAS
+#include <cblas.h>
+#include <lapacke.h>
+#define BLASLIB "OpenBLAS"
+#endif
+#endif
+
+
+
+
+static char *inM;
+static long  fpi_inM;
+
+static char *outU;
+static long  fpi_outU;
+
+static char *outS;
+static long  fpi_outS;
+
+static char *outV;
+static long  fpi_outV;
+
+// if V is 3D, set Vdim0 to its size[0]
+// otherwise leave at 0
+static uint32_t *Vdim0;
+static long   fpi_Vdim0;
+
+
+static float *svdlim;
+static long   fpi_svdlim;
+
+static uint32_t *NBmode;
+static long   fpi_NBmode;
+
+static uint32_t *NBoversample;
+static long   fpi_NBoversample;
+
+static uint32_t *NBpowiter;
+static long   fpi_NBpowiter;
+
+static uint64_t *compmode;
+static long     fpi_compmode;
+
+
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        // input
+        CLIARG_IMG,
+        ".inM",
+        "input matrix",
+        "inM",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inM,
+        &fpi_inM
+    },
+    {
+        // output U
+        CLIARG_STR,
+        ".outU",
+        "output U",
+        "outU",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outU,
+        &fpi_outU
+    },
+    {
+        CLIARG_STR,
+        ".outS",
+        "output singular values",
+        "outS",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outS,
+        &fpi_outS
+    },
+    {
+        // output V
+        CLIARG_STR,
+        ".outV",
+        "output V",
+        "outV",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outV,
+        &fpi_outV
+    },
+    {
+        CLIARG_UINT32,
+        ".Vdim0",
+        "first dimension of V if 3D, 0 if 2D",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &Vdim0,
+        &fpi_Vdim0
+    },
+    {
+        // Singular Value Decomposition limit
+        CLIARG_FLOAT32,
+        ".svdlim",
+        "SVD limit",
+        "0.01",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &svdlim,
+        &fpi_svdlim
+    },
+    {
+        CLIARG_UINT32,
+        ".NBmode",
+        "number of modes computed",
+        "100",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &NBmode,
+        &fpi_NBmode
+    },
+    {
+        CLIARG_UINT32,
+        ".NBoversample",
+        "oversampling: extra random vectors",
+        "10",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &NBoversample,
+        &fpi_NBoversample
+    },
+    {
+        CLIARG_UINT32,
+        ".NBpowiter",
+        "number of power iterations",
+        "2",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &NBpowiter,
+        &fpi_NBpowiter
+    },
+    {
+        // optional computations
+        CLIARG_UINT64,
+        ".compmode",
+        "flag: optional computations and checks",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &compmode,
+        &fpi_compmode
+    }
+};
+
+
+
+// Optional custom configuration setup.
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_inM].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+static errno_t customCONFcheck()
+{
+
+    if(data.fpsptr != NULL)
+    {
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static CLICMDDATA CLIcmddata =
+{
+    "compSVDrand", "compute truncated SVD, randomized", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Compute leading NBmode singular values and vectors\n");
+    printf("Randomized range finder with power iterations (CPU)\n");
+    printf("Output format is identical to compSVD\n");
+    printf("\n");
+    printf("Accuracy increases with .NBoversample and .NBpowiter\n");
+    printf("Modes below svdlim x largest singular value are discarded\n");
+    printf("\n");
+    printf("Optional computations and checks specified by bitmask flag .compmode :\n");
+    printf("bit dec  description\n");
+    printf(" 1    2  Compute pseudo-inverse, using svdlim for regularization\n");
+    printf("         Inverse stored as image psinv\n");
+    printf(" 2    4  Check pseudo-inverse: compute psinv x input product\n");
+    printf("         result stored as image psinvcheck\n");
+    printf(" 3    8  Reconstruct original image, stored as SVDinrec\n");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Gaussian random numbers, Box-Muller on xorshift64 sequence
+ *
+ * Fixed seed : result is reproducible
+ */
+static void fill_gaussian(float *array, uint64_t nelem)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    for(uint64_t ii = 0; ii < nelem; ii += 2)
+    {
+        double u[2];
+        for(int k = 0; k < 2; k++)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            u[k] = ((state >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+        }
+        double rad = sqrt(-2.0 * log(u[0]));
+        array[ii]  = rad * cos(2.0 * M_PI * u[1]);
+        if(ii + 1 < nelem)
+        {
+            array[ii + 1] = rad * sin(2.0 * M_PI * u[1]);
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Replace columns of mdim x ndim matrix by orthonormal basis of their span
+ */
+static errno_t orthonormalize_cols(float *mat, int mdim, int ndim, float *tau)
+{
+    DEBUG_TRACE_FSTART();
+
+    if(LAPACKE_sgeqrf(LAPACK_COL_MAJOR, mdim, ndim, mat, mdim, tau) != 0)
+    {
+        FUNC_RETURN_FAILURE("LAPACKE_sgeqrf failed");
+    }
+    if(LAPACKE_sorgqr(LAPACK_COL_MAJOR, mdim, ndim, ndim, mat, mdim, tau) != 0)
+    {
+        FUNC_RETURN_FAILURE("LAPACKE_sorgqr failed");
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Create output image, or re-create if last axis size does not match
+ */
+static errno_t create_svec_image(IMGID *img, IMGID imgtemplate)
+{
+    DEBUG_TRACE_FSTART();
+
+    if(img->ID != -1)
+    {
+        int match = (img->md->naxis == imgtemplate.naxis);
+        for(int ax = 0; ax < imgtemplate.naxis; ax++)
+        {
+            if(img->md->size[ax] != imgtemplate.size[ax])
+            {
+                match = 0;
+            }
+        }
+        if(match == 1)
+        {
+            DEBUG_TRACE_FEXIT();
+            return RETURN_SUCCESS;
+        }
+        delete_image(img, DELETE_IMAGE_ERRMODE_EXIT);
+    }
+
+    img->naxis = imgtemplate.naxis;
+    for(int ax = 0; ax < imgtemplate.naxis; ax++)
+    {
+        img->size[ax] = imgtemplate.size[ax];
+    }
+    img->datatype = _DATATYPE_FLOAT;
+    createimagefromIMGID(img);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Compute truncated SVD of indimM x indimN matrix
+ *
+ * Decompose matrix imgin as:
+ * imgU imgS imgV^T
+ *
+ * Using column-major indexing, as compute_SVD()
+ *
+ * Randomized range finder (Halko, Martinsson & Tropp 2011) :
+ * Y = (A A^T)^q A Omega, Q = orth(Y), B = Q^T A = Ub S V^T, U = Q Ub
+ */
+errno_t compute_SVD_randomized(
+    IMGID    imgin,
+    IMGID    imgU,
+    IMGID    imgS,
+    IMGID    imgV,
+    uint32_t Vdim0,
+    float    SVlimit,
+    uint32_t SVDNBmode,
+    uint32_t SVDNBoversample,
+    uint32_t SVDNBpowiter,
+    uint64_t compSVDmode
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+    resolveIMGID(&imgU, ERRMODE_NULL);
+    resolveIMGID(&imgS, ERRMODE_NULL);
+    resolveIMGID(&imgV, ERRMODE_NULL);
+
+    // input matrix is inMdim x inNdim, column-major
+    //
+    int inMdim, inMdim0, inMdim1;
+    int inNdim;
+
+    if(imgin.md->naxis == 3)
+    {
+        inMdim0 = imgin.md->size[0];
+        inMdim1 = imgin.md->size[1];
+        inMdim  = inMdim0 * inMdim1;
+        inNdim  = imgin.md->size[2];
+    }
+    else
+    {
+        inMdim0 = imgin.md->size[0];
+        inMdim1 = 1;
+        inMdim  = inMdim0;
+        inNdim  = imgin.md->size[1];
+    }
+
+    int mindim = inMdim;
+    if(inNdim < mindim)
+    {
+        mindim = inNdim;
+    }
+
+    // sketch size
+    int kdim = SVDNBmode;
+    if(kdim > mindim)
+    {
+        kdim = mindim;
+    }
+    int ldim = kdim + SVDNBoversample;
+    if(ldim > mindim)
+    {
+        ldim = mindim;
+    }
+    if(kdim < 1)
+    {
+        FUNC_RETURN_FAILURE("number of modes must be > 0");
+    }
+
+    float *matA = imgin.im->array.F;
+
+    float *matY  = (float *) malloc(sizeof(float) * inMdim * ldim);
+    float *matZ  = (float *) malloc(sizeof(float) * inNdim * ldim);
+    float *matB  = (float *) malloc(sizeof(float) * ldim * inNdim);
+    float *matUb = (float *) malloc(sizeof(float) * ldim * ldim);
+    float *matVt = (float *) malloc(sizeof(float) * ldim * inNdim);
+    float *sval  = (float *) malloc(sizeof(float) * ldim);
+    float *tau   = (float *) malloc(sizeof(float) * ldim);
+    float *superb = (float *) malloc(sizeof(float) * ldim);
+    if((matY == NULL) || (matZ == NULL) || (matB == NULL) ||
+            (matUb == NULL) || (matVt == NULL) || (sval == NULL) ||
+            (tau == NULL) || (superb == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+#ifdef HAVE_MKL
+    mkl_set_interface_layer(MKL_INTERFACE_ILP64);
+#endif
+
+    // Range finder
+    // Y = A Omega
+    //
+    fill_gaussian(matZ, (uint64_t) inNdim * ldim);
+    cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans,
+                inMdim, ldim, inNdim, 1.0,
+                matA, inMdim,
+                matZ, inNdim,
+                0.0, matY, inMdim);
+    FUNC_CHECK_RETURN(orthonormalize_cols(matY, inMdim, ldim, tau));
+
+    // Power iterations, re-orthonormalized at each half-step
+    //
+    for(uint32_t iter = 0; iter < SVDNBpowiter; iter++)
+    {
+        // Z = A^T Y
+        cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans,
+                    inNdim, ldim, inMdim, 1.0,
+                    matA, inMdim,
+                    matY, inMdim,
+                    0.0, matZ, inNdim);
+        FUNC_CHECK_RETURN(orthonormalize_cols(matZ, inNdim, ldim, tau));
+
+        // Y = A Z
+        cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans,
+                    inMdim, ldim, inNdim, 1.0,
+                    matA, inMdim,
+                    matZ, inNdim,
+                    0.0, matY, inMdim);
+        FUNC_CHECK_RETURN(orthonormalize_cols(matY, inMdim, ldim, tau));
+    }
+
+    // B = Y^T A, ldim x inNdim
+    //
+    cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans,
+                ldim, inNdim, inMdim, 1.0,
+                matY, inMdim,
+                matA, inMdim,
+                0.0, matB, ldim);
+
+    // SVD of small matrix
+    //
+    if(LAPACKE_sgesvd(LAPACK_COL_MAJOR, 'S', 'S', ldim, inNdim, matB, ldim,
+                      sval, matUb, ldim, matVt, ldim, superb) != 0)
+    {
+        FUNC_RETURN_FAILURE("LAPACKE_sgesvd failed");
+    }
+
+
+    // How many modes to keep ?
+    //
+    float svalmax = sval[0];
+    long  NBmodekeep = 0;
+    for(int k = 0; k < kdim; k++)
+    {
+        if(sval[k] > SVlimit * svalmax)
+        {
+            NBmodekeep++;
+        }
+    }
+    if(NBmodekeep < 1)
+    {
+        NBmodekeep = 1;
+    }
+    printf("KEEPING %ld MODES\n", NBmodekeep);
+
+
+    // create output images
+    //
+    {
+        IMGID imgtmpl;
+
+        imgtmpl.naxis   = 2;
+        imgtmpl.size[0] = NBmodekeep;
+        imgtmpl.size[1] = 1;
+        FUNC_CHECK_RETURN(create_svec_image(&imgS, imgtmpl));
+
+        imgtmpl.naxis = imgin.md->naxis;
+        if(imgin.md->naxis == 3)
+        {
+            imgtmpl.size[0] = inMdim0;
+            imgtmpl.size[1] = inMdim1;
+            imgtmpl.size[2] = NBmodekeep;
+        }
+        else
+        {
+            imgtmpl.size[0] = inMdim;
+            imgtmpl.size[1] = NBmodekeep;
+        }
+        FUNC_CHECK_RETURN(create_svec_image(&imgU, imgtmpl));
+
+        if(Vdim0 == 0)
+        {
+            imgtmpl.naxis   = 2;
+            imgtmpl.size[0] = inNdim;
+            imgtmpl.size[1] = NBmodekeep;
+        }
+        else
+        {
+            imgtmpl.naxis   = 3;
+            imgtmpl.size[0] = Vdim0;
+            imgtmpl.size[1] = inNdim / Vdim0;
+            imgtmpl.size[2] = NBmodekeep;
+        }
+        FUNC_CHECK_RETURN(create_svec_image(&imgV, imgtmpl));
+    }
+
+
+    // U = Y Ub
+    //
+    cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans,
+                inMdim, NBmodekeep, ldim, 1.0,
+                matY, inMdim,
+                matUb, ldim,
+                0.0, imgU.im->array.F, inMdim);
+
+    // V = Vt^T
+    //
+    for(long k = 0; k < NBmodekeep; k++)
+    {
+        imgS.im->array.F[k] = sval[k];
+        for(int jj = 0; jj < inNdim; jj++)
+        {
+            imgV.im->array.F[k * inNdim + jj] = matVt[jj * ldim + k];
+        }
+    }
+
+    free(matY);
+    free(matZ);
+    free(matB);
+    free(matUb);
+    free(matVt);
+    free(sval);
+    free(tau);
+    free(superb);
+
+    processinfo_update_output_stream(NULL, imgS.ID);
+    processinfo_update_output_stream(NULL, imgU.ID);
+    processinfo_update_output_stream(NULL, imgV.ID);
+
+
+    // Compute pseudo-inverse
+    // psinv = V S^-1 U^T
+    //
+    if(compSVDmode & COMPSVD_COMP_PSINV)
+    {
+        float *matVS = (float *) malloc(sizeof(float) * inNdim * NBmodekeep);
+        if(matVS == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        for(long k = 0; k < NBmodekeep; k++)
+        {
+            float normfact = 1.0 / imgS.im->array.F[k];
+            for(int jj = 0; jj < inNdim; jj++)
+            {
+                matVS[k * inNdim + jj] = imgV.im->array.F[k * inNdim + jj] * normfact;
+            }
+        }
+
+        delete_image_ID("psinv", DELETE_IMAGE_ERRMODE_IGNORE);
+        IMGID imgpsinv = makeIMGID_2D("psinv", inNdim, inMdim);
+        createimagefromIMGID(&imgpsinv);
+
+        cblas_sgemm(CblasColMajor, CblasNoTrans, CblasTrans,
+                    inNdim, inMdim, NBmodekeep, 1.0,
+                    matVS, inNdim,
+                    imgU.im->array.F, inMdim,
+                    0.0, imgpsinv.im->array.F, inNdim);
+        free(matVS);
+
+        // Check inverse
+        //
+        if(compSVDmode & COMPSVD_COMP_CHECKPSINV)
+        {
+            IMGID imgpsinvcheck = mkIMGID_from_name("psinvcheck");
+            computeSGEMM(imgpsinv, imgin, &imgpsinvcheck, 0, 0, -1);
+        }
+    }
+
+
+    // Reconstruct input from truncated decomposition
+    //
+    if(compSVDmode & COMPSVD_COMP_RECONSTRUCT)
+    {
+        delete_image_ID("SVDunmodes", DELETE_IMAGE_ERRMODE_IGNORE);
+        IMGID imgunmodes = mkIMGID_from_name("SVDunmodes");
+        imgunmodes.naxis    = imgU.md->naxis;
+        imgunmodes.datatype = imgU.md->datatype;
+        imgunmodes.size[0]  = imgU.md->size[0];
+        imgunmodes.size[1]  = imgU.md->size[1];
+        imgunmodes.size[2]  = imgU.md->size[2];
+        createimagefromIMGID(&imgunmodes);
+
+        for(long k = 0; k < NBmodekeep; k++)
+        {
+            float mfact = imgS.im->array.F[k];
+            for(long ii = 0; ii < inMdim; ii++)
+            {
+                imgunmodes.im->array.F[k * inMdim + ii] =
+                    imgU.im->array.F[k * inMdim + ii] * mfact;
+            }
+        }
+
+        delete_image_ID("SVDinrec", DELETE_IMAGE_ERRMODE_IGNORE);
+        IMGID iminrec = mkIMGID_from_name("SVDinrec");
+        computeSGEMM(imgunmodes, imgV, &iminrec, 0, 1, -1);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imginM = mkIMGID_from_name(inM);
+    resolveIMGID(&imginM, ERRMODE_ABORT);
+
+    IMGID imgU  = mkIMGID_from_name(outU);
+    IMGID imgS  = mkIMGID_from_name(outS);
+    IMGID imgV  = mkIMGID_from_name(outV);
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        compute_SVD_randomized(imginM, imgU, imgS, imgV,
+                               *Vdim0, *svdlim,
+                               *NBmode, *NBoversample, *NBpowiter,
+                               *compmode);
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+
+// Register function in CLI
+errno_t
+CLIADDCMD_linalgebra__compSVDrand()
+{
+
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
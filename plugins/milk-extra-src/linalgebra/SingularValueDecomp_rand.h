@@ -0,0 +1,21 @@
+#ifndef LINALGEBRA_COMPSVD_RAND_H
+#define LINALGEBRA_COMPSVD_RAND_H
+
+
+errno_t compute_SVD_randomized(
+    IMGID    imgin,
+    IMGID    imgU,
+    IMGID    imgS,
+    IMGID    imgV,
+    uint32_t Vdim0,
+    float    SVlimit,
+    uint32_t SVDNBmode,
+    uint32_t SVDNBoversample,
+    uint32_t SVDNBpowiter,
+    uint64_t compSVDmode
+);
+
+errno_t CLIADDCMD_linalgebra__compSVDrand();
+
+
+#endif
@@ -36,6 +36,7 @@
 #include "Qexpand.h"
 
 #include "SingularValueDecomp.h"
+#include "SingularValueDecomp_rand.h"
 #include "SingularValueDecomp_mkU.h"
 #include "SingularValueDecomp_mkM.h"
 #include "SGEMM.h"
@@ -118,6 +119,7 @@ static errno_t init_module_CLI()
     CLIADDCMD_linalgebra__Qexpand();
 
     CLIADDCMD_linalgebra__compSVD();
+    CLIADDCMD_linalgebra__compSVDrand();
     CLIADDCMD_linalgebra__compSVDU();
     CLIADDCMD_linalgebra__SVDmkM();
 
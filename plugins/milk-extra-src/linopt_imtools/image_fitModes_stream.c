@@ -0,0 +1,469 @@
+/**
+ * @file    image_fitModes_stream.c
+ * @brief   fit modes to each frame of input stream
+ *
+ * Stream counterpart of imfitmodes.
+ * The masked reconstructor is computed at startup, and recomputed only
+ * when mask, modes or SVDeps change. Pixel index and mask values are
+ * packed into the reconstructor, so that each frame is processed as a
+ * gather followed by a single MVM, with no allocation or image lookup.
+ */
+
+#include <gsl/gsl_cblas.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "image_to_vec.h"
+#include "mask_to_pixtable.h"
+
+#include "compute_SVDpseudoInverse.h"
+
+// Local variables pointers
+static char *insname;
+long         fpi_insname;
+
+static char *masksname;
+long         fpi_masksname;
+
+static char *modessname;
+long         fpi_modessname;
+
+static double *SVDeps;
+long           fpi_SVDeps;
+
+static char *outcoeffsname;
+long         fpi_outcoeffsname;
+
+static CLICMDARGDEF farg[] = {{
+        CLIARG_STREAM,
+        ".insname",
+        "input stream",
+        "inim",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &insname,
+        &fpi_insname
+    },
+    {
+        CLIARG_STREAM,
+        ".masksname",
+        "mask stream",
+        "immask",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &masksname,
+        &fpi_masksname
+    },
+    {
+        CLIARG_STREAM,
+        ".modessname",
+        "modes cube stream",
+        "imcmode",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &modessname,
+        &fpi_modessname
+    },
+    {
+        CLIARG_FLOAT64,
+        ".SVDeps",
+        "SVD cutoff",
+        "0.001",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &SVDeps,
+        &fpi_SVDeps
+    },
+    {
+        CLIARG_STR,
+        ".outcoeffsname",
+        "output coeff stream",
+        "outcoeff",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outcoeffsname,
+        &fpi_outcoeffsname
+    }
+};
+
+// Optional custom configuration setup.
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_insname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+        data.fpsptr->parray[fpi_masksname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+        data.fpsptr->parray[fpi_modessname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+
+        data.fpsptr->parray[fpi_SVDeps].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+static errno_t customCONFcheck()
+{
+    if(data.fpsptr != NULL)
+    {
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static CLICMDDATA CLIcmddata =
+{
+    "imfitmodesstream", "fit stream frames as sum of modes", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Fit each frame of input stream as linear sum of modes\n");
+    printf("Output stream holds one coefficient per mode\n");
+    printf("Reconstructor is recomputed when mask, modes or SVDeps change\n");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Packed reconstructor
+ *
+ * recm holds the pseudo-inverse of the masked modes, with mask values
+ * folded in : coeff[m] = sum_k recm[m * NBpix + k] * in[pixindex[k]]
+ */
+typedef struct
+{
+    uint32_t NBmode;
+    long     NBpix;
+
+    uint64_t *pixindex; // input pixel index, NBpix
+    float    *recm;     // NBmode x NBpix
+    float    *measvec;  // gathered input pixels, NBpix
+
+    uint64_t maskcnt0;
+    uint64_t modescnt0;
+    double   SVDeps;
+} FITMODES_RECONSTRUCTOR;
+
+
+
+
+static void fitmodes_reconstructor_free(FITMODES_RECONSTRUCTOR *fmrec)
+{
+    free(fmrec->pixindex);
+    free(fmrec->recm);
+    free(fmrec->measvec);
+    fmrec->pixindex = NULL;
+    fmrec->recm     = NULL;
+    fmrec->measvec  = NULL;
+    fmrec->NBmode   = 0;
+    fmrec->NBpix    = 0;
+}
+
+
+
+
+/**
+ * @brief Compute and pack reconstructor from mask and modes
+ *
+ * Intermediate images are named after output stream, so that several
+ * instances can run in the same process.
+ */
+static errno_t fitmodes_reconstructor_build(FITMODES_RECONSTRUCTOR *fmrec,
+        IMGID                   imgmask,
+        IMGID                   imgmodes,
+        double                  SVDeps)
+{
+    DEBUG_TRACE_FSTART();
+
+    // modes must have the mask (and input) xy size
+    if((uint64_t) imgmodes.md->size[0] * imgmodes.md->size[1] !=
+            (uint64_t) imgmask.md->size[0] * imgmask.md->size[1])
+    {
+        FUNC_RETURN_FAILURE("modes %s xy size does not match input",
+                            imgmodes.name);
+    }
+
+    char pixindname[STRINGMAXLEN_IMGNAME];
+    char pixmulname[STRINGMAXLEN_IMGNAME];
+    char respmname[STRINGMAXLEN_IMGNAME];
+    char recmname[STRINGMAXLEN_IMGNAME];
+    char vtmatname[STRINGMAXLEN_IMGNAME];
+
+    WRITE_IMAGENAME(pixindname, "_fms_%s_pixind", outcoeffsname);
+    WRITE_IMAGENAME(pixmulname, "_fms_%s_pixmul", outcoeffsname);
+    WRITE_IMAGENAME(respmname, "_fms_%s_respm", outcoeffsname);
+    WRITE_IMAGENAME(recmname, "_fms_%s_recm", outcoeffsname);
+    WRITE_IMAGENAME(vtmatname, "_fms_%s_vtmat", outcoeffsname);
+
+    // read counters before computing, so that an update during
+    // computation triggers a new one
+    fmrec->maskcnt0  = imgmask.md->cnt0;
+    fmrec->modescnt0 = imgmodes.md->cnt0;
+    fmrec->SVDeps    = SVDeps;
+
+    long NBpix = 0;
+    FUNC_CHECK_RETURN(linopt_imtools_mask_to_pixtable(imgmask.name,
+                      pixindname,
+                      pixmulname,
+                      &NBpix));
+
+    FUNC_CHECK_RETURN(linopt_imtools_image_to_vec(imgmodes.name,
+                      pixindname,
+                      pixmulname,
+                      respmname,
+                      NULL));
+
+    imageID IDrecm;
+    FUNC_CHECK_RETURN(linopt_compute_SVDpseudoInverse(respmname,
+                      recmname,
+                      SVDeps,
+                      10000,
+                      vtmatname,
+                      &IDrecm));
+
+    imageID IDpixind = image_ID(pixindname);
+    imageID IDpixmul = image_ID(pixmulname);
+
+    fitmodes_reconstructor_free(fmrec);
+
+    fmrec->NBmode = data.image[IDrecm].md[0].size[1];
+    fmrec->NBpix  = data.image[IDrecm].md[0].size[0];
+
+    fmrec->pixindex = (uint64_t *) malloc(sizeof(uint64_t) * fmrec->NBpix);
+    fmrec->recm =
+        (float *) malloc(sizeof(float) * fmrec->NBmode * fmrec->NBpix);
+    fmrec->measvec = (float *) malloc(sizeof(float) * fmrec->NBpix);
+    if((fmrec->pixindex == NULL) || (fmrec->recm == NULL) ||
+            (fmrec->measvec == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    for(long k = 0; k < fmrec->NBpix; k++)
+    {
+        fmrec->pixindex[k] = data.image[IDpixind].array.SI64[k];
+    }
+
+    for(uint32_t m = 0; m < fmrec->NBmode; m++)
+    {
+        for(long k = 0; k < fmrec->NBpix; k++)
+        {
+            fmrec->recm[m * fmrec->NBpix + k] =
+                data.image[IDrecm].array.F[m * fmrec->NBpix + k] *
+                data.image[IDpixmul].array.F[k];
+        }
+    }
+
+    FUNC_CHECK_RETURN(delete_image_ID(pixindname, DELETE_IMAGE_ERRMODE_WARNING));
+    FUNC_CHECK_RETURN(delete_image_ID(pixmulname, DELETE_IMAGE_ERRMODE_WARNING));
+    FUNC_CHECK_RETURN(delete_image_ID(respmname, DELETE_IMAGE_ERRMODE_WARNING));
+    FUNC_CHECK_RETURN(delete_image_ID(recmname, DELETE_IMAGE_ERRMODE_WARNING));
+    FUNC_CHECK_RETURN(delete_image_ID(vtmatname, DELETE_IMAGE_ERRMODE_WARNING));
+
+    printf("reconstructor : %u modes x %ld pixels\n", fmrec->NBmode, fmrec->NBpix);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Gather masked input pixels into contiguous float vector
+ *
+ * Input datatype is checked by caller, before the loop.
+ */
+static void fitmodes_gather(FITMODES_RECONSTRUCTOR *fmrec, IMGID imgin)
+{
+    float    *restrict measvec  = fmrec->measvec;
+    uint64_t *restrict pixindex = fmrec->pixindex;
+    long               NBpix    = fmrec->NBpix;
+
+    switch(imgin.md->datatype)
+    {
+    case _DATATYPE_FLOAT:
+        for(long k = 0; k < NBpix; k++)
+        {
+            measvec[k] = imgin.im->array.F[pixindex[k]];
+        }
+        break;
+
+    case _DATATYPE_DOUBLE:
+        for(long k = 0; k < NBpix; k++)
+        {
+            measvec[k] = imgin.im->array.D[pixindex[k]];
+        }
+        break;
+
+    case _DATATYPE_UINT16:
+        for(long k = 0; k < NBpix; k++)
+        {
+            measvec[k] = imgin.im->array.UI16[pixindex[k]];
+        }
+        break;
+
+    case _DATATYPE_INT16:
+        for(long k = 0; k < NBpix; k++)
+        {
+            measvec[k] = imgin.im->array.SI16[pixindex[k]];
+        }
+        break;
+
+    case _DATATYPE_UINT32:
+        for(long k = 0; k < NBpix; k++)
+        {
+            measvec[k] = imgin.im->array.UI32[pixindex[k]];
+        }
+        break;
+
+    case _DATATYPE_INT32:
+        for(long k = 0; k < NBpix; k++)
+        {
+            measvec[k] = imgin.im->array.SI32[pixindex[k]];
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    // CONNECT TO INPUT STREAMS
+    IMGID imgin = mkIMGID_from_name(insname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    IMGID imgmask = mkIMGID_from_name(masksname);
+    resolveIMGID(&imgmask, ERRMODE_ABORT);
+
+    IMGID imgmodes = mkIMGID_from_name(modessname);
+    resolveIMGID(&imgmodes, ERRMODE_ABORT);
+
+    if(imgmask.md->datatype != _DATATYPE_FLOAT)
+    {
+        FUNC_RETURN_FAILURE("mask %s must be float", masksname);
+    }
+
+    uint64_t sizexy = (uint64_t) imgin.md->size[0] * imgin.md->size[1];
+    if((uint64_t) imgmask.md->size[0] * imgmask.md->size[1] != sizexy)
+    {
+        FUNC_RETURN_FAILURE("mask %s size does not match input %s",
+                            masksname,
+                            insname);
+    }
+
+    // input datatypes handled by fitmodes_gather
+    switch(imgin.md->datatype)
+    {
+    case _DATATYPE_FLOAT:
+    case _DATATYPE_DOUBLE:
+    case _DATATYPE_UINT16:
+    case _DATATYPE_INT16:
+    case _DATATYPE_UINT32:
+    case _DATATYPE_INT32:
+        break;
+
+    default:
+        FUNC_RETURN_FAILURE("input %s datatype %d not supported",
+                            insname,
+                            imgin.md->datatype);
+    }
+
+    FITMODES_RECONSTRUCTOR fmrec;
+    fmrec.NBmode   = 0;
+    fmrec.NBpix    = 0;
+    fmrec.pixindex = NULL;
+    fmrec.recm     = NULL;
+    fmrec.measvec  = NULL;
+
+    FUNC_CHECK_RETURN(
+        fitmodes_reconstructor_build(&fmrec, imgmask, imgmodes, *SVDeps));
+
+    // CONNNECT TO OR CREATE OUTPUT STREAM
+    IMGID imgout = stream_connect_create_2Df32(outcoeffsname, fmrec.NBmode, 1);
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        if((imgmask.md->cnt0 != fmrec.maskcnt0) ||
+                (imgmodes.md->cnt0 != fmrec.modescnt0) ||
+                (*SVDeps != fmrec.SVDeps))
+        {
+            if(processinfo != NULL)
+            {
+                processinfo_WriteMessage(processinfo, "recomputing reconstructor");
+            }
+            if(fitmodes_reconstructor_build(&fmrec,
+                                            imgmask,
+                                            imgmodes,
+                                            *SVDeps) != RETURN_SUCCESS)
+            {
+                // exit loop, fmrec freed below
+                processinfo_error(processinfo, "reconstructor build failed");
+                processloopOK = 0;
+            }
+            else if(imgout.md->size[0] != fmrec.NBmode)
+            {
+                imgout = stream_connect_create_2Df32(outcoeffsname,
+                                                     fmrec.NBmode,
+                                                     1);
+            }
+        }
+
+        if(processloopOK == 1)
+        {
+            fitmodes_gather(&fmrec, imgin);
+
+            imgout.md->write = 1;
+            cblas_sgemv(CblasRowMajor,
+                        CblasNoTrans,
+                        fmrec.NBmode,
+                        fmrec.NBpix,
+                        1.0,
+                        fmrec.recm,
+                        fmrec.NBpix,
+                        fmrec.measvec,
+                        1,
+                        0.0,
+                        imgout.im->array.F,
+                        1);
+
+            processinfo_update_output_stream(processinfo, imgout.ID);
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    fitmodes_reconstructor_free(&fmrec);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t
+CLIADDCMD_linopt_imtools__image_fitModes_stream()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
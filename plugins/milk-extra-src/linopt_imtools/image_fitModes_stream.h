@@ -0,0 +1,6 @@
+#ifndef LINOPT_IMTOOLS__IMAGE_FITMODES_STREAM_H
+#define LINOPT_IMTOOLS__IMAGE_FITMODES_STREAM_H
+
+errno_t CLIADDCMD_linopt_imtools__image_fitModes_stream();
+
+#endif
@@ -62,6 +62,7 @@
 #include "compute_SVDpseudoInverse.h"
 #include "image_construct.h"
 #include "image_fitModes.h"
+#include "image_fitModes_stream.h"
 #include "image_to_vec.h"
 #include "imcube_crossproduct.h"
 #include "lin1Dfit.h"
@@ -138,6 +139,8 @@ static errno_t init_module_CLI()
 
     CLIADDCMD_linopt_imtools__image_fitModes();
 
+    CLIADDCMD_linopt_imtools__image_fitModes_stream();
+
     CLIADDCMD_linopt_imtools__image_construct();
 
     /*   RegisterCLIcommand(
@@ -0,0 +1,22 @@
+/**
+ * @file    perfbench.c
+ * @brief   Micro-benchmarks of real-time primitives
+ *
+ * Depends on the modules it benchmarks, so it sits above them
+ */
+
+#define MODULE_SHORTNAME_DEFAULT "perfbench"
+#define MODULE_DESCRIPTION       "Micro-benchmarks of real-time primitives"
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "perfbench_run.h"
+
+INIT_MODULE_LIB(perfbench)
+
+static errno_t init_module_CLI()
+{
+    CLIADDCMD_perfbench__run();
+
+    return RETURN_SUCCESS;
+}
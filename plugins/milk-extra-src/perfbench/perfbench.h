@@ -0,0 +1,8 @@
+#if !defined(PERFBENCH_H)
+#define PERFBENCH_H
+
+void __attribute__((constructor)) libinit_perfbench();
+
+#include "perfbench/perfbench_run.h"
+
+#endif
@@ -0,0 +1,911 @@
+/**
+ * @file perfbench_run.c
+ * @brief micro-benchmarks of real-time primitives
+ *
+ * Each benchmark writes one line to the results file :
+ *
+ *   name  niter  min  p50  p90  p99  max  mean
+ *
+ * times in microsecond. A results file can be used as baseline for a
+ * later run : p50 and p90 are then compared to baseline values, and
+ * the run fails if either exceeds baseline x (1 + tol) + tolus.
+ *
+ * Benchmarks :
+ *   imageID      image_ID() lookup among PERFBENCH_LOOKUP_NBIM images
+ *   streamcopy   copy stream to stream, update output
+ *   streampaste  paste two streams side by side, update output
+ *   sempost      semaphore post to waiter wake-up latency
+ *   trigger      processinfo_waitoninputstream wake-up latency, in modes
+ *                cnt0, cnt1 and semaphore
+ *   arith        image add, in-place constant multiply
+ *   fits         FITS save and load
+ *   mvm          computeSGEMM matrix-vector multiply
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "CommandLineInterface/processtools_trigger.h"
+#include "CommandLineInterface/timeutils.h"
+
+#include "COREMOD_arith/COREMOD_arith.h"
+#include "COREMOD_iofits/COREMOD_iofits.h"
+#include "COREMOD_memory/COREMOD_memory.h"
+#include "COREMOD_tools/quicksort.h"
+
+#include "linalgebra/SGEMM.h"
+
+#include "perfbench_run.h"
+
+// max number of benchmark results per run
+#define PERFBENCH_MAXNB 32
+
+// number of image_ID lookups per sample
+#define PERFBENCH_LOOKUP_BATCH 1000
+
+// number of images in memory for image_ID lookup
+#define PERFBENCH_LOOKUP_NBIM 100
+
+// time between posts in latency benchmarks, lets waiter go back to sleep
+#define PERFBENCH_POSTGAP_US 50
+
+// SGEMM input number of modes for MVM benchmark
+#define PERFBENCH_MVM_NBMODE 512
+
+#define PERFBENCH_FITSFNAME "_perfbench.fits"
+
+// images and state shared by benchmark operations
+typedef struct
+{
+    uint32_t size;
+
+    IMGID imgA; // shared memory streams
+    IMGID imgB;
+    IMGID imgP; // paste output, two frames side by side
+
+    IMGID imgmvmM; // MVM matrix
+    IMGID imgmvmV; // MVM input vector
+    IMGID imgmvmO; // MVM output
+
+    char lookupname[STRINGMAXLEN_IMAGE_NAME];
+} PERFBENCH_CTX;
+
+typedef errno_t (*PERFBENCH_OP)(PERFBENCH_CTX *ctx);
+
+// waiter thread for latency benchmarks
+typedef struct
+{
+    IMAGE       *image;
+    int          semindex;
+    PROCESSINFO *processinfo; // NULL : wait on raw semaphore
+    uint64_t     cnt0start;
+    uint64_t     NBpost;
+    double      *twake; // wake-up time, indexed by post
+} PERFBENCH_WAITER;
+
+// variables local to this translation unit
+static char     *benchlist;
+static uint32_t *imsize;
+static uint32_t *niter;
+static char     *outfname;
+static char     *baselinefname;
+static double   *tolerance;
+static double   *tolerance_us;
+
+static CLICMDARGDEF farg[] = {{
+        CLIARG_STR,
+        ".bench",
+        "benchmarks, comma-separated, or all",
+        "all",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &benchlist,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".size",
+        "image size",
+        "64",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &imsize,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".niter",
+        "number of samples per benchmark",
+        "1000",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &niter,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outfname",
+        "results file",
+        "perfbench.txt",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outfname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".baseline",
+        "baseline results file, empty for no comparison",
+        "",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &baselinefname,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".tol",
+        "relative tolerance on p50 and p90",
+        "0.25",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &tolerance,
+        NULL
+    },
+    {
+        CLIARG_FLOAT64,
+        ".tolus",
+        "absolute tolerance [us]",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &tolerance_us,
+        NULL
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "run", "micro-benchmarks with regression check", CLICMD_FIELDS_NOFPS
+};
+
+static inline double perfbench_time()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MILK, &t);
+    return 1.0 * t.tv_sec + 1.0e-9 * t.tv_nsec;
+}
+
+/** @brief Is benchmark name in comma-separated list
+ */
+static int perfbench_selected(const char *list, const char *name)
+{
+    if(strcmp(list, "all") == 0)
+    {
+        return 1;
+    }
+
+    size_t      len = strlen(name);
+    const char *pch = list;
+    while(pch != NULL)
+    {
+        if((strncmp(pch, name, len) == 0) &&
+                ((pch[len] == ',') || (pch[len] == '\0')))
+        {
+            return 1;
+        }
+        pch = strchr(pch, ',');
+        if(pch != NULL)
+        {
+            pch++;
+        }
+    }
+    return 0;
+}
+
+/** @brief Sort samples and compute percentiles
+ */
+static errno_t perfbench_stats(const char       *name,
+                               double           *sample,
+                               long              NBsample,
+                               PERFBENCH_RESULT *result)
+{
+    strncpy(result->name, name, PERFBENCH_NAMESTRLEN - 1);
+    result->name[PERFBENCH_NAMESTRLEN - 1] = '\0';
+    result->niter                          = NBsample;
+
+    if(NBsample == 0)
+    {
+        result->min  = 0.0;
+        result->p50  = 0.0;
+        result->p90  = 0.0;
+        result->p99  = 0.0;
+        result->max  = 0.0;
+        result->mean = 0.0;
+        return RETURN_SUCCESS;
+    }
+
+    qs_double(sample, 0, NBsample - 1);
+
+    double sum = 0.0;
+    for(long i = 0; i < NBsample; i++)
+    {
+        sum += sample[i];
+    }
+
+    // nearest-rank percentiles
+    result->min = sample[0];
+    result->p50 = sample[(long) ceil(0.50 * NBsample) - 1];
+    result->p90 = sample[(long) ceil(0.90 * NBsample) - 1];
+    result->p99 = sample[(long) ceil(0.99 * NBsample) - 1];
+    result->max = sample[NBsample - 1];
+    result->mean = sum / NBsample;
+
+    return RETURN_SUCCESS;
+}
+
+/** @brief Time operation, one sample per call
+ *
+ * Each sample is the time of batch calls divided by batch.
+ * Fails on first failed call, so that a broken operation is not timed.
+ */
+static errno_t perfbench_timeop(PERFBENCH_OP   op,
+                                PERFBENCH_CTX *ctx,
+                                uint32_t       NBsample,
+                                uint32_t       batch,
+                                double        *sample)
+{
+    DEBUG_TRACE_FSTART();
+
+    // warm up caches and lazy allocations
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        FUNC_CHECK_RETURN(op(ctx));
+    }
+
+    for(uint32_t i = 0; i < NBsample; i++)
+    {
+        double t0 = perfbench_time();
+        errno_t ret = RETURN_SUCCESS;
+        for(uint32_t b = 0; b < batch; b++)
+        {
+            ret |= op(ctx);
+        }
+        double t1 = perfbench_time();
+        if(ret != RETURN_SUCCESS)
+        {
+            FUNC_RETURN_FAILURE("operation failed in sample %u", i);
+        }
+        sample[i] = 1.0e6 * (t1 - t0) / batch;
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+static void *perfbench_waiter(void *ptr)
+{
+    PERFBENCH_WAITER *waiter = (PERFBENCH_WAITER *) ptr;
+
+    uint64_t cntend = waiter->cnt0start + waiter->NBpost;
+    uint64_t cnt    = waiter->cnt0start;
+
+    while(cnt < cntend)
+    {
+        if(waiter->processinfo == NULL)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            ImageStreamIO_semtimedwait(waiter->image, waiter->semindex, &ts);
+        }
+        else
+        {
+            processinfo_waitoninputstream(waiter->processinfo);
+        }
+        double t = perfbench_time();
+
+        // cnt0 identifies which post woke us up
+        // posts merged by the waiting function are not sampled
+        cnt = waiter->image->md->cnt0;
+        if(cnt > waiter->cnt0start)
+        {
+            uint64_t k = cnt - waiter->cnt0start - 1;
+            if((k < waiter->NBpost) && (waiter->twake[k] == 0.0))
+            {
+                waiter->twake[k] = t;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/** @brief Measure post to wake-up latency
+ *
+ * If processinfo is NULL, post semaphore semindex directly, otherwise
+ * update stream and wake up through processinfo_waitoninputstream.
+ */
+static errno_t perfbench_latency(IMAGE       *image,
+                                 int          semindex,
+                                 PROCESSINFO *processinfo,
+                                 uint32_t     NBpost,
+                                 double      *sample,
+                                 long        *NBsample)
+{
+    DEBUG_TRACE_FSTART();
+
+    double *tpost = (double *) calloc(NBpost, sizeof(double));
+    double *twake = (double *) calloc(NBpost, sizeof(double));
+    if((tpost == NULL) || (twake == NULL))
+    {
+        free(tpost);
+        free(twake);
+        FUNC_RETURN_FAILURE("calloc error");
+    }
+
+    PERFBENCH_WAITER waiter;
+    waiter.image       = image;
+    waiter.semindex    = semindex;
+    waiter.processinfo = processinfo;
+    waiter.cnt0start   = image->md->cnt0;
+    waiter.NBpost      = NBpost;
+    waiter.twake       = twake;
+
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, perfbench_waiter, &waiter) != 0)
+    {
+        free(tpost);
+        free(twake);
+        FUNC_RETURN_FAILURE("pthread_create error");
+    }
+
+    for(uint32_t k = 0; k < NBpost; k++)
+    {
+        usleep(PERFBENCH_POSTGAP_US);
+        tpost[k] = perfbench_time();
+        if(processinfo == NULL)
+        {
+            image->md->cnt0++;
+            ImageStreamIO_sempost(image, semindex);
+        }
+        else
+        {
+            image->md->cnt1++;
+            ImageStreamIO_UpdateIm(image);
+        }
+    }
+    pthread_join(thread, NULL);
+
+    *NBsample = 0;
+    for(uint32_t k = 0; k < NBpost; k++)
+    {
+        if(twake[k] > 0.0)
+        {
+            sample[*NBsample] = 1.0e6 * (twake[k] - tpost[k]);
+            (*NBsample)++;
+        }
+    }
+
+    free(tpost);
+    free(twake);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+static errno_t perfbench_op_imageID(PERFBENCH_CTX *ctx)
+{
+    if(image_ID(ctx->lookupname) == -1)
+    {
+        return RETURN_FAILURE;
+    }
+    return RETURN_SUCCESS;
+}
+
+static errno_t perfbench_op_streamcopy(PERFBENCH_CTX *ctx)
+{
+    ctx->imgB.md->write = 1;
+    memcpy(ctx->imgB.im->array.F,
+           ctx->imgA.im->array.F,
+           sizeof(float) * ctx->imgA.md->nelement);
+    ImageStreamIO_UpdateIm(ctx->imgB.im);
+
+    return RETURN_SUCCESS;
+}
+
+static errno_t perfbench_op_streampaste(PERFBENCH_CTX *ctx)
+{
+    uint32_t xsize = ctx->size;
+
+    ctx->imgP.md->write = 1;
+    for(uint32_t jj = 0; jj < ctx->size; jj++)
+    {
+        memcpy(ctx->imgP.im->array.F + 2 * jj * xsize,
+               ctx->imgA.im->array.F + jj * xsize,
+               sizeof(float) * xsize);
+        memcpy(ctx->imgP.im->array.F + (2 * jj + 1) * xsize,
+               ctx->imgB.im->array.F + jj * xsize,
+               sizeof(float) * xsize);
+    }
+    ImageStreamIO_UpdateIm(ctx->imgP.im);
+
+    return RETURN_SUCCESS;
+}
+
+static errno_t perfbench_op_arithadd(PERFBENCH_CTX *ctx)
+{
+    return arith_image_add(ctx->imgA.name, ctx->imgB.name, "_perfbench_sum");
+}
+
+static errno_t perfbench_op_arithcstmult(PERFBENCH_CTX *ctx)
+{
+    return arith_image_cstmult_inplace_byID(ctx->imgB.ID, 1.0);
+}
+
+static errno_t perfbench_op_fitssave(PERFBENCH_CTX *ctx)
+{
+    return save_fits(ctx->imgA.name, PERFBENCH_FITSFNAME);
+}
+
+static errno_t perfbench_op_fitsload(__attribute__((unused))
+                                     PERFBENCH_CTX *ctx)
+{
+    imageID ID  = -1;
+    errno_t ret = load_fits(PERFBENCH_FITSFNAME,
+                            "_perfbench_load",
+                            LOADFITS_ERRMODE_WARNING,
+                            &ID);
+    delete_image_ID("_perfbench_load", DELETE_IMAGE_ERRMODE_IGNORE);
+    if(ID == -1)
+    {
+        return RETURN_FAILURE;
+    }
+    return ret;
+}
+
+static errno_t perfbench_op_mvm(PERFBENCH_CTX *ctx)
+{
+    return computeSGEMM(ctx->imgmvmM, ctx->imgmvmV, &ctx->imgmvmO, 1, 0, -1);
+}
+
+static errno_t perfbench_write(FILE *fp, PERFBENCH_RESULT *result)
+{
+    fprintf(fp,
+            "%-20s %8ld %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f\n",
+            result->name,
+            result->niter,
+            result->min,
+            result->p50,
+            result->p90,
+            result->p99,
+            result->max,
+            result->mean);
+    return RETURN_SUCCESS;
+}
+
+static long perfbench_read(const char       *fname,
+                           PERFBENCH_RESULT *result,
+                           long              NBmax)
+{
+    FILE *fp = fopen(fname, "r");
+    if(fp == NULL)
+    {
+        return -1;
+    }
+
+    long NBresult = 0;
+    char line[STRINGMAXLEN_DEFAULT];
+    while((NBresult < NBmax) && (fgets(line, sizeof(line), fp) != NULL))
+    {
+        if(line[0] == '#')
+        {
+            continue;
+        }
+        PERFBENCH_RESULT *r = &result[NBresult];
+        if(sscanf(line,
+                  "%31s %ld %lf %lf %lf %lf %lf %lf",
+                  r->name,
+                  &r->niter,
+                  &r->min,
+                  &r->p50,
+                  &r->p90,
+                  &r->p99,
+                  &r->max,
+                  &r->mean) == 8)
+        {
+            NBresult++;
+        }
+    }
+    fclose(fp);
+
+    return NBresult;
+}
+
+static errno_t perfbench_createstream(IMGID *img, const char *name,
+                                      uint32_t xsize, uint32_t ysize)
+{
+    *img        = makeIMGID_2D(name, xsize, ysize);
+    img->shared = 1;
+    img->NBkw   = 0;
+    createimagefromIMGID(img);
+    if(img->ID == -1)
+    {
+        return RETURN_FAILURE;
+    }
+    for(uint64_t ii = 0; ii < img->md->nelement; ii++)
+    {
+        img->im->array.F[ii] = 1.0 * (ii % 17);
+    }
+    return RETURN_SUCCESS;
+}
+
+/** @brief Run selected benchmarks on streams of ctx
+ *
+ * Images created here are removed by caller, also on failure.
+ */
+static errno_t perfbench_runbench(PERFBENCH_CTX    *ctx,
+                                  const char       *benchlist,
+                                  uint32_t          niter,
+                                  double           *sample,
+                                  PERFBENCH_RESULT *result,
+                                  long             *NBresult)
+{
+    DEBUG_TRACE_FSTART();
+
+    uint32_t size = ctx->size;
+    long     NBsample;
+
+    if(perfbench_selected(benchlist, "imageID"))
+    {
+        // lookup last created, all others are scanned before it
+        for(int i = 0; i < PERFBENCH_LOOKUP_NBIM; i++)
+        {
+            imageID ID = -1;
+            snprintf(ctx->lookupname,
+                     STRINGMAXLEN_IMAGE_NAME,
+                     "_perfbench_lookup%03d",
+                     i);
+            create_2Dimage_ID(ctx->lookupname, 1, 1, &ID);
+        }
+        FUNC_CHECK_RETURN(perfbench_timeop(perfbench_op_imageID,
+                                           ctx,
+                                           niter,
+                                           PERFBENCH_LOOKUP_BATCH,
+                                           sample));
+        perfbench_stats("imageID", sample, niter, &result[(*NBresult)++]);
+        delete_image_ID_prefix("_perfbench_lookup");
+    }
+
+    if(perfbench_selected(benchlist, "streamcopy"))
+    {
+        FUNC_CHECK_RETURN(
+            perfbench_timeop(perfbench_op_streamcopy, ctx, niter, 1, sample));
+        perfbench_stats("streamcopy", sample, niter, &result[(*NBresult)++]);
+    }
+
+    if(perfbench_selected(benchlist, "streampaste"))
+    {
+        FUNC_CHECK_RETURN(perfbench_timeop(perfbench_op_streampaste,
+                                           ctx,
+                                           niter,
+                                           1,
+                                           sample));
+        perfbench_stats("streampaste", sample, niter, &result[(*NBresult)++]);
+    }
+
+    if(perfbench_selected(benchlist, "sempost"))
+    {
+        int semindex = ImageStreamIO_getsemwaitindex(ctx->imgA.im, -1);
+        if(semindex == -1)
+        {
+            PRINT_WARNING("no semaphore available, skipping sempost");
+        }
+        else
+        {
+            ImageStreamIO_semflush(ctx->imgA.im, semindex);
+            FUNC_CHECK_RETURN(perfbench_latency(ctx->imgA.im,
+                                                semindex,
+                                                NULL,
+                                                niter,
+                                                sample,
+                                                &NBsample));
+            perfbench_stats("sempost",
+                            sample,
+                            NBsample,
+                            &result[(*NBresult)++]);
+        }
+    }
+
+    if(perfbench_selected(benchlist, "trigger"))
+    {
+        int triggermode[3] = {PROCESSINFO_TRIGGERMODE_CNT0,
+                              PROCESSINFO_TRIGGERMODE_CNT1,
+                              PROCESSINFO_TRIGGERMODE_SEMAPHORE
+                             };
+        const char *triggername[3] = {"trigger_cnt0",
+                                      "trigger_cnt1",
+                                      "trigger_sem"
+                                     };
+
+        for(int m = 0; m < 3; m++)
+        {
+            PROCESSINFO processinfo;
+            memset(&processinfo, 0, sizeof(PROCESSINFO));
+            processinfo.triggermode            = triggermode[m];
+            processinfo.triggertimeout.tv_sec  = 1;
+            processinfo.triggertimeout.tv_nsec = 0;
+
+            FUNC_CHECK_RETURN(processinfo_waitoninputstream_init(&processinfo,
+                              ctx->imgB.ID,
+                              triggermode[m],
+                              -1));
+            if(processinfo.triggermode != triggermode[m])
+            {
+                PRINT_WARNING("trigger mode %d unavailable, skipping %s",
+                              triggermode[m],
+                              triggername[m]);
+                continue;
+            }
+            if(processinfo.triggermode == PROCESSINFO_TRIGGERMODE_SEMAPHORE)
+            {
+                ImageStreamIO_semflush(ctx->imgB.im, processinfo.triggersem);
+            }
+
+            FUNC_CHECK_RETURN(perfbench_latency(ctx->imgB.im,
+                                                -1,
+                                                &processinfo,
+                                                niter,
+                                                sample,
+                                                &NBsample));
+            perfbench_stats(triggername[m],
+                            sample,
+                            NBsample,
+                            &result[(*NBresult)++]);
+        }
+    }
+
+    if(perfbench_selected(benchlist, "arith"))
+    {
+        FUNC_CHECK_RETURN(
+            perfbench_timeop(perfbench_op_arithadd, ctx, niter, 1, sample));
+        perfbench_stats("arith_add", sample, niter, &result[(*NBresult)++]);
+
+        FUNC_CHECK_RETURN(perfbench_timeop(perfbench_op_arithcstmult,
+                                           ctx,
+                                           niter,
+                                           1,
+                                           sample));
+        perfbench_stats("arith_cstmult", sample, niter, &result[(*NBresult)++]);
+
+        delete_image_ID("_perfbench_sum", DELETE_IMAGE_ERRMODE_IGNORE);
+    }
+
+    if(perfbench_selected(benchlist, "fits"))
+    {
+        FUNC_CHECK_RETURN(
+            perfbench_timeop(perfbench_op_fitssave, ctx, niter, 1, sample));
+        perfbench_stats("fits_save", sample, niter, &result[(*NBresult)++]);
+
+        FUNC_CHECK_RETURN(
+            perfbench_timeop(perfbench_op_fitsload, ctx, niter, 1, sample));
+        perfbench_stats("fits_load", sample, niter, &result[(*NBresult)++]);
+
+        remove(PERFBENCH_FITSFNAME);
+    }
+
+    if(perfbench_selected(benchlist, "mvm"))
+    {
+        uint32_t NBpix = size * size;
+
+        ctx->imgmvmM =
+            makeIMGID_2D("_perfbench_mvmM", NBpix, PERFBENCH_MVM_NBMODE);
+        ctx->imgmvmM.NBkw = 0;
+        createimagefromIMGID(&ctx->imgmvmM);
+        if(ctx->imgmvmM.ID == -1)
+        {
+            FUNC_RETURN_FAILURE("cannot create MVM matrix");
+        }
+        for(uint64_t ii = 0; ii < ctx->imgmvmM.md->nelement; ii++)
+        {
+            ctx->imgmvmM.im->array.F[ii] = 1.0e-3 * (ii % 101);
+        }
+
+        ctx->imgmvmV      = makeIMGID_2D("_perfbench_mvmV", NBpix, 1);
+        ctx->imgmvmV.NBkw = 0;
+        createimagefromIMGID(&ctx->imgmvmV);
+        if(ctx->imgmvmV.ID == -1)
+        {
+            FUNC_RETURN_FAILURE("cannot create MVM input");
+        }
+        memcpy(ctx->imgmvmV.im->array.F,
+               ctx->imgA.im->array.F,
+               sizeof(float) * NBpix);
+
+        ctx->imgmvmO      = mkIMGID_from_name("_perfbench_mvmO");
+        ctx->imgmvmO.NBkw = 0;
+
+        FUNC_CHECK_RETURN(
+            perfbench_timeop(perfbench_op_mvm, ctx, niter, 1, sample));
+        perfbench_stats("mvm", sample, niter, &result[(*NBresult)++]);
+
+        delete_image_ID_prefix("_perfbench_mvm");
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+errno_t perfbench_run(const char *benchlist,
+                      uint32_t    size,
+                      uint32_t    niter,
+                      const char *outfname,
+                      const char *baselinefname,
+                      double      tolerance,
+                      double      tolerance_us,
+                      int        *NBregression)
+{
+    DEBUG_TRACE_FSTART();
+
+    *NBregression = 0;
+
+    if((size == 0) || (niter == 0))
+    {
+        FUNC_RETURN_FAILURE("size and niter must be > 0");
+    }
+
+    PERFBENCH_RESULT result[PERFBENCH_MAXNB];
+    long             NBresult = 0;
+
+    double *sample = (double *) malloc(sizeof(double) * niter);
+    if(sample == NULL)
+    {
+        FUNC_RETURN_FAILURE("malloc error");
+    }
+
+    PERFBENCH_CTX ctx;
+    ctx.size = size;
+
+    errno_t ret =
+        perfbench_createstream(&ctx.imgA, "_perfbench_sA", size, size);
+    if(ret == RETURN_SUCCESS)
+    {
+        ret = perfbench_createstream(&ctx.imgB, "_perfbench_sB", size, size);
+    }
+    if(ret == RETURN_SUCCESS)
+    {
+        ret = perfbench_createstream(&ctx.imgP,
+                                     "_perfbench_sP",
+                                     2 * size,
+                                     size);
+    }
+    if(ret == RETURN_SUCCESS)
+    {
+        ret = perfbench_runbench(&ctx,
+                                 benchlist,
+                                 niter,
+                                 sample,
+                                 result,
+                                 &NBresult);
+    }
+
+    free(sample);
+
+    // remove streams, including files in shared memory directory
+    // and images left over by a failed benchmark
+    {
+        int rmSHMfile  = data.rmSHMfile;
+        data.rmSHMfile = 1;
+        delete_image_ID_prefix("_perfbench_s");
+        data.rmSHMfile = rmSHMfile;
+    }
+    delete_image_ID_prefix("_perfbench_");
+    remove(PERFBENCH_FITSFNAME);
+
+    if(ret != RETURN_SUCCESS)
+    {
+        FUNC_RETURN_FAILURE("benchmark failed");
+    }
+
+    // write results
+    //
+    FILE *fp = fopen(outfname, "w");
+    if(fp == NULL)
+    {
+        FUNC_RETURN_FAILURE("cannot write file %s", outfname);
+    }
+    fprintf(fp, "# perfbench  size %u  niter %u\n", size, niter);
+    fprintf(fp,
+            "# %-18s %8s %12s %12s %12s %12s %12s %12s   [us]\n",
+            "name",
+            "niter",
+            "min",
+            "p50",
+            "p90",
+            "p99",
+            "max",
+            "mean");
+    for(long i = 0; i < NBresult; i++)
+    {
+        perfbench_write(fp, &result[i]);
+        perfbench_write(stdout, &result[i]);
+    }
+    fclose(fp);
+
+    // compare to baseline
+    //
+    if(strlen(baselinefname) > 0)
+    {
+        PERFBENCH_RESULT baseline[PERFBENCH_MAXNB];
+        long             NBbaseline =
+            perfbench_read(baselinefname, baseline, PERFBENCH_MAXNB);
+        if(NBbaseline < 0)
+        {
+            FUNC_RETURN_FAILURE("cannot read baseline file %s", baselinefname);
+        }
+
+        for(long i = 0; i < NBresult; i++)
+        {
+            long b = 0;
+            while((b < NBbaseline) &&
+                    (strcmp(baseline[b].name, result[i].name) != 0))
+            {
+                b++;
+            }
+            if(b == NBbaseline)
+            {
+                printf("%-20s no baseline\n", result[i].name);
+                continue;
+            }
+
+            double p50limit =
+                baseline[b].p50 * (1.0 + tolerance) + tolerance_us;
+            double p90limit =
+                baseline[b].p90 * (1.0 + tolerance) + tolerance_us;
+            if((result[i].p50 > p50limit) || (result[i].p90 > p90limit))
+            {
+                printf("%-20s REGRESSION  p50 %.3f / %.3f  p90 %.3f / %.3f\n",
+                       result[i].name,
+                       result[i].p50,
+                       p50limit,
+                       result[i].p90,
+                       p90limit);
+                (*NBregression)++;
+            }
+        }
+    }
+
+    if(*NBregression == 0)
+    {
+        printf("perfbench: PASS  %ld benchmarks\n", NBresult);
+    }
+    else
+    {
+        printf("perfbench: FAIL  %d regression(s)\n", *NBregression);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    int NBregression;
+    FUNC_CHECK_RETURN(perfbench_run(benchlist,
+                                    *imsize,
+                                    *niter,
+                                    outfname,
+                                    baselinefname,
+                                    *tolerance,
+                                    *tolerance_us,
+                                    &NBregression));
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_CLIfunction
+
+errno_t CLIADDCMD_perfbench__run()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
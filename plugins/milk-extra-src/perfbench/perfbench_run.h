@@ -0,0 +1,35 @@
+/**
+ * @file perfbench_run.h
+ */
+
+#ifndef PERFBENCH_PERFBENCH_RUN_H
+#define PERFBENCH_PERFBENCH_RUN_H
+
+#define PERFBENCH_NAMESTRLEN 32
+
+// timing statistics of one benchmark, in microsecond
+typedef struct
+{
+    char name[PERFBENCH_NAMESTRLEN];
+    long niter; // number of valid samples
+
+    double min;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    double mean;
+} PERFBENCH_RESULT;
+
+errno_t CLIADDCMD_perfbench__run();
+
+errno_t perfbench_run(const char *benchlist,
+                      uint32_t    size,
+                      uint32_t    niter,
+                      const char *outfname,
+                      const char *baselinefname,
+                      double      tolerance,
+                      double      tolerance_us,
+                      int        *NBregression);
+
+#endif
@@ -19,6 +19,7 @@
 #include "fft/fft.h"
 
 #include "psf/psf.h"
+#include "psf_multicentroid.h"
 
 /* ================================================================== */
 /* ================================================================== */
@@ -82,6 +83,8 @@ static errno_t init_module_CLI()
                        "int PSF_sequence_measure(const char *IDin_name, float "
                        "PSFsizeEst, const char *outfname)");
 
+    CLIADDCMD_psf__multicentroid();
+
     return RETURN_SUCCESS;
 }
 
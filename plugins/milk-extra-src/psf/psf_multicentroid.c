@@ -0,0 +1,668 @@
+/** @file psf_multicentroid.c
+ *
+ * Real-time multi-source centroiding and photometry
+ *
+ * Each source has a square ROI. On every frame, for each source :
+ * - local background is the median of ROI border pixels, optionally
+ *   smoothed in time
+ * - centroid is the barycenter of background-subtracted pixels above
+ *   a fraction of the peak, optionally weighted by a gaussian window,
+ *   iterated with ROI recentered on estimate
+ * - flux is the background-subtracted sum over ROI
+ * - FWHM is the equivalent-area FWHM of pixels above half peak
+ *
+ * Sources are processed in parallel. Only ROI pixels are read, so
+ * cost does not depend on image size.
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "psf_multicentroid.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+
+
+// ==========================================
+// Function parameters
+// ==========================================
+
+static char *inimname;
+static long  fpi_inimname = -1;
+
+static char *srclistname;
+
+static uint32_t *NBsrc;
+
+static char *outimname;
+
+static uint32_t *roisize;
+
+static float *thresh;
+static long   fpi_thresh = -1;
+
+static float *winsigma;
+static long   fpi_winsigma = -1;
+
+static uint32_t *NBiter;
+static long      fpi_NBiter = -1;
+
+static uint64_t *track;
+static long      fpi_track = -1;
+
+static float *bkggain;
+static long   fpi_bkggain = -1;
+
+
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_STREAM,
+        ".inim",
+        "input image stream",
+        "im",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inimname,
+        &fpi_inimname
+    },
+    {
+        CLIARG_STR,
+        ".srclist",
+        "source positions (2 x NBsrc), none to detect",
+        "none",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &srclistname,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".NBsrc",
+        "number of sources to detect if no list",
+        "1",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &NBsrc,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outim",
+        "output stream (x, y, flux, FWHM, bkg) x NBsrc",
+        "psfmc",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".roisize",
+        "ROI size [pix]",
+        "15",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &roisize,
+        NULL
+    },
+    {
+        CLIARG_FLOAT32,
+        ".thresh",
+        "centroid threshold, fraction of peak",
+        "0.1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &thresh,
+        &fpi_thresh
+    },
+    {
+        CLIARG_FLOAT32,
+        ".winsigma",
+        "gaussian centroid window sigma [pix], 0 for none",
+        "0.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &winsigma,
+        &fpi_winsigma
+    },
+    {
+        CLIARG_UINT32,
+        ".NBiter",
+        "centroid iterations",
+        "2",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &NBiter,
+        &fpi_NBiter
+    },
+    {
+        CLIARG_ONOFF,
+        ".track",
+        "ROI follows source",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &track,
+        &fpi_track
+    },
+    {
+        CLIARG_FLOAT32,
+        ".bkggain",
+        "background update gain, 1 for no smoothing",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &bkggain,
+        &fpi_bkggain
+    }
+};
+
+
+
+// Optional custom configuration setup.
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+        data.fpsptr->parray[fpi_inimname].fpflag |=
+            FPFLAG_STREAM_RUN_REQUIRED | FPFLAG_CHECKSTREAM;
+
+        data.fpsptr->parray[fpi_thresh].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_winsigma].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_NBiter].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_track].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_bkggain].fpflag |= FPFLAG_WRITERUN;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+static errno_t customCONFcheck()
+{
+    if(data.fpsptr != NULL)
+    {
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+static CLICMDDATA CLIcmddata =
+{
+    "multicentroid",
+    "multi-source PSF centroid, flux and FWHM",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Measure centroid, flux and FWHM of sources on each frame\n");
+    printf("Source positions are read from .srclist (x,y per row), or\n");
+    printf("the .NBsrc brightest sources are detected on first frame\n");
+    printf("Output stream has one row per source :\n");
+    printf("   x, y, flux, FWHM, background\n");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static inline float psfmc_pix(const IMGID *img, uint64_t index)
+{
+    switch(img->md->datatype)
+    {
+        case _DATATYPE_FLOAT:
+            return img->im->array.F[index];
+        case _DATATYPE_DOUBLE:
+            return img->im->array.D[index];
+        case _DATATYPE_UINT8:
+            return img->im->array.UI8[index];
+        case _DATATYPE_UINT16:
+            return img->im->array.UI16[index];
+        case _DATATYPE_INT16:
+            return img->im->array.SI16[index];
+        case _DATATYPE_UINT32:
+            return img->im->array.UI32[index];
+        case _DATATYPE_INT32:
+            return img->im->array.SI32[index];
+        case _DATATYPE_INT8:
+            return img->im->array.SI8[index];
+        case _DATATYPE_UINT64:
+            return img->im->array.UI64[index];
+        case _DATATYPE_INT64:
+            return img->im->array.SI64[index];
+    }
+    // complex types rejected by psfmc_checkinput()
+    return 0.0;
+}
+
+
+
+/**
+ * @brief Reject inputs the centroid loops cannot handle
+ */
+static errno_t psfmc_checkinput(IMGID img, uint32_t roisize)
+{
+    DEBUG_TRACE_FSTART();
+
+    if((img.md->datatype == _DATATYPE_COMPLEX_FLOAT) ||
+            (img.md->datatype == _DATATYPE_COMPLEX_DOUBLE))
+    {
+        FUNC_RETURN_FAILURE("%s : complex datatype not supported",
+                            img.md->name);
+    }
+    if(roisize == 0)
+    {
+        FUNC_RETURN_FAILURE("roisize must be > 0");
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+static int psfmc_cmpfloat(const void *a, const void *b)
+{
+    float fa = *(const float *) a;
+    float fb = *(const float *) b;
+    return (fa > fb) - (fa < fb);
+}
+
+
+// ROI start, clamped to image
+static inline long psfmc_roistart(double cent, uint32_t roisize, uint32_t size)
+{
+    long start = lround(cent) - (long)(roisize / 2);
+    if(start > (long) size - (long) roisize)
+    {
+        start = (long) size - (long) roisize;
+    }
+    if(start < 0)
+    {
+        start = 0;
+    }
+    return start;
+}
+
+
+
+
+/**
+ * @brief Detect NBsrc brightest sources, at least one ROI apart
+ *
+ * Background is median of subsampled image.
+ */
+errno_t psf_multicentroid_detect(
+    IMGID         img,
+    uint32_t      roisize,
+    uint32_t      NBsrc,
+    PSFMC_SOURCE *src
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    FUNC_CHECK_RETURN(psfmc_checkinput(img, roisize));
+
+    uint32_t xsize = img.md->size[0];
+    uint32_t ysize = img.md->size[1];
+    uint64_t nelem = (uint64_t) xsize * ysize;
+
+    uint64_t nsample = (nelem + 15) / 16;
+    float   *sample  = (float *) malloc(sizeof(float) * nsample);
+    if(sample == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    for(uint64_t k = 0; k < nsample; k++)
+    {
+        sample[k] = psfmc_pix(&img, 16 * k);
+    }
+    qsort(sample, nsample, sizeof(float), psfmc_cmpfloat);
+    double bkg = sample[nsample / 2];
+    free(sample);
+
+    for(uint32_t s = 0; s < NBsrc; s++)
+    {
+        double   vmax = -HUGE_VAL;
+        uint32_t iimax = xsize / 2;
+        uint32_t jjmax = ysize / 2;
+        for(uint32_t jj = 0; jj < ysize; jj++)
+        {
+            for(uint32_t ii = 0; ii < xsize; ii++)
+            {
+                float v = psfmc_pix(&img, (uint64_t) jj * xsize + ii);
+                if(v <= vmax)
+                {
+                    continue;
+                }
+                int masked = 0;
+                for(uint32_t s1 = 0; s1 < s; s1++)
+                {
+                    if((fabs(ii - src[s1].xcent) < roisize) &&
+                            (fabs(jj - src[s1].ycent) < roisize))
+                    {
+                        masked = 1;
+                        break;
+                    }
+                }
+                if(masked == 0)
+                {
+                    vmax  = v;
+                    iimax = ii;
+                    jjmax = jj;
+                }
+            }
+        }
+
+        src[s].xcent   = iimax;
+        src[s].ycent   = jjmax;
+        src[s].bkg     = bkg;
+        src[s].bkginit = 0;
+        src[s].flux    = 0.0;
+        src[s].fwhm    = 0.0;
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Measure centroid, flux and FWHM of sources
+ *
+ * src[].xcent, src[].ycent hold ROI centers on input and
+ * measured centroids on output.
+ */
+errno_t psf_multicentroid_measure(
+    IMGID               img,
+    const PSFMC_PARAMS *params,
+    uint32_t            NBsrc,
+    PSFMC_SOURCE       *src
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    FUNC_CHECK_RETURN(psfmc_checkinput(img, params->roisize));
+
+    uint32_t xsize = img.md->size[0];
+    uint32_t ysize = img.md->size[1];
+
+    uint32_t roix = (params->roisize < xsize) ? params->roisize : xsize;
+    uint32_t roiy = (params->roisize < ysize) ? params->roisize : ysize;
+    uint32_t NBborder = 2 * (roix + roiy);
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (NBsrc > 1)
+#endif
+    for(uint32_t s = 0; s < NBsrc; s++)
+    {
+        float  border[NBborder];
+        double xc = src[s].xcent;
+        double yc = src[s].ycent;
+        double flux  = 0.0;
+        long   nhalf = 0;
+
+        for(int iter = 0; iter < params->NBiter; iter++)
+        {
+            long i0 = psfmc_roistart(xc, roix, xsize);
+            long j0 = psfmc_roistart(yc, roiy, ysize);
+
+            // local background from ROI border, first iteration
+            //
+            if(iter == 0)
+            {
+                uint32_t nb = 0;
+                for(uint32_t ii = 0; ii < roix; ii++)
+                {
+                    border[nb++] = psfmc_pix(&img, j0 * xsize + i0 + ii);
+                    border[nb++] =
+                        psfmc_pix(&img, (j0 + roiy - 1) * xsize + i0 + ii);
+                }
+                for(uint32_t jj = 1; jj + 1 < roiy; jj++)
+                {
+                    border[nb++] = psfmc_pix(&img, (j0 + jj) * xsize + i0);
+                    border[nb++] =
+                        psfmc_pix(&img, (j0 + jj) * xsize + i0 + roix - 1);
+                }
+                qsort(border, nb, sizeof(float), psfmc_cmpfloat);
+                double bkg = border[nb / 2];
+
+                if(src[s].bkginit == 0)
+                {
+                    src[s].bkg     = bkg;
+                    src[s].bkginit = 1;
+                }
+                else
+                {
+                    src[s].bkg += params->bkggain * (bkg - src[s].bkg);
+                }
+            }
+            double bkg = src[s].bkg;
+
+            double peak = 0.0;
+            for(uint32_t jj = 0; jj < roiy; jj++)
+            {
+                for(uint32_t ii = 0; ii < roix; ii++)
+                {
+                    double v =
+                        psfmc_pix(&img, (j0 + jj) * xsize + i0 + ii) - bkg;
+                    peak = (v > peak) ? v : peak;
+                }
+            }
+
+            double thr    = params->thresh * peak;
+            double halfpk = 0.5 * peak;
+            double a2     = (params->winsigma > 0.0) ?
+                            0.5 / (params->winsigma * params->winsigma) :
+                            0.0;
+            double sw     = 0.0;
+            double swx    = 0.0;
+            double swy    = 0.0;
+            flux          = 0.0;
+            nhalf         = 0;
+            for(uint32_t jj = 0; jj < roiy; jj++)
+            {
+                double y = j0 + jj;
+                for(uint32_t ii = 0; ii < roix; ii++)
+                {
+                    double x = i0 + ii;
+                    double v =
+                        psfmc_pix(&img, (j0 + jj) * xsize + i0 + ii) - bkg;
+
+                    flux += v;
+                    if(v > halfpk)
+                    {
+                        nhalf++;
+                    }
+
+                    double w = v - thr;
+                    if(w > 0.0)
+                    {
+                        if(a2 > 0.0)
+                        {
+                            w *= exp(-a2 * ((x - xc) * (x - xc) +
+                                            (y - yc) * (y - yc)));
+                        }
+                        sw += w;
+                        swx += w * x;
+                        swy += w * y;
+                    }
+                }
+            }
+            if(sw > 0.0)
+            {
+                xc = swx / sw;
+                yc = swy / sw;
+            }
+        }
+
+        src[s].xcent = xc;
+        src[s].ycent = yc;
+        src[s].flux  = flux;
+        src[s].fwhm  = 2.0 * sqrt(nhalf / M_PI);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    IMGID imgin = mkIMGID_from_name(inimname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    // Set input to be the trigger
+    strcpy(CLIcmddata.cmdsettings->triggerstreamname, inimname);
+    // for FPS mode:
+    if(data.fpsptr != NULL)
+    {
+        strcpy(data.fpsptr->cmdset.triggerstreamname, inimname);
+    }
+
+
+    // sources
+    //
+    uint32_t      NBsource;
+    PSFMC_SOURCE *src;
+
+    IMGID imgsrc = mkIMGID_from_name(srclistname);
+    if(resolveIMGID(&imgsrc, ERRMODE_NULL) != -1)
+    {
+        if((imgsrc.md->datatype != _DATATYPE_FLOAT) ||
+                (imgsrc.md->size[0] != 2))
+        {
+            FUNC_RETURN_FAILURE("source list %s must be float, 2 x NBsrc",
+                                srclistname);
+        }
+        NBsource = imgsrc.md->nelement / 2;
+    }
+    else
+    {
+        NBsource = *NBsrc;
+    }
+    if(NBsource == 0)
+    {
+        FUNC_RETURN_FAILURE("no source to measure");
+    }
+    FUNC_CHECK_RETURN(psfmc_checkinput(imgin, *roisize));
+
+    src = (PSFMC_SOURCE *) malloc(sizeof(PSFMC_SOURCE) * NBsource);
+    if(src == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    if(imgsrc.ID != -1)
+    {
+        for(uint32_t s = 0; s < NBsource; s++)
+        {
+            src[s].xcent   = imgsrc.im->array.F[2 * s];
+            src[s].ycent   = imgsrc.im->array.F[2 * s + 1];
+            src[s].bkginit = 0;
+        }
+    }
+    else
+    {
+        FUNC_CHECK_RETURN(
+            psf_multicentroid_detect(imgin, *roisize, NBsource, src));
+    }
+
+    // ROI centers if not tracking
+    double *xroi = (double *) malloc(sizeof(double) * NBsource);
+    double *yroi = (double *) malloc(sizeof(double) * NBsource);
+    if((xroi == NULL) || (yroi == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    for(uint32_t s = 0; s < NBsource; s++)
+    {
+        xroi[s] = src[s].xcent;
+        yroi[s] = src[s].ycent;
+    }
+
+    IMGID imgout = stream_connect_create_2Df32(outimname, PSFMC_NBOUT, NBsource);
+
+    PSFMC_PARAMS params;
+    params.roisize = *roisize;
+
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        params.thresh   = *thresh;
+        params.winsigma = *winsigma;
+        params.NBiter   = (*NBiter < 1) ? 1 : *NBiter;
+        params.track    = *track;
+        params.bkggain  = *bkggain;
+
+        if(params.track == 0)
+        {
+            for(uint32_t s = 0; s < NBsource; s++)
+            {
+                src[s].xcent = xroi[s];
+                src[s].ycent = yroi[s];
+            }
+        }
+
+        FUNC_CHECK_RETURN(
+            psf_multicentroid_measure(imgin, &params, NBsource, src));
+
+        imgout.md->write = 1;
+        for(uint32_t s = 0; s < NBsource; s++)
+        {
+            float *out           = imgout.im->array.F + PSFMC_NBOUT * s;
+            out[PSFMC_OUT_X]    = src[s].xcent;
+            out[PSFMC_OUT_Y]    = src[s].ycent;
+            out[PSFMC_OUT_FLUX] = src[s].flux;
+            out[PSFMC_OUT_FWHM] = src[s].fwhm;
+            out[PSFMC_OUT_BKG]  = src[s].bkg;
+        }
+        processinfo_update_output_stream(processinfo, imgout.ID);
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    free(src);
+    free(xroi);
+    free(yroi);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+// Register function in CLI
+errno_t CLIADDCMD_psf__multicentroid()
+{
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/** @file psf_multicentroid.h
+ */
+
+#ifndef _PSF_MULTICENTROID_H
+#define _PSF_MULTICENTROID_H
+
+// output columns, per source
+#define PSFMC_OUT_X    0
+#define PSFMC_OUT_Y    1
+#define PSFMC_OUT_FLUX 2
+#define PSFMC_OUT_FWHM 3
+#define PSFMC_OUT_BKG  4
+#define PSFMC_NBOUT    5
+
+// per-source state, ROI follows source if tracking
+typedef struct
+{
+    double xcent;
+    double ycent;
+    double bkg;   // smoothed local background
+    int    bkginit;
+
+    double flux;
+    double fwhm;
+
+} PSFMC_SOURCE;
+
+typedef struct
+{
+    uint32_t roisize;  // ROI width [pix]
+    float    thresh;   // centroid threshold, fraction of peak
+    float    winsigma; // gaussian centroid window [pix], 0 for none
+    int      NBiter;   // centroid iterations, ROI recentered
+    int      track;    // ROI follows source between frames
+    float    bkggain;  // background update gain, 1 : no smoothing
+
+} PSFMC_PARAMS;
+
+errno_t psf_multicentroid_detect(IMGID         img,
+                                 uint32_t      roisize,
+                                 uint32_t      NBsrc,
+                                 PSFMC_SOURCE *src);
+
+errno_t psf_multicentroid_measure(IMGID               img,
+                                  const PSFMC_PARAMS *params,
+                                  uint32_t            NBsrc,
+                                  PSFMC_SOURCE       *src);
+
+errno_t CLIADDCMD_psf__multicentroid();
+
+#endif
@@ -0,0 +1,352 @@
+/**
+ * @file    rng_philox.c
+ * @brief   Counter-based Philox4x32-10 random number generator
+ *
+ * Salmon et al. 2011, "Parallel random numbers: as easy as 1, 2, 3".
+ *
+ * Each call to an array function draws from counter values
+ * (block index, sub-index, call counter) with the stream seed as key.
+ * Blocks are independent and filled in parallel (OpenMP), one block of
+ * 4 values per iteration. The Philox round function is branch-free
+ * integer code, but samplers are not vectorized : gaussian and
+ * poisson samplers call libm per element and have data-dependent
+ * branches (truncation, rejection).
+ *
+ * Gaussian samples use Box-Muller on pairs of 32-bit words.
+ * Poisson samples use multiplication method for mu < 10, and
+ * transformed rejection (PTRS, Hormann 1993) otherwise.
+ */
+
+#include <math.h>
+#include <time.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "rng_philox.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP_NELEMENT_LIMIT 100000
+#endif
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+#define PHILOX_NBROUND 10
+
+// 2^-32
+#define RNG_U32SCALE 2.3283064365386963e-10
+
+
+static RNG_PHILOX rng_default;
+static int        rng_default_init = 0;
+
+
+
+
+static inline void philox4x32(const uint32_t ctr[4],
+                              const uint32_t key[2],
+                              uint32_t       out[4])
+{
+    uint32_t c0 = ctr[0];
+    uint32_t c1 = ctr[1];
+    uint32_t c2 = ctr[2];
+    uint32_t c3 = ctr[3];
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+
+    for(int r = 0; r < PHILOX_NBROUND; r++)
+    {
+        uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t) p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t) p0;
+
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+
+
+
+// 4 random values from block, sub-counter advances on rejection
+//
+static inline void rng_block(const RNG_PHILOX *rng,
+                             int               pdf,
+                             uint64_t          block,
+                             double            v[4])
+{
+    uint32_t key[2] = {(uint32_t) rng->seed, (uint32_t)(rng->seed >> 32)};
+    uint32_t ctr[4] = {(uint32_t) block,
+                       (uint32_t)(block >> 32),
+                       0,
+                       (uint32_t) rng->counter
+                      };
+    uint32_t u[4];
+
+    if(pdf == RNG_PDF_UNIFORM)
+    {
+        philox4x32(ctr, key, u);
+        for(int i = 0; i < 4; i++)
+        {
+            // 24-bit, exact in float and < 1
+            v[i] = RNG_U32SCALE * (u[i] & 0xFFFFFF00U);
+        }
+        return;
+    }
+
+    int n = 0;
+    while(n < 4)
+    {
+        philox4x32(ctr, key, u);
+        ctr[2]++;
+        for(int i = 0; i < 4; i += 2)
+        {
+            double r   = sqrt(-2.0 * log(RNG_U32SCALE * (u[i] + 1.0)));
+            double phi = 2.0 * M_PI * RNG_U32SCALE * u[i + 1];
+            double g[2] = {r * cos(phi), r * sin(phi)};
+            for(int j = 0; j < 2; j++)
+            {
+                if((n < 4) &&
+                        ((pdf != RNG_PDF_TRGAUSS) || (fabs(g[j]) <= 1.0)))
+                {
+                    v[n++] = g[j];
+                }
+            }
+        }
+    }
+}
+
+
+
+
+// per-element generator for samplers with variable number of draws
+//
+typedef struct
+{
+    uint32_t ctr[4];
+    uint32_t key[2];
+    uint32_t buf[4];
+    int      pos;
+} RNG_ELEM;
+
+static inline void rng_elem_init(RNG_ELEM         *e,
+                                 const RNG_PHILOX *rng,
+                                 uint64_t          index)
+{
+    e->key[0] = (uint32_t) rng->seed;
+    e->key[1] = (uint32_t)(rng->seed >> 32);
+    e->ctr[0] = (uint32_t) index;
+    e->ctr[1] = (uint32_t)(index >> 32);
+    e->ctr[2] = 0;
+    e->ctr[3] = (uint32_t) rng->counter;
+    e->pos    = 4;
+}
+
+// uniform in (0,1]
+static inline double rng_elem_uniform(RNG_ELEM *e)
+{
+    if(e->pos == 4)
+    {
+        philox4x32(e->ctr, e->key, e->buf);
+        e->ctr[2]++;
+        e->pos = 0;
+    }
+    return RNG_U32SCALE * (e->buf[e->pos++] + 1.0);
+}
+
+static double rng_elem_poisson(RNG_ELEM *e, double mu)
+{
+    if(!(mu > 0.0))
+    {
+        return 0.0;
+    }
+
+    if(mu < 10.0)
+    {
+        double L = exp(-mu);
+        double p = 1.0;
+        long   k = -1;
+        do
+        {
+            k++;
+            p *= rng_elem_uniform(e);
+        }
+        while(p > L);
+        return k;
+    }
+
+    double slam     = sqrt(mu);
+    double loglam   = log(mu);
+    double b        = 0.931 + 2.53 * slam;
+    double a        = -0.059 + 0.02483 * b;
+    double invalpha = 1.1239 + 1.1328 / (b - 3.4);
+    double vr       = 0.9277 - 3.6224 / (b - 2.0);
+
+    while(1)
+    {
+        double U  = rng_elem_uniform(e) - 0.5;
+        double V  = rng_elem_uniform(e);
+        double us = 0.5 - fabs(U);
+        double k  = floor((2.0 * a / us + b) * U + mu + 0.43);
+
+        if((us >= 0.07) && (V <= vr))
+        {
+            return k;
+        }
+        if((k < 0.0) || ((us < 0.013) && (V > us)))
+        {
+            continue;
+        }
+        if((log(V) + log(invalpha) - log(a / (us * us) + b)) <=
+                (-mu + k * loglam - lgamma(k + 1.0)))
+        {
+            return k;
+        }
+    }
+}
+
+
+
+
+errno_t rng_philox_init(RNG_PHILOX *rng, uint64_t seed)
+{
+    rng->seed    = seed;
+    rng->counter = 0;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+RNG_PHILOX *rng_philox_default()
+{
+    if(rng_default_init == 0)
+    {
+        rng_philox_init(&rng_default, (uint64_t) time(NULL));
+        rng_default_init = 1;
+    }
+    return &rng_default;
+}
+
+
+
+
+errno_t rng_philox_fill_float(RNG_PHILOX *rng,
+                              int         pdf,
+                              float      *out,
+                              uint64_t    nelement)
+{
+    uint64_t NBblock = (nelement + 3) / 4;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t block = 0; block < NBblock; block++)
+    {
+        double v[4];
+        rng_block(rng, pdf, block, v);
+        for(int i = 0; i < 4; i++)
+        {
+            if(4 * block + i < nelement)
+            {
+                out[4 * block + i] = v[i];
+            }
+        }
+    }
+    rng->counter++;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+errno_t rng_philox_fill_double(RNG_PHILOX *rng,
+                               int         pdf,
+                               double     *out,
+                               uint64_t    nelement)
+{
+    uint64_t NBblock = (nelement + 3) / 4;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t block = 0; block < NBblock; block++)
+    {
+        double v[4];
+        rng_block(rng, pdf, block, v);
+        for(int i = 0; i < 4; i++)
+        {
+            if(4 * block + i < nelement)
+            {
+                out[4 * block + i] = v[i];
+            }
+        }
+    }
+    rng->counter++;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+errno_t rng_philox_addgauss_float(RNG_PHILOX  *rng,
+                                  const float *in,
+                                  float        ampl,
+                                  float       *out,
+                                  uint64_t     nelement)
+{
+    uint64_t NBblock = (nelement + 3) / 4;
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t block = 0; block < NBblock; block++)
+    {
+        double v[4];
+        rng_block(rng, RNG_PDF_GAUSS, block, v);
+        for(int i = 0; i < 4; i++)
+        {
+            uint64_t ii = 4 * block + i;
+            if(ii < nelement)
+            {
+                out[ii] = in[ii] + ampl * v[i];
+            }
+        }
+    }
+    rng->counter++;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+errno_t rng_philox_poisson_float(RNG_PHILOX  *rng,
+                                 const float *mu,
+                                 float       *out,
+                                 uint64_t     nelement)
+{
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static, 4096) if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+    for(uint64_t ii = 0; ii < nelement; ii++)
+    {
+        RNG_ELEM e;
+        rng_elem_init(&e, rng, ii);
+        out[ii] = rng_elem_poisson(&e, mu[ii]);
+    }
+    rng->counter++;
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file    rng_philox.h
+ * @brief   Counter-based Philox4x32-10 random number generator
+ *
+ * Element ii of call number cnt depends only on (seed, cnt, ii), so
+ * arrays can be filled in parallel and results do not depend on the
+ * number of threads.
+ */
+
+#ifndef _STATISTIC_RNG_PHILOX_H
+#define _STATISTIC_RNG_PHILOX_H
+
+// probability distributions, same codes as mkrnd .distrib
+#define RNG_PDF_UNIFORM 0 // [0,1), 24-bit resolution
+#define RNG_PDF_GAUSS   1 // mean 0, sigma 1
+#define RNG_PDF_TRGAUSS 2 // gaussian truncated to [-1,1]
+
+typedef struct
+{
+    uint64_t seed;
+    uint64_t counter; // incremented on every array call
+} RNG_PHILOX;
+
+errno_t rng_philox_init(RNG_PHILOX *rng, uint64_t seed);
+
+/** @brief Module default stream, seeded from time unless rngseed is called
+ */
+RNG_PHILOX *rng_philox_default();
+
+errno_t rng_philox_fill_float(RNG_PHILOX *rng,
+                              int         pdf,
+                              float      *out,
+                              uint64_t    nelement);
+
+errno_t rng_philox_fill_double(RNG_PHILOX *rng,
+                               int         pdf,
+                               double     *out,
+                               uint64_t    nelement);
+
+/** @brief out = in + ampl x gaussian
+ */
+errno_t rng_philox_addgauss_float(RNG_PHILOX  *rng,
+                                  const float *in,
+                                  float        ampl,
+                                  float       *out,
+                                  uint64_t     nelement);
+
+/** @brief out = poisson(mu), per element mean
+ */
+errno_t rng_philox_poisson_float(RNG_PHILOX  *rng,
+                                 const float *mu,
+                                 float       *out,
+                                 uint64_t     nelement);
+
+#endif
@@ -39,6 +39,8 @@
 #include "COREMOD_memory/COREMOD_memory.h"
 #include "statistic/statistic.h"
 
+#include "rng_philox.h"
+
 /* =============================================================================================== */
 /* =============================================================================================== */
 /*                                  GLOBAL DATA DECLARATION                                        */
@@ -113,6 +115,22 @@ errno_t statistic_putgaussnoise_cli()
     }
 }
 
+errno_t statistic_rngseed_cli()
+{
+
+    if(CLI_checkarg(1, CLIARG_UINT64) == 0)
+    {
+        rng_philox_init(rng_philox_default(),
+                        (uint64_t) data.cmdargtoken[1].val.numl);
+
+        return CLICMD_SUCCESS;
+    }
+    else
+    {
+        return CLICMD_INVALID_ARG;
+    }
+}
+
 /* =============================================================================================== */
 /* =============================================================================================== */
 /*                                    MODULE INITIALIZATION                                        */
@@ -140,6 +158,15 @@ static errno_t init_module_CLI()
                        "long put_gauss_noise(const char *ID_in_name, const "
                        "char *ID_out_name, doule ampl)");
 
+    RegisterCLIcommand("rngseed",
+                       __FILE__,
+                       statistic_rngseed_cli,
+                       "seed parallel random number generator",
+                       "seed",
+                       "rngseed 42",
+                       "errno_t rng_philox_init(RNG_PHILOX *rng, uint64_t "
+                       "seed)");
+
     // add atexit functions here
 
     return RETURN_SUCCESS;
@@ -293,7 +320,6 @@ long put_poisson_noise(const char *ID_in_name, const char *ID_out_name)
 {
     long ID_in;
     long ID_out;
-    long ii;
     long nelements;
     long naxis;
     long i;
@@ -309,12 +335,11 @@ long put_poisson_noise(const char *ID_in_name, const char *ID_out_name)
     copy_image_ID(ID_in_name, ID_out_name, 0);
 
     ID_out = image_ID(ID_out_name);
-    //  srand(time(NULL));
 
-    for(ii = 0; ii < nelements; ii++)
-    {
-        data.image[ID_out].array.F[ii] = poisson(data.image[ID_in].array.F[ii]);
-    }
+    rng_philox_poisson_float(rng_philox_default(),
+                             data.image[ID_in].array.F,
+                             data.image[ID_out].array.F,
+                             nelements);
 
     return (ID_out);
 }
@@ -325,7 +350,6 @@ long put_gauss_noise(const char *ID_in_name,
 {
     long ID_in;
     long ID_out;
-    long ii;
     long nelements;
     long naxis;
     long i;
@@ -341,13 +365,12 @@ long put_gauss_noise(const char *ID_in_name,
     copy_image_ID(ID_in_name, ID_out_name, 0);
 
     ID_out = image_ID(ID_out_name);
-    //  srand(time(NULL));
 
-    for(ii = 0; ii < nelements; ii++)
-    {
-        data.image[ID_out].array.F[ii] =
-            data.image[ID_in].array.F[ii] + ampl * gauss();
-    }
+    rng_philox_addgauss_float(rng_philox_default(),
+                              data.image[ID_in].array.F,
+                              ampl,
+                              data.image[ID_out].array.F,
+                              nelements);
 
     return (ID_out);
 }
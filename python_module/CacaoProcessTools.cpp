@@ -3,6 +3,7 @@
 #include <pybind11/stl.h>
 
 #include "pyFps.hpp"
+#include "pyImageStream.hpp"
 #include "pyProcessInfo.hpp"
 
 namespace py = pybind11;
@@ -367,6 +368,156 @@ Return:
                 strncpy(p->description, name.c_str(), sizeof(p->description));
             });
 
+    py::class_<pyImageStream>(m, "stream")
+        .def(py::init<>(),
+             R"pbdoc(Construct an empty stream object
+)pbdoc")
+
+        .def(py::init<std::string>(),
+             R"pbdoc(Connect to existing shared memory stream
+
+Parameters:
+    name : stream name
+)pbdoc",
+             py::arg("name"))
+
+        .def(
+            "__array__",
+            [](pyImageStream &s, py::object dtype, py::object copy) {
+                py::array arr = s.array();
+                if(!dtype.is_none())
+                {
+                    return py::array(arr.attr("astype")(dtype));
+                }
+                if(!copy.is_none() && copy.cast<bool>())
+                {
+                    return py::array(arr.attr("copy")());
+                }
+                return arr;
+            },
+            R"pbdoc(numpy view of the stream data, for numpy.asarray(stream)
+)pbdoc",
+            py::arg("dtype") = py::none(),
+            py::arg("copy")  = py::none())
+
+        .def("open",
+             &pyImageStream::open,
+             R"pbdoc(Connect to existing shared memory stream
+
+Parameters:
+    name : stream name
+Return:
+    ret : error code
+)pbdoc",
+             py::arg("name"))
+
+        .def("close",
+             &pyImageStream::close,
+             R"pbdoc(Disconnect from stream, shared memory is not removed
+
+Raises RuntimeError while array views exist : delete them first.
+
+Return:
+    ret : error code
+)pbdoc")
+
+        .def_property_readonly("array",
+                               &pyImageStream::array,
+                               R"pbdoc(numpy view of the stream data, no copy
+
+Shape is in C order (z, y, x). The view keeps the shared memory mapping
+alive, even after the stream object is deleted.
+)pbdoc")
+
+        .def_property_readonly("nviews",
+                               &pyImageStream::nviews,
+                               "number of array views holding the mapping")
+
+        .def_property_readonly("name", &pyImageStream::name)
+        .def_property_readonly("cnt0", &pyImageStream::cnt0)
+        .def_property_readonly("cnt1", &pyImageStream::cnt1)
+        .def_property_readonly("shape",
+                               [](pyImageStream &s) {
+                                   return py::tuple(
+                                       py::cast(s.buffer_info().shape));
+                               })
+        .def_property_readonly("dtype",
+                               [](pyImageStream &s) {
+                                   return py::dtype(s.buffer_info());
+                               })
+
+        .def("reserve_semindex",
+             &pyImageStream::reserve_semindex,
+             R"pbdoc(Reserve semaphore index for waits
+
+Parameters:
+    semindex : preferred index, -1 for first available
+Return:
+    semindex : reserved semaphore index
+)pbdoc",
+             py::arg("semindex") = -1)
+
+        .def("semwait",
+             &pyImageStream::semwait,
+             R"pbdoc(Wait for stream update on reserved semaphore, GIL released
+
+Parameters:
+    timeout : timeout [sec], negative waits indefinitely
+Return:
+    ret : True if semaphore was posted, False on timeout
+)pbdoc",
+             py::arg("timeout") = -1.0)
+
+        .def("semflush",
+             &pyImageStream::semflush,
+             R"pbdoc(Drain pending posts on reserved semaphore
+
+Return:
+    ret : error code
+)pbdoc")
+
+        .def("wait_cnt0",
+             &pyImageStream::wait_cnt0,
+             R"pbdoc(Wait until cnt0 moves past value, GIL released
+
+Parameters:
+    cnt : last counter value seen
+    timeout : timeout [sec], negative waits indefinitely
+Return:
+    cnt0 : new counter value, -1 on timeout
+)pbdoc",
+             py::arg("cnt"),
+             py::arg("timeout") = -1.0)
+
+        .def("write_begin",
+             &pyImageStream::write_begin,
+             R"pbdoc(Flag stream as being written, before in-place update
+
+Return:
+    ret : error code
+)pbdoc")
+
+        .def("update",
+             &pyImageStream::update,
+             R"pbdoc(Publish update : increment cnt0, clear write flag, post semaphores
+
+Return:
+    ret : error code
+)pbdoc")
+
+        .def("write",
+             &pyImageStream::write,
+             R"pbdoc(Copy array into stream and publish update
+
+Array must be C-contiguous with stream dtype and size.
+
+Parameters:
+    buf : source array
+Return:
+    ret : error code
+)pbdoc",
+             py::arg("buf"));
+
     py::class_<pyFps>(m, "fps")
         // read-only constructor
         .def(py::init<std::string>(),
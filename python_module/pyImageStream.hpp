@@ -0,0 +1,425 @@
+#ifndef PYIMAGESTREAM_H
+#define PYIMAGESTREAM_H
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+extern "C"
+{
+#include "CLIcore.h"
+}
+
+namespace py = pybind11;
+
+/**
+ * @brief Shared memory image stream, data exposed without copy
+ *
+ * array() returns a numpy view of the shared memory. Shape is in C
+ * order (z, y, x) : the fastest axis, size[0], is last.
+ *
+ * The mapping is reference counted : each view holds a reference in its
+ * base capsule, so the mapping outlives the stream object until the
+ * last view is released. close() is refused while views exist.
+ *
+ * Waits release the GIL. A semaphore index is reserved on first wait.
+ */
+class pyImageStream
+{
+    std::shared_ptr<IMAGE> m_image; // mapping, shared with array views
+    int                    m_semindex;
+
+    void check_open() const
+    {
+        if(!m_image)
+        {
+            throw std::runtime_error("stream not open");
+        }
+    }
+
+    // absolute CLOCK_REALTIME deadline, as expected by sem_timedwait
+    static struct timespec deadline(double timeout)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        long sec  = (long) timeout;
+        long nsec = (long)((timeout - sec) * 1e9);
+        ts.tv_sec += sec;
+        ts.tv_nsec += nsec;
+        if(ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        return ts;
+    }
+
+  public:
+    /**
+    * @brief Construct an empty stream object
+    *
+    */
+    pyImageStream() : m_semindex(-1) {}
+
+    /**
+    * @brief Connect to existing shared memory stream
+    *
+    * @param name : stream name, as in /milk/shm/<name>.im.shm
+    */
+    pyImageStream(std::string name) : m_semindex(-1)
+    {
+        open(name);
+    }
+
+    // mapping is closed when last array view is released
+    ~pyImageStream() = default;
+
+    pyImageStream(const pyImageStream &)            = delete;
+    pyImageStream &operator=(const pyImageStream &) = delete;
+
+    IMAGE *operator->()
+    {
+        check_open();
+        return m_image.get();
+    }
+
+    /**
+    * @brief Connect to existing shared memory stream
+    *
+    * @param name : stream name
+    * @return int : error code
+    */
+    int open(std::string name)
+    {
+        close();
+
+        IMAGE *image = new IMAGE;
+        if(ImageStreamIO_read_sharedmem_image_toIMAGE(name.c_str(), image) !=
+                IMAGESTREAMIO_SUCCESS)
+        {
+            delete image;
+            throw std::runtime_error("cannot open stream " + name);
+        }
+        m_image = std::shared_ptr<IMAGE>(image, [](IMAGE *im) {
+            ImageStreamIO_closeIm(im);
+            delete im;
+        });
+        m_semindex = -1;
+        return EXIT_SUCCESS;
+    }
+
+    /**
+    * @brief Disconnect from stream, shared memory is not removed
+    *
+    * Refused while array views or waits hold the mapping.
+    *
+    * @return int : error code
+    */
+    int close()
+    {
+        if(m_image)
+        {
+            if(m_image.use_count() > 1)
+            {
+                throw std::runtime_error(
+                    "stream " + std::string(m_image->md->name) + " has " +
+                    std::to_string(m_image.use_count() - 1) +
+                    " active array views");
+            }
+            m_image.reset();
+        }
+        m_semindex = -1;
+        return EXIT_SUCCESS;
+    }
+
+    /**
+    * @brief Number of array views holding the mapping
+    *
+    */
+    long nviews() const
+    {
+        return m_image ? m_image.use_count() - 1 : 0;
+    }
+
+    std::string name() const
+    {
+        check_open();
+        return std::string(m_image->md->name);
+    }
+
+    uint64_t cnt0() const
+    {
+        check_open();
+        return m_image->md->cnt0;
+    }
+
+    uint64_t cnt1() const
+    {
+        check_open();
+        return m_image->md->cnt1;
+    }
+
+    /**
+    * @brief Buffer description of the image array, shape in C order
+    *
+    */
+    py::buffer_info buffer_info()
+    {
+        check_open();
+
+        std::string format;
+        switch(m_image->md->datatype)
+        {
+            case _DATATYPE_UINT8:
+                format = py::format_descriptor<uint8_t>::format();
+                break;
+            case _DATATYPE_INT8:
+                format = py::format_descriptor<int8_t>::format();
+                break;
+            case _DATATYPE_UINT16:
+                format = py::format_descriptor<uint16_t>::format();
+                break;
+            case _DATATYPE_INT16:
+                format = py::format_descriptor<int16_t>::format();
+                break;
+            case _DATATYPE_UINT32:
+                format = py::format_descriptor<uint32_t>::format();
+                break;
+            case _DATATYPE_INT32:
+                format = py::format_descriptor<int32_t>::format();
+                break;
+            case _DATATYPE_UINT64:
+                format = py::format_descriptor<uint64_t>::format();
+                break;
+            case _DATATYPE_INT64:
+                format = py::format_descriptor<int64_t>::format();
+                break;
+            case _DATATYPE_HALF:
+                format = "e";
+                break;
+            case _DATATYPE_FLOAT:
+                format = py::format_descriptor<float>::format();
+                break;
+            case _DATATYPE_DOUBLE:
+                format = py::format_descriptor<double>::format();
+                break;
+            case _DATATYPE_COMPLEX_FLOAT:
+                format = "Zf";
+                break;
+            case _DATATYPE_COMPLEX_DOUBLE:
+                format = "Zd";
+                break;
+            default:
+                throw std::runtime_error("unsupported stream datatype");
+        }
+
+        ssize_t itemsize = ImageStreamIO_typesize(m_image->md->datatype);
+        int     naxis    = m_image->md->naxis;
+
+        std::vector<ssize_t> shape(naxis);
+        std::vector<ssize_t> strides(naxis);
+        ssize_t              stride = itemsize;
+        for(int axis = 0; axis < naxis; axis++)
+        {
+            shape[naxis - 1 - axis]   = m_image->md->size[axis];
+            strides[naxis - 1 - axis] = stride;
+            stride *= m_image->md->size[axis];
+        }
+
+        return py::buffer_info(m_image->array.raw,
+                               itemsize,
+                               format,
+                               naxis,
+                               shape,
+                               strides);
+    }
+
+    /**
+    * @brief numpy view of the image array, no copy
+    *
+    * The view base is a capsule holding a reference to the mapping.
+    */
+    py::array array()
+    {
+        py::buffer_info info  = buffer_info();
+        auto           *owner = new std::shared_ptr<IMAGE>(m_image);
+        py::capsule     base(owner, [](void *p) {
+            delete static_cast<std::shared_ptr<IMAGE> *>(p);
+        });
+        return py::array(py::dtype(info),
+                         info.shape,
+                         info.strides,
+                         info.ptr,
+                         base);
+    }
+
+    /**
+    * @brief Reserve semaphore index for waits
+    *
+    * @param semindex : preferred index, -1 for first available
+    * @return int : semaphore index
+    */
+    int reserve_semindex(int semindex)
+    {
+        check_open();
+        int sem = ImageStreamIO_getsemwaitindex(m_image.get(), semindex);
+        if(sem < 0)
+        {
+            throw std::runtime_error("no semaphore available on stream " +
+                                     std::string(m_image->md->name));
+        }
+        m_semindex = sem;
+        return m_semindex;
+    }
+
+    int semindex()
+    {
+        if(m_semindex == -1)
+        {
+            reserve_semindex(-1);
+        }
+        return m_semindex;
+    }
+
+    /**
+    * @brief Wait for stream update on reserved semaphore, GIL released
+    *
+    * @param timeout : timeout [sec], negative waits indefinitely
+    * @return bool : true if semaphore was posted, false on timeout
+    */
+    bool semwait(double timeout)
+    {
+        int sem = semindex();
+
+        // hold mapping while GIL is released
+        std::shared_ptr<IMAGE> image = m_image;
+
+        py::gil_scoped_release release;
+        if(timeout < 0.0)
+        {
+            return ImageStreamIO_semwait(image.get(), sem) == 0;
+        }
+        struct timespec ts = deadline(timeout);
+        return ImageStreamIO_semtimedwait(image.get(), sem, &ts) == 0;
+    }
+
+    /**
+    * @brief Drain pending posts on reserved semaphore
+    *
+    * @return int : error code
+    */
+    int semflush()
+    {
+        int sem = semindex();
+        ImageStreamIO_semflush(m_image.get(), sem);
+        return EXIT_SUCCESS;
+    }
+
+    /**
+    * @brief Wait until cnt0 moves past value, GIL released
+    *
+    * Stale semaphore posts are absorbed by re-checking cnt0 after
+    * every wake-up.
+    *
+    * @param cnt : last counter value seen
+    * @param timeout : timeout [sec], negative waits indefinitely
+    * @return int64_t : new cnt0, -1 on timeout
+    */
+    int64_t wait_cnt0(uint64_t cnt, double timeout)
+    {
+        int sem = semindex();
+
+        // hold mapping while GIL is released
+        std::shared_ptr<IMAGE> image = m_image;
+
+        py::gil_scoped_release release;
+        struct timespec ts = deadline(timeout < 0.0 ? 0.0 : timeout);
+        while(image->md->cnt0 <= cnt)
+        {
+            if(timeout < 0.0)
+            {
+                ImageStreamIO_semwait(image.get(), sem);
+            }
+            else if(ImageStreamIO_semtimedwait(image.get(), sem, &ts) != 0)
+            {
+                if(image->md->cnt0 > cnt)
+                {
+                    break;
+                }
+                return -1;
+            }
+        }
+        return image->md->cnt0;
+    }
+
+    /**
+    * @brief Flag stream as being written, before in-place update
+    *
+    * @return int : error code
+    */
+    int write_begin()
+    {
+        check_open();
+        m_image->md->write = 1;
+        return EXIT_SUCCESS;
+    }
+
+    /**
+    * @brief Publish update : increment cnt0, clear write flag, timestamp
+    * and post all semaphores
+    *
+    * @return int : error code
+    */
+    int update()
+    {
+        check_open();
+        m_image->md->write = 0;
+        ImageStreamIO_UpdateIm(m_image.get());
+        return EXIT_SUCCESS;
+    }
+
+    /**
+    * @brief Copy buffer into stream and publish update
+    *
+    * Buffer must be C-contiguous with the stream datatype and number of
+    * elements. Copy runs with GIL released.
+    *
+    * @param buf : source buffer
+    * @return int : error code
+    */
+    int write(py::buffer buf)
+    {
+        py::buffer_info src = buf.request();
+        py::buffer_info dst = buffer_info();
+
+        if((src.itemsize != dst.itemsize) || (src.size != dst.size) ||
+                (!py::dtype(src).equal(py::dtype(dst))))
+        {
+            throw std::runtime_error("buffer datatype or size mismatch");
+        }
+        ssize_t stride = src.itemsize;
+        for(ssize_t axis = src.ndim - 1; axis >= 0; axis--)
+        {
+            if(src.strides[axis] != stride)
+            {
+                throw std::runtime_error("buffer is not C-contiguous");
+            }
+            stride *= src.shape[axis];
+        }
+
+        write_begin();
+        {
+            std::shared_ptr<IMAGE> image = m_image;
+            py::gil_scoped_release release;
+            memcpy(dst.ptr, src.ptr, src.size * src.itemsize);
+        }
+        return update();
+    }
+};
+
+#endif
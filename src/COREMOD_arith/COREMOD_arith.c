@@ -51,6 +51,7 @@
 
 #include "image_crop.h"
 #include "image_cropmask.h"
+#include "image_cropmulti.h"
 #include "image_dxdy.h"
 #include "image_norm.h"
 #include "image_slicenormalize.h"
@@ -75,6 +76,7 @@
 #include "image_arith__im_f__im.h"
 #include "image_arith__im_f_f__im.h"
 #include "image_arith__im_im__im.h"
+#include "image_axisreduce.h"
 #include "mathfuncs.h"
 
 #include "execute_arith.h"
@@ -103,6 +105,7 @@ static errno_t init_module_CLI()
     CLIADDCMD_COREMOD_arith__image_slicenormalize();
 
     CLIADDCMD_COREMODE_arith__cropmask();
+    CLIADDCMD_COREMOD_arith__cropmulti();
 
     CLIADDCMD_COREMOD_arith__imset_1Dpixrange();
     CLIADDCMD_COREMOD_arith__imset_2Dpix();
@@ -116,6 +119,8 @@ static errno_t init_module_CLI()
 
     CLIADDCMD_COREMOD_arith__image_unfold();
 
+    CLIADDCMD_COREMOD_arith__imaxisreduce();
+
     return RETURN_SUCCESS;
 }
 
@@ -0,0 +1,682 @@
+/**
+ * @file    image_axisreduce.c
+ * @brief   reduce image along axis : sum, mean, min, max, variance
+ *
+ * Reduced axes form a contiguous range [axis0, axis1]. The input is
+ * viewed as outer x nred x inner, where inner is the product of sizes
+ * below axis0, so that each reduction step reads a contiguous row of
+ * inner elements.
+ *
+ * Rows are processed in tiles that fit in cache : each thread owns a
+ * tile of accumulators and streams through the reduced axis, instead
+ * of striding across whole frames for every output pixel.
+ * All operations requested are computed in a single pass.
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "image_axisreduce.h"
+
+#define OMP_NELEMENT_LIMIT 1000000
+
+// accumulator tile size [element]
+#define AXISREDUCE_TILE 1024
+
+
+
+static char *inimname;
+
+static char *outimname;
+
+static uint32_t *axis0;
+static long      fpi_axis0 = -1;
+
+static uint32_t *axis1;
+static long      fpi_axis1 = -1;
+
+static char *opname;
+
+static char *weightimname;
+
+
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_IMG,
+        ".inim",
+        "input image",
+        "im",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &inimname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outim",
+        "output image",
+        "imout",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outimname,
+        NULL
+    },
+    {
+        CLIARG_UINT32,
+        ".axis0",
+        "first reduced axis",
+        "2",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &axis0,
+        &fpi_axis0
+    },
+    {
+        CLIARG_UINT32,
+        ".axis1",
+        "last reduced axis",
+        "2",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &axis1,
+        &fpi_axis1
+    },
+    {
+        CLIARG_STR,
+        ".op",
+        "sum, mean, min, max, sumsq, var or std",
+        "sum",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &opname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".weight",
+        "optional weight image, size of reduced axes",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &weightimname,
+        NULL
+    }
+};
+
+
+
+
+static CLICMDDATA CLIcmddata =
+{
+    "imaxisreduce",
+    "reduce image along axes",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Reduce image along axes axis0 to axis1 (inclusive)\n");
+    printf("Example: axis0=2 axis1=2 collapses cube along z\n");
+    printf("         axis0=0 axis1=1 computes per-slice statistics\n");
+    printf("Operations: sum, mean, min, max, sumsq, var, std\n");
+    printf("If weight image is provided, sums, mean and variance are\n");
+    printf("weighted, and zero-weight elements are excluded from min and max\n");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Convert n elements of image, starting at offset, to double
+ */
+static inline void axisreduce_load(
+    const IMGID *img,
+    uint64_t     offset,
+    uint64_t     n,
+    double *__restrict buf
+)
+{
+    switch(img->datatype)
+    {
+        case _DATATYPE_FLOAT:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.F[offset + ii];
+            }
+            break;
+        case _DATATYPE_DOUBLE:
+            memcpy(buf, &img->im->array.D[offset], sizeof(double) * n);
+            break;
+        case _DATATYPE_UINT8:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.UI8[offset + ii];
+            }
+            break;
+        case _DATATYPE_INT8:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.SI8[offset + ii];
+            }
+            break;
+        case _DATATYPE_UINT16:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.UI16[offset + ii];
+            }
+            break;
+        case _DATATYPE_INT16:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.SI16[offset + ii];
+            }
+            break;
+        case _DATATYPE_UINT32:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.UI32[offset + ii];
+            }
+            break;
+        case _DATATYPE_INT32:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.SI32[offset + ii];
+            }
+            break;
+        case _DATATYPE_UINT64:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.UI64[offset + ii];
+            }
+            break;
+        case _DATATYPE_INT64:
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                buf[ii] = img->im->array.SI64[offset + ii];
+            }
+            break;
+    }
+}
+
+
+
+
+/**
+ * @brief Write requested outputs of one element from accumulators
+ *
+ * Accumulators hold shifted sums, s1 = sum w (x-K), s2 = sum w (x-K)^2,
+ * to limit round-off in variance.
+ */
+static inline void axisreduce_store(
+    double   *outarray[IMAXISREDUCE_NBOP],
+    uint64_t  outi,
+    double    K,
+    double    s1,
+    double    s2,
+    double    vmin,
+    double    vmax,
+    double    wsum
+)
+{
+    // zero total weight : mean and variance undefined, reported as 0
+    double mean = 0.0;
+    double var  = 0.0;
+    if(wsum != 0.0)
+    {
+        mean = s1 / wsum;
+        var  = s2 / wsum - mean * mean;
+        if(var < 0.0)
+        {
+            var = 0.0;
+        }
+    }
+
+    if(outarray[0] != NULL)
+    {
+        outarray[0][outi] = s1 + K * wsum;
+    }
+    if(outarray[1] != NULL)
+    {
+        outarray[1][outi] = (wsum != 0.0) ? K + mean : 0.0;
+    }
+    if(outarray[2] != NULL)
+    {
+        outarray[2][outi] = vmin;
+    }
+    if(outarray[3] != NULL)
+    {
+        outarray[3][outi] = vmax;
+    }
+    if(outarray[4] != NULL)
+    {
+        outarray[4][outi] = s2 + 2.0 * K * s1 + K * K * wsum;
+    }
+    if(outarray[5] != NULL)
+    {
+        outarray[5][outi] = var;
+    }
+    if(outarray[6] != NULL)
+    {
+        outarray[6][outi] = sqrt(var);
+    }
+}
+
+
+
+
+/**
+ * @brief Reduce image along axes axis0..axis1, to double arrays
+ *
+ * outarray holds IMAXISREDUCE_NBOP pointers, in the order of op bits.
+ * Arrays for operations in opmask must be allocated by caller, with one
+ * element per non-reduced pixel, in input order.
+ * weight is NULL or holds one value per reduced element.
+ */
+errno_t image_axisreduce_array(
+    IMGID        imgin,
+    uint8_t      axis0,
+    uint8_t      axis1,
+    const float *weight,
+    uint32_t     opmask,
+    double      *outarray[IMAXISREDUCE_NBOP]
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    if((axis1 < axis0) || (axis1 >= imgin.md->naxis))
+    {
+        FUNC_RETURN_FAILURE("invalid axis range %u-%u for %u-axis image",
+                            axis0, axis1, imgin.md->naxis);
+    }
+    if((imgin.datatype == _DATATYPE_COMPLEX_FLOAT) ||
+            (imgin.datatype == _DATATYPE_COMPLEX_DOUBLE))
+    {
+        FUNC_RETURN_FAILURE("complex datatype not supported");
+    }
+
+    uint64_t inner = 1;
+    uint64_t nred  = 1;
+    uint64_t outer = 1;
+    for(uint8_t ax = 0; ax < imgin.md->naxis; ax++)
+    {
+        if(ax < axis0)
+        {
+            inner *= imgin.md->size[ax];
+        }
+        else if(ax <= axis1)
+        {
+            nred *= imgin.md->size[ax];
+        }
+        else
+        {
+            outer *= imgin.md->size[ax];
+        }
+    }
+
+    double *out[IMAXISREDUCE_NBOP];
+    for(int op = 0; op < IMAXISREDUCE_NBOP; op++)
+    {
+        out[op] = (opmask & (1U << op)) ? outarray[op] : NULL;
+    }
+    int dominmax = ((opmask & (IMAXISREDUCE_MIN | IMAXISREDUCE_MAX)) != 0);
+
+    // zero-weight elements are skipped, so that NaN or Inf they may hold
+    // does not reach the sums. Shift K is read from first weighted element
+    double   wsum = nred;
+    uint64_t kref = 0;
+    if(weight != NULL)
+    {
+        wsum = 0.0;
+        for(uint64_t k = 0; k < nred; k++)
+        {
+            wsum += weight[k];
+        }
+        while((kref + 1 < nred) && (weight[kref] == 0.0))
+        {
+            kref++;
+        }
+    }
+
+
+    if(inner == 1)
+    {
+        // reduced elements are contiguous : scalar accumulators
+        //
+#ifdef _OPENMP
+        #pragma omp parallel for if (outer * nred > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t o = 0; o < outer; o++)
+        {
+            double buf[AXISREDUCE_TILE];
+            double K    = 0.0;
+            double s1   = 0.0;
+            double s2   = 0.0;
+            double vmin = INFINITY;
+            double vmax = -INFINITY;
+
+            axisreduce_load(&imgin, o * nred + kref, 1, &K);
+
+            for(uint64_t k0 = 0; k0 < nred; k0 += AXISREDUCE_TILE)
+            {
+                uint64_t n = nred - k0;
+                if(n > AXISREDUCE_TILE)
+                {
+                    n = AXISREDUCE_TILE;
+                }
+                axisreduce_load(&imgin, o * nred + k0, n, buf);
+
+                if(weight == NULL)
+                {
+#ifdef _OPENMP
+                    #pragma omp simd reduction(+:s1,s2)
+#endif
+                    for(uint64_t k = 0; k < n; k++)
+                    {
+                        double d = buf[k] - K;
+                        s1 += d;
+                        s2 += d * d;
+                    }
+                }
+                else
+                {
+#ifdef _OPENMP
+                    #pragma omp simd reduction(+:s1,s2)
+#endif
+                    for(uint64_t k = 0; k < n; k++)
+                    {
+                        double w = weight[k0 + k];
+                        double d = (w != 0.0) ? buf[k] - K : 0.0;
+                        s1 += w * d;
+                        s2 += w * d * d;
+                    }
+                }
+
+                if(dominmax)
+                {
+                    for(uint64_t k = 0; k < n; k++)
+                    {
+                        if((weight != NULL) && (weight[k0 + k] == 0.0))
+                        {
+                            continue;
+                        }
+                        vmin = (buf[k] < vmin) ? buf[k] : vmin;
+                        vmax = (buf[k] > vmax) ? buf[k] : vmax;
+                    }
+                }
+            }
+
+            axisreduce_store(out, o, K, s1, s2, vmin, vmax, wsum);
+        }
+    }
+    else
+    {
+        // slice-major : stream rows of inner elements, tiled
+        //
+        uint64_t NBtile = (inner + AXISREDUCE_TILE - 1) / AXISREDUCE_TILE;
+
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic) if (outer * nred * inner > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t ot = 0; ot < outer * NBtile; ot++)
+        {
+            uint64_t o  = ot / NBtile;
+            uint64_t i0 = (ot % NBtile) * AXISREDUCE_TILE;
+            uint64_t n  = inner - i0;
+            if(n > AXISREDUCE_TILE)
+            {
+                n = AXISREDUCE_TILE;
+            }
+
+            double buf[AXISREDUCE_TILE];
+            double K[AXISREDUCE_TILE];
+            double s1[AXISREDUCE_TILE];
+            double s2[AXISREDUCE_TILE];
+            double vmin[AXISREDUCE_TILE];
+            double vmax[AXISREDUCE_TILE];
+
+            uint64_t offset0 = o * nred * inner + i0;
+
+            axisreduce_load(&imgin, offset0 + kref * inner, n, K);
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                s1[ii]   = 0.0;
+                s2[ii]   = 0.0;
+                vmin[ii] = INFINITY;
+                vmax[ii] = -INFINITY;
+            }
+
+            for(uint64_t k = 0; k < nred; k++)
+            {
+                double w = (weight == NULL) ? 1.0 : weight[k];
+                if(w == 0.0)
+                {
+                    // whole row masked
+                    continue;
+                }
+
+                axisreduce_load(&imgin, offset0 + k * inner, n, buf);
+
+#ifdef _OPENMP
+                #pragma omp simd
+#endif
+                for(uint64_t ii = 0; ii < n; ii++)
+                {
+                    double d = buf[ii] - K[ii];
+                    s1[ii] += w * d;
+                    s2[ii] += w * d * d;
+                }
+
+                if(dominmax)
+                {
+#ifdef _OPENMP
+                    #pragma omp simd
+#endif
+                    for(uint64_t ii = 0; ii < n; ii++)
+                    {
+                        vmin[ii] = (buf[ii] < vmin[ii]) ? buf[ii] : vmin[ii];
+                        vmax[ii] = (buf[ii] > vmax[ii]) ? buf[ii] : vmax[ii];
+                    }
+                }
+            }
+
+            for(uint64_t ii = 0; ii < n; ii++)
+            {
+                axisreduce_store(out, o * inner + i0 + ii,
+                                 K[ii], s1[ii], s2[ii], vmin[ii], vmax[ii],
+                                 wsum);
+            }
+        }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Reduce image along axes axis0..axis1, single operation
+ *
+ * Output image has reduced axes removed.
+ * Output datatype is double for double input, float otherwise.
+ * imgweight is optional (ID = -1 if not used).
+ */
+errno_t image_axisreduce(
+    IMGID    imgin,
+    IMGID   *imgout,
+    uint8_t  axis0,
+    uint8_t  axis1,
+    uint32_t op,
+    IMGID    imgweight
+)
+{
+    DEBUG_TRACE_FSTART();
+
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    int opindex = -1;
+    for(int opi = 0; opi < IMAXISREDUCE_NBOP; opi++)
+    {
+        if(op == (1U << opi))
+        {
+            opindex = opi;
+        }
+    }
+    if(opindex == -1)
+    {
+        FUNC_RETURN_FAILURE("op must be a single operation");
+    }
+    if((axis1 < axis0) || (axis1 >= imgin.md->naxis))
+    {
+        FUNC_RETURN_FAILURE("invalid axis range %u-%u for %u-axis image",
+                            axis0, axis1, imgin.md->naxis);
+    }
+
+    // output shape : non-reduced axes
+    //
+    uint32_t outsize[3] = {1, 1, 1};
+    int      outnaxis   = 0;
+    uint64_t nred       = 1;
+    for(uint8_t ax = 0; ax < imgin.md->naxis; ax++)
+    {
+        if((ax >= axis0) && (ax <= axis1))
+        {
+            nred *= imgin.md->size[ax];
+        }
+        else
+        {
+            outsize[outnaxis] = imgin.md->size[ax];
+            outnaxis++;
+        }
+    }
+    if(outnaxis < 2)
+    {
+        outnaxis = 2;
+    }
+
+    const float *weight = NULL;
+    if(imgweight.ID != -1)
+    {
+        resolveIMGID(&imgweight, ERRMODE_ABORT);
+        if((imgweight.md->nelement != nred) ||
+                (imgweight.md->datatype != _DATATYPE_FLOAT))
+        {
+            FUNC_RETURN_FAILURE("weight must be float, %lu elements",
+                                (unsigned long) nred);
+        }
+        weight = imgweight.im->array.F;
+    }
+
+    imgout->naxis   = outnaxis;
+    imgout->size[0] = outsize[0];
+    imgout->size[1] = outsize[1];
+    imgout->size[2] = outsize[2];
+    imgout->datatype = (imgin.datatype == _DATATYPE_DOUBLE) ?
+                       _DATATYPE_DOUBLE : _DATATYPE_FLOAT;
+    createimagefromIMGID(imgout);
+
+    uint64_t nout = imgout->md->nelement;
+
+    double *outarray[IMAXISREDUCE_NBOP];
+    for(int opi = 0; opi < IMAXISREDUCE_NBOP; opi++)
+    {
+        outarray[opi] = NULL;
+    }
+    if(imgout->datatype == _DATATYPE_DOUBLE)
+    {
+        outarray[opindex] = imgout->im->array.D;
+    }
+    else
+    {
+        outarray[opindex] = (double *) malloc(sizeof(double) * nout);
+        if(outarray[opindex] == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+    }
+
+    FUNC_CHECK_RETURN(
+        image_axisreduce_array(imgin, axis0, axis1, weight, op, outarray));
+
+    if(imgout->datatype == _DATATYPE_FLOAT)
+    {
+        for(uint64_t ii = 0; ii < nout; ii++)
+        {
+            imgout->im->array.F[ii] = outarray[opindex][ii];
+        }
+        free(outarray[opindex]);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    uint32_t op = 0;
+    const char *opnames[IMAXISREDUCE_NBOP] =
+    {"sum", "mean", "min", "max", "sumsq", "var", "std"};
+    for(int opi = 0; opi < IMAXISREDUCE_NBOP; opi++)
+    {
+        if(strcmp(opname, opnames[opi]) == 0)
+        {
+            op = 1U << opi;
+        }
+    }
+    if(op == 0)
+    {
+        FUNC_RETURN_FAILURE("unknown operation %s", opname);
+    }
+
+    uint8_t ax1 = *axis1;
+    if(ax1 < *axis0)
+    {
+        ax1 = *axis0;
+    }
+
+    IMGID imgweight = mkIMGID_from_name(weightimname);
+    resolveIMGID(&imgweight, ERRMODE_NULL);
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_START
+    {
+        IMGID imgout = mkIMGID_from_name(outimname);
+        FUNC_CHECK_RETURN(image_axisreduce(mkIMGID_from_name(inimname),
+                                           &imgout,
+                                           *axis0,
+                                           ax1,
+                                           op,
+                                           imgweight));
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+
+// Register function in CLI
+errno_t
+CLIADDCMD_COREMOD_arith__imaxisreduce()
+{
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
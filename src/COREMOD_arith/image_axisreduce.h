@@ -0,0 +1,36 @@
+#ifndef COREMOD_ARITH_IMAGE_AXISREDUCE_H
+#define COREMOD_ARITH_IMAGE_AXISREDUCE_H
+
+// reduction operations, can be combined as bitmask
+// weighted if weight vector is provided
+#define IMAXISREDUCE_SUM   0x0001
+#define IMAXISREDUCE_MEAN  0x0002
+#define IMAXISREDUCE_MIN   0x0004
+#define IMAXISREDUCE_MAX   0x0008
+#define IMAXISREDUCE_SUMSQ 0x0010
+#define IMAXISREDUCE_VAR   0x0020
+#define IMAXISREDUCE_STD   0x0040
+
+#define IMAXISREDUCE_NBOP 7
+
+errno_t image_axisreduce_array(
+    IMGID        imgin,
+    uint8_t      axis0,
+    uint8_t      axis1,
+    const float *weight,
+    uint32_t     opmask,
+    double      *outarray[IMAXISREDUCE_NBOP]
+);
+
+errno_t image_axisreduce(
+    IMGID    imgin,
+    IMGID   *imgout,
+    uint8_t  axis0,
+    uint8_t  axis1,
+    uint32_t op,
+    IMGID    imgweight
+);
+
+errno_t CLIADDCMD_COREMOD_arith__imaxisreduce();
+
+#endif
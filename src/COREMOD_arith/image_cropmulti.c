@@ -0,0 +1,510 @@
+/**
+ * @file    image_cropmulti.c
+ * @brief   extract multiple regions of interest from stream
+ *
+ * All regions are extracted on a single wake-up per input frame, to
+ * separate output streams or to one packed stream.
+ *
+ * Regions are defined by image .roi :
+ * - roimode rect : 4 x NBroi image, one row per region :
+ *                  xstart ystart xsize ysize
+ * - roimode mask : same size as input, pixel value k > 0 assigns pixel
+ *                  to region k-1, 0 is not extracted. Values must cover
+ *                  1..NBroi, empty regions are rejected
+ *
+ * Separate outputs are named <outim>_00, <outim>_01 ...
+ * Rectangular regions are xsize x ysize images, mask regions are
+ * NBpix x 1 images of the region pixels in raster order.
+ * Packed output <outim> is NBpixtot x 1, regions in index order.
+ *
+ * Extraction is compiled into runs (one per region row), see
+ * COREMOD_memory/pixremap.c
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "COREMOD_memory/pixremap.h"
+
+// input stream
+//
+static char *insname;
+
+// region definition image
+//
+static char *roisname;
+
+// rect or mask
+//
+static char *roimode;
+
+static LOCVAR_OUTIMG2D outim;
+
+// 1 : single packed output
+//
+static int64_t *packed;
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        CLIARG_IMG,
+        ".insname",
+        "input image name",
+        "inim",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &insname,
+        NULL
+    },
+    {
+        CLIARG_IMG,
+        ".roi",
+        "region definition image",
+        "roiim",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &roisname,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".roimode",
+        "region definition: rect or mask",
+        "rect",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &roimode,
+        NULL
+    },
+    FARG_OUTIM_NAME(outim),
+    FARG_OUTIM_SHARED(outim),
+    {
+        CLIARG_ONOFF,
+        ".packed",
+        "single packed output",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &packed,
+        NULL
+    }
+};
+
+static CLICMDDATA CLIcmddata =
+{
+    "cropmulti", "extract multiple regions from image", CLICMD_FIELDS_DEFAULTS
+};
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Extract regions of interest from input, single pass per frame\n");
+    printf("roimode rect : roi image is 4 x NBroi, rows xstart ystart "
+           "xsize ysize\n");
+    printf("roimode mask : roi image same size as input, value k>0 assigns "
+           "pixel to region k-1\n");
+    printf("               every value 1..max must be used, no empty "
+           "region\n");
+    printf("Outputs <outim>_00, <outim>_01 ..., or <outim> if .packed ON\n");
+
+    return RETURN_SUCCESS;
+}
+
+// region definition pixel value, any real datatype
+//
+static long roi_pixval(IMGID img, uint64_t ii)
+{
+    switch(img.md->datatype)
+    {
+        case _DATATYPE_FLOAT:
+            return (long) img.im->array.F[ii];
+        case _DATATYPE_DOUBLE:
+            return (long) img.im->array.D[ii];
+        case _DATATYPE_UINT8:
+            return (long) img.im->array.UI8[ii];
+        case _DATATYPE_INT8:
+            return (long) img.im->array.SI8[ii];
+        case _DATATYPE_UINT16:
+            return (long) img.im->array.UI16[ii];
+        case _DATATYPE_INT16:
+            return (long) img.im->array.SI16[ii];
+        case _DATATYPE_UINT32:
+            return (long) img.im->array.UI32[ii];
+        case _DATATYPE_INT32:
+            return (long) img.im->array.SI32[ii];
+        case _DATATYPE_UINT64:
+            return (long) img.im->array.UI64[ii];
+        case _DATATYPE_INT64:
+            return (long) img.im->array.SI64[ii];
+        default:
+            return 0;
+    }
+}
+
+static IMGID cropmulti_outimg(char    *name,
+                              uint32_t shared,
+                              uint32_t xsize,
+                              uint32_t ysize,
+                              uint8_t  datatype)
+{
+    IMGID imgout = mkIMGID_from_name(name);
+    imgout.shared = shared;
+    if(shared == 1)
+    {
+        imgout = stream_connect_create_2D(name, xsize, ysize, datatype);
+    }
+    else
+    {
+        imgout.naxis    = 2;
+        imgout.size[0]  = xsize;
+        imgout.size[1]  = ysize;
+        imgout.datatype = datatype;
+        createimagefromIMGID(&imgout);
+    }
+    imcreateIMGID(&imgout);
+
+    return imgout;
+}
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+    // connect to input
+    //
+    IMGID imgin = mkIMGID_from_name(insname);
+    resolveIMGID(&imgin, ERRMODE_ABORT);
+
+    // Set input to be the trigger
+    strcpy(CLIcmddata.cmdsettings->triggerstreamname, insname);
+    // for FPS mode:
+    if(data.fpsptr != NULL)
+    {
+        strcpy(data.fpsptr->cmdset.triggerstreamname, insname);
+    }
+
+    uint32_t xsize  = imgin.md->size[0];
+    uint32_t ysize  = imgin.md->naxis > 1 ? imgin.md->size[1] : 1;
+    uint64_t insize = (uint64_t) xsize * ysize;
+
+    IMGID imgroi = mkIMGID_from_name(roisname);
+    resolveIMGID(&imgroi, ERRMODE_ABORT);
+
+    int maskmode = 0;
+    if(strcmp(roimode, "mask") == 0)
+    {
+        maskmode = 1;
+    }
+    else if(strcmp(roimode, "rect") != 0)
+    {
+        FUNC_RETURN_FAILURE("roimode %s invalid, must be rect or mask",
+                            roimode);
+    }
+
+    // region sizes
+    //
+    long      NBroi;
+    uint32_t *roixsize;
+    uint32_t *roiysize;
+
+    if(maskmode == 1)
+    {
+        if(imgroi.md->nelement != insize)
+        {
+            FUNC_RETURN_FAILURE("mask %s size %lu does not match input %lu",
+                                roisname,
+                                imgroi.md->nelement,
+                                insize);
+        }
+        NBroi = 0;
+        for(uint64_t ii = 0; ii < insize; ii++)
+        {
+            long k = roi_pixval(imgroi, ii);
+            if(k > NBroi)
+            {
+                NBroi = k;
+            }
+        }
+    }
+    else
+    {
+        if(imgroi.md->size[0] != 4)
+        {
+            FUNC_RETURN_FAILURE("rect roi image %s must be 4 x NBroi",
+                                roisname);
+        }
+        NBroi = imgroi.md->nelement / 4;
+    }
+    if(NBroi == 0)
+    {
+        FUNC_RETURN_FAILURE("no region defined in %s", roisname);
+    }
+
+    roixsize = (uint32_t *) calloc(NBroi, sizeof(uint32_t));
+    roiysize = (uint32_t *) calloc(NBroi, sizeof(uint32_t));
+    if((roixsize == NULL) || (roiysize == NULL))
+    {
+        PRINT_ERROR("calloc returns NULL pointer");
+        abort();
+    }
+
+    if(maskmode == 1)
+    {
+        for(uint64_t ii = 0; ii < insize; ii++)
+        {
+            long k = roi_pixval(imgroi, ii);
+            if(k > 0)
+            {
+                roixsize[k - 1]++;
+            }
+        }
+        for(long r = 0; r < NBroi; r++)
+        {
+            if(roixsize[r] == 0)
+            {
+                free(roixsize);
+                free(roiysize);
+                FUNC_RETURN_FAILURE("region %ld (mask value %ld) is empty",
+                                    r,
+                                    r + 1);
+            }
+            roiysize[r] = 1;
+        }
+    }
+    else
+    {
+        for(long r = 0; r < NBroi; r++)
+        {
+            long x0 = roi_pixval(imgroi, 4 * r);
+            long y0 = roi_pixval(imgroi, 4 * r + 1);
+            long xs = roi_pixval(imgroi, 4 * r + 2);
+            long ys = roi_pixval(imgroi, 4 * r + 3);
+            if((x0 < 0) || (y0 < 0) || (xs < 1) || (ys < 1) ||
+                    (x0 + xs > xsize) || (y0 + ys > ysize))
+            {
+                free(roixsize);
+                free(roiysize);
+                FUNC_RETURN_FAILURE(
+                    "region %ld [%ld %ld %ld %ld] outside input %u x %u",
+                    r,
+                    x0,
+                    y0,
+                    xs,
+                    ys,
+                    xsize,
+                    ysize);
+            }
+            roixsize[r] = xs;
+            roiysize[r] = ys;
+        }
+    }
+
+    // pixel offset of each region in packed output
+    //
+    uint64_t *roioffset = (uint64_t *) malloc(sizeof(uint64_t) * (NBroi + 1));
+    if(roioffset == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    roioffset[0] = 0;
+    for(long r = 0; r < NBroi; r++)
+    {
+        roioffset[r + 1] = roioffset[r] + (uint64_t) roixsize[r] * roiysize[r];
+    }
+    uint64_t NBpixtot = roioffset[NBroi];
+
+    // (output, input) pixel pairs, output index within packed output
+    //
+    uint64_t *outindex = (uint64_t *) malloc(sizeof(uint64_t) * NBpixtot);
+    uint64_t *inindex  = (uint64_t *) malloc(sizeof(uint64_t) * NBpixtot);
+    if((outindex == NULL) || (inindex == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    if(maskmode == 1)
+    {
+        uint64_t *fill = (uint64_t *) malloc(sizeof(uint64_t) * NBroi);
+        if(fill == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        memcpy(fill, roioffset, sizeof(uint64_t) * NBroi);
+        for(uint64_t ii = 0; ii < insize; ii++)
+        {
+            long k = roi_pixval(imgroi, ii);
+            if(k > 0)
+            {
+                outindex[fill[k - 1]] = fill[k - 1];
+                inindex[fill[k - 1]]  = ii;
+                fill[k - 1]++;
+            }
+        }
+        free(fill);
+    }
+    else
+    {
+        for(long r = 0; r < NBroi; r++)
+        {
+            long     x0 = roi_pixval(imgroi, 4 * r);
+            long     y0 = roi_pixval(imgroi, 4 * r + 1);
+            uint64_t k  = roioffset[r];
+            for(uint32_t jj = 0; jj < roiysize[r]; jj++)
+            {
+                for(uint32_t ii = 0; ii < roixsize[r]; ii++)
+                {
+                    outindex[k] = k;
+                    inindex[k]  = (uint64_t)(y0 + jj) * xsize + x0 + ii;
+                    k++;
+                }
+            }
+        }
+    }
+
+    // compile remap(s), create output(s)
+    //
+    long      NBout = (*packed == 1) ? 1 : NBroi;
+    PIXREMAP *rmap  = (PIXREMAP *) malloc(sizeof(PIXREMAP) * NBout);
+    IMGID    *imgout = (IMGID *) malloc(sizeof(IMGID) * NBout);
+    if((rmap == NULL) || (imgout == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    long NBcompiled = 0;
+    if(*packed == 1)
+    {
+        if(pixremap_compile(&rmap[0], outindex, inindex, NBpixtot) ==
+                RETURN_SUCCESS)
+        {
+            NBcompiled = 1;
+        }
+    }
+    else
+    {
+        for(long r = 0; r < NBroi; r++)
+        {
+            // output index relative to region
+            for(uint64_t k = roioffset[r]; k < roioffset[r + 1]; k++)
+            {
+                outindex[k] -= roioffset[r];
+            }
+            if(pixremap_compile(&rmap[r],
+                                outindex + roioffset[r],
+                                inindex + roioffset[r],
+                                roioffset[r + 1] - roioffset[r]) !=
+                    RETURN_SUCCESS)
+            {
+                break;
+            }
+            NBcompiled++;
+        }
+    }
+    free(outindex);
+    free(inindex);
+
+    if(NBcompiled < NBout)
+    {
+        for(long o = 0; o < NBcompiled; o++)
+        {
+            pixremap_free(&rmap[o]);
+        }
+        free(rmap);
+        free(imgout);
+        free(roioffset);
+        free(roixsize);
+        free(roiysize);
+        FUNC_RETURN_FAILURE("cannot compile remap for %s", roisname);
+    }
+
+    if(*packed == 1)
+    {
+        imgout[0] = cropmulti_outimg(outim.name,
+                                     *outim.shared,
+                                     NBpixtot,
+                                     1,
+                                     imgin.md->datatype);
+        printf("%ld regions packed, %lu pixels : %lu runs, %lu gathers\n",
+               NBroi,
+               rmap[0].NBpix,
+               rmap[0].NBseg,
+               rmap[0].NBgat);
+    }
+    else
+    {
+        for(long r = 0; r < NBroi; r++)
+        {
+            char outname[STRINGMAXLEN_IMAGE_NAME];
+            WRITE_IMAGENAME(outname, "%s_%02ld", outim.name, r);
+            imgout[r] = cropmulti_outimg(outname,
+                                         *outim.shared,
+                                         roixsize[r],
+                                         roiysize[r],
+                                         imgin.md->datatype);
+        }
+    }
+    for(long r = 0; r < NBroi; r++)
+    {
+        printf("region %3ld  %5u x %5u  offset %lu\n",
+               r,
+               roixsize[r],
+               roiysize[r],
+               roioffset[r]);
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_INIT;
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
+    {
+        int applyOK = 1;
+        for(long o = 0; o < NBout; o++)
+        {
+            if(pixremap_apply(&rmap[o],
+                              imgin.im->array.raw,
+                              imgin.md->datatype,
+                              imgout[o].im->array.raw,
+                              imgin.md->datatype) != RETURN_SUCCESS)
+            {
+                applyOK = 0;
+                break;
+            }
+        }
+        if(applyOK == 0)
+        {
+            // outputs incomplete : do not publish
+            processinfo_error(processinfo, "pixremap failed");
+            processloopOK = 0;
+        }
+        else
+        {
+            for(long o = 0; o < NBout; o++)
+            {
+                processinfo_update_output_stream(processinfo, imgout[o].ID);
+            }
+        }
+    }
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    for(long o = 0; o < NBout; o++)
+    {
+        pixremap_free(&rmap[o]);
+    }
+    free(rmap);
+    free(imgout);
+    free(roioffset);
+    free(roixsize);
+    free(roiysize);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+INSERT_STD_FPSCLIfunctions
+
+// Register function in CLI
+errno_t
+CLIADDCMD_COREMOD_arith__cropmulti()
+{
+
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,6 @@
+#ifndef COREMOD_ARITH_CROPMULTI_H
+#define COREMOD_ARITH_CROPMULTI_H
+
+errno_t CLIADDCMD_COREMOD_arith__cropmulti();
+
+#endif
@@ -1,5 +1,14 @@
+/**
+ * @file    image_pixremap.c
+ * @brief   pixel remapping of image stream
+ *
+ * Map is compiled into runs and gathers, see COREMOD_memory/pixremap.c
+ */
+
 #include "CommandLineInterface/CLIcore.h"
 
+#include "COREMOD_memory/pixremap.h"
+
 
 // input image
 //
@@ -18,6 +27,10 @@ static char *mapsname;
 //
 static LOCVAR_OUTIMG2D outim;
 
+// output datatype : same, float or double
+//
+static char *outtypestr;
+
 
 
 static CLICMDARGDEF farg[] =
@@ -41,7 +54,16 @@ static CLICMDARGDEF farg[] =
         NULL
     },
     FARG_OUTIM_NAME(outim),
-    FARG_OUTIM_SHARED(outim)
+    FARG_OUTIM_SHARED(outim),
+    {
+        CLIARG_STR,
+        ".outtype",
+        "output datatype: same, float or double",
+        "same",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &outtypestr,
+        NULL
+    }
 };
 
 
@@ -57,6 +79,8 @@ static CLICMDDATA CLIcmddata =
 static errno_t help_function()
 {
     printf("Remap input image to ouput image by pixel lookup\n");
+    printf("out[ii] = in[map[ii]], map is int32, negative not mapped\n");
+    printf("Output may be converted to float or double (.outtype)\n");
 
     return RETURN_SUCCESS;
 }
@@ -88,56 +112,57 @@ static errno_t compute_function()
     uint32_t xsize = imgmap.md->size[0];
     uint32_t ysize = imgmap.md->size[1];
 
+    uint8_t outtype = imgin.md->datatype;
+    if(strcmp(outtypestr, "float") == 0)
+    {
+        outtype = _DATATYPE_FLOAT;
+    }
+    else if(strcmp(outtypestr, "double") == 0)
+    {
+        outtype = _DATATYPE_DOUBLE;
+    }
+    else if(strcmp(outtypestr, "same") != 0)
+    {
+        FUNC_RETURN_FAILURE("outtype %s invalid, must be same, float or double",
+                            outtypestr);
+    }
+    if(pixremap_checktypes(imgin.md->datatype, outtype) == 0)
+    {
+        FUNC_RETURN_FAILURE("cannot convert %s datatype %d to %s",
+                            insname,
+                            imgin.md->datatype,
+                            outtypestr);
+    }
+
     // link/create output image/stream
 
     IMGID imgout = mkIMGID_from_name(outim.name);
     imgout.shared = *outim.shared;
     if(*outim.shared == 1)
     {
-        imgout = stream_connect_create_2D(outim.name, xsize, ysize, imgin.md->datatype);
+        imgout = stream_connect_create_2D(outim.name, xsize, ysize, outtype);
     }
     else
     {
         imgout.naxis = 2;
         imgout.size[0] = xsize;
         imgout.size[1] = ysize;
-        imgout.datatype = imgin.md->datatype;
+        imgout.datatype = outtype;
         createimagefromIMGID(&imgout);
     }
     imcreateIMGID(&imgout);
 
 
-    // build mapping table
+    // compile mapping table
     //
-    uint64_t nbpix = 0;
-    for(uint64_t ii = 0; ii < xsize*ysize; ii++)
-    {
-        int64_t pixindex = imgmap.im->array.SI32[ii];
-        if ( ( pixindex > -1 )
-                && ( pixindex < insize) )
-        {
-            nbpix ++;
-        }
-    }
+    PIXREMAP rmap;
+    FUNC_CHECK_RETURN(pixremap_compile_gathermap(&rmap,
+                      imgmap.im->array.SI32,
+                      (uint64_t) xsize * ysize,
+                      insize));
 
-    printf("mapping table has %lu elements\n", nbpix);
-
-    uint64_t * __restrict map_outpixindex = (uint64_t*) malloc(sizeof(uint64_t) * nbpix);
-    uint64_t * __restrict map_inpixindex  = (uint64_t*) malloc(sizeof(uint64_t) * nbpix);
-
-
-    nbpix = 0;
-    for(uint64_t ii = 0; ii < xsize*ysize; ii++)
-    {
-        int64_t pixindex = imgmap.im->array.SI32[ii];
-        if ( ( pixindex > -1 )
-                && ( pixindex < insize) )
-        {
-            map_outpixindex[nbpix] = ii;
-            map_inpixindex[nbpix] = pixindex;
-            nbpix ++;
-        }
-    }
+    printf("mapping table has %lu elements : %lu runs, %lu gathers\n",
+           rmap.NBpix, rmap.NBseg, rmap.NBgat);
 
 
 
@@ -147,88 +172,25 @@ static errno_t compute_function()
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_LOOPSTART
     {
-        switch ( imgin.md->datatype)
+        if(pixremap_apply(&rmap,
+                          imgin.im->array.raw,
+                          imgin.md->datatype,
+                          imgout.im->array.raw,
+                          outtype) != RETURN_SUCCESS)
         {
-        case _DATATYPE_FLOAT:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.F[map_outpixindex[pixi]] = imgin.im->array.F[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_DOUBLE:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.D[map_outpixindex[pixi]] = imgin.im->array.D[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_INT8:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.SI8[map_outpixindex[pixi]] = imgin.im->array.SI8[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_UINT8:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.UI8[map_outpixindex[pixi]] = imgin.im->array.UI8[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_INT16:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.SI16[map_outpixindex[pixi]] = imgin.im->array.SI16[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_UINT16:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.UI16[map_outpixindex[pixi]] = imgin.im->array.UI16[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_INT32:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.SI32[map_outpixindex[pixi]] = imgin.im->array.SI32[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_UINT32:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.UI32[map_outpixindex[pixi]] = imgin.im->array.UI32[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_INT64:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.SI64[map_outpixindex[pixi]] = imgin.im->array.SI64[map_inpixindex[pixi]];
-            }
-            break;
-
-        case _DATATYPE_UINT64:
-            for(uint64_t pixi=0; pixi<nbpix; pixi++)
-            {
-                imgout.im->array.UI64[map_outpixindex[pixi]] = imgin.im->array.UI64[map_inpixindex[pixi]];
-            }
-            break;
+            // frame not written : do not publish
+            processinfo_error(processinfo, "pixremap failed");
+            processloopOK = 0;
+        }
+        else
+        {
+            processinfo_update_output_stream(processinfo, imgout.ID);
         }
-
-
-
-        processinfo_update_output_stream(processinfo, imgout.ID);
 
     }
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
-    free(map_outpixindex);
-    free(map_inpixindex);
+    pixremap_free(&rmap);
 
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
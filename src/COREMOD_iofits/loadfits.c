@@ -3,7 +3,11 @@
  * @brief   load FITS format files
  */
 
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "CommandLineInterface/CLIcore.h"
 
@@ -17,6 +21,11 @@
 #include "COREMOD_memory/image_keyword_addL.h"
 #include "COREMOD_memory/image_keyword_addS.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP_NELEMENT_LIMIT 1000000
+#endif
+
 extern COREMOD_IOFITS_DATA COREMOD_iofits_data;
 
 // CLI function arguments and parameters
@@ -69,6 +78,8 @@ static errno_t help_function()
     printf(
         "Load FITS file from filesystem\n"
         "Uses fitsio library, supports extended fitsio file syntax\n"
+        "Uncompressed single-HDU files are memory-mapped and converted\n"
+        "in parallel, bypassing fitsio\n"
         "File name should be in double quotes unless free of special chars\n"
         "Examples:\n"
         "   loadfits \"im1.fits\" im\n");
@@ -76,6 +87,524 @@ static errno_t help_function()
     return RETURN_SUCCESS;
 }
 
+// keywords to ignore
+static char *keywordignore[] = {"BITPIX",
+                                "NAXIS",
+                                "SIMPLE",
+                                "EXTEND",
+                                "COMMENT",
+                                "DATE",
+                                "NAXIS1",
+                                "NAXIS2",
+                                "NAXIS3",
+                                "NAXIS4",
+                                "BSCALE",
+                                "BZERO",
+                                0
+                               };
+
+/**
+ * @brief Copy FITS header keyword to image keyword
+ *
+ * Value type is long if it parses as integer, double if it parses as
+ * floating point, string (quotes removed) otherwise.
+ */
+static errno_t load_fits_keyword(
+    IMGID img,
+    char *keyname,
+    char *kwvaluestr,
+    char *kwcomment
+)
+{
+    int ki = 0;
+    while(keywordignore[ki])
+    {
+        if(strcmp(keywordignore[ki], keyname) == 0)
+        {
+            return RETURN_SUCCESS;
+        }
+        ki++;
+    }
+
+    if(strlen(kwvaluestr) == 0)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    // is this a long ?
+    char *tailstr;
+    long  kwlongval = strtol(kwvaluestr, &tailstr, 10);
+    if(strlen(tailstr) == 0)
+    {
+        image_keyword_addL(img, keyname, kwlongval, kwcomment);
+        return RETURN_SUCCESS;
+    }
+
+    // is this a float ?
+    double kwdoubleval = strtold(kwvaluestr, &tailstr);
+    if(strlen(tailstr) == 0)
+    {
+        image_keyword_addD(img, keyname, kwdoubleval, kwcomment);
+        return RETURN_SUCCESS;
+    }
+
+    // default to string
+    // remove leading and trailing '
+    kwvaluestr[strlen(kwvaluestr) - 1] = '\0';
+    image_keyword_addS(img, keyname, kwvaluestr + 1, kwcomment);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/*
+ * mmap fast path
+ *
+ * Uncompressed single-HDU files are the common case for calibration
+ * cubes and response matrices. The file is mapped read-only, the header
+ * is parsed directly, and the big-endian data unit is byte-swapped and
+ * converted into the destination image array by parallel threads, each
+ * streaming a contiguous chunk. Avoids the cfitsio intermediate buffer
+ * and copy.
+ *
+ * Anything the fast path does not handle (extended file name syntax,
+ * compressed or non-regular files, extensions, unusual BSCALE/BZERO)
+ * returns ID -1 before the image is created, and load_fits falls back
+ * to cfitsio.
+ */
+
+#define FITSBLOCKSIZE 2880
+#define FITSCARDSIZE  80
+
+// parse card value and comment, same conventions as fits_read_keyn
+//
+static void fitsmmap_parsecard(
+    const char *card,
+    char       *keyname,
+    char       *value,
+    char       *comment
+)
+{
+    int ii;
+
+    memcpy(keyname, card, 8);
+    keyname[8] = '\0';
+    for(ii = 7; (ii >= 0) && (keyname[ii] == ' '); ii--)
+    {
+        keyname[ii] = '\0';
+    }
+
+    value[0]   = '\0';
+    comment[0] = '\0';
+
+    if((card[8] != '=') || (card[9] != ' '))
+    {
+        // commentary keyword, no value
+        return;
+    }
+
+    ii = 10;
+    while((ii < FITSCARDSIZE) && (card[ii] == ' '))
+    {
+        ii++;
+    }
+
+    int jj = 0;
+    if((ii < FITSCARDSIZE) && (card[ii] == '\''))
+    {
+        // quoted string, '' is an embedded quote
+        value[jj++] = card[ii++];
+        while(ii < FITSCARDSIZE)
+        {
+            if(card[ii] == '\'')
+            {
+                if((ii + 1 < FITSCARDSIZE) && (card[ii + 1] == '\''))
+                {
+                    value[jj++] = card[ii++];
+                    value[jj++] = card[ii++];
+                    continue;
+                }
+                value[jj++] = card[ii++];
+                break;
+            }
+            value[jj++] = card[ii++];
+        }
+        value[jj] = '\0';
+    }
+    else
+    {
+        while((ii < FITSCARDSIZE) && (card[ii] != '/'))
+        {
+            value[jj++] = card[ii++];
+        }
+        while((jj > 0) && (value[jj - 1] == ' '))
+        {
+            jj--;
+        }
+        value[jj] = '\0';
+    }
+
+    while((ii < FITSCARDSIZE) && (card[ii] != '/'))
+    {
+        ii++;
+    }
+    if(ii < FITSCARDSIZE)
+    {
+        ii++;
+        if((ii < FITSCARDSIZE) && (card[ii] == ' '))
+        {
+            ii++;
+        }
+        jj = 0;
+        while(ii < FITSCARDSIZE)
+        {
+            comment[jj++] = card[ii++];
+        }
+        while((jj > 0) && (comment[jj - 1] == ' '))
+        {
+            jj--;
+        }
+        comment[jj] = '\0';
+    }
+}
+
+
+
+
+// byte-swap and convert data unit into image array
+// branch-free loops over aligned words, vectorized by compiler
+//
+static void fitsmmap_convert(
+    const void *__restrict src,
+    int         bitpix,
+    double      bscale,
+    double      bzero,
+    void *__restrict dst,
+    uint64_t    nelement
+)
+{
+    switch(bitpix)
+    {
+    case 8:
+    {
+        const uint8_t *s = (const uint8_t *) src;
+        float *d = (float *) dst;
+#ifdef _OPENMP
+        #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t ii = 0; ii < nelement; ii++)
+        {
+            d[ii] = s[ii];
+        }
+    }
+    break;
+
+    case 16:
+    {
+        const uint16_t *s = (const uint16_t *) src;
+        uint16_t *d = (uint16_t *) dst;
+        if(bzero == 32768.0)
+        {
+            // unsigned convention : flip sign bit
+#ifdef _OPENMP
+            #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+            for(uint64_t ii = 0; ii < nelement; ii++)
+            {
+                d[ii] = __builtin_bswap16(s[ii]) ^ 0x8000;
+            }
+        }
+        else
+        {
+            // signed values, negative clipped as cfitsio does
+#ifdef _OPENMP
+            #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+            for(uint64_t ii = 0; ii < nelement; ii++)
+            {
+                int16_t v = (int16_t) __builtin_bswap16(s[ii]);
+                d[ii] = (v < 0) ? 0 : v;
+            }
+        }
+    }
+    break;
+
+    case 32:
+    case -32:
+    {
+        const uint32_t *s = (const uint32_t *) src;
+        uint32_t *d = (uint32_t *) dst;
+#ifdef _OPENMP
+        #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t ii = 0; ii < nelement; ii++)
+        {
+            d[ii] = __builtin_bswap32(s[ii]);
+        }
+    }
+    break;
+
+    case 64:
+    case -64:
+    {
+        const uint64_t *s = (const uint64_t *) src;
+        uint64_t *d = (uint64_t *) dst;
+#ifdef _OPENMP
+        #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+        for(uint64_t ii = 0; ii < nelement; ii++)
+        {
+            d[ii] = __builtin_bswap64(s[ii]);
+        }
+    }
+    break;
+    }
+
+    // scaling only allowed for floating point data
+    if((bscale != 1.0) || (bzero != 0.0))
+    {
+        if(bitpix == -32)
+        {
+            float *d = (float *) dst;
+#ifdef _OPENMP
+            #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+            for(uint64_t ii = 0; ii < nelement; ii++)
+            {
+                d[ii] = d[ii] * bscale + bzero;
+            }
+        }
+        if(bitpix == -64)
+        {
+            double *d = (double *) dst;
+#ifdef _OPENMP
+            #pragma omp parallel for if (nelement > OMP_NELEMENT_LIMIT)
+#endif
+            for(uint64_t ii = 0; ii < nelement; ii++)
+            {
+                d[ii] = d[ii] * bscale + bzero;
+            }
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Load uncompressed FITS file through mmap
+ *
+ * Sets *IDout to -1, without creating image, if file is not suitable
+ * for fast path. Returns RETURN_FAILURE if image cannot be created.
+ */
+static errno_t load_fits_mmap(
+    const char *file_name,
+    const char *ID_name,
+    imageID    *IDout
+)
+{
+    *IDout = -1;
+
+    // cfitsio extended file name syntax
+    if((strpbrk(file_name, "[]()") != NULL) ||
+            (strstr(file_name, "://") != NULL) ||
+            (file_name[0] == '-') || (file_name[0] == '!'))
+    {
+        return RETURN_SUCCESS;
+    }
+
+    int fd = open(file_name, O_RDONLY);
+    if(fd == -1)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    struct stat file_stat;
+    if((fstat(fd, &file_stat) == -1) || (!S_ISREG(file_stat.st_mode)) ||
+            (file_stat.st_size < FITSBLOCKSIZE))
+    {
+        close(fd);
+        return RETURN_SUCCESS;
+    }
+    size_t filesize = file_stat.st_size;
+
+    const char *map =
+        (const char *) mmap(NULL, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    if(strncmp(map, "SIMPLE  =", 9) != 0)
+    {
+        munmap((void *) map, filesize);
+        return RETURN_SUCCESS;
+    }
+
+    char     keyname[9];
+    char     kwvaluestr[FLEN_VALUE];
+    char     kwcomment[FLEN_COMMENT];
+    int      simpleOK = 0;
+    long     bitpix   = 0;
+    long     naxis    = -1;
+    uint32_t naxes[3] = {0, 0, 0};
+    int      naxisOK  = 0;
+    double   bscale   = 1.0;
+    double   bzero    = 0.0;
+    int      fastOK   = 1;
+    long     NBcard   = -1;
+
+    for(long card = 0; (card + 1) * FITSCARDSIZE <= (long) filesize; card++)
+    {
+        const char *cardstr = map + card * FITSCARDSIZE;
+        if(strncmp(cardstr, "END     ", 8) == 0)
+        {
+            NBcard = card;
+            break;
+        }
+
+        fitsmmap_parsecard(cardstr, keyname, kwvaluestr, kwcomment);
+
+        if(strcmp(keyname, "SIMPLE") == 0)
+        {
+            simpleOK = (strcmp(kwvaluestr, "T") == 0);
+        }
+        else if(strcmp(keyname, "BITPIX") == 0)
+        {
+            bitpix = strtol(kwvaluestr, NULL, 10);
+        }
+        else if(strcmp(keyname, "NAXIS") == 0)
+        {
+            naxis = strtol(kwvaluestr, NULL, 10);
+        }
+        else if((strncmp(keyname, "NAXIS", 5) == 0) && (keyname[5] >= '1') &&
+                (keyname[5] <= '3') && (keyname[6] == '\0'))
+        {
+            long n = strtol(kwvaluestr, NULL, 10);
+            if((n < 1) || (n > UINT32_MAX))
+            {
+                fastOK = 0;
+            }
+            naxes[keyname[5] - '1'] = (uint32_t) n;
+            naxisOK |= 1 << (keyname[5] - '1');
+        }
+        else if(strcmp(keyname, "BSCALE") == 0)
+        {
+            bscale = strtod(kwvaluestr, NULL);
+        }
+        else if(strcmp(keyname, "BZERO") == 0)
+        {
+            bzero = strtod(kwvaluestr, NULL);
+        }
+        else if((strcmp(keyname, "GROUPS") == 0) ||
+                (strcmp(keyname, "ZIMAGE") == 0))
+        {
+            fastOK = 0;
+        }
+    }
+
+    if((NBcard == -1) || (simpleOK == 0) || (naxis < 1) || (naxis > 3) ||
+            (naxisOK != (1 << naxis) - 1))
+    {
+        fastOK = 0;
+    }
+
+    // conversions matching cfitsio path
+    uint8_t datatype = 0;
+    switch(bitpix)
+    {
+    case -32:
+        datatype = _DATATYPE_FLOAT;
+        break;
+    case -64:
+        datatype = _DATATYPE_DOUBLE;
+        break;
+    case 16:
+        datatype = _DATATYPE_UINT16;
+        if((bscale != 1.0) || ((bzero != 0.0) && (bzero != 32768.0)))
+        {
+            fastOK = 0;
+        }
+        break;
+    case 32:
+    case 64:
+    case 8:
+        datatype = (bitpix == 8) ? _DATATYPE_FLOAT :
+                   ((bitpix == 32) ? _DATATYPE_INT32 : _DATATYPE_INT64);
+        if((bscale != 1.0) || (bzero != 0.0))
+        {
+            fastOK = 0;
+        }
+        break;
+    default:
+        fastOK = 0;
+    }
+
+    uint64_t nelement = 1;
+    for(long i = 0; i < naxis; i++)
+    {
+        nelement *= naxes[i];
+    }
+    size_t dataoffset =
+        ((NBcard * FITSCARDSIZE) / FITSBLOCKSIZE + 1) * FITSBLOCKSIZE;
+    size_t datasize = nelement * (labs(bitpix) / 8);
+
+    if((fastOK == 0) || (dataoffset + datasize > filesize))
+    {
+        munmap((void *) map, filesize);
+        return RETURN_SUCCESS;
+    }
+
+    DEBUG_TRACEPOINT("mmap fast path %s bitpix %ld", file_name, bitpix);
+
+    madvise((void *) map, filesize, MADV_SEQUENTIAL);
+
+    imageID ID = -1;
+    if((create_image_ID(ID_name,
+                        naxis,
+                        naxes,
+                        datatype,
+                        data.SHARED_DFT,
+                        NB_KEYWNODE_MAX,
+                        0,
+                        &ID) != RETURN_SUCCESS) ||
+            (ID == -1))
+    {
+        munmap((void *) map, filesize);
+        PRINT_ERROR("cannot create image %s", ID_name);
+        return RETURN_FAILURE;
+    }
+
+    fitsmmap_convert(map + dataoffset,
+                     bitpix,
+                     bscale,
+                     bzero,
+                     data.image[ID].array.raw,
+                     nelement);
+
+    IMGID img = makesetIMGID(ID_name, ID);
+    for(long card = 0; card < NBcard; card++)
+    {
+        fitsmmap_parsecard(map + card * FITSCARDSIZE,
+                           keyname,
+                           kwvaluestr,
+                           kwcomment);
+        load_fits_keyword(img, keyname, kwvaluestr, kwcomment);
+    }
+
+    munmap((void *) map, filesize);
+
+    *IDout = ID;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
 /// errmode values :
 /// LOADFITS_ERRMODE_IGNORE  (0) print warning, do not show error messages, continue
 /// LOADFITS_ERRMODE_WARNING (1) print error, continue
@@ -117,6 +646,21 @@ errno_t load_fits(
 
     DEBUG_TRACEPOINT("FARG \"%s\" %s %d", file_name, ID_name, errmode);
 
+    {
+        // fast path for uncompressed files, cfitsio otherwise
+        imageID IDmmap = -1;
+        FUNC_CHECK_RETURN(load_fits_mmap(file_name, ID_name, &IDmmap));
+        if(IDmmap != -1)
+        {
+            if(IDout != NULL)
+            {
+                *IDout = IDmmap;
+            }
+            DEBUG_TRACE_FEXIT();
+            return RETURN_SUCCESS;
+        }
+    }
+
     {
         // Open fitsio file pointer
         // tyr 3 consecutive times and then give up if not successful
@@ -523,27 +1067,11 @@ errno_t load_fits(
 
     IMGID img = makesetIMGID(ID_name, ID);
 
-// keywords to ignore
-    char *keywordignore[] = {"BITPIX",
-                             "NAXIS",
-                             "SIMPLE",
-                             "EXTEND",
-                             "COMMENT",
-                             "DATE",
-                             "NAXIS1",
-                             "NAXIS2",
-                             "NAXIS3",
-                             "NAXIS4",
-                             "BSCALE",
-                             "BZERO",
-                             0
-                            };
-//printf("%d FITS keywords detected\n", nbFITSkeys);
     for(int kwnum = 0; kwnum < nbFITSkeys; kwnum++)
     {
         char keyname[9];
-        char kwvaluestr[21];
-        char kwcomment[81];
+        char kwvaluestr[FLEN_VALUE];
+        char kwcomment[FLEN_COMMENT];
         {
             int status = 0;
             fits_read_keyn(fptr,
@@ -554,70 +1082,7 @@ errno_t load_fits(
                            &status);
         }
 
-        //printf("FITS KEYW %3d  %8s %20s / %s\n", kwnum, keyname, kwvaluestr, kwcomment);
-
-        int kwignore = 0;
-        int ki       = 0;
-        while(keywordignore[ki])
-        {
-            if(strcmp(keywordignore[ki], keyname) == 0)
-            {
-                //printf("%3d IGNORING %s\n", kwnum, keyname);
-                kwignore = 1;
-                break;
-            }
-            ki++;
-        }
-
-        if((kwignore == 0) && (strlen(kwvaluestr) > 0))
-        {
-            int kwtypeOK = 0;
-
-            // is this a long ?
-            char *tailstr;
-            long  kwlongval = strtol(kwvaluestr, &tailstr, 10);
-            if(strlen(tailstr) == 0)
-            {
-                kwtypeOK = 1;
-                /*printf("%3d FITS KEYW [L] %-8s= %20ld / %s\n",
-                       kwnum,
-                       keyname,
-                       kwlongval,
-                       kwcomment);*/
-                image_keyword_addL(img, keyname, kwlongval, kwcomment);
-            }
-
-            if(kwtypeOK == 0)
-            {
-                // is this a float ?
-                double kwdoubleval = strtold(kwvaluestr, &tailstr);
-                if(strlen(tailstr) == 0)
-                {
-                    kwtypeOK = 1;
-                    /*printf("%3d FITS KEYW [D] %-8s= %20g / %s\n",
-                           kwnum,
-                           keyname,
-                           kwdoubleval,
-                           kwcomment);*/
-                    image_keyword_addD(img, keyname, kwdoubleval, kwcomment);
-                }
-
-                if(kwtypeOK == 0)
-                {
-                    // default to string
-                    /*printf("%3d FITS KEYW [S] %-8s= %-20s / %s\n",
-                           kwnum,
-                           keyname,
-                           kwvaluestr,
-                           kwcomment);*/
-                    // remove leading and trailing '
-                    kwvaluestr[strlen(kwvaluestr) - 1] = '\0';
-                    char *kwvaluestr1;
-                    kwvaluestr1 = kwvaluestr + 1;
-                    image_keyword_addS(img, keyname, kwvaluestr1, kwcomment);
-                }
-            }
-        }
+        load_fits_keyword(img, keyname, kwvaluestr, kwcomment);
     }
 
     {
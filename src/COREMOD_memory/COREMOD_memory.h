@@ -56,6 +56,7 @@
 #include "COREMOD_memory/list_image.h"
 #include "COREMOD_memory/list_variable.h"
 #include "COREMOD_memory/logshmim.h"
+#include "COREMOD_memory/pixremap.h"
 #include "COREMOD_memory/read_shmim.h"
 #include "COREMOD_memory/saveall.h"
 #include "COREMOD_memory/stream_TCP.h"
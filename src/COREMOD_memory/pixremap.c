@@ -0,0 +1,468 @@
+/**
+ * @file    pixremap.c
+ * @brief   compiled pixel remap engine
+ *
+ * A pixel map is compiled once into contiguous runs, where consecutive
+ * output pixels read consecutive input pixels, and residual single-pixel
+ * gathers. Runs are copied as blocks (memcpy, or vectorizable conversion
+ * loop), and split to bounded length so that runs and gathers can be
+ * statically distributed across threads.
+ *
+ * Output type may be float or double for any real input type, so
+ * conversion happens during the remap.
+ *
+ * Pairs writing the same output pixel are reduced at compile time to the
+ * last one, which is what a sequential remap would leave, so that all
+ * compiled writes are independent and can run in parallel.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "pixremap.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define OMP_NELEMENT_LIMIT 100000
+#endif
+
+// runs shorter than this are stored as gathers
+#define PIXREMAP_MINRUN 8
+
+// runs are split to this length for load balancing
+#define PIXREMAP_MAXRUN 4096
+
+
+
+
+errno_t pixremap_compile(PIXREMAP       *rmap,
+                         const uint64_t *outindex_,
+                         const uint64_t *inindex_,
+                         uint64_t        NBpair_)
+{
+    DEBUG_TRACE_FSTART();
+
+    uint64_t outmax = 0;
+    uint64_t inmax  = 0;
+    for(uint64_t k = 0; k < NBpair_; k++)
+    {
+        outmax = (outindex_[k] > outmax) ? outindex_[k] : outmax;
+        inmax  = (inindex_[k] > inmax) ? inindex_[k] : inmax;
+    }
+    if((outmax > UINT32_MAX) || (inmax > UINT32_MAX))
+    {
+        FUNC_RETURN_FAILURE("pixel index exceeds 32-bit range");
+    }
+
+    // duplicate outputs : keep last pair
+    uint8_t *outset = (uint8_t *) calloc(outmax + 1, sizeof(uint8_t));
+    uint8_t *keep   = (uint8_t *) malloc(sizeof(uint8_t) * (NBpair_ + 1));
+    if((outset == NULL) || (keep == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    uint64_t NBpair = 0;
+    for(uint64_t k = NBpair_; k-- > 0;)
+    {
+        keep[k] = !outset[outindex_[k]];
+        outset[outindex_[k]] = 1;
+        NBpair += keep[k];
+    }
+    free(outset);
+
+    const uint64_t *outindex = outindex_;
+    const uint64_t *inindex  = inindex_;
+    uint64_t       *outdedup = NULL;
+    uint64_t       *indedup  = NULL;
+    if(NBpair < NBpair_)
+    {
+        outdedup = (uint64_t *) malloc(sizeof(uint64_t) * NBpair);
+        indedup  = (uint64_t *) malloc(sizeof(uint64_t) * NBpair);
+        if((outdedup == NULL) || (indedup == NULL))
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        uint64_t k1 = 0;
+        for(uint64_t k = 0; k < NBpair_; k++)
+        {
+            if(keep[k])
+            {
+                outdedup[k1] = outindex_[k];
+                indedup[k1]  = inindex_[k];
+                k1++;
+            }
+        }
+        outindex = outdedup;
+        inindex  = indedup;
+    }
+    free(keep);
+
+    rmap->NBpix = NBpair;
+
+    // upper bound allocation, trimmed at end
+    rmap->seg_out = (uint64_t *) malloc(sizeof(uint64_t) * (NBpair + 1));
+    rmap->seg_in  = (uint64_t *) malloc(sizeof(uint64_t) * (NBpair + 1));
+    rmap->seg_len = (uint32_t *) malloc(sizeof(uint32_t) * (NBpair + 1));
+    rmap->gat_out = (uint32_t *) malloc(sizeof(uint32_t) * (NBpair + 1));
+    rmap->gat_in  = (uint32_t *) malloc(sizeof(uint32_t) * (NBpair + 1));
+    if((rmap->seg_out == NULL) || (rmap->seg_in == NULL) ||
+            (rmap->seg_len == NULL) || (rmap->gat_out == NULL) ||
+            (rmap->gat_in == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    rmap->NBseg = 0;
+    rmap->NBgat = 0;
+
+    uint64_t k = 0;
+    while(k < NBpair)
+    {
+        uint64_t len = 1;
+        while((k + len < NBpair) && (len < PIXREMAP_MAXRUN) &&
+                (outindex[k + len] == outindex[k] + len) &&
+                (inindex[k + len] == inindex[k] + len))
+        {
+            len++;
+        }
+
+        if(len >= PIXREMAP_MINRUN)
+        {
+            rmap->seg_out[rmap->NBseg] = outindex[k];
+            rmap->seg_in[rmap->NBseg]  = inindex[k];
+            rmap->seg_len[rmap->NBseg] = len;
+            rmap->NBseg++;
+        }
+        else
+        {
+            for(uint64_t k1 = k; k1 < k + len; k1++)
+            {
+                rmap->gat_out[rmap->NBgat] = outindex[k1];
+                rmap->gat_in[rmap->NBgat]  = inindex[k1];
+                rmap->NBgat++;
+            }
+        }
+        k += len;
+    }
+    free(outdedup);
+    free(indedup);
+
+    rmap->seg_out = (uint64_t *) realloc(rmap->seg_out,
+                                         sizeof(uint64_t) * (rmap->NBseg + 1));
+    rmap->seg_in  = (uint64_t *) realloc(rmap->seg_in,
+                                         sizeof(uint64_t) * (rmap->NBseg + 1));
+    rmap->seg_len = (uint32_t *) realloc(rmap->seg_len,
+                                         sizeof(uint32_t) * (rmap->NBseg + 1));
+    rmap->gat_out = (uint32_t *) realloc(rmap->gat_out,
+                                         sizeof(uint32_t) * (rmap->NBgat + 1));
+    rmap->gat_in  = (uint32_t *) realloc(rmap->gat_in,
+                                         sizeof(uint32_t) * (rmap->NBgat + 1));
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Compile gather map : out[ii] = in[map[ii]]
+ *
+ * Negative or out-of-range map values are not mapped.
+ */
+errno_t pixremap_compile_gathermap(PIXREMAP      *rmap,
+                                   const int32_t *map,
+                                   uint64_t       outsize,
+                                   uint64_t       insize)
+{
+    DEBUG_TRACE_FSTART();
+
+    uint64_t *outindex = (uint64_t *) malloc(sizeof(uint64_t) * outsize);
+    uint64_t *inindex  = (uint64_t *) malloc(sizeof(uint64_t) * outsize);
+    if((outindex == NULL) || (inindex == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    uint64_t NBpair = 0;
+    for(uint64_t ii = 0; ii < outsize; ii++)
+    {
+        int64_t pixindex = map[ii];
+        if((pixindex > -1) && (pixindex < (int64_t) insize))
+        {
+            outindex[NBpair] = ii;
+            inindex[NBpair]  = pixindex;
+            NBpair++;
+        }
+    }
+
+    FUNC_CHECK_RETURN(pixremap_compile(rmap, outindex, inindex, NBpair));
+
+    free(outindex);
+    free(inindex);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Compile scatter map : out[map[ii]] = in[inoffset + ii]
+ *
+ * Out-of-range map values are not mapped.
+ */
+errno_t pixremap_compile_scattermap(PIXREMAP       *rmap,
+                                    const uint32_t *map,
+                                    uint64_t        NBpix,
+                                    uint64_t        inoffset,
+                                    uint64_t        outsize)
+{
+    DEBUG_TRACE_FSTART();
+
+    uint64_t *outindex = (uint64_t *) malloc(sizeof(uint64_t) * (NBpix + 1));
+    uint64_t *inindex  = (uint64_t *) malloc(sizeof(uint64_t) * (NBpix + 1));
+    if((outindex == NULL) || (inindex == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    uint64_t NBpair = 0;
+    for(uint64_t ii = 0; ii < NBpix; ii++)
+    {
+        if(map[ii] < outsize)
+        {
+            outindex[NBpair] = map[ii];
+            inindex[NBpair]  = inoffset + ii;
+            NBpair++;
+        }
+    }
+
+    FUNC_CHECK_RETURN(pixremap_compile(rmap, outindex, inindex, NBpair));
+
+    free(outindex);
+    free(inindex);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t pixremap_free(PIXREMAP *rmap)
+{
+    free(rmap->seg_out);
+    free(rmap->seg_in);
+    free(rmap->seg_len);
+    free(rmap->gat_out);
+    free(rmap->gat_in);
+
+    rmap->seg_out = NULL;
+    rmap->seg_in  = NULL;
+    rmap->seg_len = NULL;
+    rmap->gat_out = NULL;
+    rmap->gat_in  = NULL;
+    rmap->NBseg   = 0;
+    rmap->NBgat   = 0;
+    rmap->NBpix   = 0;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+#ifdef _OPENMP
+#define PIXREMAP_OMP_FOR                                                    \
+    _Pragma("omp for schedule(static)")
+#else
+#define PIXREMAP_OMP_FOR
+#endif
+
+// same type : block copy of runs, gathers by element size
+//
+#define PIXREMAP_GATHER(TYPE)                                               \
+    do                                                                      \
+    {                                                                       \
+        const TYPE *__restrict src = (const TYPE *) in;                     \
+        TYPE *__restrict       dst = (TYPE *) out;                          \
+        PIXREMAP_OMP_FOR                                                    \
+        for(uint64_t k = 0; k < rmap->NBgat; k++)                           \
+        {                                                                   \
+            dst[rmap->gat_out[k]] = src[rmap->gat_in[k]];                   \
+        }                                                                   \
+    } while(0)
+
+// type conversion to OUTTYPE
+//
+#define PIXREMAP_CONVERT(INTYPE, OUTTYPE)                                   \
+    do                                                                      \
+    {                                                                       \
+        const INTYPE *__restrict src = (const INTYPE *) in;                 \
+        OUTTYPE *__restrict      dst = (OUTTYPE *) out;                     \
+        PIXREMAP_OMP_FOR                                                    \
+        for(uint64_t s = 0; s < rmap->NBseg; s++)                           \
+        {                                                                   \
+            const INTYPE *__restrict s_in  = src + rmap->seg_in[s];         \
+            OUTTYPE *__restrict      s_out = dst + rmap->seg_out[s];        \
+            uint32_t                 len   = rmap->seg_len[s];              \
+            for(uint32_t k = 0; k < len; k++)                               \
+            {                                                               \
+                s_out[k] = (OUTTYPE) s_in[k];                               \
+            }                                                               \
+        }                                                                   \
+        PIXREMAP_OMP_FOR                                                    \
+        for(uint64_t k = 0; k < rmap->NBgat; k++)                           \
+        {                                                                   \
+            dst[rmap->gat_out[k]] = (OUTTYPE) src[rmap->gat_in[k]];         \
+        }                                                                   \
+    } while(0)
+
+#define PIXREMAP_CONVERT_SWITCH(OUTTYPE)                                    \
+    switch(intype)                                                          \
+    {                                                                       \
+        case _DATATYPE_FLOAT:                                               \
+            PIXREMAP_CONVERT(float, OUTTYPE);                               \
+            break;                                                          \
+        case _DATATYPE_DOUBLE:                                              \
+            PIXREMAP_CONVERT(double, OUTTYPE);                              \
+            break;                                                          \
+        case _DATATYPE_UINT8:                                               \
+            PIXREMAP_CONVERT(uint8_t, OUTTYPE);                             \
+            break;                                                          \
+        case _DATATYPE_INT8:                                                \
+            PIXREMAP_CONVERT(int8_t, OUTTYPE);                              \
+            break;                                                          \
+        case _DATATYPE_UINT16:                                              \
+            PIXREMAP_CONVERT(uint16_t, OUTTYPE);                            \
+            break;                                                          \
+        case _DATATYPE_INT16:                                               \
+            PIXREMAP_CONVERT(int16_t, OUTTYPE);                             \
+            break;                                                          \
+        case _DATATYPE_UINT32:                                              \
+            PIXREMAP_CONVERT(uint32_t, OUTTYPE);                            \
+            break;                                                          \
+        case _DATATYPE_INT32:                                               \
+            PIXREMAP_CONVERT(int32_t, OUTTYPE);                             \
+            break;                                                          \
+        case _DATATYPE_UINT64:                                              \
+            PIXREMAP_CONVERT(uint64_t, OUTTYPE);                            \
+            break;                                                          \
+        case _DATATYPE_INT64:                                               \
+            PIXREMAP_CONVERT(int64_t, OUTTYPE);                             \
+            break;                                                          \
+        default:                                                            \
+            break;                                                          \
+    }
+
+
+
+
+/**
+ * @brief Is datatype conversion supported by pixremap_apply
+ *
+ * Returns 1 if outtype is intype, or float / double for real intype.
+ */
+int pixremap_checktypes(uint8_t intype, uint8_t outtype)
+{
+    if(outtype == intype)
+    {
+        return 1;
+    }
+    if((outtype != _DATATYPE_FLOAT) && (outtype != _DATATYPE_DOUBLE))
+    {
+        return 0;
+    }
+    if((intype == _DATATYPE_COMPLEX_FLOAT) ||
+            (intype == _DATATYPE_COMPLEX_DOUBLE))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+
+
+
+/**
+ * @brief Apply compiled remap to one frame
+ *
+ * outtype must be intype, or float / double for real input types.
+ * Unmapped output pixels are not written.
+ */
+errno_t pixremap_apply(const PIXREMAP *rmap,
+                       const void     *in,
+                       uint8_t         intype,
+                       void           *out,
+                       uint8_t         outtype)
+{
+    DEBUG_TRACE_FSTART();
+
+    if(pixremap_checktypes(intype, outtype) == 0)
+    {
+        FUNC_RETURN_FAILURE("unsupported remap datatype conversion %d -> %d",
+                            intype,
+                            outtype);
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel if (rmap->NBpix > OMP_NELEMENT_LIMIT)
+#endif
+    {
+        if(outtype == intype)
+        {
+            int typesize = ImageStreamIO_typesize(intype);
+
+            PIXREMAP_OMP_FOR
+            for(uint64_t s = 0; s < rmap->NBseg; s++)
+            {
+                memcpy((char *) out + typesize * rmap->seg_out[s],
+                       (const char *) in + typesize * rmap->seg_in[s],
+                       (size_t) typesize * rmap->seg_len[s]);
+            }
+
+            switch(typesize)
+            {
+                case 1:
+                    PIXREMAP_GATHER(uint8_t);
+                    break;
+                case 2:
+                    PIXREMAP_GATHER(uint16_t);
+                    break;
+                case 4:
+                    PIXREMAP_GATHER(uint32_t);
+                    break;
+                case 8:
+                    PIXREMAP_GATHER(uint64_t);
+                    break;
+                default:
+                    PIXREMAP_OMP_FOR
+                    for(uint64_t k = 0; k < rmap->NBgat; k++)
+                    {
+                        memcpy((char *) out +
+                               (size_t) typesize * rmap->gat_out[k],
+                               (const char *) in +
+                               (size_t) typesize * rmap->gat_in[k],
+                               typesize);
+                    }
+            }
+        }
+        else if(outtype == _DATATYPE_FLOAT)
+        {
+            PIXREMAP_CONVERT_SWITCH(float);
+        }
+        else
+        {
+            PIXREMAP_CONVERT_SWITCH(double);
+        }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file    pixremap.h
+ */
+
+#ifndef COREMOD_MEMORY_PIXREMAP_H
+#define COREMOD_MEMORY_PIXREMAP_H
+
+// compiled pixel remap : out[outindex] = in[inindex] pairs are grouped
+// into contiguous runs (copied as blocks) and residual single gathers
+// pixel indices are limited to 32 bit, each output pixel written once
+//
+typedef struct
+{
+    uint64_t  NBpix; // number of mapped pixels
+
+    uint64_t  NBseg;
+    uint64_t *seg_out;
+    uint64_t *seg_in;
+    uint32_t *seg_len;
+
+    uint64_t  NBgat;
+    uint32_t *gat_out;
+    uint32_t *gat_in;
+
+} PIXREMAP;
+
+errno_t pixremap_compile(PIXREMAP       *rmap,
+                         const uint64_t *outindex,
+                         const uint64_t *inindex,
+                         uint64_t        NBpair);
+
+errno_t pixremap_compile_gathermap(PIXREMAP      *rmap,
+                                   const int32_t *map,
+                                   uint64_t       outsize,
+                                   uint64_t       insize);
+
+errno_t pixremap_compile_scattermap(PIXREMAP       *rmap,
+                                    const uint32_t *map,
+                                    uint64_t        NBpix,
+                                    uint64_t        inoffset,
+                                    uint64_t        outsize);
+
+errno_t pixremap_free(PIXREMAP *rmap);
+
+int pixremap_checktypes(uint8_t intype, uint8_t outtype);
+
+errno_t pixremap_apply(const PIXREMAP *rmap,
+                       const void     *in,
+                       uint8_t         intype,
+                       void           *out,
+                       uint8_t         outtype);
+
+#endif
@@ -5,6 +5,7 @@
 #include "create_image.h"
 #include "delete_image.h"
 #include "image_ID.h"
+#include "pixremap.h"
 #include "stream_sem.h"
 
 #include "COREMOD_iofits/COREMOD_iofits.h"
@@ -330,6 +331,37 @@ imageID COREMOD_MEMORY_PixMapDecode_U(
     }
 
 
+    // compile remap tables, one per slice in forward mode
+    //
+    processinfo_WriteMessage(processinfo, "Compiling pixel maps");
+    long      NBrmap = (reverse == 0) ? NBslice : 1;
+    PIXREMAP *rmap   = (PIXREMAP *) malloc(sizeof(PIXREMAP) * NBrmap);
+    if(rmap == NULL)
+    {
+        PRINT_ERROR("malloc error");
+        abort();
+    }
+    if(reverse == 0)
+    {
+        for(slice = 0; slice < NBslice; slice++)
+        {
+            sliceii = slice * data.image[IDmap].md[0].size[0] *
+                      data.image[IDmap].md[0].size[1];
+            pixremap_compile_scattermap(&rmap[slice],
+                                        data.image[IDmap].array.UI32 + sliceii,
+                                        nbpixslice[slice],
+                                        sliceii,
+                                        nbpixout);
+        }
+    }
+    else
+    {
+        pixremap_compile_gathermap(&rmap[0],
+                                   data.image[IDmap].array.SI32,
+                                   nbpixout,
+                                   (uint64_t) xsizein * ysizein * NBslice);
+    }
+
     processinfo->loopcntMax = -1;
     processinfo_WriteMessage(processinfo, "Starting loop");
 
@@ -406,24 +438,20 @@ imageID COREMOD_MEMORY_PixMapDecode_U(
                 {
                     if(slice < NBslice)
                     {
-                        sliceii = slice * data.image[IDmap].md[0].size[0] *
-                                  data.image[IDmap].md[0].size[1];
-                        for(ii = 0; ii < nbpixslice[slice]; ii++)
-                        {
-                            data.image[IDout].array.UI16
-                            [data.image[IDmap].array.UI32[sliceii + ii]] =
-                                data.image[IDin].array.UI16[sliceii + ii];
-                        }
+                        pixremap_apply(&rmap[slice],
+                                       data.image[IDin].array.raw,
+                                       data.image[IDin].md->datatype,
+                                       data.image[IDout].array.raw,
+                                       data.image[IDout].md->datatype);
                     }
                 }
                 else // reverse == 1, full image assumed (at least given how ocam is scrambled)
                 {
-                    for(ii = 0; ii < nbpixout; ++ii)
-                    {
-                        data.image[IDout].array.UI16[ii] =
-                            data.image[IDin]
-                            .array.UI16[data.image[IDmap].array.UI32[ii]];
-                    }
+                    pixremap_apply(&rmap[0],
+                                   data.image[IDin].array.raw,
+                                   data.image[IDin].md->datatype,
+                                   data.image[IDout].array.raw,
+                                   data.image[IDout].md->datatype);
                 }
 
                 // Copy the value of the keywords
@@ -471,6 +499,12 @@ imageID COREMOD_MEMORY_PixMapDecode_U(
             processinfo_cleanExit(processinfo);
         }*/
 
+    for(slice = 0; slice < NBrmap; slice++)
+    {
+        pixremap_free(&rmap[slice]);
+    }
+    free(rmap);
+
     free(nbpixslice);
     free(sizearray);
     free(dtarray);
@@ -394,6 +394,10 @@ typedef struct
             CLIcmddata.cmdsettings->procinfo_MeasureTiming;                    \
         DEBUG_TRACEPOINT("loopstart");                                         \
         processinfo_loopstart(processinfo);                                    \
+    }                                                                          \
+    if (data.fpsptr != NULL)                                                   \
+    { /* RUN loop ready, used by fpsCTRL wait points */                        \
+        data.fpsptr->md->status |= FUNCTION_PARAMETER_STRUCT_STATUS_RUNLOOP;   \
     }
 
 
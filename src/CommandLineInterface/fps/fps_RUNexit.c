@@ -10,6 +10,7 @@ uint16_t function_parameter_RUNexit(FUNCTION_PARAMETER_STRUCT *fps)
     //fps->md->confpid = 0;
 
     fps->md->status &= ~FUNCTION_PARAMETER_STRUCT_STATUS_CMDRUN;
+    fps->md->status &= ~FUNCTION_PARAMETER_STRUCT_STATUS_RUNLOOP;
     function_parameter_struct_disconnect(fps);
 
     return 0;
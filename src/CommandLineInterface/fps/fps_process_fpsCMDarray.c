@@ -8,7 +8,7 @@
 
 #include "fps_processcmdline.h"
 
-/** @brief Find the next task to execute
+/** @brief Find the tasks to execute
  *
  * Tasks are arranged in execution queues.
  * Each task belongs to a single queue.
@@ -24,9 +24,25 @@
  * all tasks in the queue
  * - If queue priority = 0, no task is executed in the queue: it is paused
  * - Task order within a queue must be respected. Execution order is submission order (FIFO)
- * - Tasks can overlap if they belong to separate queues and have the same priority
+ * - Tasks in separate queues run concurrently : the ready task at the head of each queue
+ * is launched in the same pass, higher priority first, lower queue index first at equal priority
  * - A running task waiting to be completed cannot block tasks in other queues
- * - If two tasks are ready with the same priority, the one in the lower queue index will be launched
+ * - A task with dependencies (taskdep) only starts when all tasks carrying the
+ * dependency labels (tasklabel), submitted before it, are completed.
+ * Dependencies form a graph across queues
+ * - If one of these tasks failed (command error, wait point timeout), the
+ * dependent task is not executed : it completes as failed (DEPFAIL), so that
+ * failures propagate along the dependency graph while the rest of its queue
+ * proceeds. Labels and failure status of purged tasks are kept, so this holds
+ * after the failed task is removed from the list
+ * - A dependency label not carried by any task submitted before is rejected at
+ * submission, see fps_read_fpsCMD_fifo.c
+ * - Wait points (waitfpsrun, waitfpsconf, waitfpsnorun) are tasks that complete when
+ * the FPS reaches the requested state, or fail on timeout
+ *
+ * Tasks launched in the same pass execute concurrently through the FPS processes
+ * they start (tmux sessions). Command lines themselves are interpreted in this
+ * thread, as they share the FPS and keyword tree state.
  *
  * CONVENTIONS AND GUIDELINES :
  * - queue #0 is the main queue
@@ -35,6 +51,167 @@
  * - Return to queue 0 when done working in other queues
  */
 
+
+
+
+// labelled tasks purged from task list (ring buffer)
+// keeps labels known, and failure status for dependents submitted later
+#define FPSTASK_PURGEDLABEL_MAX 1000
+
+typedef struct
+{
+    char     label[FPSTASK_LABEL_STRLEN];
+    uint64_t inputindex;
+    int      failed;
+} FPSTASK_PURGEDLABEL;
+
+static FPSTASK_PURGEDLABEL purgedlabel[FPSTASK_PURGEDLABEL_MAX];
+static int                 NBpurgedlabel  = 0;
+static int                 purgedlabelpos = 0;
+
+
+
+
+static double timespec_elapsed(struct timespec t0, struct timespec t1)
+{
+    return 1.0 * (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (t1.tv_nsec - t0.tv_nsec);
+}
+
+
+
+// dependencies of task : labelled tasks submitted before it
+// returns 1 if all completed, 0 if some pending, -1 if some failed
+//
+static int task_deps_completed(
+    FPSCTRL_TASK_ENTRY *fpsctrltasklist,
+    int                 cmdindex
+)
+{
+    FPSCTRL_TASK_ENTRY *task   = &fpsctrltasklist[cmdindex];
+    int                 result = 1;
+
+    for(int dep = 0; dep < task->NBdep; dep++)
+    {
+        for(int ci = 0; ci < NB_FPSCTRL_TASK_MAX; ci++)
+        {
+            FPSCTRL_TASK_ENTRY *deptask = &fpsctrltasklist[ci];
+
+            if((deptask->status == 0) ||
+                    (deptask->inputindex >= task->inputindex) ||
+                    (strcmp(deptask->label, task->deplabel[dep]) != 0))
+            {
+                continue;
+            }
+            if(deptask->status &
+                    (FPSTASK_STATUS_ACTIVE | FPSTASK_STATUS_STAGED))
+            {
+                result = 0;
+            }
+            else if(deptask->status & FPSTASK_STATUS_FAILMASK)
+            {
+                return -1;
+            }
+        }
+
+        for(int pi = 0; pi < NBpurgedlabel; pi++)
+        {
+            if((purgedlabel[pi].failed == 1) &&
+                    (purgedlabel[pi].inputindex < task->inputindex) &&
+                    (strcmp(purgedlabel[pi].label, task->deplabel[dep]) == 0))
+            {
+                return -1;
+            }
+        }
+    }
+    return result;
+}
+
+
+
+/**
+ * @brief Is label carried by a task in the list, or by a purged task
+ *
+ * Used at submission to reject dependencies on unknown labels.
+ */
+int functionparameter_tasklabel_known(
+    FPSCTRL_TASK_ENTRY *fpsctrltasklist,
+    const char         *label
+)
+{
+    for(int ci = 0; ci < NB_FPSCTRL_TASK_MAX; ci++)
+    {
+        if((fpsctrltasklist[ci].status != 0) &&
+                (strcmp(fpsctrltasklist[ci].label, label) == 0))
+        {
+            return 1;
+        }
+    }
+    for(int pi = 0; pi < NBpurgedlabel; pi++)
+    {
+        if(strcmp(purgedlabel[pi].label, label) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+// wait point condition
+// returns 1 if reached
+//
+static int task_waitpoint_reached(
+    FPSCTRL_TASK_ENTRY        *task,
+    FPSCTRL_PROCESS_VARS      *fpsCTRLvar,
+    FUNCTION_PARAMETER_STRUCT *fps
+)
+{
+    char stringtmp[STRINGMAXLEN_FPS_CMDLINE];
+    char fpsname[STRINGMAXLEN_FPS_CMDLINE] = "";
+    sscanf(task->cmdstring, "%s %s", stringtmp, fpsname);
+
+    int fpsindex = -1;
+    for(int fi = 0; fi < fpsCTRLvar->NBfps; fi++)
+    {
+        if(strcmp(fps[fi].md->name, fpsname) == 0)
+        {
+            fpsindex = fi;
+            break;
+        }
+    }
+    task->fpsindex = fpsindex;
+
+    if(fpsindex == -1)
+    {
+        // FPS does not exist : not running
+        return (task->flag & FPSTASK_FLAG_WAIT_FOR_FPS_NORUN) ? 1 : 0;
+    }
+
+    FUNCTION_PARAMETER_STRUCT_MD *md = fps[fpsindex].md;
+
+    int runalive  = (md->runpid > 0) && (getpgid(md->runpid) >= 0);
+    int confalive = (md->confpid > 0) && (getpgid(md->confpid) >= 0);
+
+    if(task->flag & FPSTASK_FLAG_WAIT_FOR_FPS_NORUN)
+    {
+        return (runalive == 0);
+    }
+    if(task->flag & FPSTASK_FLAG_WAIT_FOR_FPS_RUNREADY)
+    {
+        return runalive &&
+               (md->status & FUNCTION_PARAMETER_STRUCT_STATUS_RUNLOOP);
+    }
+    if(task->flag & FPSTASK_FLAG_WAIT_FOR_FPS_CONFREADY)
+    {
+        return confalive &&
+               (md->status & FUNCTION_PARAMETER_STRUCT_STATUS_CONF);
+    }
+    return 1;
+}
+
+
+
 int function_parameter_process_fpsCMDarray(
     FPSCTRL_TASK_ENTRY *fpsctrltasklist,
     FPSCTRL_TASK_QUEUE *fpsctrlqueuelist,
@@ -48,13 +225,14 @@ int function_parameter_process_fpsCMDarray(
     // queue has a running task, must waiting for completion
     int QUEUE_WAIT = -2;
 
-    // queue is ready for next scan
-    int QUEUE_SCANREADY = -3;
+    int NBtaskLaunched = 0;
 
-    // the scheduler handles multiple queues
-    // in each queue, we look for a task to run, and run it if conditions are met
+    uint64_t waitpointflags = FPSTASK_FLAG_WAIT_FOR_FPS_NORUN |
+                              FPSTASK_FLAG_WAIT_FOR_FPS_RUNREADY |
+                              FPSTASK_FLAG_WAIT_FOR_FPS_CONFREADY;
 
-    int NBtaskLaunched = 0;
+    struct timespec tnow;
+    clock_gettime(CLOCK_MILK, &tnow);
 
     // For each queue, lets find which task is ready
     // results are written in array
@@ -62,102 +240,156 @@ int function_parameter_process_fpsCMDarray(
     //
     int queue_nexttask[NB_FPSCTRL_TASKQUEUE_MAX];
 
-    for(uint32_t qi = 0; qi < NB_FPSCTRL_TASKQUEUE_MAX; qi++)
+    int rescan = 1;
+    while(rescan == 1)
     {
-        queue_nexttask[qi] = QUEUE_SCANREADY;
+        rescan = 0;
 
-        while(queue_nexttask[qi] == QUEUE_SCANREADY)
+        // head of each queue : active task with smallest inputindex
+        // single pass over task list
+        uint64_t queue_inputindexmin[NB_FPSCTRL_TASKQUEUE_MAX];
+        for(uint32_t qi = 0; qi < NB_FPSCTRL_TASKQUEUE_MAX; qi++)
         {
-            // find next command to execute
-            uint64_t inputindexmin = UINT_MAX;
-            int      cmdindexExec;
-            int      cmdOK = 0;
-
-            queue_nexttask[qi] = QUEUE_NOTASK;
-            //
-            // Find task with smallest inputindex within this queue
-            // This is the one to be executed
-            //
-            for(int cmdindex = 0; cmdindex < NB_FPSCTRL_TASK_MAX; cmdindex++)
+            queue_nexttask[qi]      = QUEUE_NOTASK;
+            queue_inputindexmin[qi] = UINT64_MAX;
+        }
+        for(int cmdindex = 0; cmdindex < NB_FPSCTRL_TASK_MAX; cmdindex++)
+        {
+            if(fpsctrltasklist[cmdindex].status & FPSTASK_STATUS_ACTIVE)
             {
-                if((fpsctrltasklist[cmdindex].status &
-                        FPSTASK_STATUS_ACTIVE) &&
-                        (fpsctrltasklist[cmdindex].queue == qi))
+                uint32_t qi = fpsctrltasklist[cmdindex].queue;
+                if(fpsctrltasklist[cmdindex].inputindex <
+                        queue_inputindexmin[qi])
                 {
-                    if(fpsctrltasklist[cmdindex].inputindex < inputindexmin)
-                    {
-                        inputindexmin = fpsctrltasklist[cmdindex].inputindex;
-                        cmdindexExec  = cmdindex;
-                        cmdOK         = 1;
-                    }
+                    queue_inputindexmin[qi] = fpsctrltasklist[cmdindex].inputindex;
+                    queue_nexttask[qi]      = cmdindex;
                 }
             }
+        }
+
+        for(uint32_t qi = 0; qi < NB_FPSCTRL_TASKQUEUE_MAX; qi++)
+        {
+            if(queue_nexttask[qi] == QUEUE_NOTASK)
+            {
+                continue;
+            }
+            int cmdindexExec = queue_nexttask[qi];
 
-            if(cmdOK == 1)  // A potential task to be executed has been found
+            if(!(fpsctrltasklist[cmdindexExec].status &
+                    FPSTASK_STATUS_RUNNING))
             {
-                if(!(fpsctrltasklist[cmdindexExec].status &
-                        FPSTASK_STATUS_RUNNING)) // if task not running, launch it
+                // if task not running, launch it when dependencies are met
+                int depstatus =
+                    task_deps_completed(fpsctrltasklist, cmdindexExec);
+                if(depstatus == 0)
+                {
+                    fpsctrltasklist[cmdindexExec].status |=
+                        FPSTASK_STATUS_DEPWAIT;
+                    queue_nexttask[qi] = QUEUE_WAIT;
+                }
+                else if(depstatus == -1)
                 {
-                    queue_nexttask[qi] = cmdindexExec;
+                    // dependency failed : fail without executing
+                    fpsctrltasklist[cmdindexExec].status &=
+                        ~(FPSTASK_STATUS_DEPWAIT | FPSTASK_STATUS_ACTIVE |
+                          FPSTASK_STATUS_WAITING);
+                    fpsctrltasklist[cmdindexExec].status |=
+                        FPSTASK_STATUS_COMPLETED | FPSTASK_STATUS_CMDFAIL |
+                        FPSTASK_STATUS_DEPFAIL;
+                    clock_gettime(
+                        CLOCK_MILK,
+                        &fpsctrltasklist[cmdindexExec].completiontime);
+                    queue_nexttask[qi] = QUEUE_WAIT;
+                    rescan             = 1;
                 }
                 else
                 {
-                    // if it's already running, lets check if it is completed
-                    int task_completed = 1; // default
+                    fpsctrltasklist[cmdindexExec].status &=
+                        ~FPSTASK_STATUS_DEPWAIT;
+                }
+                continue;
+            }
 
-                    if(fpsctrltasklist[cmdindexExec].flag &
-                            FPSTASK_FLAG_WAITONRUN) // are we waiting for run to be completed ?
-                    {
-                        if((fps[fpsctrltasklist[cmdindexExec].fpsindex]
-                                .md->status &
-                                FUNCTION_PARAMETER_STRUCT_STATUS_CMDRUN))
-                        {
-                            task_completed     = 0; // must wait
-                            queue_nexttask[qi] = QUEUE_WAIT;
-                        }
-                    }
+            // if it's already running, lets check if it is completed
+            int task_completed = 1; // default
 
-                    if(fpsctrltasklist[cmdindexExec].flag &
-                            FPSTASK_FLAG_WAITONCONF) // are we waiting for conf update to be completed ?
+            if(fpsctrltasklist[cmdindexExec].flag & waitpointflags)
+            {
+                if(task_waitpoint_reached(&fpsctrltasklist[cmdindexExec],
+                                          fpsCTRLvar,
+                                          fps) == 1)
+                {
+                    fpsctrltasklist[cmdindexExec].status |=
+                        FPSTASK_STATUS_CMDOK;
+                }
+                else if((fpsctrltasklist[cmdindexExec].timeout > 0.0) &&
+                        (timespec_elapsed(
+                             fpsctrltasklist[cmdindexExec].activationtime,
+                             tnow) > fpsctrltasklist[cmdindexExec].timeout))
+                {
+                    fpsctrltasklist[cmdindexExec].status |=
+                        FPSTASK_STATUS_CMDFAIL | FPSTASK_STATUS_TIMEOUT;
+                }
+                else
+                {
+                    task_completed = 0; // must wait
+                }
+            }
+            else if(fpsctrltasklist[cmdindexExec].fpsindex > -1)
+            {
+                if(fpsctrltasklist[cmdindexExec].flag &
+                        FPSTASK_FLAG_WAITONRUN) // are we waiting for run to be completed ?
+                {
+                    if((fps[fpsctrltasklist[cmdindexExec].fpsindex]
+                            .md->status &
+                            FUNCTION_PARAMETER_STRUCT_STATUS_CMDRUN))
                     {
-                        if(fps[fpsctrltasklist[cmdindexExec].fpsindex]
-                                .md->status &
-                                FUNCTION_PARAMETER_STRUCT_SIGNAL_CHECKED)
-                        {
-                            task_completed     = 0; // must wait
-                            queue_nexttask[qi] = QUEUE_WAIT;
-                        }
+                        task_completed = 0; // must wait
                     }
+                }
 
-                    if(task_completed == 1)
+                if(fpsctrltasklist[cmdindexExec].flag &
+                        FPSTASK_FLAG_WAITONCONF) // are we waiting for conf update to be completed ?
+                {
+                    if(fps[fpsctrltasklist[cmdindexExec].fpsindex]
+                            .md->status &
+                            FUNCTION_PARAMETER_STRUCT_SIGNAL_CHECKED)
                     {
-                        // update status - no longer running
-                        fpsctrltasklist[cmdindexExec].status &=
-                            ~FPSTASK_STATUS_RUNNING;
-                        fpsctrltasklist[cmdindexExec].status |=
-                            FPSTASK_STATUS_COMPLETED;
-
-                        //no longer active, remove it from list
-                        fpsctrltasklist[cmdindexExec].status &=
-                            ~FPSTASK_STATUS_ACTIVE;
-
-                        //   fpsctrltasklist[cmdindexExec].status &= ~FPSTASK_STATUS_SHOW; // and stop displaying
-
-                        clock_gettime(
-                            CLOCK_MILK,
-                            &fpsctrltasklist[cmdindexExec].completiontime);
-                        queue_nexttask[qi] = QUEUE_SCANREADY;
+                        task_completed = 0; // must wait
                     }
                 }
-            } // end if(cmdOK==1)
-        }     // end while QUEUE_SCANREADY
+            }
+
+            if(task_completed == 1)
+            {
+                // update status - no longer running
+                fpsctrltasklist[cmdindexExec].status &=
+                    ~FPSTASK_STATUS_RUNNING;
+                fpsctrltasklist[cmdindexExec].status |=
+                    FPSTASK_STATUS_COMPLETED;
+
+                //no longer active, remove it from list
+                fpsctrltasklist[cmdindexExec].status &=
+                    ~FPSTASK_STATUS_ACTIVE;
+
+                clock_gettime(
+                    CLOCK_MILK,
+                    &fpsctrltasklist[cmdindexExec].completiontime);
+
+                // next task in queue, or dependent tasks, may now be ready
+                rescan = 1;
+            }
+            else
+            {
+                queue_nexttask[qi] = QUEUE_WAIT;
+            }
+        }
     }
 
     // Remove old tasks
     //
     double         *completion_age; // completion time
     long            oldest_index = 0;
-    struct timespec tnow;
     double          tnowd;
 
     completion_age = (double *) malloc(sizeof(double) * NB_FPSCTRL_TASK_MAX);
@@ -197,38 +429,69 @@ int function_parameter_process_fpsCMDarray(
         }
         if(taskcnt > NB_FPSCTRL_TASK_MAX - NB_FPSCTRL_TASK_PURGESIZE)
         {
-            fpsctrltasklist[oldest_index].status = 0;
+            FPSCTRL_TASK_ENTRY *task = &fpsctrltasklist[oldest_index];
+            if(task->label[0] != '\0')
+            {
+                // remember label and outcome
+                strcpy(purgedlabel[purgedlabelpos].label, task->label);
+                purgedlabel[purgedlabelpos].inputindex = task->inputindex;
+                purgedlabel[purgedlabelpos].failed =
+                    (task->status & FPSTASK_STATUS_FAILMASK) ? 1 : 0;
+                purgedlabelpos =
+                    (purgedlabelpos + 1) % FPSTASK_PURGEDLABEL_MAX;
+                if(NBpurgedlabel < FPSTASK_PURGEDLABEL_MAX)
+                {
+                    NBpurgedlabel++;
+                }
+            }
+            task->status = 0;
         }
     }
 
     free(completion_age);
 
-    // find out which task to run among the ones pre-selected above
+    // launch ready tasks, highest priority first
+    // equal priority : lower queue index first
 
-    int nexttask_priority = -1;
-    int nexttask_cmdindex = -1;
+    int launchorder[NB_FPSCTRL_TASKQUEUE_MAX];
+    int NBlaunch = 0;
     for(uint32_t qi = 0; qi < NB_FPSCTRL_TASKQUEUE_MAX; qi++)
     {
         if((queue_nexttask[qi] != QUEUE_NOTASK) &&
-                (queue_nexttask[qi] != QUEUE_WAIT))
+                (queue_nexttask[qi] != QUEUE_WAIT) &&
+                (fpsctrlqueuelist[qi].priority > 0))
         {
-            if(fpsctrlqueuelist[qi].priority > nexttask_priority)
+            // insertion sort, stable
+            int pos = NBlaunch;
+            while((pos > 0) && (fpsctrlqueuelist[launchorder[pos - 1]].priority <
+                                fpsctrlqueuelist[qi].priority))
             {
-                nexttask_priority = fpsctrlqueuelist[qi].priority;
-                nexttask_cmdindex = queue_nexttask[qi];
+                launchorder[pos] = launchorder[pos - 1];
+                pos--;
             }
+            launchorder[pos] = qi;
+            NBlaunch++;
         }
     }
 
-    if(nexttask_cmdindex != -1)
+    for(int li = 0; li < NBlaunch; li++)
     {
-        if(nexttask_priority > 0)
-        {
-            // execute task
-            int cmdindexExec = nexttask_cmdindex;
+        // execute task
+        int cmdindexExec = queue_nexttask[launchorder[li]];
+
+        uint64_t taskstatus = 0;
 
-            uint64_t taskstatus = 0;
+        clock_gettime(CLOCK_MILK,
+                      &fpsctrltasklist[cmdindexExec].activationtime);
 
+        if(fpsctrltasklist[cmdindexExec].flag & waitpointflags)
+        {
+            // wait point : resolved when checking completion
+            taskstatus |= FPSTASK_STATUS_RECEIVED;
+            fpsctrltasklist[cmdindexExec].fpsindex = -1;
+        }
+        else
+        {
             fpsctrltasklist[cmdindexExec].fpsindex =
                 functionparameter_FPSprocess_cmdline(
                     fpsctrltasklist[cmdindexExec].cmdstring,
@@ -237,18 +500,15 @@ int function_parameter_process_fpsCMDarray(
                     fpsCTRLvar,
                     fps,
                     &taskstatus);
-            NBtaskLaunched++;
-
-            // update status form cmdline interpreter
-            fpsctrltasklist[cmdindexExec].status |= taskstatus;
+        }
+        NBtaskLaunched++;
 
-            clock_gettime(CLOCK_MILK,
-                          &fpsctrltasklist[cmdindexExec].activationtime);
+        // update status form cmdline interpreter
+        fpsctrltasklist[cmdindexExec].status |= taskstatus;
 
-            // update status to running
-            fpsctrltasklist[cmdindexExec].status |= FPSTASK_STATUS_RUNNING;
-            fpsctrltasklist[cmdindexExec].status &= ~FPSTASK_STATUS_WAITING;
-        }
+        // update status to running
+        fpsctrltasklist[cmdindexExec].status |= FPSTASK_STATUS_RUNNING;
+        fpsctrltasklist[cmdindexExec].status &= ~FPSTASK_STATUS_WAITING;
     }
 
     return NBtaskLaunched;
@@ -13,4 +13,7 @@ int function_parameter_process_fpsCMDarray(FPSCTRL_TASK_ENTRY *fpsctrltasklist,
         FPSCTRL_PROCESS_VARS *fpsCTRLvar,
         FUNCTION_PARAMETER_STRUCT *fps);
 
+int functionparameter_tasklabel_known(FPSCTRL_TASK_ENTRY *fpsctrltasklist,
+                                      const char         *label);
+
 #endif
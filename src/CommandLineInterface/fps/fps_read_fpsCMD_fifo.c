@@ -1,241 +1,491 @@
 /**
  * @file    fps_read_fpsCMD_fifo.c
+ * @brief   fill up task list from fifo submissions
+ *
+ * Fifo content is read in large blocks into a persistent buffer and
+ * split into lines. Incomplete lines are kept for the next call, so a
+ * command is not lost if its writer is preempted mid-line. Lines
+ * containing NUL bytes or exceeding STRINGMAXLEN_FPS_CMDLINE are
+ * rejected.
+ *
+ * If the task list is full, remaining lines stay in the buffer and
+ * the fifo is not read further until entries are purged.
+ *
+ * Lines between "txbegin" and "txend" form a transaction : tasks are
+ * staged, then activated together on "txend", with consecutive input
+ * indices. "txabort", or the task list filling up, drops all staged
+ * tasks. To prevent interleaving with other writers, a transaction
+ * should be submitted in a single write() of at most PIPE_BUF bytes.
+ *
+ * "tasklabel <label>" labels the next task, "taskdep <label>" makes the
+ * next task wait for completion of labelled tasks already submitted.
+ * A taskdep label carried by no submitted task is rejected : the next task
+ * is entered as failed (DEPFAIL) without being executed, or the
+ * transaction is dropped.
+ * Wait point commands (waitfpsrun, waitfpsconf, waitfpsnorun) are
+ * flagged here and resolved by the scheduler.
  */
 
 #include "CommandLineInterface/CLIcore.h"
 
-// fill up task list from fifo submissions
+#include "fps_outlog.h"
+#include "fps_process_fpsCMDarray.h"
+
+#define FPSCMD_FIFO_BUFSIZE 65536
+
+static char   fifobuf[FPSCMD_FIFO_BUFSIZE];
+static size_t fifobuflen = 0;
+
+// set when buffer filled up without newline : skip until next newline
+static int fifolinediscard = 0;
+
+// toggles
+static uint32_t queue      = 0;
+static int      waitonrun  = 0;
+static int      waitonconf = 0;
+
+static uint64_t cmdinputcnt = 0;
+
+// applied to next task
+static char nextlabel[FPSTASK_LABEL_STRLEN] = "";
+static int  nextNBdep                       = 0;
+static char nextdeplabel[FPSTASK_MAXNBDEP][FPSTASK_LABEL_STRLEN];
+static int  nextdepunknown = 0; // next task rejected
+
+// free entry search starts here
+static int cmdindexhint = 0;
+
+// transaction state
+static int txactive = 0;
+static int txfail   = 0;
+
+
+
+
+// end of transaction : activate or drop staged tasks
 //
+static int fifo_tx_close(
+    FPSCTRL_TASK_ENTRY *fpsctrltasklist,
+    int                 commit
+)
+{
+    int NBtask = 0;
 
+    for(int cmdindex = 0; cmdindex < NB_FPSCTRL_TASK_MAX; cmdindex++)
+    {
+        if(fpsctrltasklist[cmdindex].status & FPSTASK_STATUS_STAGED)
+        {
+            if(commit == 1)
+            {
+                fpsctrltasklist[cmdindex].status =
+                    FPSTASK_STATUS_ACTIVE | FPSTASK_STATUS_SHOW |
+                    FPSTASK_STATUS_WAITING;
+                NBtask++;
+            }
+            else
+            {
+                fpsctrltasklist[cmdindex].status = 0;
+            }
+        }
+    }
 
-int functionparameter_read_fpsCMD_fifo(
-    int                 fpsCTRLfifofd,
+    txactive = 0;
+
+    return NBtask;
+}
+
+
+
+
+// process single command line
+// returns number of tasks activated, -1 if task list is full
+//
+static int fifo_process_line(
+    char               *FPScmdline,
     FPSCTRL_TASK_ENTRY *fpsctrltasklist,
     FPSCTRL_TASK_QUEUE *fpsctrlqueuelist
 )
 {
-    int   cmdcnt     = 0;
-    char *FPScmdline = NULL;
-    char  buff[200];
-    int   total_bytes = 0;
-    int   bytes;
-    char  buf0[1];
+    DEBUG_TRACEPOINT("%s", FPScmdline);
 
-    // toggles
-    static uint32_t queue      = 0;
-    static int      waitonrun  = 0;
-    static int      waitonconf = 0;
+    // disregard line
+    if((FPScmdline[0] == '#') || (FPScmdline[0] == ' ') ||
+            (FPScmdline[0] == '\0'))
+    {
+        return 0;
+    }
 
-    static uint16_t cmdinputcnt = 0;
+    // transaction control
+    if(strncmp(FPScmdline, "txbegin", strlen("txbegin")) == 0)
+    {
+        if(txactive == 1)
+        {
+            functionparameter_outlog("FIFO", "txbegin inside transaction");
+            return 0;
+        }
+        txactive = 1;
+        txfail   = 0;
+        return 0;
+    }
 
-    int lineOK = 1; // keep reading
+    if(strncmp(FPScmdline, "txend", strlen("txend")) == 0)
+    {
+        if(txactive == 0)
+        {
+            functionparameter_outlog("FIFO", "txend without txbegin");
+            return 0;
+        }
+        return fifo_tx_close(fpsctrltasklist, (txfail == 0));
+    }
 
-    DEBUG_TRACEPOINT(" ");
+    if(strncmp(FPScmdline, "txabort", strlen("txabort")) == 0)
+    {
+        if(txactive == 1)
+        {
+            fifo_tx_close(fpsctrltasklist, 0);
+        }
+        return 0;
+    }
+
+    if((txactive == 1) && (txfail == 1))
+    {
+        // failed transaction : ignore until txend
+        return 0;
+    }
+
+    // Some commands affect how the task list is configured instead of being inserted as entries
+
+    // set task counter to zero
+    if(strncmp(FPScmdline, "taskcntzero", strlen("taskcntzero")) == 0)
+    {
+        cmdinputcnt = 0;
+        return 0;
+    }
 
-    while(lineOK == 1)
+    // Set queue index
+    // entries will now be placed in queue specified by this command
+    if(strncmp(FPScmdline, "setqindex", strlen("setqindex")) == 0)
     {
-        total_bytes = 0;
-        lineOK      = 0;
-        for(;;)
+        char stringtmp[STRINGMAXLEN_FPS_CMDLINE];
+        int  queue_index = -1;
+        sscanf(FPScmdline, "%s %d", stringtmp, &queue_index);
+
+        if((queue_index > -1) && (queue_index < NB_FPSCTRL_TASKQUEUE_MAX))
         {
-            bytes = read(fpsCTRLfifofd, buf0, 1); // read one char at a time
-            DEBUG_TRACEPOINT("ERRROR: BUFFER OVERFLOW %d %d\n",
-                             bytes,
-                             total_bytes);
-            if(bytes > 0)
+            queue = queue_index;
+        }
+        return 0;
+    }
+
+    // Set current queue priority
+    if(strncmp(FPScmdline, "setqprio", strlen("setqprio")) == 0)
+    {
+        char stringtmp[STRINGMAXLEN_FPS_CMDLINE];
+        int  queue_priority = 0;
+        sscanf(FPScmdline, "%s %d", stringtmp, &queue_priority);
+
+        if(queue_priority < 0)
+        {
+            queue_priority = 0;
+        }
+
+        fpsctrlqueuelist[queue].priority = queue_priority;
+        return 0;
+    }
+
+    // set wait on run ON
+    if(strncmp(FPScmdline, "waitonrunON", strlen("waitonrunON")) == 0)
+    {
+        waitonrun = 1;
+        return 0;
+    }
+
+    // set wait on run OFF
+    if(strncmp(FPScmdline, "waitonrunOFF", strlen("waitonrunOFF")) == 0)
+    {
+        waitonrun = 0;
+        return 0;
+    }
+
+    // set wait on conf ON
+    if(strncmp(FPScmdline, "waitonconfON", strlen("waitonconfON")) == 0)
+    {
+        waitonconf = 1;
+        return 0;
+    }
+
+    // set wait on conf OFF
+    if(strncmp(FPScmdline, "waitonconfOFF", strlen("waitonconfOFF")) == 0)
+    {
+        waitonconf = 0;
+        return 0;
+    }
+
+    // label next task
+    if(strncmp(FPScmdline, "tasklabel", strlen("tasklabel")) == 0)
+    {
+        char stringtmp[STRINGMAXLEN_FPS_CMDLINE];
+        char label[STRINGMAXLEN_FPS_CMDLINE] = "";
+        sscanf(FPScmdline, "%s %s", stringtmp, label);
+        strncpy(nextlabel, label, FPSTASK_LABEL_STRLEN - 1);
+        return 0;
+    }
+
+    // add dependency to next task
+    if(strncmp(FPScmdline, "taskdep", strlen("taskdep")) == 0)
+    {
+        char stringtmp[STRINGMAXLEN_FPS_CMDLINE];
+        char label[STRINGMAXLEN_FPS_CMDLINE] = "";
+        int  NBarg = sscanf(FPScmdline, "%s %s", stringtmp, label);
+        label[FPSTASK_LABEL_STRLEN - 1] = '\0'; // as stored by tasklabel
+
+        if((NBarg != 2) || (nextNBdep >= FPSTASK_MAXNBDEP))
+        {
+            functionparameter_outlog("FIFO",
+                                     "taskdep ignored : %s",
+                                     FPScmdline);
+        }
+        else if(functionparameter_tasklabel_known(fpsctrltasklist, label) == 0)
+        {
+            functionparameter_outlog("FIFO",
+                                     "taskdep %s : unknown label",
+                                     label);
+            if(txactive == 1)
             {
-                buff[total_bytes] = buf0[0];
-                total_bytes += (size_t) bytes;
+                functionparameter_outlog("FIFO", "transaction dropped");
+                fifo_tx_close(fpsctrltasklist, 0);
+                txactive     = 1;
+                txfail       = 1;
+                nextlabel[0] = '\0';
+                nextNBdep    = 0;
             }
             else
             {
-                if(errno == EWOULDBLOCK)
-                {
-                    break;
-                }
-                else // read 0 byte
-                {
-                    //perror("read 0 byte");
-                    return cmdcnt;
-                }
+                nextdepunknown = 1;
             }
+        }
+        else
+        {
+            strcpy(nextdeplabel[nextNBdep], label);
+            nextNBdep++;
+        }
+        return 0;
+    }
 
-            DEBUG_TRACEPOINT(" ");
+    // for all other commands, put in task list
 
-            if(buf0[0] == '\n')
-            {
-                // reached end of line
-                // -> process command
-                //
+    // find next free index
+    int cmdindex = -1;
+    for(int i = 0; i < NB_FPSCTRL_TASK_MAX; i++)
+    {
+        int ci = (cmdindexhint + i) % NB_FPSCTRL_TASK_MAX;
+        if(fpsctrltasklist[ci].status == 0)
+        {
+            cmdindex = ci;
+            break;
+        }
+    }
 
-                buff[total_bytes - 1] = '\0';
-                FPScmdline            = buff;
+    if(cmdindex == -1)
+    {
+        if(txactive == 1)
+        {
+            functionparameter_outlog("FIFO",
+                                     "task list full (%d), transaction dropped",
+                                     NB_FPSCTRL_TASK_MAX);
+            fifo_tx_close(fpsctrltasklist, 0);
+            txactive = 1;
+            txfail   = 1;
+            return 0;
+        }
+        return -1;
+    }
+    cmdindexhint = (cmdindex + 1) % NB_FPSCTRL_TASK_MAX;
 
-                // find next index
-                int cmdindex   = 0;
-                int cmdindexOK = 0;
-                while((cmdindexOK == 0) && (cmdindex < NB_FPSCTRL_TASK_MAX))
-                {
-                    if(fpsctrltasklist[cmdindex].status == 0)
-                    {
-                        cmdindexOK = 1;
-                    }
-                    else
-                    {
-                        cmdindex++;
-                    }
-                }
+    strncpy(fpsctrltasklist[cmdindex].cmdstring,
+            FPScmdline,
+            STRINGMAXLEN_FPS_CMDLINE - 1);
 
-                if(cmdindex == NB_FPSCTRL_TASK_MAX)
-                {
-                    printf(
-                        "ERROR: fpscmdarray is full, %d NB_FPSCTRL_TASK_MAX "
-                        "limit reached\n",
-                        NB_FPSCTRL_TASK_MAX);
-                    exit(0);
-                }
+    fpsctrltasklist[cmdindex].inputindex = cmdinputcnt;
+    fpsctrltasklist[cmdindex].queue      = queue;
+    clock_gettime(CLOCK_MILK, &fpsctrltasklist[cmdindex].creationtime);
 
-                DEBUG_TRACEPOINT(" ");
+    fpsctrltasklist[cmdindex].flag = 0;
+    if(waitonrun == 1)
+    {
+        fpsctrltasklist[cmdindex].flag |= FPSTASK_FLAG_WAITONRUN;
+    }
+    if(waitonconf == 1)
+    {
+        fpsctrltasklist[cmdindex].flag |= FPSTASK_FLAG_WAITONCONF;
+    }
 
-                // Some commands affect how the task list is configured instead of being inserted as entries
-                int cmdFOUND = 0;
+    // wait points : <cmd> <fpsname> [timeout]
+    {
+        char   stringtmp[STRINGMAXLEN_FPS_CMDLINE];
+        char   fpsname[STRINGMAXLEN_FPS_CMDLINE];
+        double timeout = 0.0;
+        sscanf(FPScmdline, "%s %s %lf", stringtmp, fpsname, &timeout);
 
-                if((FPScmdline[0] == '#') || (FPScmdline[0] == ' ') ||
-                        (total_bytes < 2)) // disregard line
-                {
-                    cmdFOUND = 1;
-                }
+        if(strcmp(stringtmp, "waitfpsrun") == 0)
+        {
+            fpsctrltasklist[cmdindex].flag |= FPSTASK_FLAG_WAIT_FOR_FPS_RUNREADY;
+        }
+        if(strcmp(stringtmp, "waitfpsconf") == 0)
+        {
+            fpsctrltasklist[cmdindex].flag |=
+                FPSTASK_FLAG_WAIT_FOR_FPS_CONFREADY;
+        }
+        if(strcmp(stringtmp, "waitfpsnorun") == 0)
+        {
+            fpsctrltasklist[cmdindex].flag |= FPSTASK_FLAG_WAIT_FOR_FPS_NORUN;
+        }
+        fpsctrltasklist[cmdindex].timeout = (timeout > 0.0) ? timeout : 0.0;
+    }
 
-                // set task counter to zero
-                if((cmdFOUND == 0) && (strncmp(FPScmdline,
-                                               "taskcntzero",
-                                               strlen("taskcntzero")) == 0))
-                {
-                    cmdFOUND    = 1;
-                    cmdinputcnt = 0;
-                }
+    // label and dependencies
+    strcpy(fpsctrltasklist[cmdindex].label, nextlabel);
+    fpsctrltasklist[cmdindex].NBdep = nextNBdep;
+    for(int dep = 0; dep < nextNBdep; dep++)
+    {
+        strcpy(fpsctrltasklist[cmdindex].deplabel[dep], nextdeplabel[dep]);
+    }
+    nextlabel[0] = '\0';
+    nextNBdep    = 0;
 
-                // Set queue index
-                // entries will now be placed in queue specified by this command
-                if((cmdFOUND == 0) &&
-                        (strncmp(FPScmdline, "setqindex", strlen("setqindex")) ==
-                         0))
-                {
-                    cmdFOUND = 1;
-                    char stringtmp[200];
-                    int  queue_index;
-                    sscanf(FPScmdline, "%s %d", stringtmp, &queue_index);
-
-                    if((queue_index > -1) &&
-                            (queue_index < NB_FPSCTRL_TASKQUEUE_MAX))
-                    {
-                        queue = queue_index;
-                    }
-                }
+    cmdinputcnt++;
 
-                // Set current queue priority
-                if((cmdFOUND == 0) &&
-                        (strncmp(FPScmdline, "setqprio", strlen("setqprio")) == 0))
-                {
-                    cmdFOUND = 1;
-                    char stringtmp[200];
-                    int  queue_priority;
-                    sscanf(FPScmdline, "%s %d", stringtmp, &queue_priority);
+    if(nextdepunknown == 1)
+    {
+        // rejected : completes as failed, dependents fail too
+        nextdepunknown                   = 0;
+        fpsctrltasklist[cmdindex].status = FPSTASK_STATUS_SHOW |
+                                           FPSTASK_STATUS_COMPLETED |
+                                           FPSTASK_STATUS_CMDFAIL |
+                                           FPSTASK_STATUS_DEPFAIL;
+        clock_gettime(CLOCK_MILK, &fpsctrltasklist[cmdindex].completiontime);
+        return 0;
+    }
 
-                    if(queue_priority < 0)
-                    {
-                        queue_priority = 0;
-                    }
+    if(txactive == 1)
+    {
+        // activated on txend
+        fpsctrltasklist[cmdindex].status = FPSTASK_STATUS_STAGED;
+        return 0;
+    }
 
-                    fpsctrlqueuelist[queue].priority = queue_priority;
-                }
+    // waiting to be processed
+    fpsctrltasklist[cmdindex].status =
+        FPSTASK_STATUS_ACTIVE | FPSTASK_STATUS_SHOW | FPSTASK_STATUS_WAITING;
 
-                // set wait on run ON
-                if((cmdFOUND == 0) && (strncmp(FPScmdline,
-                                               "waitonrunON",
-                                               strlen("waitonrunON")) == 0))
-                {
-                    cmdFOUND  = 1;
-                    waitonrun = 1;
-                }
+    return 1;
+}
 
-                // set wait on run OFF
-                if((cmdFOUND == 0) && (strncmp(FPScmdline,
-                                               "waitonrunOFF",
-                                               strlen("waitonrunOFF")) == 0))
-                {
-                    cmdFOUND  = 1;
-                    waitonrun = 0;
-                }
 
-                // set wait on conf ON
-                if((cmdFOUND == 0) && (strncmp(FPScmdline,
-                                               "waitonconfON",
-                                               strlen("waitonconfON")) == 0))
-                {
-                    cmdFOUND   = 1;
-                    waitonconf = 1;
-                }
 
-                // set wait on conf OFF
-                if((cmdFOUND == 0) && (strncmp(FPScmdline,
-                                               "waitonconfOFF",
-                                               strlen("waitonconfOFF")) == 0))
-                {
-                    cmdFOUND   = 1;
-                    waitonconf = 0;
-                }
 
-                // set wait point for arbitrary FPS run to have finished
+int functionparameter_read_fpsCMD_fifo(
+    int                 fpsCTRLfifofd,
+    FPSCTRL_TASK_ENTRY *fpsctrltasklist,
+    FPSCTRL_TASK_QUEUE *fpsctrlqueuelist
+)
+{
+    int cmdcnt   = 0;
+    int listfull = 0;
+
+    DEBUG_TRACEPOINT(" ");
+
+    while(listfull == 0)
+    {
+        ssize_t bytes = 0;
+        if(fifobuflen < FPSCMD_FIFO_BUFSIZE)
+        {
+            bytes = read(fpsCTRLfifofd,
+                         fifobuf + fifobuflen,
+                         FPSCMD_FIFO_BUFSIZE - fifobuflen);
+            if(bytes > 0)
+            {
+                fifobuflen += bytes;
+            }
+        }
+
+        // process complete lines
+        size_t linestart = 0;
+        while(linestart < fifobuflen)
+        {
+            char *nlptr = memchr(fifobuf + linestart,
+                                 '\n',
+                                 fifobuflen - linestart);
+            if(nlptr == NULL)
+            {
+                break;
+            }
+            size_t linelen = nlptr - (fifobuf + linestart);
+
+            if(fifolinediscard == 1)
+            {
+                // tail of overlong line
+                fifolinediscard = 0;
+                linestart += linelen + 1;
+                continue;
+            }
 
-                DEBUG_TRACEPOINT(" ");
+            size_t cmdlen = linelen;
+            if((cmdlen > 0) && (fifobuf[linestart + cmdlen - 1] == '\r'))
+            {
+                cmdlen--;
+            }
 
-                // for all other commands, put in task list
-                if(cmdFOUND == 0)
+            if(cmdlen >= STRINGMAXLEN_FPS_CMDLINE)
+            {
+                functionparameter_outlog("FIFO",
+                                         "line too long (%ld), rejected",
+                                         (long) cmdlen);
+            }
+            else if(memchr(fifobuf + linestart, '\0', cmdlen) != NULL)
+            {
+                functionparameter_outlog("FIFO",
+                                         "NUL byte in line, rejected");
+            }
+            else
+            {
+                char FPScmdline[STRINGMAXLEN_FPS_CMDLINE];
+                memcpy(FPScmdline, fifobuf + linestart, cmdlen);
+                FPScmdline[cmdlen] = '\0';
+
+                int ret = fifo_process_line(FPScmdline,
+                                            fpsctrltasklist,
+                                            fpsctrlqueuelist);
+                if(ret == -1)
                 {
-                    strncpy(fpsctrltasklist[cmdindex].cmdstring,
-                            FPScmdline,
-                            STRINGMAXLEN_FPS_CMDLINE - 1);
-
-                    fpsctrltasklist[cmdindex].status =
-                        FPSTASK_STATUS_ACTIVE | FPSTASK_STATUS_SHOW;
-                    fpsctrltasklist[cmdindex].inputindex = cmdinputcnt;
-                    fpsctrltasklist[cmdindex].queue      = queue;
-                    clock_gettime(CLOCK_MILK,
-                                  &fpsctrltasklist[cmdindex].creationtime);
-
-                    // waiting to be processed
-                    fpsctrltasklist[cmdindex].status |= FPSTASK_STATUS_WAITING;
-
-                    if(waitonrun == 1)
-                    {
-                        fpsctrltasklist[cmdindex].flag |=
-                            FPSTASK_FLAG_WAITONRUN;
-                    }
-                    else
-                    {
-                        fpsctrltasklist[cmdindex].flag &=
-                            ~FPSTASK_FLAG_WAITONRUN;
-                    }
-
-                    if(waitonconf == 1)
-                    {
-                        fpsctrltasklist[cmdindex].flag |=
-                            FPSTASK_FLAG_WAITONCONF;
-                    }
-                    else
-                    {
-                        fpsctrltasklist[cmdindex].flag &=
-                            ~FPSTASK_FLAG_WAITONCONF;
-                    }
-
-                    cmdinputcnt++;
-
-                    cmdcnt++;
+                    // keep line for next call
+                    listfull = 1;
+                    break;
                 }
-                lineOK = 1;
-                break;
+                cmdcnt += ret;
             }
+            linestart += linelen + 1;
+        }
+
+        if(linestart > 0)
+        {
+            memmove(fifobuf, fifobuf + linestart, fifobuflen - linestart);
+            fifobuflen -= linestart;
+        }
+
+        if((fifobuflen == FPSCMD_FIFO_BUFSIZE) && (listfull == 0))
+        {
+            // buffer full without newline
+            functionparameter_outlog("FIFO", "line too long, rejected");
+            fifobuflen      = 0;
+            fifolinediscard = 1;
+            continue;
+        }
+
+        if(bytes <= 0)
+        {
+            // fifo drained
+            break;
         }
     }
 
@@ -543,7 +543,11 @@ errno_t functionparameter_CTRLscreen(
 
             fifocmdcnt += fcnt;
 
-            usleep(getchardt_us);
+            if(taskflag == 0)
+            {
+                usleep(getchardt_us);
+            }
+            // else : tasks pending, launch next without waiting
 
             // ==================
             // = GET USER INPUT =
@@ -40,7 +40,10 @@ errno_t fpsCTRL_scheduler_display(
         abort();
     }
 
-    long sortcnt = 0;
+    long   sortcnt    = 0;
+    long   latencycnt = 0;
+    double latencysum = 0.0;
+    double latencymax = 0.0;
     for(int fpscmdindex = 0; fpscmdindex < NB_FPSCTRL_TASK_MAX; fpscmdindex++)
     {
         if(fpsctrltasklist[fpscmdindex].status & FPSTASK_STATUS_SHOW)
@@ -49,6 +52,22 @@ errno_t fpsCTRL_scheduler_display(
                 -1.0 * fpsctrltasklist[fpscmdindex].inputindex;
             sort_indexarray[sortcnt] = fpscmdindex;
             sortcnt++;
+
+            if(fpsctrltasklist[fpscmdindex].status &
+                    (FPSTASK_STATUS_RUNNING | FPSTASK_STATUS_COMPLETED))
+            {
+                // latency : submission to activation
+                tdiff = timespec_diff(
+                            fpsctrltasklist[fpscmdindex].creationtime,
+                            fpsctrltasklist[fpscmdindex].activationtime);
+                double latency = 1.0 * tdiff.tv_sec + 1.0e-9 * tdiff.tv_nsec;
+                latencysum += latency;
+                if(latency > latencymax)
+                {
+                    latencymax = latency;
+                }
+                latencycnt++;
+            }
         }
     }
     DEBUG_TRACEPOINT(" ");
@@ -70,6 +89,13 @@ errno_t fpsCTRL_scheduler_display(
     }
     TUI_printfw(" showing   %5d / %5d  starting at %d", wrow - 8, sortcnt,
                 *firstrow);
+    if(latencycnt > 0)
+    {
+        TUI_printfw("    latency over %ld tasks : avg %8.3f ms  max %8.3f ms",
+                    latencycnt,
+                    1.0e3 * latencysum / latencycnt,
+                    1.0e3 * latencymax);
+    }
     TUI_newline();
 
     for(int sortindex = 0; sortindex < sortcnt; sortindex++)
@@ -105,6 +131,20 @@ errno_t fpsCTRL_scheduler_display(
             double tdiffv = 1.0 * tdiff.tv_sec + 1.0e-9 * tdiff.tv_nsec;
             TUI_printfw("%6.2f s ", tdiffv);
 
+            if(fpsctrltasklist[fpscmdindex].status &
+                    (FPSTASK_STATUS_RUNNING | FPSTASK_STATUS_COMPLETED))
+            {
+                // latency : submission to activation
+                tdiff = timespec_diff(fpsctrltasklist[fpscmdindex].creationtime,
+                                      fpsctrltasklist[fpscmdindex].activationtime);
+                tdiffv = 1.0 * tdiff.tv_sec + 1.0e-9 * tdiff.tv_nsec;
+                TUI_printfw("%8.3f ms ", 1.0e3 * tdiffv);
+            }
+            else
+            {
+                TUI_printfw("            ");
+            }
+
             if(fpsctrltasklist[fpscmdindex].status & FPSTASK_STATUS_RUNNING)
             {
                 // run time (ongoing)
@@ -204,6 +244,16 @@ errno_t fpsCTRL_scheduler_display(
                 {
                     TUI_printfw(" NOFPS");
                 }
+                if(fpsctrltasklist[fpscmdindex].status &
+                        FPSTASK_STATUS_TIMEOUT)
+                {
+                    TUI_printfw(" TIMEOUT");
+                }
+                if(fpsctrltasklist[fpscmdindex].status &
+                        FPSTASK_STATUS_DEPFAIL)
+                {
+                    TUI_printfw(" DEPFAIL");
+                }
                 screenprint_unsetcolor(4);
             }
             else if(fpsctrltasklist[fpscmdindex].status & FPSTASK_STATUS_CMDOK)
@@ -219,6 +269,13 @@ errno_t fpsCTRL_scheduler_display(
                 TUI_printfw(" RECVD ");
                 screenprint_unsetcolor(2);
             }
+            else if(fpsctrltasklist[fpscmdindex].status &
+                    FPSTASK_STATUS_DEPWAIT)
+            {
+                screenprint_setcolor(5);
+                TUI_printfw("DEPWAIT");
+                screenprint_unsetcolor(5);
+            }
             else if(fpsctrltasklist[fpscmdindex].status &
                     FPSTASK_STATUS_WAITING)
             {
@@ -233,6 +290,14 @@ errno_t fpsCTRL_scheduler_display(
                 screenprint_unsetcolor(3);
             }
 
+            if(fpsctrltasklist[fpscmdindex].label[0] != '\0')
+            {
+                TUI_printfw("  [%s]", fpsctrltasklist[fpscmdindex].label);
+            }
+            for(int dep = 0; dep < fpsctrltasklist[fpscmdindex].NBdep; dep++)
+            {
+                TUI_printfw(" <%s", fpsctrltasklist[fpscmdindex].deplabel[dep]);
+            }
             TUI_printfw("  %s", fpsctrltasklist[fpscmdindex].cmdstring);
             TUI_newline();
 
@@ -576,6 +576,22 @@ typedef struct
 #define FPSTASK_STATUS_ERR_NOFPS    0x0000000000000800
 #define FPSTASK_STATUS_CMDOK        0x0000000000001000
 
+// staged in transaction, not yet active
+#define FPSTASK_STATUS_STAGED 0x0000000000002000
+
+// dependencies not completed, cannot start
+#define FPSTASK_STATUS_DEPWAIT 0x0000000000004000
+// wait point timed out
+#define FPSTASK_STATUS_TIMEOUT 0x0000000000008000
+// not executed : a dependency failed
+#define FPSTASK_STATUS_DEPFAIL 0x0000000000010000
+
+// task failed, dependent tasks fail too
+#define FPSTASK_STATUS_FAILMASK                                                \
+    (FPSTASK_STATUS_CMDNOTFOUND | FPSTASK_STATUS_CMDFAIL |                     \
+     FPSTASK_STATUS_ERR_ARGTYPE | FPSTASK_STATUS_ERR_TYPECONV |                \
+     FPSTASK_STATUS_ERR_NBARG | FPSTASK_STATUS_ERR_NOFPS)
+
 // use WAITONRUN to ensure the queue is blocked until the current run process is done
 #define FPSTASK_FLAG_WAITONRUN  0x0000000000000001
 #define FPSTASK_FLAG_WAITONCONF 0x0000000000000002
@@ -583,6 +599,13 @@ typedef struct
 // If ON, the task is a wait point, and will only proceed if the FPS pointed to by fpsindex is NOT running
 #define FPSTASK_FLAG_WAIT_FOR_FPS_NORUN 0x0000000000000004
 
+// wait points : task completes when the FPS named in the command has its RUN loop running, or its CONF process running
+#define FPSTASK_FLAG_WAIT_FOR_FPS_RUNREADY  0x0000000000000008
+#define FPSTASK_FLAG_WAIT_FOR_FPS_CONFREADY 0x0000000000000010
+
+#define FPSTASK_LABEL_STRLEN 32
+#define FPSTASK_MAXNBDEP     4 // max number of dependencies per task
+
 #define NB_FPSCTRL_TASKQUEUE_MAX 100 // max number of queues
 
 typedef struct
@@ -614,6 +637,15 @@ typedef struct
     struct timespec activationtime;
     struct timespec completiontime;
 
+    // optional label, referenced by other tasks dependencies
+    char label[FPSTASK_LABEL_STRLEN];
+
+    // labelled tasks that must be completed before this task starts
+    int  NBdep;
+    char deplabel[FPSTASK_MAXNBDEP][FPSTASK_LABEL_STRLEN];
+
+    double timeout; // wait point timeout [sec], 0 for none
+
 } FPSCTRL_TASK_ENTRY;
 
 // status of control / monitoring process
@@ -1,9 +1,12 @@
+#include <dirent.h>
+#include <fcntl.h>
+
 #include "CLIcore.h"
 #include <processtools.h>
 
 #include "CommandLineInterface/timeutils.h"
 
-#include "processinfo/processinfo_procdirname.h"
+#include "procCTRL_procfs.h"
 
 
 
@@ -15,59 +18,165 @@ static double scantime_CPUload;
 static double scantime_CPUpcnt;
 
 
+// /proc/stat is kept open and re-read with pread()
+// cpu lines are at the top of the file, ahead of the (long) intr line
+#define PROCSTAT_BUFSIZE 32768
+
+static int  fdprocstat = -1;
+static char procstatbuf[PROCSTAT_BUFSIZE];
+
+
+
+
+// per-CPU process count requires reading every /proc/<pid>/stat
+// it changes slowly and is display-only : rescan at most once per period
+#define CPUPCNT_PERIOD 1.0
+
+static DIR            *dpproc = NULL;
+static struct timespec tCPUpcnt;
+static int             CPUpcntinit = 0;
+
+
+
+
+/**
+ * @brief Count processes per CPU
+ *
+ * Reads field 39 (processor) of /proc/<pid>/stat for each process.
+ * Equivalent to ps -e -o psr, without fork/exec or intermediate files.
+ * /proc directory stream is kept open, files are opened relative to it.
+ * Counts are refreshed every CPUPCNT_PERIOD sec, independently of
+ * the CPU load refresh rate.
+ */
+static int GetCPUprocesscount(PROCINFOPROC *pinfop)
+{
+    struct dirent  *ep;
+    struct timespec tnow;
+    char            fname[STRINGMAXLEN_FULLFILENAME];
+    char            buf[PROCFS_TASKBUFSIZE];
+
+    clock_gettime(CLOCK_MILK, &tnow);
+    if(CPUpcntinit == 1)
+    {
+        struct timespec tdiffpcnt = timespec_diff(tCPUpcnt, tnow);
+        if(1.0 * tdiffpcnt.tv_sec + 1.0e-9 * tdiffpcnt.tv_nsec <
+                CPUPCNT_PERIOD)
+        {
+            return 0;
+        }
+    }
+    tCPUpcnt    = tnow;
+    CPUpcntinit = 1;
+
+    if(dpproc == NULL)
+    {
+        dpproc = opendir("/proc");
+        if(dpproc == NULL)
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        rewinddir(dpproc);
+    }
+    int dfd = dirfd(dpproc);
+
+    for(int cpu = 0; cpu < MAXNBCPU; cpu++)
+    {
+        pinfop->CPUpcnt[cpu] = 0;
+    }
+
+    while((ep = readdir(dpproc)))
+    {
+        if((ep->d_name[0] < '0') || (ep->d_name[0] > '9'))
+        {
+            continue;
+        }
+
+        WRITE_FULLFILENAME(fname, "%s/stat", ep->d_name);
+        int fd = openat(dfd, fname, O_RDONLY | O_CLOEXEC);
+        if(fd == -1)
+        {
+            continue;
+        }
+        ssize_t nbread = procfs_pread(fd, buf, PROCFS_TASKBUFSIZE);
+        close(fd);
+        if(nbread < 1)
+        {
+            continue;
+        }
+
+        // command name may contain blanks : start after closing parenthesis
+        const char *p = strrchr(buf, ')');
+        if(p == NULL)
+        {
+            continue;
+        }
+        // p+1 points to field 3 (state), skip fields 3 to 38
+        p             = procfs_skipfields(p + 1, 36);
+        int processor = (int) procfs_scanll(&p);
+        if((processor >= 0) && (processor < MAXNBCPU))
+        {
+            pinfop->CPUpcnt[processor]++;
+        }
+    }
+
+    return 0;
+}
+
+
+
+
 int GetCPUloads(PROCINFOPROC *pinfop)
 {
-    char     *line      = NULL;
-    size_t    maxstrlen = 256;
-    FILE     *fp;
-    ssize_t   read;
     int       cpu;
     long long vall0, vall1, vall2, vall3, vall4, vall5, vall6, vall7, vall8;
     long long v0, v1, v2, v3, v4, v5, v6, v7, v8;
-    char      string0[80];
 
     static int cnt = 0;
 
     clock_gettime(CLOCK_MILK, &t1);
 
-    line = (char *) malloc(sizeof(char) * maxstrlen);
-    if(line == NULL)
+    if(fdprocstat == -1)
     {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
+        fdprocstat = procfs_open("/proc/stat");
+        if(fdprocstat == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
     }
 
-    fp = fopen("/proc/stat", "r");
-    if(fp == NULL)
+    if(procfs_pread(fdprocstat, procstatbuf, PROCSTAT_BUFSIZE) < 1)
     {
-        exit(EXIT_FAILURE);
+        printf("[%s][%d]  ERROR: cannot read file\n", __FILE__, __LINE__);
+        exit(EXIT_SUCCESS);
     }
 
     cpu = 0;
 
-    read = getline(&line, &maxstrlen, fp);
-    if(read == -1)
-    {
-        printf("[%s][%d]  ERROR: cannot read file\n", __FILE__, __LINE__);
-        exit(EXIT_SUCCESS);
-    }
+    // skip first line (all CPUs aggregate)
+    const char *line = strchr(procstatbuf, '\n');
 
-    while(((read = getline(&line, &maxstrlen, fp)) != -1) &&
-            (cpu < pinfop->NBcpus))
+    while((line != NULL) && (cpu < pinfop->NBcpus))
     {
+        line++;
+        if(strncmp(line, "cpu", 3) != 0)
+        {
+            break;
+        }
 
-        sscanf(line,
-               "%s %lld %lld %lld %lld %lld %lld %lld %lld %lld",
-               string0,
-               &vall0,
-               &vall1,
-               &vall2,
-               &vall3,
-               &vall4,
-               &vall5,
-               &vall6,
-               &vall7,
-               &vall8);
+        const char *p = procfs_skipfields(line, 1);
+
+        vall0 = procfs_scanll(&p);
+        vall1 = procfs_scanll(&p);
+        vall2 = procfs_scanll(&p);
+        vall3 = procfs_scanll(&p);
+        vall4 = procfs_scanll(&p);
+        vall5 = procfs_scanll(&p);
+        vall6 = procfs_scanll(&p);
+        vall7 = procfs_scanll(&p);
+        vall8 = procfs_scanll(&p);
 
         v0 = vall0 - pinfop->CPUcnt0[cpu];
         v1 = vall1 - pinfop->CPUcnt1[cpu];
@@ -89,83 +198,23 @@ int GetCPUloads(PROCINFOPROC *pinfop)
         pinfop->CPUcnt7[cpu] = vall7;
         pinfop->CPUcnt8[cpu] = vall8;
 
-        pinfop->CPUload[cpu] = (1.0 * v0 + v1 + v2 + v4 + v5 + v6) /
-                               (v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8);
+        long long vtot = v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8;
+        if(vtot > 0)
+        {
+            pinfop->CPUload[cpu] = (1.0 * v0 + v1 + v2 + v4 + v5 + v6) / vtot;
+        }
         cpu++;
+
+        line = strchr(line, '\n');
     }
-    free(line);
-    fclose(fp);
     clock_gettime(CLOCK_MILK, &t2);
     tdiff = timespec_diff(t1, t2);
     scantime_CPUload += 1.0 * tdiff.tv_sec + 1.0e-9 * tdiff.tv_nsec;
 
     clock_gettime(CLOCK_MILK, &t1);
 
-    // number of process per CPU -> we can get that from ps
-    char command[STRINGMAXLEN_COMMAND];
-    char psoutfname[STRINGMAXLEN_FULLFILENAME];
-    char procdname[STRINGMAXLEN_DIRNAME];
-    processinfo_procdirname(procdname);
-
-    WRITE_FULLFILENAME(psoutfname, "%s/_psoutput.txt", procdname);
-
-    // use ps command to scan processes, store result in file psoutfname
-
-    EXECUTE_SYSTEM_COMMAND(
-        "{ if [ ! -f %s/_psOKlock ]; then touch %s/_psOKlock; ps -e -o "
-        "pid,psr,cpu,cmd > %s; fi; rm "
-        "%s/_psOKlock &> /dev/null; }",
-        procdname,
-        procdname,
-        psoutfname,
-        procdname);
-
-
-    // read and process psoutfname file
-
-    if(access(psoutfname, F_OK) != -1)
-    {
-
-        for(cpu = 0; cpu < pinfop->NBcpus; cpu++)
-        {
-            char  outstring[STRINGMAXLEN_DEFAULT];
-            FILE *fpout;
-            {
-                int slen = snprintf(command,
-                                    STRINGMAXLEN_COMMAND,
-                                    "CORENUM=%d; cat %s | grep -E  "
-                                    "\"^[[:space:]][[:digit:]]+[[:"
-                                    "space:]]+${CORENUM}\"|wc -l",
-                                    cpu,
-                                    psoutfname);
-                if(slen < 1)
-                {
-                    PRINT_ERROR("snprintf wrote <1 char");
-                    abort(); // can't handle this error any other way
-                }
-                if(slen >= STRINGMAXLEN_COMMAND)
-                {
-                    PRINT_ERROR("snprintf string truncation");
-                    abort(); // can't handle this error any other way
-                }
-            }
-            fpout = popen(command, "r");
-            if(fpout == NULL)
-            {
-                printf("WARNING: cannot run command \"%s\"\n", command);
-            }
-            else
-            {
-                if(fgets(outstring, STRINGMAXLEN_DEFAULT, fpout) == NULL)
-                {
-                    printf("WARNING: fgets error\n");
-                }
-                pclose(fpout);
-                pinfop->CPUpcnt[cpu] = atoi(outstring);
-            }
-        }
-        remove(psoutfname);
-    }
+    // number of process per CPU
+    GetCPUprocesscount(pinfop);
     cnt++;
 
     clock_gettime(CLOCK_MILK, &t2);
@@ -174,3 +223,18 @@ int GetCPUloads(PROCINFOPROC *pinfop)
 
     return (cpu);
 }
+
+
+
+/**
+ * @brief Release /proc/stat file descriptor and /proc directory stream
+ */
+void GetCPUloads_close()
+{
+    procfs_close(&fdprocstat);
+    if(dpproc != NULL)
+    {
+        closedir(dpproc);
+        dpproc = NULL;
+    }
+}
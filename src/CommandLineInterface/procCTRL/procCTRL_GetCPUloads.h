@@ -3,4 +3,6 @@
 
 int GetCPUloads(PROCINFOPROC *pinfop);
 
+void GetCPUloads_close();
+
 #endif
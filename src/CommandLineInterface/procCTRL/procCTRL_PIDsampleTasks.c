@@ -0,0 +1,462 @@
+/**
+ * @file    procCTRL_PIDsampleTasks.c
+ * @brief   Batched per-thread resource sampling for procCTRL
+ *
+ * All threads of all displayed processes are sampled in a single pass.
+ * /proc/<PID>/task/<TID>/{stat,status,schedstat,sched} file descriptors
+ * are opened once per thread and kept open between scans, so that each
+ * refresh costs one pread() per file and no allocation.
+ *
+ * Cached descriptors are capped at half of RLIMIT_NOFILE. Threads beyond
+ * the cap, or opened while the process is out of descriptors (EMFILE,
+ * ENFILE), are sampled with open/pread/close on each scan.
+ * A process is only reported gone on ENOENT/ESRCH.
+ */
+
+#include <errno.h>
+#include <sys/resource.h>
+
+#include "CLIcore.h"
+#include <processtools.h>
+
+#include "CommandLineInterface/timeutils.h"
+
+#include "procCTRL_procfs.h"
+#include "procCTRL_PIDsampleTasks.h"
+
+
+
+typedef struct
+{
+    pid_t PID; // process (thread group) ID
+    pid_t TID; // thread ID, 0 if slot unused
+
+    int cached; // 1 if descriptors below are kept open between scans
+
+    int fd_stat;      // per-thread stat : processor, rt_priority, ticks
+    int fd_status;    // context switches, VmRSS, Cpus_allowed_list
+    int fd_schedstat; // run time [ns], -1 if not supported by kernel
+    int fd_sched;     // se.nr_migrations, -1 if not supported by kernel
+    int fd_cpuset;    // main thread only
+
+    int  processor;  // last CPU seen, for migration count fallback
+    long migrations; // migration count fallback
+
+} PIDSAMPLE_TASK;
+
+
+static PIDSAMPLE_TASK *tasksamplearray = NULL;
+static long            NBtasksample    = 0;
+
+// descriptors opened per cached thread (at most)
+#define PIDSAMPLE_NBFD 5
+
+// cap if RLIMIT_NOFILE is unlimited
+#define PIDSAMPLE_MAXCACHEDFD 4096
+
+static long NBcachedfd  = 0;
+static long MAXcachedfd = 0;
+
+static char samplebuf[PROCFS_TASKBUFSIZE];
+
+
+
+
+static void PIDsampleTask_close(PIDSAMPLE_TASK *task)
+{
+    int *fdlist[PIDSAMPLE_NBFD] = {&task->fd_stat,
+                                   &task->fd_status,
+                                   &task->fd_schedstat,
+                                   &task->fd_sched,
+                                   &task->fd_cpuset
+                                  };
+
+    for(int fdi = 0; fdi < PIDSAMPLE_NBFD; fdi++)
+    {
+        if(*fdlist[fdi] != -1)
+        {
+            NBcachedfd--;
+        }
+        procfs_close(fdlist[fdi]);
+    }
+    task->cached = 0;
+    task->PID    = 0;
+    task->TID    = 0;
+}
+
+
+
+
+static int PIDsampleTask_openfd(PIDSAMPLE_TASK *task, const char *fname)
+{
+    char fullfname[STRINGMAXLEN_FULLFILENAME];
+
+    WRITE_FULLFILENAME(fullfname,
+                       "/proc/%d/task/%d/%s",
+                       task->PID,
+                       task->TID,
+                       fname);
+    int fd = procfs_open(fullfname);
+    if(fd != -1)
+    {
+        NBcachedfd++;
+    }
+    return fd;
+}
+
+
+
+
+/**
+ * @brief Start sampling thread TID of process PID
+ *
+ * Descriptors are cached if below cap, otherwise files are opened
+ * on each read.
+ *
+ * @return 0 if OK, -1 if thread does not exist (errno ENOENT or ESRCH)
+ */
+static int PIDsampleTask_open(PIDSAMPLE_TASK *task, pid_t PID, pid_t TID)
+{
+    PIDsampleTask_close(task);
+
+    task->PID        = PID;
+    task->TID        = TID;
+    task->processor  = -1;
+    task->migrations = 0;
+
+    if(NBcachedfd + PIDSAMPLE_NBFD > MAXcachedfd)
+    {
+        return 0;
+    }
+
+    task->fd_stat = PIDsampleTask_openfd(task, "stat");
+    if(task->fd_stat == -1)
+    {
+        if((errno == ENOENT) || (errno == ESRCH))
+        {
+            task->PID = 0;
+            task->TID = 0;
+            return -1;
+        }
+        // out of descriptors : sample without caching
+        return 0;
+    }
+    task->cached = 1;
+
+    task->fd_status    = PIDsampleTask_openfd(task, "status");
+    task->fd_schedstat = PIDsampleTask_openfd(task, "schedstat");
+    task->fd_sched     = PIDsampleTask_openfd(task, "sched");
+    if(PID == TID)
+    {
+        task->fd_cpuset = PIDsampleTask_openfd(task, "cpuset");
+    }
+
+    return 0;
+}
+
+
+
+
+/**
+ * @brief Read task file into samplebuf
+ *
+ * Uses cached descriptor fd, or open/pread/close if task is not cached.
+ * errno is preserved for the caller.
+ */
+static ssize_t PIDsampleTask_pread(PIDSAMPLE_TASK *task,
+                                   int             fd,
+                                   const char     *fname)
+{
+    if(task->cached == 1)
+    {
+        return procfs_pread(fd, samplebuf, PROCFS_TASKBUFSIZE);
+    }
+
+    char fullfname[STRINGMAXLEN_FULLFILENAME];
+    WRITE_FULLFILENAME(fullfname,
+                       "/proc/%d/task/%d/%s",
+                       task->PID,
+                       task->TID,
+                       fname);
+    int fd1 = procfs_open(fullfname);
+    if(fd1 == -1)
+    {
+        return -1;
+    }
+    ssize_t nbread   = procfs_pread(fd1, samplebuf, PROCFS_TASKBUFSIZE);
+    int     errnosav = errno;
+    close(fd1);
+    errno = errnosav;
+
+    return nbread;
+}
+
+
+
+
+/**
+ * @brief Sample one thread into subprocess index spindex of pinfodisp
+ *
+ * @return 0 if OK, -1 if stat cannot be read.
+ * errno is ENOENT or ESRCH if thread has gone away.
+ */
+static int PIDsampleTask_read(PIDSAMPLE_TASK  *task,
+                              PROCESSINFODISP *pinfodisp,
+                              int              spindex)
+{
+    struct timespec tnow;
+    const char     *p;
+    long long       ticks;
+    int             processor;
+
+    clock_gettime(CLOCK_MILK, &tnow);
+
+    // stat
+    ssize_t nbread = PIDsampleTask_pread(task, task->fd_stat, "stat");
+    if(nbread < 1)
+    {
+        if(nbread == 0)
+        {
+            // exited thread reads empty
+            errno = ESRCH;
+        }
+        return -1;
+    }
+    // command name may contain blanks : start after closing parenthesis
+    p = strrchr(samplebuf, ')');
+    if(p == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    p     = procfs_skipfields(p + 1, 11); // skip fields 3 to 13
+    ticks = procfs_scanll(&p);            // (14) utime
+    ticks += procfs_scanll(&p);           // (15) stime
+    p         = procfs_skipfields(p, 23); // skip fields 16 to 38
+    processor = (int) procfs_scanll(&p);  // (39) processor
+    if(spindex == 0)
+    {
+        pinfodisp->rt_priority = (int) procfs_scanll(&p); // (40)
+    }
+
+    pinfodisp->processorarray[spindex]  = processor;
+    pinfodisp->sampletimearray[spindex] = 1.0 * tnow.tv_sec + 1.0e-9 * tnow.tv_nsec;
+
+    // CPU time [ns]
+    // schedstat is ns-accurate, stat is in clock ticks (too coarse at >1Hz)
+    if(PIDsampleTask_pread(task, task->fd_schedstat, "schedstat") > 0)
+    {
+        p = samplebuf;
+        pinfodisp->cpuloadcntarray[spindex] = procfs_scanll(&p);
+    }
+    else
+    {
+        pinfodisp->cpuloadcntarray[spindex] =
+            ticks * (1000000000LL / sysconf(_SC_CLK_TCK));
+    }
+
+    // migrations
+    if(PIDsampleTask_pread(task, task->fd_sched, "sched") > 0)
+    {
+        p = procfs_findkey(samplebuf, "se.nr_migrations");
+        if(p != NULL)
+        {
+            task->migrations = procfs_scanll(&p);
+        }
+    }
+    else
+    {
+        // kernel without CONFIG_SCHED_DEBUG : count CPU changes between samples
+        if((task->processor != -1) && (task->processor != processor))
+        {
+            task->migrations++;
+        }
+    }
+    task->processor                = processor;
+    pinfodisp->migrations[spindex] = task->migrations;
+
+    // status
+    if(PIDsampleTask_pread(task, task->fd_status, "status") > 0)
+    {
+        p = procfs_findkey(samplebuf, "voluntary_ctxt_switches");
+        if(p != NULL)
+        {
+            pinfodisp->ctxtsw_voluntary[spindex] = procfs_scanll(&p);
+        }
+
+        p = procfs_findkey(samplebuf, "nonvoluntary_ctxt_switches");
+        if(p != NULL)
+        {
+            pinfodisp->ctxtsw_nonvoluntary[spindex] = procfs_scanll(&p);
+        }
+
+        p = procfs_findkey(samplebuf, "VmRSS");
+        if(p != NULL)
+        {
+            pinfodisp->VmRSSarray[spindex] = procfs_scanll(&p);
+        }
+
+        if(spindex == 0)
+        {
+            p = procfs_findkey(samplebuf, "Cpus_allowed_list");
+            if(p != NULL)
+            {
+                procfs_scanstr(&p,
+                               pinfodisp->cpusallowed,
+                               sizeof(pinfodisp->cpusallowed));
+            }
+        }
+    }
+
+    // cpuset
+    if(spindex == 0)
+    {
+        if(PIDsampleTask_pread(task, task->fd_cpuset, "cpuset") > 0)
+        {
+            p = samplebuf;
+            procfs_scanstr(&p, pinfodisp->cpuset, sizeof(pinfodisp->cpuset));
+        }
+    }
+
+    pinfodisp->memload = 0.0;
+
+    return 0;
+}
+
+
+
+
+/**
+ * @brief Sample all threads of all displayed processes
+ *
+ * Thread lists must have been built by PIDcollectSystemInfo().
+ * Processes which have gone away get psysinfostatus = -1.
+ * Other read errors skip the sample, the process stays displayed.
+ *
+ * @return number of threads sampled
+ */
+int PIDsampleTasks(PROCINFOPROC *pinfop)
+{
+    int NBsampled = 0;
+
+    DEBUG_TRACEPOINT(" ");
+
+    if(NBtasksample < pinfop->NBpinfodisp * MAXNBSUBPROCESS)
+    {
+        // display size changed : start over
+        PIDsampleTasks_close();
+
+        // leave half of descriptor limit to the rest of the process
+        struct rlimit rlim;
+        MAXcachedfd = PIDSAMPLE_MAXCACHEDFD;
+        if((getrlimit(RLIMIT_NOFILE, &rlim) == 0) &&
+                (rlim.rlim_cur != RLIM_INFINITY) &&
+                ((long)(rlim.rlim_cur / 2) < MAXcachedfd))
+        {
+            MAXcachedfd = rlim.rlim_cur / 2;
+        }
+
+        NBtasksample    = pinfop->NBpinfodisp * MAXNBSUBPROCESS;
+        tasksamplearray = (PIDSAMPLE_TASK *) malloc(sizeof(PIDSAMPLE_TASK) *
+                          NBtasksample);
+        if(tasksamplearray == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        for(long tindex = 0; tindex < NBtasksample; tindex++)
+        {
+            tasksamplearray[tindex].PID          = 0;
+            tasksamplearray[tindex].TID          = 0;
+            tasksamplearray[tindex].cached       = 0;
+            tasksamplearray[tindex].fd_stat      = -1;
+            tasksamplearray[tindex].fd_status    = -1;
+            tasksamplearray[tindex].fd_schedstat = -1;
+            tasksamplearray[tindex].fd_sched     = -1;
+            tasksamplearray[tindex].fd_cpuset    = -1;
+        }
+    }
+
+    for(long pdispindex = 0; pdispindex < pinfop->NBpinfodisp; pdispindex++)
+    {
+        PROCESSINFODISP *pinfodisp = &(pinfop->pinfodisp[pdispindex]);
+        int              NBsubproc = 0;
+
+        if((pinfop->pindexActive[pdispindex] != 0) &&
+                (pinfop->psysinfostatus[pdispindex] != -1))
+        {
+            NBsubproc = pinfodisp->NBsubprocesses;
+        }
+
+        for(int spindex = 0; spindex < MAXNBSUBPROCESS; spindex++)
+        {
+            PIDSAMPLE_TASK *task =
+                &tasksamplearray[pdispindex * MAXNBSUBPROCESS + spindex];
+
+            if(spindex >= NBsubproc)
+            {
+                // release descriptors of threads no longer displayed
+                if(task->TID != 0)
+                {
+                    PIDsampleTask_close(task);
+                }
+                continue;
+            }
+
+            pid_t TID = pinfodisp->subprocPIDarray[spindex];
+            if((task->PID != pinfodisp->PID) || (task->TID != TID))
+            {
+                if(PIDsampleTask_open(task, pinfodisp->PID, TID) == -1)
+                {
+                    if(spindex == 0)
+                    {
+                        pinfop->psysinfostatus[pdispindex] = -1;
+                        break;
+                    }
+                    continue;
+                }
+            }
+
+            if(PIDsampleTask_read(task, pinfodisp, spindex) == -1)
+            {
+                if((errno != ENOENT) && (errno != ESRCH))
+                {
+                    // transient error : skip sample
+                    continue;
+                }
+                PIDsampleTask_close(task);
+                if(spindex == 0)
+                {
+                    pinfop->psysinfostatus[pdispindex] = -1;
+                    break;
+                }
+                continue;
+            }
+            NBsampled++;
+        }
+    }
+
+    DEBUG_TRACEPOINT(" ");
+
+    return NBsampled;
+}
+
+
+
+
+/**
+ * @brief Close all file descriptors held by sampler
+ */
+void PIDsampleTasks_close()
+{
+    if(tasksamplearray != NULL)
+    {
+        for(long tindex = 0; tindex < NBtasksample; tindex++)
+        {
+            PIDsampleTask_close(&tasksamplearray[tindex]);
+        }
+        free(tasksamplearray);
+        tasksamplearray = NULL;
+    }
+    NBtasksample = 0;
+}
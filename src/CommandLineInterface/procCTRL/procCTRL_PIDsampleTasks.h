@@ -0,0 +1,8 @@
+#ifndef _PIDSAMPLETASKS_H
+#define _PIDSAMPLETASKS_H
+
+int PIDsampleTasks(PROCINFOPROC *pinfop);
+
+void PIDsampleTasks_close();
+
+#endif
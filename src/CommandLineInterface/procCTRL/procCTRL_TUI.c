@@ -68,6 +68,7 @@ typedef int errno_t;
 
 #include "procCTRL/procCTRL_PIDcollectSystemInfo.h"
 #include "procCTRL/procCTRL_GetCPUloads.h"
+#include "procCTRL/procCTRL_PIDsampleTasks.h"
 #include "procCTRL/procCTRL_GetNumberCPUs.h"
 #include "procCTRL/procCTRL_processinfo_scan.h"
 
@@ -528,6 +529,9 @@ errno_t processinfo_CTRLscreen()
             procinfoproc.pinfodisp[pinfodispindex]
             .ctxtsw_nonvoluntary_prev[spi] = 0;
 
+            procinfoproc.pinfodisp[pinfodispindex].migrations[spi]      = 0;
+            procinfoproc.pinfodisp[pinfodispindex].migrations_prev[spi] = 0;
+
             procinfoproc.pinfodisp[pinfodispindex].cpuloadcntarray[spi] = 0;
             procinfoproc.pinfodisp[pinfodispindex].cpuloadcntarray_prev[spi] =
                 0;
@@ -1725,7 +1729,7 @@ errno_t processinfo_CTRLscreen()
                     // Print CPU LOAD
                     TUI_printfw(
                         " %*.*s %*.*s %-*.*s PR %-*.*s  #T  "
-                        "ctxsw   ",
+                        "ctxsw   mig ",
                         pstrlen_status,
                         pstrlen_status,
                         "STATUS",
@@ -2372,6 +2376,32 @@ errno_t processinfo_CTRLscreen()
                                         {
                                             attroff(COLOR_PAIR(3));
                                         }
+
+                                        // CPU migrations
+                                        if(procinfoproc.pinfodisp[pindex]
+                                                .migrations_prev[spindex] !=
+                                                procinfoproc.pinfodisp[pindex]
+                                                .migrations[spindex])
+                                        {
+                                            attron(COLOR_PAIR(4));
+                                        }
+                                        snprintf(
+                                            string,
+                                            stringlen,
+                                            " +%02ld",
+                                            labs(procinfoproc.pinfodisp[pindex]
+                                                 .migrations[spindex] -
+                                                 procinfoproc.pinfodisp[pindex]
+                                                 .migrations_prev[spindex]) %
+                                            100);
+                                        TUI_printfw("%s", string);
+                                        if(procinfoproc.pinfodisp[pindex]
+                                                .migrations_prev[spindex] !=
+                                                procinfoproc.pinfodisp[pindex]
+                                                .migrations[spindex])
+                                        {
+                                            attroff(COLOR_PAIR(4));
+                                        }
                                         TUI_printfw(" ");
 #endif
 
@@ -3082,6 +3112,9 @@ errno_t processinfo_CTRLscreen()
     }
 
     // cleanup
+    PIDsampleTasks_close();
+    GetCPUloads_close();
+
     for(pindex = 0; pindex < procinfoproc.NBpinfodisp; pindex++)
     {
         if(procinfoproc.pinfommapped[pindex] == 1)
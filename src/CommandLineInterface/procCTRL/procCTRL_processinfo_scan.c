@@ -12,6 +12,8 @@
 
 #include "procCTRL_PIDcollectSystemInfo.h"
 #include "procCTRL_GetCPUloads.h"
+#include "procCTRL_procfs.h"
+#include "procCTRL_PIDsampleTasks.h"
 
 #include "processinfo/processinfo_procdirname.h"
 
@@ -462,7 +464,7 @@ void *processinfo_scan(void *thptr)
             GetCPUloads(pinfop);
             pinfop->scandebugline = __LINE__;
 
-            // collect required info for display
+            // build thread lists, keep previous sample for rates
             {
                 long pdispindex = 0;
                 while(pdispindex < pinfop->NBpinfodisp)
@@ -484,147 +486,41 @@ void *processinfo_scan(void *thptr)
                             if(pinfop->pinfodisp[pdispindex].NBsubprocesses !=
                                     0)
                             {
-
-                                int spindex; // sub process index, 0 for main
+                                PROCESSINFODISP *pinfodisp =
+                                    &(pinfop->pinfodisp[pdispindex]);
 
                                 if(pinfop->psysinfostatus[pdispindex] != -1)
                                 {
-                                    for(spindex = 0;
-                                            spindex < pinfop->pinfodisp[pdispindex]
-                                            .NBsubprocesses;
+                                    for(int spindex = 0;
+                                            spindex < pinfodisp->NBsubprocesses;
                                             spindex++)
                                     {
                                         // place info in subprocess arrays
-                                        pinfop->pinfodisp[pdispindex]
-                                        .sampletimearray_prev[spindex] =
-                                            pinfop->pinfodisp[pdispindex]
-                                            .sampletimearray[spindex];
+                                        pinfodisp->sampletimearray_prev[spindex] =
+                                            pinfodisp->sampletimearray[spindex];
+
                                         // Context Switches
+                                        pinfodisp->ctxtsw_voluntary_prev[spindex] =
+                                            pinfodisp->ctxtsw_voluntary[spindex];
+                                        pinfodisp
+                                        ->ctxtsw_nonvoluntary_prev[spindex] =
+                                            pinfodisp->ctxtsw_nonvoluntary[spindex];
 
-                                        pinfop->pinfodisp[pdispindex]
-                                        .ctxtsw_voluntary_prev[spindex] =
-                                            pinfop->pinfodisp[pdispindex]
-                                            .ctxtsw_voluntary[spindex];
-                                        pinfop->pinfodisp[pdispindex]
-                                        .ctxtsw_nonvoluntary_prev[spindex] =
-                                            pinfop->pinfodisp[pdispindex]
-                                            .ctxtsw_nonvoluntary[spindex];
+                                        // Migrations
+                                        pinfodisp->migrations_prev[spindex] =
+                                            pinfodisp->migrations[spindex];
 
                                         // CPU use
-                                        pinfop->pinfodisp[pdispindex]
-                                        .cpuloadcntarray_prev[spindex] =
-                                            pinfop->pinfodisp[pdispindex]
-                                            .cpuloadcntarray[spindex];
+                                        pinfodisp->cpuloadcntarray_prev[spindex] =
+                                            pinfodisp->cpuloadcntarray[spindex];
                                     }
                                 }
 
                                 pinfop->scandebugline = __LINE__;
 
                                 pinfop->psysinfostatus[pdispindex] =
-                                    PIDcollectSystemInfo(
-                                        &(pinfop->pinfodisp[pdispindex]),
-                                        0);
-
-                                if(pinfop->psysinfostatus[pdispindex] != -1)
-                                {
-                                    char cpuliststring[200];
-                                    char cpustring[16];
-
-                                    for(spindex = 0;
-                                            spindex < pinfop->pinfodisp[pdispindex]
-                                            .NBsubprocesses;
-                                            spindex++)
-                                    {
-                                        if(pinfop->pinfodisp[pdispindex]
-                                                .sampletimearray[spindex] !=
-                                                pinfop->pinfodisp[pdispindex]
-                                                .sampletimearray_prev[spindex])
-                                        {
-                                            // get CPU and MEM load
-
-                                            // THIS DOES NOT WORK ON TICKLESS KERNEL
-                                            pinfop->pinfodisp[pdispindex]
-                                            .subprocCPUloadarray[spindex] =
-                                                100.0 *
-                                                ((1.0 * pinfop
-                                                  ->pinfodisp
-                                                  [pdispindex]
-                                                  .cpuloadcntarray
-                                                  [spindex] -
-                                                  pinfop->pinfodisp[pdispindex]
-                                                  .cpuloadcntarray_prev
-                                                  [spindex]) /
-                                                 sysconf(_SC_CLK_TCK)) /
-                                                (pinfop->pinfodisp[pdispindex]
-                                                 .sampletimearray[spindex] -
-                                                 pinfop->pinfodisp[pdispindex]
-                                                 .sampletimearray_prev
-                                                 [spindex]);
-
-                                            pinfop->pinfodisp[pdispindex]
-                                            .subprocCPUloadarray_timeaveraged
-                                            [spindex] =
-                                                0.9 *
-                                                pinfop
-                                                ->pinfodisp[pdispindex]
-                                                .subprocCPUloadarray_timeaveraged
-                                                [spindex] +
-                                                0.1 *
-                                                pinfop
-                                                ->pinfodisp[pdispindex]
-                                                .subprocCPUloadarray
-                                                [spindex];
-                                        }
-                                    }
-
-                                    snprintf(cpuliststring,
-                                             200,
-                                             ",%s,",
-                                             pinfop->pinfodisp[pdispindex]
-                                             .cpusallowed);
-
-                                    pinfop->scandebugline = __LINE__;
-
-                                    int cpu;
-                                    for(cpu = 0; cpu < pinfop->NBcpus; cpu++)
-                                    {
-                                        int cpuOK = 0;
-                                        int cpumin, cpumax;
-
-                                        snprintf(cpustring,
-                                                 16,
-                                                 ",%d,",
-                                                 pinfop->CPUids[cpu]);
-                                        if(strstr(cpuliststring, cpustring) !=
-                                                NULL)
-                                        {
-                                            cpuOK = 1;
-                                        }
-
-                                        for(cpumin = 0;
-                                                cpumin <= pinfop->CPUids[cpu];
-                                                cpumin++)
-                                            for(cpumax = pinfop->CPUids[cpu];
-                                                    cpumax < pinfop->NBcpus;
-                                                    cpumax++)
-                                            {
-                                                SNPRINTF_CHECK(cpustring,
-                                                               16,
-                                                               ",%d-%d,",
-                                                               cpumin,
-                                                               cpumax);
-                                                if(strstr(cpuliststring,
-                                                          cpustring) != NULL)
-                                                {
-                                                    cpuOK = 1;
-                                                }
-                                            }
-                                        pinfop->pinfodisp[pdispindex]
-                                        .cpuOKarray[cpu] = cpuOK;
-                                    }
-                                }
+                                    PIDcollectSystemInfo(pinfodisp, 0);
                             }
-                            //pdispindex++;
                         }
                         pdispindex++;
                     }
@@ -637,6 +533,62 @@ void *processinfo_scan(void *thptr)
                 }
             }
 
+            // sample all threads in one pass
+            pinfop->scandebugline = __LINE__;
+            PIDsampleTasks(pinfop);
+            pinfop->scandebugline = __LINE__;
+
+            // derived quantities for display
+            for(long pdispindex = 0; pdispindex < pinfop->NBpinfodisp;
+                    pdispindex++)
+            {
+                PROCESSINFODISP *pinfodisp = &(pinfop->pinfodisp[pdispindex]);
+
+                if((pinfop->pindexActive[pdispindex] == 0) ||
+                        (pinfodisp->NBsubprocesses == 0) ||
+                        (pinfop->psysinfostatus[pdispindex] == -1))
+                {
+                    continue;
+                }
+
+                char cpumask[MAXNBCPU];
+
+                for(int spindex = 0; spindex < pinfodisp->NBsubprocesses;
+                        spindex++)
+                {
+                    if(pinfodisp->sampletimearray[spindex] !=
+                            pinfodisp->sampletimearray_prev[spindex])
+                    {
+                        // get CPU load
+                        // cpuloadcntarray is CPU time in ns
+                        pinfodisp->subprocCPUloadarray[spindex] =
+                            100.0 *
+                            (1.0e-9 * (pinfodisp->cpuloadcntarray[spindex] -
+                                       pinfodisp->cpuloadcntarray_prev[spindex])) /
+                            (pinfodisp->sampletimearray[spindex] -
+                             pinfodisp->sampletimearray_prev[spindex]);
+
+                        pinfodisp->subprocCPUloadarray_timeaveraged[spindex] =
+                            0.9 * pinfodisp
+                            ->subprocCPUloadarray_timeaveraged[spindex] +
+                            0.1 * pinfodisp->subprocCPUloadarray[spindex];
+                    }
+                }
+
+                procfs_cpulistmask(pinfodisp->cpusallowed, cpumask, MAXNBCPU);
+
+                pinfop->scandebugline = __LINE__;
+
+                for(int cpu = 0; cpu < pinfop->NBcpus; cpu++)
+                {
+                    int cpuid = pinfop->CPUids[cpu];
+
+                    pinfodisp->cpuOKarray[cpu] =
+                        ((cpuid >= 0) && (cpuid < MAXNBCPU)) ? cpumask[cpuid]
+                        : 0;
+                }
+            }
+
             pinfop->scandebugline = __LINE__;
 
         } // end of DisplayMode PROCCTRL_DISPLAYMODE_RESOURCES
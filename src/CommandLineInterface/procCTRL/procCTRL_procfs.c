@@ -0,0 +1,240 @@
+/**
+ * @file    procCTRL_procfs.c
+ * @brief   Zero-allocation readers for /proc pseudo-files
+ *
+ * /proc files are kept open by the caller and re-read from offset 0
+ * with pread() into fixed buffers. The scanner functions below walk
+ * the buffer in place : no malloc, no stdio, no sscanf.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "procCTRL_procfs.h"
+
+
+
+/**
+ * @brief Open /proc file for repeated pread() sampling
+ *
+ * @return file descriptor, -1 if file cannot be opened
+ */
+int procfs_open(const char *fname)
+{
+    return open(fname, O_RDONLY | O_CLOEXEC);
+}
+
+
+
+void procfs_close(int *fd)
+{
+    if(*fd != -1)
+    {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+
+
+/**
+ * @brief Re-read whole /proc file into buf, NUL-terminated
+ *
+ * /proc files are regenerated on each read from offset 0, so the same
+ * file descriptor can be sampled any number of times.
+ *
+ * @return number of bytes read, -1 on error (file has gone away)
+ */
+ssize_t procfs_pread(int fd, char *buf, size_t bufsize)
+{
+    size_t nbread = 0;
+
+    if(fd == -1)
+    {
+        return -1;
+    }
+
+    while(nbread < bufsize - 1)
+    {
+        ssize_t ret = pread(fd, buf + nbread, bufsize - 1 - nbread, nbread);
+        if(ret < 0)
+        {
+            buf[0] = '\0';
+            return -1;
+        }
+        if(ret == 0)
+        {
+            break;
+        }
+        nbread += ret;
+    }
+    buf[nbread] = '\0';
+
+    return nbread;
+}
+
+
+
+/**
+ * @brief Skip nbfields whitespace-separated fields
+ */
+const char *procfs_skipfields(const char *p, int nbfields)
+{
+    for(int field = 0; field < nbfields; field++)
+    {
+        while((*p == ' ') || (*p == '\t'))
+        {
+            p++;
+        }
+        while((*p != ' ') && (*p != '\t') && (*p != '\n') && (*p != '\0'))
+        {
+            p++;
+        }
+    }
+    return p;
+}
+
+
+
+/**
+ * @brief Scan signed integer, advance pointer past it
+ *
+ * Leading blanks and ':' separators are skipped.
+ */
+long long procfs_scanll(const char **pp)
+{
+    const char *p    = *pp;
+    long long   val  = 0;
+    int         sign = 1;
+
+    while((*p == ' ') || (*p == '\t') || (*p == ':'))
+    {
+        p++;
+    }
+    if(*p == '-')
+    {
+        sign = -1;
+        p++;
+    }
+    while((*p >= '0') && (*p <= '9'))
+    {
+        val = 10 * val + (*p - '0');
+        p++;
+    }
+
+    *pp = p;
+    return sign * val;
+}
+
+
+
+/**
+ * @brief Copy next whitespace-delimited token to outstr
+ *
+ * @return number of characters copied
+ */
+int procfs_scanstr(const char **pp, char *outstr, size_t outstrlen)
+{
+    const char *p = *pp;
+    size_t      n = 0;
+
+    while((*p == ' ') || (*p == '\t') || (*p == ':'))
+    {
+        p++;
+    }
+    while((*p != ' ') && (*p != '\t') && (*p != '\n') && (*p != '\0'))
+    {
+        if(n < outstrlen - 1)
+        {
+            outstr[n] = *p;
+            n++;
+        }
+        p++;
+    }
+    outstr[n] = '\0';
+
+    *pp = p;
+    return n;
+}
+
+
+
+/**
+ * @brief Find "key : value" line, return pointer to value
+ *
+ * Key must appear at start of line and be followed by blank or ':'.
+ *
+ * @return pointer past ':' separator, NULL if key not found
+ */
+const char *procfs_findkey(const char *buf, const char *key)
+{
+    size_t      keylen = strlen(key);
+    const char *line   = buf;
+
+    while((line != NULL) && (*line != '\0'))
+    {
+        if((strncmp(line, key, keylen) == 0) &&
+                ((line[keylen] == ':') || (line[keylen] == ' ') ||
+                 (line[keylen] == '\t')))
+        {
+            const char *p = line + keylen;
+            while((*p != ':') && (*p != '\n') && (*p != '\0'))
+            {
+                p++;
+            }
+            if(*p == ':')
+            {
+                return p + 1;
+            }
+        }
+
+        line = strchr(line, '\n');
+        if(line != NULL)
+        {
+            line++;
+        }
+    }
+
+    return NULL;
+}
+
+
+
+/**
+ * @brief Parse CPU list such as "0-3,8,10-11" into mask
+ *
+ * mask[cpu] = 1 for listed CPUs below masksize, 0 for others.
+ * Single pass over string, replaces per-CPU string matching.
+ *
+ * @return number of CPUs set in mask
+ */
+int procfs_cpulistmask(const char *str, char *mask, int masksize)
+{
+    const char *p     = str;
+    int         nbset = 0;
+
+    memset(mask, 0, masksize);
+
+    while((*p >= '0') && (*p <= '9'))
+    {
+        long long cpumin = procfs_scanll(&p);
+        long long cpumax = cpumin;
+        if(*p == '-')
+        {
+            p++;
+            cpumax = procfs_scanll(&p);
+        }
+        for(long long cpu = cpumin; (cpu <= cpumax) && (cpu < masksize); cpu++)
+        {
+            nbset += (mask[cpu] == 0);
+            mask[cpu] = 1;
+        }
+        if(*p == ',')
+        {
+            p++;
+        }
+    }
+
+    return nbset;
+}
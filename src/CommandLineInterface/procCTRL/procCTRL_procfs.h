@@ -0,0 +1,25 @@
+#ifndef _PROCCTRL_PROCFS_H
+#define _PROCCTRL_PROCFS_H
+
+#include <sys/types.h>
+
+// buffer size for per-task /proc files (stat, status, sched)
+#define PROCFS_TASKBUFSIZE 4096
+
+int procfs_open(const char *fname);
+
+void procfs_close(int *fd);
+
+ssize_t procfs_pread(int fd, char *buf, size_t bufsize);
+
+const char *procfs_skipfields(const char *p, int nbfields);
+
+long long procfs_scanll(const char **pp);
+
+int procfs_scanstr(const char **pp, char *outstr, size_t outstrlen);
+
+const char *procfs_findkey(const char *buf, const char *key);
+
+int procfs_cpulistmask(const char *str, char *mask, int masksize);
+
+#endif
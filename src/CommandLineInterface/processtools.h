@@ -32,7 +32,7 @@
 #define PROCESSINFOLISTSIZE 50000
 
 #define MAXNBSUBPROCESS 50
-#define MAXNBCPU        100
+#define MAXNBCPU        256
 
 #ifndef __STDC_LIB_EXT1__
 typedef int errno_t;
@@ -92,7 +92,10 @@ typedef struct
     long ctxtsw_voluntary_prev[MAXNBSUBPROCESS];
     long ctxtsw_nonvoluntary_prev[MAXNBSUBPROCESS];
 
-    long long cpuloadcntarray[MAXNBSUBPROCESS];
+    long migrations[MAXNBSUBPROCESS]; // CPU migrations count
+    long migrations_prev[MAXNBSUBPROCESS];
+
+    long long cpuloadcntarray[MAXNBSUBPROCESS]; // CPU time [ns]
     long long cpuloadcntarray_prev[MAXNBSUBPROCESS];
     float     subprocCPUloadarray[MAXNBSUBPROCESS];
     float     subprocCPUloadarray_timeaveraged[MAXNBSUBPROCESS];
@@ -0,0 +1 @@
+#include "milk_config.h"